@@ -587,8 +587,11 @@ static int gen_version;
 #define MATH_PRECISION(inst)       GEN_BITS_FIELD(inst, bits3.math_gen5.precision)
 #define COND_DST_OR_MODIFIER(inst) GEN_BITS_FIELD(inst, header.destreg_or_condmod)
 #define EXECUTION_SIZE(inst)       GEN_BITS_FIELD(inst, header.execution_size)
-#define BRANCH_JIP(inst)           GEN_BITS_FIELD2(inst, bits3.gen7_branch.jip, bits3.gen8_branch.jip/8)
-#define BRANCH_UIP(inst)           GEN_BITS_FIELD2(inst, bits3.gen7_branch.uip, bits2.gen8_branch.uip/8)
+/* Gen8 offsets are signed bytes, divide them as such to also print backward jumps */
+#define BRANCH_JIP(inst)           (gen_version < 80 ? GEN7_BITS_FIELD(inst, bits3.gen7_branch.jip) : \
+                                    GEN8_BITS_FIELD(inst, bits3.gen8_branch.jip) / 8)
+#define BRANCH_UIP(inst)           (gen_version < 80 ? GEN7_BITS_FIELD(inst, bits3.gen7_branch.uip) : \
+                                    GEN8_BITS_FIELD(inst, bits2.gen8_branch.uip) / 8)
 #define VME_BTI(inst)              GEN7_BITS_FIELD(inst, bits3.vme_gen7.bti)
 #define VME_MSG_TYPE(inst)         GEN7_BITS_FIELD(inst, bits3.vme_gen7.msg_type)
 #define IME_BTI(inst)              GEN8_BITS_FIELD(inst, bits3.ime_gen8.bti)
@@ -766,6 +769,8 @@ static int dest(FILE *file, const void* inst)
       err |= reg(file, GEN_BITS_FIELD(inst, bits1.da1.dest_reg_file),
                  GEN_BITS_FIELD(inst, bits1.da1.dest_reg_nr));
       if (err == -1) {
+        if (GEN_BITS_FIELD(inst, bits1.da1.dest_horiz_stride) != GEN_HORIZONTAL_STRIDE_1)
+          format(file, "<%s>", horiz_stride[GEN_BITS_FIELD(inst, bits1.da1.dest_horiz_stride)]);
         control(file, "dest reg encoding", reg_encoding, GEN_BITS_FIELD(inst, bits1.da1.dest_reg_type), NULL);
         return 0;
       }
@@ -775,12 +780,14 @@ static int dest(FILE *file, const void* inst)
       format(file, "<%s>", horiz_stride[GEN_BITS_FIELD(inst, bits1.da1.dest_horiz_stride)]);
       err |= control(file, "dest reg encoding", reg_encoding, GEN_BITS_FIELD(inst, bits1.da1.dest_reg_type), NULL);
     } else {
+      int32_t imm_off = GEN_BITS_FIELD(inst, bits1.ia1.dest_indirect_offset);
+      if (gen_version >= 80)
+        imm_off += ((const union Gen8NativeInstruction *)inst)->bits1.ia1.dest_indirect_offset_9 << 9;
       string(file, "g[a0");
       if (GEN_BITS_FIELD(inst, bits1.ia1.dest_subreg_nr))
-        format(file, ".%d", GEN_BITS_FIELD(inst, bits1.ia1.dest_subreg_nr) /
-               reg_type_size[GEN_BITS_FIELD(inst, bits1.ia1.dest_reg_type)]);
-      if (GEN_BITS_FIELD(inst, bits1.ia1.dest_indirect_offset))
-        format(file, " %d", GEN_BITS_FIELD(inst, bits1.ia1.dest_indirect_offset));
+        format(file, ".%d", GEN_BITS_FIELD(inst, bits1.ia1.dest_subreg_nr));
+      if (imm_off)
+        format(file, " %d", imm_off);
       string(file, "]");
       format(file, "<%s>", horiz_stride[GEN_BITS_FIELD(inst, bits1.ia1.dest_horiz_stride)]);
       err |= control(file, "dest reg encoding", reg_encoding, GEN_BITS_FIELD(inst, bits1.ia1.dest_reg_type), NULL);
@@ -791,8 +798,8 @@ static int dest(FILE *file, const void* inst)
       if (err == -1)
         return 0;
       if (GEN_BITS_FIELD(inst, bits1.da16.dest_subreg_nr))
-        format(file, ".%d", GEN_BITS_FIELD(inst, bits1.da16.dest_subreg_nr) /
-               reg_type_size[GEN_BITS_FIELD(inst, bits1.da16.dest_reg_type)]);
+        /* same byte addressing as the da16 sources */
+        format(file, ".%d", 16 / reg_type_size[GEN_BITS_FIELD(inst, bits1.da16.dest_reg_type)]);
       string(file, "<1>");
 
       if (is_special_acc(inst)) {
@@ -858,9 +865,9 @@ static int src_da1(FILE *file, uint32_t type, uint32_t _reg_file,
   err |= control(file, "negate", negate, _negate, NULL);
   err |= control(file, "abs", _abs, __abs, NULL);
 
-  err |= reg(file, _reg_file, reg_num);
-  if (err == -1)
-    return 0;
+  /* null and ip also get their region and type, the assembler needs them */
+  if (reg(file, _reg_file, reg_num) > 0)
+    err = 1;
   if (sub_reg_num)
     format(file, ".%d", sub_reg_num / reg_type_size[type]); /* use formal style like spec */
   src_align1_region(file, _vert_stride, _width, _horiz_stride);
@@ -912,9 +919,8 @@ static int src_da16(FILE *file, const void* inst, int src_num,
   err |= control(file, "negate", negate, _negate, NULL);
   err |= control(file, "abs", _abs, __abs, NULL);
 
-  err |= reg(file, _reg_file, _reg_nr);
-  if (err == -1)
-    return 0;
+  if (reg(file, _reg_file, _reg_nr) > 0)
+    err = 1;
   if (_subreg_nr)
     /* bit4 for subreg number byte addressing. Make this same meaning as
        in da1 case, so output looks consistent. */
@@ -931,6 +937,7 @@ static int src_da16(FILE *file, const void* inst, int src_num,
       assert(src_num == 1);
       err |= control(file, "specialacc", special_acc, ((const union Gen8NativeInstruction *)inst)->bits3.da16acc.src1_special_acc_lo, NULL);
     }
+    err |= control(file, "src da16 reg type", reg_encoding, _reg_type, NULL);
     return err;
   }
 
@@ -1036,6 +1043,8 @@ static int src1_3src(FILE *file, const void* inst)
 
   if (gen_version < 80) {
     err |= control(file, "src da16 reg type", reg_encoding, GEN_TYPE_F, NULL);
+  } else if (((const union Gen8NativeInstruction *)inst)->bits1.da3src.src1_type) {
+    string(file, ":HF");
   } else {
     err |= control(file, "src da16 reg type", reg_encoding_3src, ((const union Gen8NativeInstruction *)inst)->bits1.da3src.src_type, NULL);
   }
@@ -1089,6 +1098,8 @@ static int src2_3src(FILE *file, const void* inst)
 
   if (gen_version < 80) {
     err |= control(file, "src da16 reg type", reg_encoding, GEN_TYPE_F, NULL);
+  } else if (((const union Gen8NativeInstruction *)inst)->bits1.da3src.src2_type) {
+    string(file, ":HF");
   } else {
     err |= control(file, "src da16 reg type", reg_encoding_3src, ((const union Gen8NativeInstruction *)inst)->bits1.da3src.src_type, NULL);
   }
@@ -1173,8 +1184,51 @@ static uint32_t __conv_half_to_float(uint16_t h)
   return f;
 }
 
-static int imm(FILE *file, uint32_t type, const void* inst)
+/* Print a float so that reading it back gives the very same bits */
+static int float_imm(FILE *file, float f, const char *suffix)
 {
+  char buf[64];
+  uint32_t u, v;
+  float back;
+
+  memcpy(&u, &f, sizeof(u));
+  if (((u >> 23) & 0xff) == 0xff)
+    return format(file, "0x%08x%s", u, suffix);
+  snprintf(buf, sizeof(buf), "%-g", f);
+  back = strtof(buf, NULL);
+  memcpy(&v, &back, sizeof(v));
+  if (u != v)
+    snprintf(buf, sizeof(buf), "%.9g", f);
+  return format(file, "%s%s", buf, suffix);
+}
+
+static int double_imm(FILE *file, uint64_t u)
+{
+  char buf[64];
+  double d, back;
+
+  memcpy(&d, &u, sizeof(d));
+  if (((u >> 52) & 0x7ff) == 0x7ff)
+    return format(file, "0x%016llxDF", (unsigned long long) u);
+  snprintf(buf, sizeof(buf), "%-g", d);
+  back = strtod(buf, NULL);
+  if (memcmp(&back, &d, sizeof(d)))
+    snprintf(buf, sizeof(buf), "%.17g", d);
+  return format(file, "%sDF", buf);
+}
+
+/* 64 bits immediates only fit in src0, src1 only has the low dword */
+static int imm(FILE *file, uint32_t type, const void* inst, int src_num)
+{
+  uint64_t lo = 0, hi = 0;
+  if (gen_version >= 80) {
+    if (src_num == 0) {
+      hi = (((const union Gen8NativeInstruction *)inst)->bits3).ud;
+      lo = (((const union Gen8NativeInstruction *)inst)->bits2).ud;
+    } else
+      lo = (((const union Gen8NativeInstruction *)inst)->bits3).ud;
+  }
+
   switch (type) {
     case GEN_TYPE_UD:
       format(file, "0x%xUD", GEN_BITS_FIELD(inst, bits3.ud));
@@ -1189,47 +1243,46 @@ static int imm(FILE *file, uint32_t type, const void* inst)
       format(file, "%dW", (int16_t) GEN_BITS_FIELD(inst, bits3.d));
       break;
     case GEN_TYPE_UB:
-      format(file, "0x%xUB", (int8_t) GEN_BITS_FIELD(inst, bits3.ud));
+      format(file, "0x%xUB", (uint8_t) GEN_BITS_FIELD(inst, bits3.ud));
       break;
     case GEN_TYPE_VF:
-      format(file, "Vector Float");
+      format(file, "0x%xVF", GEN_BITS_FIELD(inst, bits3.ud));
       break;
     case GEN_TYPE_V:
       format(file, "0x%xV", GEN_BITS_FIELD(inst, bits3.ud));
       break;
     case GEN_TYPE_F:
-      format(file, "%-gF", GEN_BITS_FIELD_WITH_TYPE(inst, bits3.f, float));
+      float_imm(file, GEN_BITS_FIELD_WITH_TYPE(inst, bits3.f, float), "F");
       break;
     case GEN_TYPE_UL:
       assert(!(gen_version < 80));
-      format(file, "0x%.8x %.8xUQ", (((const union Gen8NativeInstruction *)inst)->bits3).ud,
-                                (((const union Gen8NativeInstruction *)inst)->bits2).ud);
+      format(file, "0x%llxUQ", (unsigned long long) ((hi << 32) | lo));
       break;
     case GEN_TYPE_L:
-    {
       assert(!(gen_version < 80));
-      uint64_t val = (((const union Gen8NativeInstruction *)inst)->bits3).ud;
-      val = (val << 32) + ((((const union Gen8NativeInstruction *)inst)->bits2).ud);
-      format(file, "0x%lldQ", val);
-    }
+      format(file, "0x%llxQ", (unsigned long long) ((hi << 32) | lo));
+      break;
     case GEN_TYPE_HF_IMM:
     {
       uint16_t h = GEN_BITS_FIELD_WITH_TYPE(inst, bits3.d, uint16_t);
       uint32_t uf = __conv_half_to_float(h);
       float f;
+      if ((h & 0x7c00) == 0x7c00) {
+        format(file, "0x%04xHF", h);
+        break;
+      }
       memcpy(&f, &uf, sizeof(float));
-      format(file, "%-gHF", f);
+      float_imm(file, f, "HF");
       break;
     }
     case GEN_TYPE_DF_IMM:
     {
       assert(!(gen_version < 80));
-      double val;
-      uint32_t hi = (((const union Gen8NativeInstruction *)inst)->bits3).ud;
-      uint32_t lo = (((const union Gen8NativeInstruction *)inst)->bits2).ud;
-      memcpy((void *)(&val), &lo, sizeof(uint32_t));
-      memcpy(((void *)(&val) + sizeof(uint32_t)), &hi, sizeof(uint32_t));
-      format(file, "%f", val);
+      if (src_num == 0)
+        double_imm(file, (hi << 32) | lo);
+      else
+        format(file, "0x%llxDF", (unsigned long long) lo);
+      break;
     }
   }
   return 0;
@@ -1238,7 +1291,7 @@ static int imm(FILE *file, uint32_t type, const void* inst)
 static int src0(FILE *file, const void* inst)
 {
   if (GEN_BITS_FIELD(inst, bits1.da1.src0_reg_file) == GEN_IMMEDIATE_VALUE)
-    return imm(file, GEN_BITS_FIELD(inst, bits1.da1.src0_reg_type), inst);
+    return imm(file, GEN_BITS_FIELD(inst, bits1.da1.src0_reg_type), inst, 0);
   else if (ACCESS_MODE(inst) == GEN_ALIGN_1) {
     if (GEN_BITS_FIELD(inst, bits2.da1.src0_address_mode) == GEN_ADDRESS_DIRECT) {
       return src_da1(file,
@@ -1294,7 +1347,7 @@ static int src1(FILE *file, const void* inst)
 {
   if (GEN_BITS_FIELD2(inst, bits1.da1.src1_reg_file, bits2.da1.src1_reg_file) == GEN_IMMEDIATE_VALUE)
     return imm(file, GEN_BITS_FIELD2(inst, bits1.da1.src1_reg_type, bits2.da1.src1_reg_type),
-               inst);
+               inst, 1);
   else if (ACCESS_MODE(inst) == GEN_ALIGN_1) {
     if (GEN_BITS_FIELD(inst, bits3.da1.src1_address_mode) == GEN_ADDRESS_DIRECT) {
       return src_da1(file,
@@ -1308,10 +1361,13 @@ static int src1(FILE *file, const void* inst)
                      GEN_BITS_FIELD(inst, bits3.da1.src1_abs),
                      GEN_BITS_FIELD(inst, bits3.da1.src1_negate));
     } else {
+      int32_t imm_off = GEN_BITS_FIELD(inst, bits3.ia1.src1_indirect_offset);
+      if (gen_version >= 80)
+        imm_off += ((const union Gen8NativeInstruction *)inst)->bits3.ia1.src1_indirect_offset_9 << 9;
       return src_ia1(file,
                      GEN_BITS_FIELD2(inst, bits1.ia1.src1_reg_type, bits2.ia1.src1_reg_type),
                      GEN_BITS_FIELD2(inst, bits1.ia1.src1_reg_file, bits2.ia1.src1_reg_file),
-                     GEN_BITS_FIELD(inst, bits3.ia1.src1_indirect_offset),
+                     imm_off,
                      GEN_BITS_FIELD(inst, bits3.ia1.src1_subreg_nr),
                      GEN_BITS_FIELD(inst, bits3.ia1.src1_negate),
                      GEN_BITS_FIELD(inst, bits3.ia1.src1_abs),
@@ -1354,6 +1410,16 @@ static int qtr_ctrl(FILE *file, const void* inst)
 {
   int qtr_ctl = QUARTER_CONTROL(inst);
   int exec_size = esize[EXECUTION_SIZE(inst)];
+  int nib_ctl = gen_version >= 80 ? GEN8_BITS_FIELD(inst, header.nib_ctrl) : 0;
+
+  /* Narrow widths select their channels with the nibble control: 1N..8N */
+  if (exec_size <= 4 || (exec_size == 16 && ((qtr_ctl & 1) || nib_ctl))) {
+    if (exec_size == 4 || qtr_ctl || nib_ctl)
+      format(file, " %dN", qtr_ctl * 2 + nib_ctl + 1);
+    return 0;
+  }
+  if (nib_ctl)
+    string(file, " NibCtrl");
 
   if (exec_size == 8) {
     switch (qtr_ctl) {
@@ -1375,7 +1441,8 @@ static int qtr_ctrl(FILE *file, const void* inst)
       string(file, " 1H");
     else
       string(file, " 2H");
-  }
+  } else if (qtr_ctl)
+    format(file, " %dQ", qtr_ctl + 1);
   return 0;
 }
 
@@ -1446,12 +1513,19 @@ int gen_disasm (FILE *file, const void *inst, uint32_t deviceID, uint32_t compac
       reg(file, GEN_ARCHITECTURE_REGISTER_FILE, gen9_insn->bits1.sends.dest_reg_nr);
     else
       format(file, "g%d", gen9_insn->bits1.sends.dest_reg_nr);
+    if (gen9_insn->bits1.sends.dest_reg_type)
+      control(file, "dest reg encoding", reg_encoding, gen9_insn->bits1.sends.dest_reg_type, NULL);
     pad(file, 32);
     format(file, "g%d(addLen:%d)", gen9_insn->bits2.sends.src0_reg_nr, GENERIC_MSG_LENGTH(inst));
     pad(file, 48);
     format(file, "g%d(dataLen:%d)", gen9_insn->bits1.sends.src1_reg_nr, gen9_insn->bits2.sends.src1_length);
     pad(file, 64);
-    format(file, "0x%08x", gen9_insn->bits3.ud);
+    if (gen9_insn->bits2.sends.sel_reg32_desc && gen9_insn->bits3.ud == 0)
+      string(file, "a0.0");
+    else
+      format(file, "0x%08x", gen9_insn->bits3.ud);
+    if (gen9_insn->bits2.sends.exdesc_31_16)
+      format(file, " exdesc:0x%x", gen9_insn->bits2.sends.exdesc_31_16);
   } else if (opcode[OPCODE(inst)].nsrc == 3) {
     pad(file, 16);
     err |= dest_3src(file, inst);
@@ -1468,14 +1542,14 @@ int gen_disasm (FILE *file, const void *inst, uint32_t deviceID, uint32_t compac
     if (opcode[OPCODE(inst)].ndst > 0) {
       pad(file, 16);
       err |= dest(file, inst);
-    } else if (OPCODE(inst) == GEN_OPCODE_IF ||
-               OPCODE(inst) == GEN_OPCODE_ELSE ||
-               OPCODE(inst) == GEN_OPCODE_ENDIF ||
+    } else if (OPCODE(inst) == GEN_OPCODE_ENDIF ||
                OPCODE(inst) == GEN_OPCODE_WHILE ||
                OPCODE(inst) == GEN_OPCODE_BRD ||
                OPCODE(inst) == GEN_OPCODE_JMPI) {
       format(file, " %d", (int16_t)BRANCH_JIP(inst));
-    } else if (OPCODE(inst) == GEN_OPCODE_BREAK ||
+    } else if (OPCODE(inst) == GEN_OPCODE_IF ||
+               OPCODE(inst) == GEN_OPCODE_ELSE ||
+               OPCODE(inst) == GEN_OPCODE_BREAK ||
                OPCODE(inst) == GEN_OPCODE_CONTINUE ||
                OPCODE(inst) == GEN_OPCODE_HALT ||
                OPCODE(inst) == GEN_OPCODE_BRC) {
@@ -1650,6 +1724,13 @@ int gen_disasm (FILE *file, const void *inst, uint32_t deviceID, uint32_t compac
       err |= control(file, "thread control", thread_ctrl_gen8, THREAD_CONTROL(inst), &space);
     }
     err |= control(file, "acc write control", accwr, ACC_WR_CONTROL(inst), &space);
+    if (!PRED_CTRL(inst) && (FLAG_REG_NR(inst) || FLAG_SUB_REG_NR(inst)) &&
+        (COND_DST_OR_MODIFIER(inst) == 0 ||
+         OPCODE(inst) == GEN_OPCODE_MATH ||
+         OPCODE(inst) == GEN_OPCODE_SEND ||
+         OPCODE(inst) == GEN_OPCODE_SENDC ||
+         OPCODE(inst) == GEN_OPCODE_SENDS))
+      format(file, " f%d.%d", FLAG_REG_NR(inst), FLAG_SUB_REG_NR(inst));
     if (OPCODE(inst) == GEN_OPCODE_SEND ||
         OPCODE(inst) == GEN_OPCODE_SENDC)
       err |= control(file, "end of thread", end_of_thread,
@@ -30,6 +30,7 @@
 #include "backend/gen_insn_scheduling.hpp"
 #include "backend/gen_insn_selection_output.hpp"
 #include "backend/gen_reg_allocation.hpp"
+#include "backend/gen_insn_assembler.hpp"
 #include "backend/gen/gen_mesa_disasm.h"
 #include "ir/function.hpp"
 #include "ir/value.hpp"
@@ -38,9 +39,15 @@
 #include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
 
 namespace gbe
 {
+  extern uint32_t recompactInstructions(GenEncoder *p, vector<uint32_t> &posMap);
+  extern uint32_t peepholeInstructions(GenEncoder *p, vector<uint32_t> &posMap,
+                                       uint32_t &removedNum, uint32_t &fusedNum, uint32_t &hintNum);
+
   ///////////////////////////////////////////////////////////////////////////
   // GenContext implementation
   ///////////////////////////////////////////////////////////////////////////
@@ -95,6 +102,7 @@ namespace gbe
   }
 
   extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
+  extern int32_t OCL_OUTPUT_BUILD_LOG; // BVAR in program.cpp, an int32_t
 #define SET_GENINSN_DBGINFO(I) \
   if(OCL_DEBUGINFO) p->DBGInfo = I.DBGInfo;
       
@@ -161,6 +169,26 @@ namespace gbe
     return true;
   }
 
+  void GenContext::recompactInstructions(void) {
+    vector<uint32_t> posMap;
+    if (gbe::recompactInstructions(p, posMap) == 0)
+      return;
+    for (auto &label : labelPos)
+      label.second = posMap[label.second];
+  }
+
+  void GenContext::peepholeInstructions(GenKernel *genKernel) {
+    vector<uint32_t> posMap;
+    uint32_t removedNum, fusedNum, hintNum;
+    if (gbe::peepholeInstructions(p, posMap, removedNum, fusedNum, hintNum) == 0)
+      return;
+    for (auto &label : labelPos)
+      label.second = posMap[label.second];
+    genKernel->setStat(GBE_KERNEL_STAT_PEEPHOLE_REMOVED_NUM, removedNum);
+    genKernel->setStat(GBE_KERNEL_STAT_PEEPHOLE_FUSED_NUM, fusedNum);
+    genKernel->setStat(GBE_KERNEL_STAT_PEEPHOLE_HINT_NUM, hintNum);
+  }
+
   /* Get proper block ip register according to current label width. */
   GenRegister GenContext::getBlockIP(void) {
     GenRegister blockip;
@@ -3662,6 +3690,75 @@ namespace gbe
   BVAR(OCL_OUTPUT_SEL_IR, false);
   BVAR(OCL_OPTIMIZE_SEL_IR, true);
   BVAR(OCL_OPTIMIZE_IF_BLOCK, true);
+  BVAR(OCL_RECOMPACT_INSN, true);
+  BVAR(OCL_PEEPHOLE_INSN, true);
+  SVAR(OCL_KERNEL_ASM_DIR, "");
+  BVAR(OCL_CHECK_ASM_ROUNDTRIP, false);
+
+  bool GenContext::overrideInstructions(void) {
+    if (OCL_KERNEL_ASM_DIR.empty())
+      return false;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_0x%04x_simd%u.asm", deviceID, this->simdWidth);
+    const std::string path = OCL_KERNEL_ASM_DIR + "/" + name + suffix;
+    std::ifstream file(path.c_str());
+    if (!file.is_open())
+      return false;
+    std::stringstream text;
+    text << file.rdbuf();
+
+    vector<GenInstruction> insns;
+    std::string error;
+    if (!assembleGenISA(text.str().c_str(), deviceID, name.c_str(), insns, error)) {
+      std::cerr << path << ": " << error << ", keeping the generated code" << std::endl;
+      return false;
+    }
+    // Only the code changes, the curbe and the patch list are still the ones
+    // of this compile, so the override must read its payload at the same place
+    p->store = insns;
+    if (OCL_DEBUGINFO)
+      p->storedbg.resize(p->store.size());
+    labelPos.clear();
+    if (OCL_OUTPUT_BUILD_LOG)
+      std::cerr << name << ": instructions replaced by " << path << std::endl;
+    return true;
+  }
+
+  uint32_t GenContext::checkAssemblyRoundTrip(GenKernel *genKernel) {
+    char *buffer = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&buffer, &size);
+    if (file == NULL)
+      return 0;
+    outputAssembly(file, genKernel);
+    fclose(file);
+
+    vector<GenInstruction> insns;
+    std::string error;
+    const bool assembled = assembleGenISA(buffer, deviceID, genKernel->getName(), insns, error);
+    free(buffer);
+    if (!assembled) {
+      std::cerr << genKernel->getName() << ": assembly round trip failed, " << error << std::endl;
+      return 0;
+    }
+    if (insns.size() != genKernel->insnNum)
+      std::cerr << genKernel->getName() << ": assembly round trip gives " << insns.size()
+                << " slots instead of " << genKernel->insnNum << std::endl;
+    // Count the instructions which come back unchanged, up to the first difference
+    uint32_t insnNum = 0;
+    for (uint32_t insnID = 0; insnID < genKernel->insnNum; insnNum++) {
+      const GenCompactInstruction *insn = (const GenCompactInstruction *)&genKernel->insns[insnID];
+      const uint32_t slots = insn->bits1.cmpt_control ? 1 : 2;
+      if (insnID + slots > insns.size() ||
+          std::memcmp(&insns[insnID], &genKernel->insns[insnID], slots * sizeof(GenInstruction))) {
+        std::cerr << genKernel->getName() << ": assembly round trip differs at slot " << insnID << std::endl;
+        break;
+      }
+      insnID += slots;
+    }
+    return insnNum;
+  }
+
   bool GenContext::emitCode(void) {
     GenKernel *genKernel = static_cast<GenKernel*>(this->kernel);
     sel->select();
@@ -3681,6 +3778,7 @@ namespace gbe
     sel->addID();
     if (UNLIKELY(ra->allocate(*this->sel) == false))
       return false;
+    genKernel->setStat(GBE_KERNEL_STAT_BANK_CONFLICT_NUM, ra->getBankConflictNum());
     schedulePostRegAllocation(*this, *this->sel);
     if (OCL_OUTPUT_REG_ALLOC)
       ra->outputAllocation();
@@ -3693,9 +3791,26 @@ namespace gbe
     this->emitInstructionStream();
     if (this->patchBranches() == false)
       return false;
+    if (OCL_PEEPHOLE_INSN)
+      this->peepholeInstructions(genKernel);
+    if (OCL_RECOMPACT_INSN)
+      this->recompactInstructions();
+    if (IS_GEN8(deviceID) || IS_GEN9(deviceID))
+      this->overrideInstructions();
+    uint32_t insnNum = 0, compactNum = 0;
+    for (uint32_t insnID = 0; insnID < p->store.size(); insnNum++) {
+      const GenCompactInstruction *insn = (const GenCompactInstruction *)&p->store[insnID];
+      compactNum += insn->bits1.cmpt_control;
+      insnID += insn->bits1.cmpt_control ? 1 : 2;
+    }
+    genKernel->setStat(GBE_KERNEL_STAT_INSN_NUM, insnNum);
+    genKernel->setStat(GBE_KERNEL_STAT_COMPACT_INSN_NUM, compactNum);
     genKernel->insnNum = p->store.size();
     genKernel->insns = GBE_NEW_ARRAY_NO_ARG(GenInstruction, genKernel->insnNum);
     std::memcpy(genKernel->insns, &p->store[0], genKernel->insnNum * sizeof(GenInstruction));
+    // A dumped kernel is also checked, its dump is what an override starts from
+    if ((OCL_CHECK_ASM_ROUNDTRIP || this->asmFileName) && (IS_GEN8(deviceID) || IS_GEN9(deviceID)))
+      genKernel->setStat(GBE_KERNEL_STAT_ASM_ROUNDTRIP_NUM, checkAssemblyRoundTrip(genKernel));
     if (OCL_OUTPUT_ASM)
       outputAssembly(stdout, genKernel);
 
@@ -3729,12 +3844,17 @@ namespace gbe
     GenCompactInstruction * pCom = NULL;
     GenInstruction insn[2];
     fprintf(file, "  L0:\n");
+    // labels are gone once the code is replaced by an assembled override
+    auto isLabelAt = [&](ir::LabelIndex label, uint32_t insnID) {
+      auto it = labelPos.find(label);
+      return it != labelPos.end() && it->second == insnID;
+    };
     for (uint32_t insnID = 0; insnID < genKernel->insnNum; ) {
-      if (labelPos.find((ir::LabelIndex)(curLabel + 1))->second == insnID &&
+      if (isLabelAt((ir::LabelIndex)(curLabel + 1), insnID) &&
           curLabel < this->getFunction().labelNum()) {
         fprintf(file, "  L%i:\n", curLabel + 1);
         curLabel = (ir::LabelIndex)(curLabel + 1);
-        while(labelPos.find((ir::LabelIndex)(curLabel + 1))->second == insnID) {
+        while(isLabelAt((ir::LabelIndex)(curLabel + 1), insnID)) {
           fprintf(file, "  L%i:\n", curLabel + 1);
           curLabel = (ir::LabelIndex)(curLabel + 1);
         }
@@ -96,6 +96,10 @@ namespace gbe
     void emitInstructionStream(void);
     /*! Set the correct target values for the branches */
     virtual bool patchBranches(void);
+    /*! Remove or fuse useless MOVs and add dependency hints to the final code */
+    void peepholeInstructions(GenKernel *genKernel);
+    /*! Compact the instructions left native once the branches are patched */
+    void recompactInstructions(void);
     /*! Forward ir::Function isSpecialReg method */
     INLINE bool isSpecialReg(ir::Register reg) const {
       return fn.isSpecialReg(reg);
@@ -256,6 +260,12 @@ namespace gbe
     void buildPatchList(void);
     /* Helper for printing the assembly */
     void outputAssembly(FILE *file, GenKernel* genKernel);
+    /*! Replace the code with the assembled OCL_KERNEL_ASM_DIR file of this
+     *  kernel, device and SIMD width if there is one (Gen8+) */
+    bool overrideInstructions(void);
+    /*! Disassemble and reassemble the kernel, report any difference and
+     *  return how many instructions come back unchanged before it */
+    uint32_t checkAssemblyRoundTrip(GenKernel *genKernel);
     /*! Calc the group's slm offset from R0.0, to work around HSW SLM bug*/
     virtual void emitSLMOffset(void) { };
     /*! new selection of device */
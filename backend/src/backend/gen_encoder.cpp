@@ -1046,7 +1046,10 @@ namespace gbe
 
   void GenEncoder::CMP(uint32_t conditional, GenRegister src0, GenRegister src1, GenRegister dst) {
     if (needToSplitCmp(this, src0, src1, dst) == false) {
-      if(!GenRegister::isNull(dst) && compactAlu2(this, GEN_OPCODE_CMP, dst, src0, src1, conditional, false)) {
+      // The thread switch a null destination needs is a Gen7 workaround, the
+      // compact form cannot encode it
+      if((!GenRegister::isNull(dst) || this->getCompactVersion() >= 8) &&
+         compactAlu2(this, GEN_OPCODE_CMP, dst, src0, src1, conditional, false)) {
         return;
       }
       GenNativeInstruction *insn = this->next(GEN_OPCODE_CMP);
@@ -0,0 +1,1258 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file gen_insn_assembler.cpp
+ *
+ * The parser follows gen_disasm output field by field. Everything the
+ * disassembler prints is read back, everything it leaves out (branch
+ * destinations, the sources of the flow control instructions, nop) is
+ * rebuilt the way GenEncoder emits it. Branch offsets may be given as
+ * numbers (in 8 bytes slots, as printed) or as label names
+ */
+
+#include "backend/gen_insn_assembler.hpp"
+#include "backend/gen_defs.hpp"
+#include "src/cl_device_data.h"
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+namespace gbe
+{
+  extern bool compactNativeInstruction(const GenNativeInstruction *native, GenCompactInstruction *out);
+  extern void decompactInstruction(GenCompactInstruction *p, void *insn, uint32_t insn_version);
+
+  struct AsmOpcode {
+    uint32_t opcode;
+    const char *name;
+    uint32_t nsrc, ndst;
+  };
+
+  /*! Same names and operand numbers as the disassembler table */
+  static const AsmOpcode asmOpcodes[] = {
+    {GEN_OPCODE_MOV, "mov", 1, 1}, {GEN_OPCODE_FRC, "frc", 1, 1},
+    {GEN_OPCODE_RNDU, "rndu", 1, 1}, {GEN_OPCODE_RNDD, "rndd", 1, 1},
+    {GEN_OPCODE_RNDE, "rnde", 1, 1}, {GEN_OPCODE_RNDZ, "rndz", 1, 1},
+    {GEN_OPCODE_NOT, "not", 1, 1}, {GEN_OPCODE_LZD, "lzd", 1, 1},
+    {GEN_OPCODE_FBH, "fbh", 1, 1}, {GEN_OPCODE_FBL, "fbl", 1, 1},
+    {GEN_OPCODE_CBIT, "cbit", 1, 1}, {GEN_OPCODE_F16TO32, "f16to32", 1, 1},
+    {GEN_OPCODE_F32TO16, "f32to16", 1, 1}, {GEN_OPCODE_BFREV, "bfrev", 1, 1},
+    {GEN_OPCODE_MUL, "mul", 2, 1}, {GEN_OPCODE_MAC, "mac", 2, 1},
+    {GEN_OPCODE_MACH, "mach", 2, 1}, {GEN_OPCODE_LINE, "line", 2, 1},
+    {GEN_OPCODE_PLN, "pln", 2, 1}, {GEN_OPCODE_MAD, "mad", 3, 1},
+    {GEN_OPCODE_LRP, "lrp", 3, 1}, {GEN_OPCODE_SAD2, "sad2", 2, 1},
+    {GEN_OPCODE_SADA2, "sada2", 2, 1}, {GEN_OPCODE_DP4, "dp4", 2, 1},
+    {GEN_OPCODE_DPH, "dph", 2, 1}, {GEN_OPCODE_DP3, "dp3", 2, 1},
+    {GEN_OPCODE_DP2, "dp2", 2, 1}, {GEN_OPCODE_MATH, "math", 2, 1},
+    {GEN_OPCODE_MADM, "madm", 3, 1}, {GEN_OPCODE_AVG, "avg", 2, 1},
+    {GEN_OPCODE_ADD, "add", 2, 1}, {GEN_OPCODE_ADDC, "addc", 2, 1},
+    {GEN_OPCODE_SUBB, "subb", 2, 1}, {GEN_OPCODE_SEL, "sel", 2, 1},
+    {GEN_OPCODE_AND, "and", 2, 1}, {GEN_OPCODE_OR, "or", 2, 1},
+    {GEN_OPCODE_XOR, "xor", 2, 1}, {GEN_OPCODE_SHR, "shr", 2, 1},
+    {GEN_OPCODE_SHL, "shl", 2, 1}, {GEN_OPCODE_ASR, "asr", 2, 1},
+    {GEN_OPCODE_CMP, "cmp", 2, 1}, {GEN_OPCODE_CMPN, "cmpn", 2, 1},
+    {GEN_OPCODE_SEND, "send", 2, 1}, {GEN_OPCODE_SENDC, "sendc", 2, 1},
+    {GEN_OPCODE_SENDS, "sends", 2, 1}, {GEN_OPCODE_NOP, "nop", 0, 0},
+    {GEN_OPCODE_JMPI, "jmpi", 0, 0}, {GEN_OPCODE_BRD, "brd", 0, 0},
+    {GEN_OPCODE_IF, "if", 0, 0}, {GEN_OPCODE_BRC, "brc", 0, 0},
+    {GEN_OPCODE_WHILE, "while", 0, 0}, {GEN_OPCODE_ELSE, "else", 0, 0},
+    {GEN_OPCODE_BREAK, "break", 0, 0}, {GEN_OPCODE_CONTINUE, "cont", 0, 0},
+    {GEN_OPCODE_HALT, "halt", 1, 0}, {GEN_OPCODE_MSAVE, "msave", 1, 1},
+    {GEN_OPCODE_PUSH, "push", 1, 1}, {GEN_OPCODE_MRESTORE, "mrest", 1, 1},
+    {GEN_OPCODE_POP, "pop", 2, 0}, {GEN_OPCODE_WAIT, "wait", 1, 0},
+    {GEN_OPCODE_DO, "do", 0, 0}, {GEN_OPCODE_ENDIF, "endif", 1, 0},
+  };
+
+  static const char *condNames[] = {"", "e", "ne", "g", "ge", "l", "le", "r", "o", "u"};
+
+  static const char *mathNames[16] = {
+    NULL, "inv", "log", "exp", "sqrt", "rsq", "sin", "cos", NULL,
+    "fdiv", "pow", "intdivmod", "intdiv", "intmod", "invm", "rsqrtm"
+  };
+
+  static const char *predAlign1Names[16] = {
+    NULL, NULL, "anyv", "allv", "any2h", "all2h", "any4h", "all4h",
+    "any8h", "all8h", "any16h", "all16h"
+  };
+
+  static const char *predAlign16Names[16] = {
+    NULL, NULL, "x", "y", "z", "w", "any4h", "all4h"
+  };
+
+  /*! Register types, indexed by their encoding */
+  static const char *typeNames[] = {"UD", "D", "UW", "W", "UB", "B", "DF", "F", "UQ", "Q", "HF"};
+  static const uint32_t typeSizes[] = {4, 4, 2, 2, 1, 1, 8, 4, 8, 8, 2};
+
+  /*! Immediate suffixes and types, the two letters ones are matched first */
+  static const struct { const char *suffix; uint32_t type; } immTypes[] = {
+    {"UD", GEN_TYPE_UD}, {"UW", GEN_TYPE_UW}, {"UB", GEN_TYPE_UB},
+    {"VF", GEN_TYPE_VF}, {"UQ", GEN_TYPE_UL}, {"HF", GEN_TYPE_HF_IMM},
+    {"DF", GEN_TYPE_DF_IMM}, {"D", GEN_TYPE_D}, {"W", GEN_TYPE_W},
+    {"V", GEN_TYPE_V}, {"F", GEN_TYPE_F}, {"Q", GEN_TYPE_L},
+  };
+
+  static const char *sfidNames[16] = {
+    "null", NULL, "sampler", "gateway", "dataport_sampler", "render", "urb",
+    "thread_spawner", "video_motion_estimation", "const", "data (0)",
+    "pix_interpolator", "data (1)", "check_and_refine"
+  };
+
+  static const struct { const char *prefix; uint32_t base; } arfNames[] = {
+    {"acc", GEN_ARF_ACCUMULATOR}, {"mask", GEN_ARF_MASK}, {"msd", GEN_ARF_MASK_STACK},
+    {"sr", GEN_ARF_STATE}, {"cr", GEN_ARF_CONTROL}, {"tm", GEN_ARF_TM},
+    {"a", GEN_ARF_ADDRESS}, {"f", GEN_ARF_FLAG}, {"n", GEN_ARF_NOTIFICATION_COUNT},
+  };
+
+#define NO_SWIZZLE ((0<<0) | (1<<2) | (2<<4) | (3<<6))
+
+  /*! One operand as printed. Its fields only become bits once the whole
+   *  statement (and so its access mode) is known */
+  struct AsmOperand {
+    bool present = false;
+    bool immediate = false;
+    bool indirect = false;
+    bool negate = false;
+    bool absolute = false;
+    uint32_t file = GEN_GENERAL_REGISTER_FILE;
+    uint32_t nr = 0;
+    uint32_t sub = 0;           //!< sub register, in elements of the type
+    uint32_t addrSub = 0;       //!< a0 sub register for g[a0.S OFF]
+    int32_t addrImm = 0;        //!< offset for g[a0.S OFF]
+    int32_t type = -1;
+    uint32_t regionNum = 0;     //!< 1 for <hs>, 3 for <vs,w,hs>
+    int32_t region[3] = {0, 0, 0};
+    bool hasSuffix = false;     //!< swizzle, write mask or special accumulator
+    std::string suffix;
+    uint64_t imm = 0;
+  };
+
+  struct AsmStatement {
+    uint32_t line = 0;
+    uint32_t slot = 0;
+    const AsmOpcode *op = NULL;
+    bool predicated = false, predInverse = false;
+    std::string predCtrl;
+    uint32_t flagNr = 0, flagSub = 0;
+    bool saturate = false, breakpoint = false;
+    uint32_t cond = 0, mathFn = 0, sfid = 0;
+    uint32_t execSize = 0;
+    AsmOperand dst, src[3];
+    vector<std::string> offsets;
+    uint32_t sendsDataLen = 0, sendsDesc = 0, sendsExDesc = 0;
+    bool sendsRegDesc = false;
+    bool align16 = false, weAll = false, accWr = false, eot = false, compacted = false;
+    uint32_t depCtrl = 0, qtr = 0, nib = 0, threadCtrl = 0;
+  };
+
+  static void skipSpace(const char *&p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+  }
+
+  static std::string readIdent(const char *&p) {
+    const char *start = p;
+    while (isalnum(*p) || *p == '_') p++;
+    return std::string(start, p);
+  }
+
+  static bool readInt(const char *&p, int32_t &value) {
+    char *end;
+    const long v = strtol(p, &end, 10);
+    if (end == p) return false;
+    value = (int32_t) v;
+    p = end;
+    return true;
+  }
+
+  static bool isBlank(const std::string &str) {
+    for (char c : str)
+      if (!isspace(c)) return false;
+    return true;
+  }
+
+  static int32_t lookup(const char *const *table, uint32_t num, const std::string &name) {
+    for (uint32_t i = 0; i < num; i++)
+      if (table[i] && name == table[i]) return i;
+    return -1;
+  }
+
+  /*! Exec size, width, vertical and horizontal strides all encode as log2 + 1,
+   *  except for a 0 stride */
+  static int32_t encodeStride(int32_t value) {
+    if (value == 0) return 0;
+    for (int32_t enc = 1; enc < 8; enc++)
+      if (value == (1 << (enc - 1))) return enc;
+    return -1;
+  }
+
+  static int32_t encodeLog2(int32_t value) {
+    for (int32_t enc = 0; enc < 6; enc++)
+      if (value == (1 << enc)) return enc;
+    return -1;
+  }
+
+  static uint16_t floatToHalf(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    const uint32_t sign = (u >> 16) & 0x8000;
+    const int32_t exp = int32_t((u >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = u & 0x7fffff;
+    if (((u >> 23) & 0xff) == 0xff)
+      return sign | 0x7c00 | (mant ? 0x200 : 0);
+    if (exp >= 31)
+      return sign | 0x7c00;
+    if (exp <= 0) {
+      if (exp < -10)
+        return sign;
+      mant |= 0x800000;
+      const uint32_t shift = 14 - exp;
+      uint32_t h = mant >> shift;
+      const uint32_t rem = mant & ((1u << shift) - 1), half = 1u << (shift - 1);
+      if (rem > half || (rem == half && (h & 1))) h++;
+      return sign | h;
+    }
+    uint32_t h = (uint32_t(exp) << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return sign | h;
+  }
+
+  /*! The low 9 bits of an indirect offset are signed, bit 9 lives apart and
+   *  weighs +512 or -512 depending on the operand (see gen_disasm) */
+  static bool splitIndirectOffset(int32_t offset, int32_t bit9Weight, int32_t &low, bool &bit9) {
+    bit9 = false;
+    low = offset;
+    if (low >= -256 && low <= 255) return true;
+    bit9 = true;
+    low = offset - bit9Weight;
+    return low >= -256 && low <= 255;
+  }
+
+  static bool parseSwizzle(const AsmOperand &op, uint32_t &swizzle) {
+    swizzle = NO_SWIZZLE;
+    if (!op.hasSuffix) return true;
+    const std::string &s = op.suffix;
+    if (s.size() != 1 && s.size() != 4) return false;
+    uint32_t chan[4];
+    for (uint32_t i = 0; i < 4; i++) {
+      const char *c = strchr("xyzw", s[s.size() == 1 ? 0 : i]);
+      if (c == NULL || *c == '\0') return false;
+      chan[i] = c - "xyzw";
+    }
+    swizzle = chan[0] | (chan[1] << 2) | (chan[2] << 4) | (chan[3] << 6);
+    return true;
+  }
+
+  static bool parseWritemask(const AsmOperand &op, uint32_t &mask) {
+    mask = 0xf;
+    if (!op.hasSuffix) return true;
+    mask = 0;
+    int32_t last = -1;
+    for (char ch : op.suffix) {
+      const char *c = strchr("xyzw", ch);
+      if (c == NULL || *c == '\0' || c - "xyzw" <= last) return false;
+      last = c - "xyzw";
+      mask |= 1 << last;
+    }
+    return true;
+  }
+
+  static int32_t parseSpecialAcc(const AsmOperand &op) {
+    if (!op.hasSuffix) return -1;
+    if (op.suffix == "noacc") return 8;
+    if (op.suffix.size() == 4 && op.suffix.compare(0, 3, "acc") == 0 &&
+        op.suffix[3] >= '2' && op.suffix[3] <= '9')
+      return op.suffix[3] - '2';
+    return -1;
+  }
+
+  static bool isSend(uint32_t opcode) {
+    return opcode == GEN_OPCODE_SEND || opcode == GEN_OPCODE_SENDC || opcode == GEN_OPCODE_SENDS;
+  }
+
+  /*! Offsets printed as " jip" */
+  static bool hasOneOffset(uint32_t opcode) {
+    return opcode == GEN_OPCODE_ENDIF || opcode == GEN_OPCODE_WHILE ||
+           opcode == GEN_OPCODE_BRD || opcode == GEN_OPCODE_JMPI;
+  }
+
+  /*! Offsets printed as " jip uip" */
+  static bool hasTwoOffsets(uint32_t opcode) {
+    return opcode == GEN_OPCODE_IF || opcode == GEN_OPCODE_ELSE ||
+           opcode == GEN_OPCODE_BREAK || opcode == GEN_OPCODE_CONTINUE ||
+           opcode == GEN_OPCODE_HALT || opcode == GEN_OPCODE_BRC;
+  }
+
+  /*! Compact a native instruction. Three sources instructions have their own
+   *  format, the candidate is only kept if it decompacts to the same bits */
+  static bool compactInstruction(const GenNativeInstruction &native, GenCompactInstruction &compact) {
+    const Gen8NativeInstruction &insn = native.gen8_insn;
+    const uint32_t opcode = insn.header.opcode;
+    if (opcode != GEN_OPCODE_MAD && opcode != GEN_OPCODE_LRP)
+      return compactNativeInstruction(&native, &compact);
+
+    for (uint32_t control = 0; control < 4; control++)
+    for (uint32_t src = 0; src < 4; src++) {
+      memset(&compact, 0, sizeof(compact));
+      compact.src3Insn.bits1.opcode = opcode;
+      compact.src3Insn.bits1.control_index = control;
+      compact.src3Insn.bits1.src_index = src;
+      compact.src3Insn.bits1.dst_reg_nr = insn.bits1.da3src.dest_reg_nr;
+      compact.src3Insn.bits1.src0_rep_ctrl = insn.bits2.da3src.src0_rep_ctrl;
+      compact.src3Insn.bits1.compact_control = 1;
+      compact.src3Insn.bits1.debug_control = insn.header.debug_control;
+      compact.src3Insn.bits1.saturate = insn.header.saturate;
+      compact.src3Insn.bits2.src1_rep_ctrl = insn.bits2.da3src.src1_rep_ctrl;
+      compact.src3Insn.bits2.src2_rep_ctrl = insn.bits3.da3src.src2_rep_ctrl;
+      compact.src3Insn.bits2.src0_subnr = insn.bits2.da3src.src0_subreg_nr;
+      compact.src3Insn.bits2.src1_subnr = insn.bits2.da3src.src1_subreg_nr_low |
+                                          (insn.bits3.da3src.src1_subreg_nr_high << 2);
+      compact.src3Insn.bits2.src2_subnr = insn.bits3.da3src.src2_subreg_nr;
+      compact.src3Insn.bits2.src0_reg_nr = insn.bits2.da3src.src0_reg_nr;
+      compact.src3Insn.bits2.src1_reg_nr = insn.bits3.da3src.src1_reg_nr;
+      compact.src3Insn.bits2.src2_reg_nr = insn.bits3.da3src.src2_reg_nr;
+      GenNativeInstruction check;
+      memset(&check, 0, sizeof(check));
+      decompactInstruction(&compact, &check, 8);
+      check.gen8_insn.header.cmpt_control = 0;
+      if (memcmp(&check, &native, sizeof(check)) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  class GenAssembler
+  {
+  public:
+    GenAssembler(std::string &error) : error(error) {}
+    bool assemble(const char *text, const char *kernelName, vector<GenInstruction> &insns);
+  private:
+    bool fail(uint32_t line, const char *fmt, ...);
+    bool parseStatement(const std::string &text, uint32_t line, AsmStatement &s);
+    bool parseOperand(const char *&p, uint32_t line, AsmOperand &op);
+    bool parseImmediate(const char *&p, uint32_t line, AsmOperand &op);
+    bool parseSends(const char *&p, AsmStatement &s);
+    bool parseOptions(const char *&p, AsmStatement &s);
+    bool resolveOffset(const AsmStatement &s, uint32_t id, int32_t &offset);
+    bool encode(const AsmStatement &s, GenNativeInstruction &native);
+    bool encodeDst(const AsmStatement &s, Gen8NativeInstruction &insn);
+    bool encodeSrc(const AsmStatement &s, uint32_t id, Gen8NativeInstruction &insn);
+    bool encode3Src(const AsmStatement &s, Gen8NativeInstruction &insn);
+    bool encodeBranch(const AsmStatement &s, Gen8NativeInstruction &insn);
+    void encodeNop(Gen8NativeInstruction &insn);
+    std::string &error;
+    vector<AsmStatement> statements;
+    std::map<std::string, uint32_t> labels; //!< label -> index of the next statement
+    uint32_t endSlot = 0;
+  };
+
+  bool GenAssembler::fail(uint32_t line, const char *fmt, ...) {
+    char msg[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+    char where[32];
+    snprintf(where, sizeof(where), "line %u: ", line);
+    error = std::string(where) + msg;
+    return false;
+  }
+
+  bool GenAssembler::parseImmediate(const char *&p, uint32_t line, AsmOperand &op) {
+    const char *start = p;
+    while (*p && !isspace(*p) && *p != '{') p++;
+    std::string token(start, p);
+    op.immediate = true;
+    op.file = GEN_IMMEDIATE_VALUE;
+
+    // the suffix is upper case, hexadecimal digits are printed lower case
+    std::string num;
+    for (const auto &imm : immTypes) {
+      const size_t len = strlen(imm.suffix);
+      if (token.size() > len && token.compare(token.size() - len, len, imm.suffix) == 0) {
+        op.type = imm.type;
+        num = token.substr(0, token.size() - len);
+        break;
+      }
+    }
+    if (op.type < 0)
+      return fail(line, "immediate '%s' without type", token.c_str());
+
+    const char *n = num.c_str();
+    const bool hex = num.compare(0, 2, "0x") == 0;
+    char *end = NULL;
+    switch (op.type) {
+      case GEN_TYPE_D:
+      case GEN_TYPE_W:
+        op.imm = uint32_t(int32_t(strtol(n, &end, 10)));
+        break;
+      case GEN_TYPE_F:
+        if (hex)
+          op.imm = uint32_t(strtoul(n, &end, 16));
+        else {
+          const float f = strtof(n, &end);
+          uint32_t u;
+          memcpy(&u, &f, sizeof(u));
+          op.imm = u;
+        }
+        break;
+      case GEN_TYPE_HF_IMM:
+        if (hex)
+          op.imm = uint32_t(strtoul(n, &end, 16));
+        else
+          op.imm = floatToHalf(strtof(n, &end));
+        break;
+      case GEN_TYPE_DF_IMM:
+        if (hex)
+          op.imm = strtoull(n, &end, 16);
+        else {
+          const double d = strtod(n, &end);
+          memcpy(&op.imm, &d, sizeof(d));
+        }
+        break;
+      default:
+        op.imm = strtoull(n, &end, 0);
+        break;
+    }
+    if (end == n || *end != '\0')
+      return fail(line, "bad immediate '%s'", token.c_str());
+    return true;
+  }
+
+  bool GenAssembler::parseOperand(const char *&p, uint32_t line, AsmOperand &op) {
+    skipSpace(p);
+    op.present = true;
+    if (isdigit(*p) || (*p == '-' && isdigit(p[1])))
+      return parseImmediate(p, line, op);
+    if (*p == '-') {
+      op.negate = true;
+      p++;
+    }
+    if (strncmp(p, "(abs)", 5) == 0) {
+      op.absolute = true;
+      p += 5;
+    }
+
+    if (strncmp(p, "g[a0", 4) == 0) {
+      p += 4;
+      op.indirect = true;
+      int32_t value;
+      if (*p == '.') {
+        p++;
+        if (!readInt(p, value) || value < 0 || value > 15)
+          return fail(line, "bad address sub register");
+        op.addrSub = value;
+      }
+      skipSpace(p);
+      if (*p != ']' && !readInt(p, op.addrImm))
+        return fail(line, "bad indirect offset");
+      if (*p++ != ']')
+        return fail(line, "missing ']'");
+    } else {
+      const std::string name = readIdent(p);
+      if (name == "null") {
+        op.file = GEN_ARCHITECTURE_REGISTER_FILE;
+        op.nr = GEN_ARF_NULL;
+      } else if (name == "ip") {
+        op.file = GEN_ARCHITECTURE_REGISTER_FILE;
+        op.nr = GEN_ARF_IP;
+      } else {
+        size_t digit = 0;
+        while (digit < name.size() && !isdigit(name[digit])) digit++;
+        const std::string prefix = name.substr(0, digit);
+        if (digit == 0 || digit == name.size())
+          return fail(line, "bad register '%s'", name.c_str());
+        const uint32_t nr = atoi(name.c_str() + digit);
+        // Gen8+ has no MRF anymore
+        if (prefix == "g") {
+          op.file = GEN_GENERAL_REGISTER_FILE;
+          op.nr = nr;
+        } else if (prefix == "ARF") {
+          op.file = GEN_ARCHITECTURE_REGISTER_FILE;
+          op.nr = nr;
+        } else {
+          uint32_t i = 0;
+          for (; i < sizeof(arfNames) / sizeof(arfNames[0]); i++)
+            if (prefix == arfNames[i].prefix) break;
+          if (i == sizeof(arfNames) / sizeof(arfNames[0]) || nr > 0xf)
+            return fail(line, "bad register '%s'", name.c_str());
+          op.file = GEN_ARCHITECTURE_REGISTER_FILE;
+          op.nr = arfNames[i].base | nr;
+        }
+        if (op.nr > 0xff)
+          return fail(line, "bad register '%s'", name.c_str());
+      }
+      if (*p == '.' && isdigit(p[1])) {
+        int32_t value;
+        p++;
+        readInt(p, value);
+        op.sub = value;
+      }
+    }
+
+    if (*p == '<') {
+      p++;
+      while (op.regionNum < 3) {
+        if (strncmp(p, "VxH", 3) == 0) {
+          op.region[op.regionNum++] = -1;
+          p += 3;
+        } else if (!readInt(p, op.region[op.regionNum++]))
+          return fail(line, "bad region");
+        if (*p != ',') break;
+        p++;
+      }
+      if (*p++ != '>')
+        return fail(line, "bad region");
+    }
+    for (uint32_t i = 0; i < 2; i++) {
+      if (*p == '.') {
+        p++;
+        op.hasSuffix = true;
+        op.suffix = readIdent(p);
+      }
+      if (i == 0 && *p == ':') {
+        p++;
+        op.type = lookup(typeNames, sizeof(typeNames) / sizeof(typeNames[0]), readIdent(p));
+        if (op.type < 0)
+          return fail(line, "bad register type");
+      }
+    }
+    return true;
+  }
+
+  bool GenAssembler::parseSends(const char *&p, AsmStatement &s) {
+    if (!parseOperand(p, s.line, s.dst))
+      return false;
+    for (uint32_t i = 0; i < 2; i++) {
+      const char *field = i == 0 ? "(addLen:" : "(dataLen:";
+      int32_t nr, len;
+      skipSpace(p);
+      if (*p++ != 'g' || !readInt(p, nr) || strncmp(p, field, strlen(field)) != 0)
+        return fail(s.line, "bad sends source");
+      p += strlen(field);
+      if (!readInt(p, len) || *p++ != ')')
+        return fail(s.line, "bad sends source");
+      s.src[i].present = true;
+      s.src[i].nr = nr;
+      if (i == 1) s.sendsDataLen = len;
+    }
+    skipSpace(p);
+    char *end;
+    if (strncmp(p, "a0.0", 4) == 0) {
+      s.sendsRegDesc = true;
+      p += 4;
+    } else {
+      s.sendsDesc = strtoul(p, &end, 16);
+      if (end == p)
+        return fail(s.line, "bad sends descriptor");
+      p = end;
+    }
+    skipSpace(p);
+    if (strncmp(p, "exdesc:", 7) == 0) {
+      p += 7;
+      s.sendsExDesc = strtoul(p, &end, 16);
+      if (end == p)
+        return fail(s.line, "bad sends extended descriptor");
+      p = end;
+    }
+    return true;
+  }
+
+  bool GenAssembler::parseOptions(const char *&p, AsmStatement &s) {
+    p++;
+    for (;;) {
+      while (isspace(*p) || *p == ',') p++;
+      if (*p == '}') {
+        p++;
+        return true;
+      }
+      if (*p == '\0')
+        return fail(s.line, "missing '}'");
+      const char *start = p;
+      while (*p && !isspace(*p) && *p != ',' && *p != '}') p++;
+      const std::string opt(start, p);
+      if (opt == "align1") s.align16 = false;
+      else if (opt == "align16") s.align16 = true;
+      else if (opt == "WE_normal") s.weAll = false;
+      else if (opt == "WE_all") s.weAll = true;
+      else if (opt == "NoDDClr") s.depCtrl |= 1;
+      else if (opt == "NoDDChk") s.depCtrl |= 2;
+      else if (opt == "NibCtrl") s.nib = 1;
+      else if (opt == "atomic") s.threadCtrl = 1;
+      else if (opt == "switch") s.threadCtrl = 2;
+      else if (opt == "AccWrEnable") s.accWr = true;
+      else if (opt == "EOT") s.eot = true;
+      else if (opt == "Compacted") s.compacted = true;
+      else if (opt.size() == 2 && opt[0] >= '1' && opt[0] <= '8' &&
+               (opt[1] == 'Q' || opt[1] == 'H' || opt[1] == 'N')) {
+        const uint32_t n = opt[0] - '1';
+        if (opt[1] == 'Q' && n < 4)
+          s.qtr = n;
+        else if (opt[1] == 'H' && n < 2)
+          s.qtr = n * 2;
+        else if (opt[1] == 'N') {
+          s.qtr = n / 2;
+          s.nib = n & 1;
+        } else
+          return fail(s.line, "bad option '%s'", opt.c_str());
+      } else if (opt.size() == 4 && opt[0] == 'f' && (opt[1] == '0' || opt[1] == '1') &&
+                 opt[2] == '.' && (opt[3] == '0' || opt[3] == '1')) {
+        s.flagNr = opt[1] - '0';
+        s.flagSub = opt[3] - '0';
+      } else
+        return fail(s.line, "unknown option '%s'", opt.c_str());
+    }
+  }
+
+  bool GenAssembler::parseStatement(const std::string &text, uint32_t line, AsmStatement &s) {
+    const char *p = text.c_str();
+    s.line = line;
+    skipSpace(p);
+
+    // (+f0.1.anyv)
+    if (*p == '(') {
+      p++;
+      if (*p != '+' && *p != '-')
+        return fail(line, "bad predicate");
+      s.predicated = true;
+      s.predInverse = *p++ == '-';
+      if (*p++ != 'f' || (*p != '0' && *p != '1'))
+        return fail(line, "bad predicate flag");
+      s.flagNr = *p++ - '0';
+      if (*p == '.' && isdigit(p[1])) {
+        s.flagSub = p[1] - '0';
+        p += 2;
+      }
+      if (*p == '.') {
+        p++;
+        s.predCtrl = readIdent(p);
+      }
+      if (*p++ != ')')
+        return fail(line, "bad predicate");
+      skipSpace(p);
+    }
+
+    const std::string name = readIdent(p);
+    for (const auto &op : asmOpcodes)
+      if (name == op.name) s.op = &op;
+    if (s.op == NULL)
+      return fail(line, "unknown opcode '%s'", name.c_str());
+    const uint32_t opcode = s.op->opcode;
+
+    while (*p == '.') {
+      p++;
+      const std::string mod = readIdent(p);
+      int32_t cond;
+      if (mod == "sat")
+        s.saturate = true;
+      else if (mod == "breakpoint")
+        s.breakpoint = true;
+      else if ((cond = lookup(condNames, sizeof(condNames) / sizeof(condNames[0]), mod)) > 0)
+        s.cond = cond;
+      else if ((mod == "f0" || mod == "f1") && p[0] == '.' && (p[1] == '0' || p[1] == '1')) {
+        s.flagNr = mod[1] - '0';
+        s.flagSub = p[1] - '0';
+        p += 2;
+      } else
+        return fail(line, "unknown modifier '%s'", mod.c_str());
+    }
+
+    if (opcode == GEN_OPCODE_MATH) {
+      skipSpace(p);
+      const std::string fn = readIdent(p);
+      const int32_t id = lookup(mathNames, 16, fn);
+      if (id < 0)
+        return fail(line, "unknown math function '%s'", fn.c_str());
+      s.mathFn = id;
+    }
+
+    if (opcode != GEN_OPCODE_NOP) {
+      int32_t width, enc;
+      if (*p++ != '(' || !readInt(p, width) || *p++ != ')' || (enc = encodeLog2(width)) < 0)
+        return fail(line, "bad execution size");
+      s.execSize = enc;
+    }
+
+    if (opcode == GEN_OPCODE_SENDS) {
+      if (!parseSends(p, s))
+        return false;
+    } else {
+      if (s.op->ndst > 0) {
+        if (!parseOperand(p, line, s.dst))
+          return false;
+      } else if (hasOneOffset(opcode) || hasTwoOffsets(opcode)) {
+        const uint32_t num = hasOneOffset(opcode) ? 1 : 2;
+        for (uint32_t i = 0; i < num; i++) {
+          skipSpace(p);
+          const char *start = p;
+          if (*p == '-') p++;
+          while (isalnum(*p) || *p == '_') p++;
+          if (start == p)
+            return fail(line, "missing branch offset");
+          s.offsets.push_back(std::string(start, p));
+        }
+      }
+      for (uint32_t i = 0; i < s.op->nsrc; i++)
+        if (!parseOperand(p, line, s.src[i]))
+          return false;
+    }
+
+    if (isSend(opcode)) {
+      skipSpace(p);
+      size_t best = 0;
+      for (uint32_t i = 0; i < 16; i++) {
+        if (sfidNames[i] == NULL) continue;
+        const size_t len = strlen(sfidNames[i]);
+        if (len > best && strncmp(p, sfidNames[i], len) == 0) {
+          best = len;
+          s.sfid = i;
+        }
+      }
+      if (best == 0)
+        return fail(line, "unknown message target");
+      // the message details are all in the descriptor
+      while (*p && *p != '{') p++;
+    }
+
+    skipSpace(p);
+    if (*p == '{' && !parseOptions(p, s))
+      return false;
+    skipSpace(p);
+    if (*p)
+      return fail(line, "unexpected '%s'", p);
+    return true;
+  }
+
+  bool GenAssembler::resolveOffset(const AsmStatement &s, uint32_t id, int32_t &offset) {
+    const std::string &str = s.offsets[id];
+    if (str[0] == '-' || isdigit(str[0])) {
+      offset = atoi(str.c_str());
+      return true;
+    }
+    auto it = labels.find(str);
+    if (it == labels.end())
+      return fail(s.line, "unknown label '%s'", str.c_str());
+    const uint32_t target = it->second < statements.size() ? statements[it->second].slot : endSlot;
+    offset = int32_t(target) - int32_t(s.slot);
+    // jmpi counts from the next instruction
+    if (s.op->opcode == GEN_OPCODE_JMPI)
+      offset -= 2;
+    return true;
+  }
+
+  bool GenAssembler::encodeDst(const AsmStatement &s, Gen8NativeInstruction &insn) {
+    const AsmOperand &dst = s.dst;
+    if (dst.immediate)
+      return fail(s.line, "immediate destination");
+    const uint32_t type = dst.type < 0 ? GEN_TYPE_UD : dst.type;
+    int32_t hstride = GEN_HORIZONTAL_STRIDE_1;
+    if (dst.regionNum == 1 && !s.align16)
+      hstride = encodeStride(dst.region[0]);
+    if (dst.regionNum > 1 || hstride < 0 || hstride > GEN_HORIZONTAL_STRIDE_4)
+      return fail(s.line, "bad destination stride");
+
+    if (dst.indirect) {
+      int32_t offset;
+      bool bit9;
+      if (!splitIndirectOffset(dst.addrImm, -512, offset, bit9))
+        return fail(s.line, "indirect offset out of range");
+      insn.bits1.ia1.dest_reg_file = GEN_GENERAL_REGISTER_FILE;
+      insn.bits1.ia1.dest_reg_type = type;
+      insn.bits1.ia1.dest_address_mode = GEN_ADDRESS_REGISTER_INDIRECT_REGISTER;
+      insn.bits1.ia1.dest_subreg_nr = dst.addrSub;
+      insn.bits1.ia1.dest_indirect_offset = offset;
+      insn.bits1.ia1.dest_indirect_offset_9 = bit9 ? -1 : 0;
+      insn.bits1.ia1.dest_horiz_stride = hstride;
+      return true;
+    }
+
+    insn.bits1.da1.dest_reg_file = dst.file;
+    insn.bits1.da1.dest_reg_type = type;
+    insn.bits1.da1.dest_reg_nr = dst.nr;
+    insn.bits1.da1.dest_horiz_stride = hstride;
+    if (!s.align16) {
+      if (dst.sub * typeSizes[type] >= 32)
+        return fail(s.line, "bad destination sub register");
+      insn.bits1.da1.dest_subreg_nr = dst.sub * typeSizes[type];
+      return true;
+    }
+
+    insn.bits1.da16.dest_subreg_nr = dst.sub != 0;
+    const int32_t acc = parseSpecialAcc(dst);
+    uint32_t mask;
+    if (acc >= 0)
+      insn.bits1.da16acc.dst_special_acc = acc;
+    else if (parseWritemask(dst, mask))
+      insn.bits1.da16.dest_writemask = mask;
+    else
+      return fail(s.line, "bad write mask '%s'", dst.suffix.c_str());
+    return true;
+  }
+
+  bool GenAssembler::encodeSrc(const AsmStatement &s, uint32_t id, Gen8NativeInstruction &insn) {
+    const AsmOperand &src = s.src[id];
+    if (!src.present)
+      return fail(s.line, "missing source %u", id);
+    if (src.type < 0)
+      return fail(s.line, "source %u without type", id);
+
+    if (src.immediate) {
+      const bool is64 = src.type == GEN_TYPE_UL || src.type == GEN_TYPE_L || src.type == GEN_TYPE_DF_IMM;
+      if (id == 0) {
+        insn.bits1.da1.src0_reg_file = GEN_IMMEDIATE_VALUE;
+        insn.bits1.da1.src0_reg_type = src.type;
+        if (is64) {
+          insn.bits3.ud = uint32_t(src.imm >> 32);
+          insn.bits2.ud = uint32_t(src.imm);
+        } else {
+          insn.bits3.ud = uint32_t(src.imm);
+          insn.bits2.da1.src1_reg_file = GEN_ARCHITECTURE_REGISTER_FILE;
+          insn.bits2.da1.src1_reg_type = src.type;
+        }
+      } else {
+        insn.bits2.da1.src1_reg_file = GEN_IMMEDIATE_VALUE;
+        insn.bits2.da1.src1_reg_type = src.type;
+        insn.bits3.ud = uint32_t(src.imm);
+      }
+      return true;
+    }
+
+    const uint32_t typeSize = typeSizes[src.type];
+    if (s.align16) {
+      const int32_t vstride = src.regionNum == 3 ? encodeStride(src.region[0]) : -1;
+      if (vstride < 0 || src.region[1] != 4 || src.region[2] != 1)
+        return fail(s.line, "bad align16 region for source %u", id);
+      if (src.indirect || (src.sub * typeSize != 0 && src.sub * typeSize != 16))
+        return fail(s.line, "bad align16 source %u", id);
+      const int32_t acc = parseSpecialAcc(src);
+      uint32_t swizzle = NO_SWIZZLE;
+      if (acc < 0 && !parseSwizzle(src, swizzle))
+        return fail(s.line, "bad swizzle '%s'", src.suffix.c_str());
+      if (acc >= 0)
+        swizzle = acc;   // x and y hold the accumulator, z and w stay clear
+      if (id == 0) {
+        insn.bits1.da16.src0_reg_file = src.file;
+        insn.bits1.da16.src0_reg_type = src.type;
+        insn.bits2.da16.src0_swz_x = swizzle & 3;
+        insn.bits2.da16.src0_swz_y = (swizzle >> 2) & 3;
+        insn.bits2.da16.src0_subreg_nr = src.sub != 0;
+        insn.bits2.da16.src0_reg_nr = src.nr;
+        insn.bits2.da16.src0_abs = src.absolute;
+        insn.bits2.da16.src0_negate = src.negate;
+        insn.bits2.da16.src0_swz_z = (swizzle >> 4) & 3;
+        insn.bits2.da16.src0_swz_w = (swizzle >> 6) & 3;
+        insn.bits2.da16.src0_vert_stride = vstride;
+      } else {
+        insn.bits2.da16.src1_reg_file = src.file;
+        insn.bits2.da16.src1_reg_type = src.type;
+        insn.bits3.da16.src1_swz_x = swizzle & 3;
+        insn.bits3.da16.src1_swz_y = (swizzle >> 2) & 3;
+        insn.bits3.da16.src1_subreg_nr = src.sub != 0;
+        insn.bits3.da16.src1_reg_nr = src.nr;
+        insn.bits3.da16.src1_abs = src.absolute;
+        insn.bits3.da16.src1_negate = src.negate;
+        insn.bits3.da16.src1_swz_z = (swizzle >> 4) & 3;
+        insn.bits3.da16.src1_swz_w = (swizzle >> 6) & 3;
+        insn.bits3.da16.src1_vert_stride = vstride;
+      }
+      return true;
+    }
+
+    if (src.regionNum != 3)
+      return fail(s.line, "missing region for source %u", id);
+    const int32_t vstride = src.region[0] < 0 ? 0xf : encodeStride(src.region[0]);
+    const int32_t width = encodeLog2(src.region[1]);
+    const int32_t hstride = encodeStride(src.region[2]);
+    if (vstride < 0 || width < 0 || width > GEN_WIDTH_16 || hstride < 0 || hstride > GEN_HORIZONTAL_STRIDE_4)
+      return fail(s.line, "bad region for source %u", id);
+
+    if (src.indirect) {
+      int32_t offset;
+      bool bit9;
+      if (!splitIndirectOffset(src.addrImm, id == 0 ? 512 : -512, offset, bit9))
+        return fail(s.line, "indirect offset out of range");
+      if (id == 0) {
+        insn.bits1.ia1.src0_reg_file = GEN_GENERAL_REGISTER_FILE;
+        insn.bits1.ia1.src0_reg_type = src.type;
+        insn.bits2.ia1.src0_subreg_nr = src.addrSub;
+        insn.bits2.ia1.src0_indirect_offset = offset;
+        insn.bits2.ia1.src0_abs = src.absolute;
+        insn.bits2.ia1.src0_negate = src.negate;
+        insn.bits2.ia1.src0_address_mode = GEN_ADDRESS_REGISTER_INDIRECT_REGISTER;
+        insn.bits2.ia1.src0_horiz_stride = hstride;
+        insn.bits2.ia1.src0_width = width;
+        insn.bits2.ia1.src0_vert_stride = vstride;
+        insn.bits2.ia1.src0_indirect_offset_9 = bit9;
+      } else {
+        insn.bits2.ia1.src1_reg_file = GEN_GENERAL_REGISTER_FILE;
+        insn.bits2.ia1.src1_reg_type = src.type;
+        insn.bits3.ia1.src1_subreg_nr = src.addrSub;
+        insn.bits3.ia1.src1_indirect_offset = offset;
+        insn.bits3.ia1.src1_abs = src.absolute;
+        insn.bits3.ia1.src1_negate = src.negate;
+        insn.bits3.ia1.src1_address_mode = GEN_ADDRESS_REGISTER_INDIRECT_REGISTER;
+        insn.bits3.ia1.src1_horiz_stride = hstride;
+        insn.bits3.ia1.src1_width = width;
+        insn.bits3.ia1.src1_vert_stride = vstride;
+        insn.bits3.ia1.src1_indirect_offset_9 = bit9 ? -1 : 0;
+      }
+      return true;
+    }
+
+    if (src.sub * typeSize >= 32)
+      return fail(s.line, "bad sub register for source %u", id);
+    if (id == 0) {
+      insn.bits1.da1.src0_reg_file = src.file;
+      insn.bits1.da1.src0_reg_type = src.type;
+      insn.bits2.da1.src0_subreg_nr = src.sub * typeSize;
+      insn.bits2.da1.src0_reg_nr = src.nr;
+      insn.bits2.da1.src0_abs = src.absolute;
+      insn.bits2.da1.src0_negate = src.negate;
+      insn.bits2.da1.src0_horiz_stride = hstride;
+      insn.bits2.da1.src0_width = width;
+      insn.bits2.da1.src0_vert_stride = vstride;
+    } else {
+      insn.bits2.da1.src1_reg_file = src.file;
+      insn.bits2.da1.src1_reg_type = src.type;
+      insn.bits3.da1.src1_subreg_nr = src.sub * typeSize;
+      insn.bits3.da1.src1_reg_nr = src.nr;
+      insn.bits3.da1.src1_abs = src.absolute;
+      insn.bits3.da1.src1_negate = src.negate;
+      insn.bits3.da1.src1_horiz_stride = hstride;
+      insn.bits3.da1.src1_width = width;
+      insn.bits3.da1.src1_vert_stride = vstride;
+    }
+    return true;
+  }
+
+  bool GenAssembler::encode3Src(const AsmStatement &s, Gen8NativeInstruction &insn) {
+    static const int32_t type3Src[] = {2, 1, -1, -1, -1, -1, 3, 0, -1, -1, 4};
+    const AsmOperand *ops[4] = {&s.dst, &s.src[0], &s.src[1], &s.src[2]};
+    uint32_t swizzle[4], nr[4], sub[4], rep[4];
+    int32_t acc[4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+      const AsmOperand &op = *ops[i];
+      if (!op.present || op.immediate || op.indirect || op.file != GEN_GENERAL_REGISTER_FILE)
+        return fail(s.line, "three sources instructions only take GRF operands");
+      if (op.type < 0 || type3Src[op.type] < 0)
+        return fail(s.line, "bad three sources operand type");
+      acc[i] = parseSpecialAcc(op);
+      if (acc[i] >= 0)
+        swizzle[i] = acc[i];
+      else if (i == 0 ? !parseWritemask(op, swizzle[i]) : !parseSwizzle(op, swizzle[i]))
+        return fail(s.line, "bad swizzle '%s'", op.suffix.c_str());
+      rep[i] = op.regionNum == 3 && op.region[0] == 0 && op.region[1] == 1 && op.region[2] == 0;
+      if (i > 0 && op.regionNum != 0 && !rep[i])
+        return fail(s.line, "only <0,1,0> is allowed for three sources operands");
+      nr[i] = op.nr;
+      sub[i] = op.sub;
+    }
+    if (sub[0] > 7 || sub[1] > 7 || sub[2] > 7 || sub[3] > 7)
+      return fail(s.line, "bad sub register");
+
+    insn.bits1.da3src.dest_reg_nr = nr[0];
+    insn.bits1.da3src.dest_subreg_nr = sub[0];
+    insn.bits1.da3src.dest_writemask = swizzle[0];
+    insn.bits1.da3src.dest_type = type3Src[s.dst.type];
+    insn.bits1.da3src.src_type = type3Src[s.src[0].type];
+    insn.bits1.da3src.src1_type = s.src[1].type == GEN_TYPE_HF;
+    insn.bits1.da3src.src2_type = s.src[2].type == GEN_TYPE_HF;
+    insn.bits1.da3src.src0_abs = s.src[0].absolute;
+    insn.bits1.da3src.src0_negate = s.src[0].negate;
+    insn.bits1.da3src.src1_abs = s.src[1].absolute;
+    insn.bits1.da3src.src1_negate = s.src[1].negate;
+    insn.bits1.da3src.src2_abs = s.src[2].absolute;
+    insn.bits1.da3src.src2_negate = s.src[2].negate;
+    insn.bits2.da3src.src0_rep_ctrl = rep[1];
+    insn.bits2.da3src.src0_swizzle = swizzle[1];
+    insn.bits2.da3src.src0_subreg_nr = sub[1];
+    insn.bits2.da3src.src0_reg_nr = nr[1];
+    insn.bits2.da3src.src1_rep_ctrl = rep[2];
+    insn.bits2.da3src.src1_swizzle = swizzle[2];
+    insn.bits2.da3src.src1_subreg_nr_low = sub[2] & 0x3;
+    insn.bits3.da3src.src1_subreg_nr_high = sub[2] >> 2;
+    insn.bits3.da3src.src1_reg_nr = nr[2];
+    insn.bits3.da3src.src2_rep_ctrl = rep[3];
+    insn.bits3.da3src.src2_swizzle = swizzle[3];
+    insn.bits3.da3src.src2_subreg_nr = sub[3];
+    insn.bits3.da3src.src2_reg_nr = nr[3];
+    return true;
+  }
+
+  /*! Flow control operands are not printed, they are rebuilt the way
+   *  GenEncoder and patchJMPI leave them */
+  bool GenAssembler::encodeBranch(const AsmStatement &s, Gen8NativeInstruction &insn) {
+    const uint32_t opcode = s.op->opcode;
+    int32_t jip = 0, uip = 0;
+    if (!resolveOffset(s, 0, jip))
+      return false;
+    if (s.offsets.size() > 1 && !resolveOffset(s, 1, uip))
+      return false;
+
+    insn.bits1.da1.dest_reg_file = GEN_ARCHITECTURE_REGISTER_FILE;
+    insn.bits1.da1.dest_reg_type = opcode == GEN_OPCODE_JMPI ? GEN_TYPE_D : GEN_TYPE_UD;
+    insn.bits1.da1.dest_reg_nr = opcode == GEN_OPCODE_JMPI ? GEN_ARF_IP : GEN_ARF_NULL;
+    insn.bits1.da1.dest_horiz_stride = GEN_HORIZONTAL_STRIDE_1;
+
+    if (opcode == GEN_OPCODE_IF || opcode == GEN_OPCODE_ELSE) {
+      insn.bits1.da1.src0_reg_file = GEN_IMMEDIATE_VALUE;
+      insn.bits1.da1.src0_reg_type = GEN_TYPE_UD;
+      insn.bits2.gen8_branch.uip = uip * 8;
+      insn.bits3.gen8_branch.jip = jip * 8;
+      return true;
+    }
+
+    if (s.src[0].present) {
+      if (!encodeSrc(s, 0, insn))
+        return false;
+    } else {
+      insn.bits1.da1.src0_reg_file = GEN_ARCHITECTURE_REGISTER_FILE;
+      if (opcode == GEN_OPCODE_JMPI) {
+        insn.bits1.da1.src0_reg_type = GEN_TYPE_D;
+        insn.bits2.da1.src0_reg_nr = GEN_ARF_IP;
+        if (s.execSize != GEN_WIDTH_1)
+          insn.bits2.da1.src0_vert_stride = GEN_VERTICAL_STRIDE_4;
+      } else {
+        insn.bits1.da1.src0_reg_type = GEN_TYPE_UD;
+        insn.bits2.da1.src0_horiz_stride = GEN_HORIZONTAL_STRIDE_1;
+        insn.bits2.da1.src0_width = GEN_WIDTH_8;
+        insn.bits2.da1.src0_vert_stride = GEN_VERTICAL_STRIDE_8;
+      }
+    }
+
+    if (s.offsets.size() > 1) {
+      // the whole dword is read back as uip, the source fields included
+      insn.bits2.gen8_branch.uip = uip * 8;
+    } else {
+      insn.bits2.da1.src1_reg_file = GEN_IMMEDIATE_VALUE;
+      insn.bits2.da1.src1_reg_type = GEN_TYPE_D;
+    }
+    insn.bits3.gen8_branch.jip = jip * 8;
+    return true;
+  }
+
+  /*! GenEncoder::NOP, without any header */
+  void GenAssembler::encodeNop(Gen8NativeInstruction &insn) {
+    insn.bits1.da1.dest_reg_file = GEN_GENERAL_REGISTER_FILE;
+    insn.bits1.da1.dest_reg_type = GEN_TYPE_UD;
+    insn.bits1.da1.dest_horiz_stride = GEN_HORIZONTAL_STRIDE_1;
+    insn.bits1.da1.src0_reg_file = GEN_GENERAL_REGISTER_FILE;
+    insn.bits1.da1.src0_reg_type = GEN_TYPE_UD;
+    insn.bits2.da1.src0_horiz_stride = GEN_HORIZONTAL_STRIDE_1;
+    insn.bits2.da1.src0_width = GEN_WIDTH_4;
+    insn.bits2.da1.src0_vert_stride = GEN_VERTICAL_STRIDE_4;
+    insn.bits2.da1.src1_reg_file = GEN_IMMEDIATE_VALUE;
+    insn.bits2.da1.src1_reg_type = GEN_TYPE_UD;
+  }
+
+  bool GenAssembler::encode(const AsmStatement &s, GenNativeInstruction &native) {
+    Gen8NativeInstruction &insn = native.gen8_insn;
+    const uint32_t opcode = s.op->opcode;
+    memset(&native, 0, sizeof(native));
+    insn.header.opcode = opcode;
+    if (opcode == GEN_OPCODE_NOP) {
+      encodeNop(insn);
+      return true;
+    }
+
+    int32_t predCtrl = GEN_PREDICATE_NONE;
+    if (s.predicated) {
+      predCtrl = GEN_PREDICATE_NORMAL;
+      if (!s.predCtrl.empty())
+        predCtrl = lookup(s.align16 ? predAlign16Names : predAlign1Names, 16, s.predCtrl);
+      if (predCtrl < 0)
+        return fail(s.line, "bad predicate control '%s'", s.predCtrl.c_str());
+    }
+    insn.header.access_mode = s.align16 ? GEN_ALIGN_16 : GEN_ALIGN_1;
+    insn.header.dependency_control = s.depCtrl;
+    insn.header.nib_ctrl = s.nib;
+    insn.header.quarter_control = s.qtr;
+    insn.header.thread_control = s.threadCtrl;
+    insn.header.predicate_control = predCtrl;
+    insn.header.predicate_inverse = s.predInverse;
+    insn.header.execution_size = s.execSize;
+    if (opcode == GEN_OPCODE_MATH)
+      insn.header.destreg_or_condmod = s.mathFn;
+    else if (isSend(opcode))
+      insn.header.destreg_or_condmod = s.sfid;
+    else
+      insn.header.destreg_or_condmod = s.cond;
+    insn.header.acc_wr_control = s.accWr;
+    insn.header.debug_control = s.breakpoint;
+    insn.header.saturate = s.saturate;
+    insn.bits1.da1.flag_sub_reg_nr = s.flagSub;
+    insn.bits1.da1.flag_reg_nr = s.flagNr;
+    insn.bits1.da1.mask_control = s.weAll;
+
+    if (opcode == GEN_OPCODE_SENDS) {
+      Gen9NativeInstruction &gen9 = native.gen9_insn;
+      if (s.dst.file != GEN_GENERAL_REGISTER_FILE && s.dst.file != GEN_ARCHITECTURE_REGISTER_FILE)
+        return fail(s.line, "bad sends destination");
+      gen9.bits1.sends.dest_reg_file_0 = s.dst.file == GEN_GENERAL_REGISTER_FILE;
+      gen9.bits1.sends.src1_reg_file_0 = 1;
+      gen9.bits1.sends.dest_reg_type = s.dst.type < 0 ? 0 : s.dst.type;
+      gen9.bits1.sends.src1_reg_nr = s.src[1].nr;
+      gen9.bits1.sends.dest_reg_nr = s.dst.nr;
+      gen9.bits2.sends.src1_length = s.sendsDataLen;
+      gen9.bits2.sends.src0_reg_nr = s.src[0].nr;
+      gen9.bits2.sends.sel_reg32_desc = s.sendsRegDesc;
+      gen9.bits2.sends.exdesc_31_16 = s.sendsExDesc;
+      gen9.bits3.ud = s.sendsDesc;
+      return true;
+    }
+    if (s.op->nsrc == 3)
+      return encode3Src(s, insn);
+    if (hasOneOffset(opcode) || hasTwoOffsets(opcode))
+      return encodeBranch(s, insn);
+
+    if (s.op->ndst > 0 && !encodeDst(s, insn))
+      return false;
+    for (uint32_t i = 0; i < s.op->nsrc; i++)
+      if (!encodeSrc(s, i, insn))
+        return false;
+    if (s.eot && isSend(opcode))
+      insn.bits3.generic_gen5.end_of_thread = 1;
+    return true;
+  }
+
+  bool GenAssembler::assemble(const char *text, const char *kernelName, vector<GenInstruction> &insns) {
+    const char *beginMark = "'s disassemble begin:", *endMark = "'s disassemble end.";
+    const bool hasBlocks = strstr(text, beginMark) != NULL;
+    bool active = !hasBlocks, found = !hasBlocks;
+    std::string pending;
+    uint32_t pendingLine = 0, lineNum = 0;
+
+    for (const char *p = text; *p; ) {
+      const char *eol = strchr(p, '\n');
+      const size_t len = eol ? size_t(eol - p) : strlen(p);
+      std::string line(p, len);
+      p += eol ? len + 1 : len;
+      lineNum++;
+
+      const size_t comment = line.find("//");
+      if (comment != std::string::npos)
+        line.erase(comment);
+      const size_t begin = line.find(beginMark);
+      if (begin != std::string::npos) {
+        const char *name = line.c_str();
+        skipSpace(name);
+        active = kernelName == NULL || std::string(name, line.c_str() + begin) == kernelName;
+        found = found || active;
+        continue;
+      }
+      if (line.find(endMark) != std::string::npos) {
+        if (active) break;
+        continue;
+      }
+      if (!active)
+        continue;
+
+      const char *q = line.c_str();
+      if (isBlank(pending)) {
+        pending.clear();
+        skipSpace(q);
+        // [line,col] debug information
+        if (*q == '[' && strchr(q, ']')) {
+          q = strchr(q, ']') + 1;
+          skipSpace(q);
+        }
+        // "  L3:" label definition
+        const char *l = q;
+        const std::string label = readIdent(l);
+        if (!label.empty() && *l == ':') {
+          l++;
+          skipSpace(l);
+          if (*l == '\0') {
+            labels[label] = statements.size();
+            continue;
+          }
+        }
+        // "(      12)" slot number
+        if (*q == '(') {
+          const char *d = q + 1;
+          skipSpace(d);
+          if (isdigit(*d)) {
+            while (isdigit(*d)) d++;
+            if (*d == ')') q = d + 1;
+          }
+        }
+        pendingLine = lineNum;
+      }
+      pending += q;
+      pending += '\n';
+
+      size_t semi;
+      while ((semi = pending.find(';')) != std::string::npos) {
+        const std::string stmt = pending.substr(0, semi);
+        pending.erase(0, semi + 1);
+        if (!isBlank(stmt)) {
+          AsmStatement s;
+          if (!parseStatement(stmt, pendingLine, s))
+            return false;
+          statements.push_back(s);
+        }
+        pendingLine = lineNum;
+      }
+    }
+    if (!isBlank(pending))
+      return fail(pendingLine, "missing ';'");
+    if (!found) {
+      error = std::string("no disassembly for kernel ") + kernelName;
+      return false;
+    }
+
+    uint32_t slot = 0;
+    for (auto &s : statements) {
+      s.slot = slot;
+      slot += s.compacted ? 1 : 2;
+    }
+    endSlot = slot;
+
+    insns.clear();
+    for (const auto &s : statements) {
+      GenNativeInstruction native;
+      if (!encode(s, native))
+        return false;
+      if (s.compacted) {
+        GenCompactInstruction compact;
+        if (!compactInstruction(native, compact))
+          return fail(s.line, "instruction cannot be compacted");
+        insns.push_back(compact.low);
+      } else {
+        insns.push_back(native.low);
+        insns.push_back(native.high);
+      }
+    }
+    return true;
+  }
+
+  bool assembleGenISA(const char *text, uint32_t deviceID, const char *kernelName,
+                      vector<GenInstruction> &insns, std::string &error) {
+    if (!IS_GEN8(deviceID) && !IS_GEN9(deviceID)) {
+      error = "the assembler only supports Gen8 and Gen9";
+      return false;
+    }
+    GenAssembler assembler(error);
+    return assembler.assemble(text, kernelName, insns);
+  }
+
+} /* namespace gbe */
+
@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file gen_insn_assembler.hpp
+ *
+ * Text to binary Gen ISA. The accepted syntax is the one printed by
+ * gen_disasm (and so by OCL_OUTPUT_ASM), which makes it possible to dump a
+ * kernel, hand edit it and load it back in place of the generated code
+ */
+
+#ifndef __GBE_GEN_INSN_ASSEMBLER_HPP__
+#define __GBE_GEN_INSN_ASSEMBLER_HPP__
+
+#include "sys/vector.hpp"
+#include <string>
+
+struct GenInstruction;
+
+namespace gbe
+{
+  /*! Assemble the text of one kernel into the encoder store layout (8 bytes
+   *  slots, compacted instructions use one slot and native ones two). If the
+   *  text holds several "X's disassemble begin:" blocks, only the one of
+   *  kernelName is read. Gen8+ only. On failure, error says what and where
+   */
+  bool assembleGenISA(const char *text, uint32_t deviceID, const char *kernelName,
+                      vector<GenInstruction> &insns, std::string &error);
+
+} /* namespace gbe */
+
+#endif /* __GBE_GEN_INSN_ASSEMBLER_HPP__ */
+
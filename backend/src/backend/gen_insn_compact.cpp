@@ -18,6 +18,7 @@
  */
 #include "backend/gen_defs.hpp"
 #include "backend/gen_encoder.hpp"
+#include "backend/gen8_instruction.hpp"
 #include <cstring>
 
 namespace gbe {
@@ -62,7 +63,16 @@ namespace gbe {
     {0b0101000000100000000, 31},
   };
 
+  /* The lookup tables must stay sorted by bit pattern for bsearch, the
+   * *_decompact tables list the same entries in hardware index order */
   static compact_table_entry src3_control_table[] = {
+    {0b000000000110000000000001, 1},
+    {0b000000001000000000000001, 2},
+    {0b000000001000000000100001, 3},
+    {0b100000000110000000000001, 0},
+  };
+
+  static compact_table_entry src3_control_decompact[] = {
     {0b100000000110000000000001, 0},
     {0b000000000110000000000001, 1},
     {0b000000001000000000000001, 2},
@@ -105,6 +115,41 @@ namespace gbe {
   };
 
   static compact_table_entry gen8_data_type_table[] = {
+    {0b000000000010000001100, 20},
+    {0b001000000000000000001, 0},
+    {0b001000000000001000000, 1},
+    {0b001000000000001000001, 2},
+    {0b001000000000001011101, 21},
+    {0b001000000000011000001, 3},
+    {0b001000000000101000101, 22},
+    {0b001000000000101011101, 4},
+    {0b001000000010111011101, 5},
+    {0b001000000011101000001, 6},
+    {0b001000000011101000101, 7},
+    {0b001000000011101011101, 8},
+    {0b001000001000001000000, 23},
+    {0b001000001000001000001, 9},
+    {0b001000011000001000000, 10},
+    {0b001000011000001000001, 11},
+    {0b001000101000101000100, 24},
+    {0b001000101000101000101, 12},
+    {0b001000111000100000100, 25},
+    {0b001000111000101000100, 13},
+    {0b001000111000101000101, 14},
+    {0b001001001001000001001, 26},
+    {0b001001001001001001000, 30},
+    {0b001001011001001001000, 31},
+    {0b001001111001101001100, 29},
+    {0b001010111011101011101, 27},
+    {0b001011100011101011101, 15},
+    {0b001011101011100011101, 16},
+    {0b001011101011101011100, 17},
+    {0b001011101011101011101, 18},
+    {0b001011111011101011100, 19},
+    {0b001011111011101011101, 28},
+  };
+
+  static compact_table_entry gen8_data_type_decompact[] = {
     {0b001000000000000000001, 0},
     {0b001000000000001000000, 1},
     {0b001000000000001000001, 2},
@@ -346,7 +391,7 @@ namespace gbe {
       Gen8NativeInstruction *pOut = (union Gen8NativeInstruction *) insn;
       memset(pOut, 0, sizeof(Gen8NativeInstruction));
       union Src3ControlBits control_bits;
-      control_bits.data = src3_control_table[(uint32_t)p->src3Insn.bits1.control_index].bit_pattern;
+      control_bits.data = src3_control_decompact[(uint32_t)p->src3Insn.bits1.control_index].bit_pattern;
       pOut->header.opcode = p->bits1.opcode;
 
       pOut->bits1.da1.flag_sub_reg_nr = control_bits.flag_sub_reg_nr;
@@ -457,7 +502,7 @@ namespace gbe {
         union Gen8DataTypeBits data_type_bits;
         union SubRegBits subreg_bits;
         union SrcRegBits src0_bits;
-        data_type_bits.data = gen8_data_type_table[(uint32_t)p->bits1.data_type_index].bit_pattern;
+        data_type_bits.data = gen8_data_type_decompact[(uint32_t)p->bits1.data_type_index].bit_pattern;
         subreg_bits.data = subreg_table[(uint32_t)p->bits1.sub_reg_index].bit_pattern;
         src0_bits.data = srcreg_table[p->bits1.src0_index_lo | p->bits2.src0_index_hi << 2].bit_pattern;
 
@@ -476,7 +521,9 @@ namespace gbe {
 
         pOut->bits2.da1.src1_reg_file = data_type_bits.src1_reg_file;
         pOut->bits2.da1.src1_reg_type = data_type_bits.src1_reg_type;
-        if(data_type_bits.src1_reg_file == GEN_IMMEDIATE_VALUE) {
+        // the immediate of a one source instruction also lives in the src1 fields
+        if(data_type_bits.src0_reg_file == GEN_IMMEDIATE_VALUE ||
+           data_type_bits.src1_reg_file == GEN_IMMEDIATE_VALUE) {
           uint32_t imm = (uint32_t)p->bits2.src1_reg_nr | (p->bits2.src1_index<<8);
           pOut->bits3.ud = imm & 0x1000 ? (imm | 0xfffff000) : imm;
         } else {
@@ -800,6 +847,9 @@ namespace gbe {
     assert(src2.address_mode == GEN_ADDRESS_DIRECT);
     assert(src2.nr < 128);
 
+    // the compact form has neither a destination sub register nor a write mask
+    if( dst.subnr != 0) return false;
+
     int control_index = compactControlBitsSrc3(p, p->curr.quarterControl, p->curr.execWidth);
     if( control_index == -1) return false;
     if( src0.negation + src1.negation + src2.negation > 1)
@@ -825,4 +875,271 @@ namespace gbe {
     insn->src3Insn.bits2.src2_reg_nr = src2.nr;
     return true;
   }
+
+  /* 13 bits immediates, sign extended to 32 bits by the hardware */
+  static bool isCompactableImmediate(uint32_t imm) {
+    return (imm & 0xfffff000) == 0 || (imm & 0xfffff000) == 0xfffff000;
+  }
+
+  /*! Build the compact form of an already encoded Gen8 one or two sources
+   *  instruction. It is only accepted if it decompacts to the very same bits */
+  bool compactNativeInstruction(const GenNativeInstruction *native, GenCompactInstruction *out) {
+    const Gen8NativeInstruction *insn = &native->gen8_insn;
+    const uint32_t opcode = insn->header.opcode;
+
+    // flow control keeps its offsets in the source fields, sends their descriptor
+    if ((opcode >= GEN_OPCODE_JMPI && opcode <= GEN_OPCODE_WAIT) ||
+        opcode == GEN_OPCODE_SEND || opcode == GEN_OPCODE_SENDC ||
+        opcode == GEN_OPCODE_SENDS || opcode == GEN_OPCODE_MAD ||
+        opcode == GEN_OPCODE_LRP || opcode == GEN_OPCODE_MADM ||
+        opcode == GEN_OPCODE_NOP)
+      return false;
+    if (insn->header.cmpt_control != 0 || insn->header.nib_ctrl != 0)
+      return false;
+
+    ControlBits control;
+    control.data = 0;
+    control.access_mode = insn->header.access_mode;
+    control.mask_control = insn->bits1.da1.mask_control;
+    control.dependency_control = insn->header.dependency_control;
+    control.quarter_control = insn->header.quarter_control;
+    control.thread_control = insn->header.thread_control;
+    control.predicate_control = insn->header.predicate_control;
+    control.predicate_inverse = insn->header.predicate_inverse;
+    control.execution_size = insn->header.execution_size;
+    control.saturate = insn->header.saturate;
+    control.flag_sub_reg_nr = insn->bits1.da1.flag_sub_reg_nr;
+    control.flag_reg_nr = insn->bits1.da1.flag_reg_nr;
+
+    Gen8DataTypeBits dataType;
+    dataType.data = 0;
+    dataType.dest_reg_file = insn->bits1.da1.dest_reg_file;
+    dataType.dest_reg_type = insn->bits1.da1.dest_reg_type;
+    dataType.src0_reg_file = insn->bits1.da1.src0_reg_file;
+    dataType.src0_reg_type = insn->bits1.da1.src0_reg_type;
+    dataType.src1_reg_file = insn->bits2.da1.src1_reg_file;
+    dataType.src1_reg_type = insn->bits2.da1.src1_reg_type;
+    dataType.dest_horiz_stride = insn->bits1.da1.dest_horiz_stride;
+    dataType.dest_address_mode = insn->bits1.da1.dest_address_mode;
+
+    const bool hasImm = dataType.src0_reg_file == GEN_IMMEDIATE_VALUE ||
+                        dataType.src1_reg_file == GEN_IMMEDIATE_VALUE;
+    const uint32_t imm = insn->bits3.ud;
+    if (hasImm && !isCompactableImmediate(imm))
+      return false;
+
+    SubRegBits subreg;
+    subreg.data = 0;
+    subreg.dest_subreg_nr = insn->bits1.da1.dest_subreg_nr;
+    subreg.src0_subreg_nr = insn->bits2.da1.src0_subreg_nr;
+    subreg.src1_subreg_nr = hasImm ? 0 : insn->bits3.da1.src1_subreg_nr;
+
+    compact_table_entry key, *control_entry, *data_type_entry, *subreg_entry;
+    compact_table_entry *src0_entry, *src1_entry = NULL;
+    key.bit_pattern = control.data;
+    control_entry = (compact_table_entry *)bsearch(&key, control_table,
+      sizeof(control_table)/sizeof(compact_table_entry), sizeof(compact_table_entry), cmp_key);
+    key.bit_pattern = dataType.data;
+    data_type_entry = (compact_table_entry *)bsearch(&key, gen8_data_type_table,
+      sizeof(gen8_data_type_table)/sizeof(compact_table_entry), sizeof(compact_table_entry), cmp_key);
+    key.bit_pattern = subreg.data;
+    subreg_entry = (compact_table_entry *)bsearch(&key, subreg_table,
+      sizeof(subreg_table)/sizeof(compact_table_entry), sizeof(compact_table_entry), cmp_key);
+    key.bit_pattern = (insn->bits2.ud >> 13) & 0xfff;
+    src0_entry = (compact_table_entry *)bsearch(&key, srcreg_table,
+      sizeof(srcreg_table)/sizeof(compact_table_entry), sizeof(compact_table_entry), cmp_key);
+    if (!hasImm) {
+      key.bit_pattern = (insn->bits3.ud >> 13) & 0xfff;
+      src1_entry = (compact_table_entry *)bsearch(&key, srcreg_table,
+        sizeof(srcreg_table)/sizeof(compact_table_entry), sizeof(compact_table_entry), cmp_key);
+      if (src1_entry == NULL) return false;
+    }
+    if (control_entry == NULL || data_type_entry == NULL ||
+        subreg_entry == NULL || src0_entry == NULL)
+      return false;
+
+    std::memset(out, 0, sizeof(GenCompactInstruction));
+    out->bits1.opcode = opcode;
+    out->bits1.debug_control = insn->header.debug_control;
+    out->bits1.control_index = control_entry->index;
+    out->bits1.data_type_index = data_type_entry->index;
+    out->bits1.sub_reg_index = subreg_entry->index;
+    out->bits1.acc_wr_control = insn->header.acc_wr_control;
+    out->bits1.destreg_or_condmod = insn->header.destreg_or_condmod;
+    out->bits1.cmpt_control = 1;
+    out->bits1.src0_index_lo = src0_entry->index & 3;
+    out->bits2.src0_index_hi = src0_entry->index >> 2;
+    out->bits2.src1_index = hasImm ? (imm & 8191) >> 8 : src1_entry->index;
+    out->bits2.dest_reg_nr = insn->bits1.da1.dest_reg_nr;
+    out->bits2.src0_reg_nr = insn->bits2.da1.src0_reg_nr;
+    out->bits2.src1_reg_nr = hasImm ? (imm & 0xff) : insn->bits3.da1.src1_reg_nr;
+
+    GenNativeInstruction check;
+    decompactInstruction(out, &check, 8);
+    check.gen8_insn.header.cmpt_control = 0;
+    return std::memcmp(&check, native, sizeof(GenNativeInstruction)) == 0;
+  }
+
+  /*! IF, ELSE and BRC keep uip in the second dword, except for the indexed
+   *  BRC of the encoder whose GRF source leaves the jip alone in the last one */
+  static bool hasUip(const Gen8NativeInstruction *insn) {
+    if (insn->header.opcode == GEN_OPCODE_IF || insn->header.opcode == GEN_OPCODE_ELSE)
+      return true;
+    return insn->header.opcode == GEN_OPCODE_BRC &&
+           insn->bits1.da1.src0_reg_file != GEN_GENERAL_REGISTER_FILE;
+  }
+
+  /*! Gen8 jumps are byte offsets. JMPI is relative to the next instruction,
+   *  the other branches to themselves. f(insnID, from, jip, uip) is called for
+   *  every branch (uip is 0 when there is none), false is returned as soon as
+   *  f fails or a branch is not one the encoder generates */
+  template <typename T>
+  static bool forEachJump(const vector<GenInstruction> &store, T f) {
+    for (uint32_t insnID = 0; insnID < store.size(); ) {
+      const GenCompactInstruction *cmp = (const GenCompactInstruction *)&store[insnID];
+      if (cmp->bits1.cmpt_control == 1) {
+        insnID++;
+        continue;
+      }
+      const Gen8NativeInstruction *insn = &((const GenNativeInstruction *)&store[insnID])->gen8_insn;
+      if (hasUip(insn)) {
+        if (!f(insnID, insnID, (int32_t)insn->bits3.gen8_branch.jip, (int32_t)insn->bits2.gen8_branch.uip))
+          return false;
+        insnID += 2;
+        continue;
+      }
+      switch (insn->header.opcode) {
+        case GEN_OPCODE_JMPI:
+          if (!f(insnID, insnID + 2, (int32_t)insn->bits3.ud, 0))
+            return false;
+          break;
+        case GEN_OPCODE_BRD:
+        case GEN_OPCODE_BRC:
+        case GEN_OPCODE_ENDIF:
+        case GEN_OPCODE_WHILE:
+          if (!f(insnID, insnID, (int32_t)insn->bits3.ud, 0))
+            return false;
+          break;
+        case GEN_OPCODE_BREAK:
+        case GEN_OPCODE_CONTINUE:
+        case GEN_OPCODE_HALT:
+          return false; // not generated, do not guess their encoding
+        default:
+          break;
+      }
+      insnID += 2;
+    }
+    return true;
+  }
+
+  static bool remapJump(const vector<uint32_t> &posMap, uint32_t from, int32_t &offset) {
+    if (offset % 8 != 0)
+      return false;
+    const int64_t target = (int64_t)from + offset / 8;
+    if (target < 0 || target >= (int64_t)posMap.size() || posMap[target] == 0xffffffff)
+      return false;
+    offset = ((int32_t)posMap[target] - (int32_t)posMap[from]) * 8;
+    return true;
+  }
+
+  /*! Flag every slot some branch of the stream lands on */
+  bool getBranchTargets(const vector<GenInstruction> &store, vector<uint8_t> &isTarget) {
+    isTarget.assign(store.size() + 1, 0);
+    return forEachJump(store, [&](uint32_t insnID, uint32_t from, int32_t jip, int32_t uip) {
+      const int32_t offsets[2] = {jip, uip};
+      for (uint32_t i = 0; i < (uip ? 2 : 1); i++) {
+        const int64_t target = (int64_t)from + offsets[i] / 8;
+        if (offsets[i] % 8 != 0 || target < 0 || target > (int64_t)store.size())
+          return false;
+        isTarget[target] = 1;
+      }
+      return true;
+    });
+  }
+
+  /*! Fix the branch offsets of the stream for the moves given by posMap */
+  bool remapBranches(vector<GenInstruction> &store, const vector<uint32_t> &posMap) {
+    // Compute every new jump offset first, the stream is left untouched if
+    // any branch does not land on an instruction
+    vector<std::pair<uint32_t, std::pair<int32_t, int32_t>>> jumps;
+    const bool valid = forEachJump(store, [&](uint32_t insnID, uint32_t from, int32_t jip, int32_t uip) {
+      if (!remapJump(posMap, from, jip) || !remapJump(posMap, from, uip))
+        return false;
+      jumps.push_back(std::make_pair(insnID, std::make_pair(jip, uip)));
+      return true;
+    });
+    if (!valid)
+      return false;
+    for (auto &jump : jumps) {
+      Gen8NativeInstruction *insn = &((GenNativeInstruction *)&store[jump.first])->gen8_insn;
+      if (hasUip(insn)) {
+        insn->bits3.gen8_branch.jip = jump.second.first;
+        insn->bits2.gen8_branch.uip = jump.second.second;
+      } else
+        insn->bits3.ud = jump.second.first;
+    }
+    return true;
+  }
+
+  uint32_t recompactInstructions(GenEncoder *p, vector<uint32_t> &posMap) {
+    if (p->getCompactVersion() < 8)
+      return 0;
+    vector<GenInstruction> &store = p->store;
+    const uint32_t insnNum = store.size();
+    vector<GenCompactInstruction> compacted(insnNum);
+    vector<uint8_t> isCompacted(insnNum, 0);
+    uint32_t compactNum = 0, newNum = 0;
+
+    // Decide which instructions shrink and where every instruction moves.
+    // The second half of a native instruction is never a valid position
+    posMap.assign(insnNum + 1, 0xffffffff);
+    for (uint32_t insnID = 0; insnID < insnNum; ) {
+      posMap[insnID] = newNum;
+      const GenCompactInstruction *insn = (const GenCompactInstruction *)&store[insnID];
+      if (insn->bits1.cmpt_control == 1) {
+        insnID++;
+        newNum++;
+        continue;
+      }
+      GBE_ASSERT(insnID + 1 < insnNum);
+      if (compactNativeInstruction((const GenNativeInstruction *)&store[insnID], &compacted[insnID])) {
+        isCompacted[insnID] = 1;
+        compactNum++;
+        newNum++;
+      } else
+        newNum += 2;
+      insnID += 2;
+    }
+    posMap[insnNum] = newNum;
+    if (compactNum == 0)
+      return 0;
+
+    if (!remapBranches(store, posMap))
+      return 0;
+
+    // Rebuild the stream (and the debug info which follows it)
+    const bool hasDBGInfo = p->storedbg.size() == insnNum;
+    vector<GenInstruction> newStore;
+    vector<DebugInfo> newDBGInfo;
+    newStore.reserve(newNum);
+    for (uint32_t insnID = 0; insnID < insnNum; ) {
+      const GenCompactInstruction *insn = (const GenCompactInstruction *)&store[insnID];
+      const uint32_t size = insn->bits1.cmpt_control == 1 ? 1 : 2;
+      if (isCompacted[insnID]) {
+        newStore.push_back(compacted[insnID].low);
+        if (hasDBGInfo) newDBGInfo.push_back(p->storedbg[insnID]);
+      } else {
+        for (uint32_t i = 0; i < size; ++i) {
+          newStore.push_back(store[insnID + i]);
+          if (hasDBGInfo) newDBGInfo.push_back(p->storedbg[insnID + i]);
+        }
+      }
+      insnID += size;
+    }
+    GBE_ASSERT(newStore.size() == newNum);
+    store.swap(newStore);
+    if (hasDBGInfo)
+      p->storedbg.swap(newDBGInfo);
+    return compactNum;
+  }
 };
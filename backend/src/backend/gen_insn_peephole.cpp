@@ -0,0 +1,534 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file gen_insn_peephole.cpp
+ *
+ * Last cleanup of the encoded Gen8+ stream, once the branches are patched:
+ * - MOVs which change nothing (self copies not waiting for a SEND reply,
+ *   the same copy twice, a copy followed by the copy back) are removed,
+ * - two MOVs of consecutive channels are fused into one twice wider,
+ * - consecutive writes to disjoint parts of the same GRF get NoDDClr /
+ *   NoDDChk so the second one does not wait for the first one.
+ * An instruction any branch lands on is never removed nor hinted.
+ */
+
+#include "backend/gen_defs.hpp"
+#include "backend/gen_encoder.hpp"
+#include "backend/gen8_instruction.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace gbe
+{
+  extern void decompactInstruction(GenCompactInstruction *p, void *insn, uint32_t insn_version);
+  extern bool getBranchTargets(const vector<GenInstruction> &store, vector<uint8_t> &isTarget);
+  extern bool remapBranches(vector<GenInstruction> &store, const vector<uint32_t> &posMap);
+
+#define NO_DD_CLEAR 1
+#define NO_DD_CHECK 2
+
+  /*! One instruction of the stream, always seen in its native form */
+  struct PeepholeInsn {
+    Gen8NativeInstruction insn;
+    uint32_t pos;        //!< first slot in the store
+    uint32_t size;       //!< 1 if compacted, 2 otherwise
+    bool removed;
+    bool modified;       //!< must be written back as a native instruction
+  };
+
+  /*! Byte range [begin, end) of the GRF file */
+  struct ByteRange {
+    uint32_t begin, end;
+    INLINE bool overlaps(const ByteRange &other) const {
+      return begin < other.end && other.begin < end;
+    }
+  };
+
+  static uint32_t regTypeSize(uint32_t type) {
+    static const uint32_t sizes[] = {4, 4, 2, 2, 1, 1, 8, 4, 8, 8, 2};
+    return type < sizeof(sizes) / sizeof(sizes[0]) ? sizes[type] : 0;
+  }
+
+  static uint32_t execWidth(const Gen8NativeInstruction &insn) {
+    return 1 << insn.header.execution_size;
+  }
+
+  static uint32_t decodeStride(uint32_t enc) {
+    return enc == 0 ? 0 : 1 << (enc - 1);
+  }
+
+  static bool isDirectGRFDst(const Gen8NativeInstruction &insn) {
+    return insn.header.access_mode == GEN_ALIGN_1 &&
+           insn.bits1.da1.dest_reg_file == GEN_GENERAL_REGISTER_FILE &&
+           insn.bits1.da1.dest_address_mode == GEN_ADDRESS_DIRECT &&
+           regTypeSize(insn.bits1.da1.dest_reg_type) != 0;
+  }
+
+  static bool isDirectGRFSrc0(const Gen8NativeInstruction &insn) {
+    return insn.bits1.da1.src0_reg_file == GEN_GENERAL_REGISTER_FILE &&
+           insn.bits2.da1.src0_address_mode == GEN_ADDRESS_DIRECT &&
+           regTypeSize(insn.bits1.da1.src0_reg_type) != 0;
+  }
+
+  static uint32_t dstOffset(const Gen8NativeInstruction &insn, uint32_t i) {
+    const uint32_t size = regTypeSize(insn.bits1.da1.dest_reg_type);
+    return insn.bits1.da1.dest_reg_nr * GEN_REG_SIZE + insn.bits1.da1.dest_subreg_nr +
+           i * decodeStride(insn.bits1.da1.dest_horiz_stride) * size;
+  }
+
+  static uint32_t src0Offset(const Gen8NativeInstruction &insn, uint32_t i) {
+    const uint32_t size = regTypeSize(insn.bits1.da1.src0_reg_type);
+    const uint32_t width = 1 << insn.bits2.da1.src0_width;
+    const uint32_t vstride = decodeStride(insn.bits2.da1.src0_vert_stride);
+    const uint32_t hstride = decodeStride(insn.bits2.da1.src0_horiz_stride);
+    return insn.bits2.da1.src0_reg_nr * GEN_REG_SIZE + insn.bits2.da1.src0_subreg_nr +
+           ((i / width) * vstride + (i % width) * hstride) * size;
+  }
+
+  static uint32_t src1Offset(const Gen8NativeInstruction &insn, uint32_t i) {
+    const uint32_t size = regTypeSize(insn.bits2.da1.src1_reg_type);
+    const uint32_t width = 1 << insn.bits3.da1.src1_width;
+    const uint32_t vstride = decodeStride(insn.bits3.da1.src1_vert_stride);
+    const uint32_t hstride = decodeStride(insn.bits3.da1.src1_horiz_stride);
+    return insn.bits3.da1.src1_reg_nr * GEN_REG_SIZE + insn.bits3.da1.src1_subreg_nr +
+           ((i / width) * vstride + (i % width) * hstride) * size;
+  }
+
+  static ByteRange dstRange(const Gen8NativeInstruction &insn) {
+    const uint32_t size = regTypeSize(insn.bits1.da1.dest_reg_type);
+    return {dstOffset(insn, 0), dstOffset(insn, execWidth(insn) - 1) + size};
+  }
+
+  /*! Regions may go back with a 0 vertical stride, look at every element */
+  template <typename T>
+  static ByteRange srcRange(const Gen8NativeInstruction &insn, uint32_t size, T offset) {
+    ByteRange range = {offset(insn, 0), offset(insn, 0) + size};
+    for (uint32_t i = 1; i < execWidth(insn); i++) {
+      range.begin = std::min(range.begin, offset(insn, i));
+      range.end = std::max(range.end, offset(insn, i) + size);
+    }
+    return range;
+  }
+
+  static ByteRange src0Range(const Gen8NativeInstruction &insn) {
+    return srcRange(insn, regTypeSize(insn.bits1.da1.src0_reg_type), src0Offset);
+  }
+
+  static ByteRange src1Range(const Gen8NativeInstruction &insn) {
+    return srcRange(insn, regTypeSize(insn.bits2.da1.src1_reg_type), src1Offset);
+  }
+
+  /*! A MOV without side effect besides its destination */
+  static bool isPlainMov(const Gen8NativeInstruction &insn) {
+    return insn.header.opcode == GEN_OPCODE_MOV &&
+           insn.header.access_mode == GEN_ALIGN_1 &&
+           insn.header.destreg_or_condmod == GEN_CONDITIONAL_NONE &&
+           insn.header.acc_wr_control == 0 &&
+           insn.header.debug_control == 0 &&
+           insn.header.dependency_control == 0 &&
+           insn.header.thread_control == 0 &&
+           isDirectGRFDst(insn);
+  }
+
+  static bool hasSrc0Modifier(const Gen8NativeInstruction &insn) {
+    return insn.bits2.da1.src0_abs || insn.bits2.da1.src0_negate;
+  }
+
+  static bool samePredicate(const Gen8NativeInstruction &a, const Gen8NativeInstruction &b) {
+    return a.header.predicate_control == b.header.predicate_control &&
+           a.header.predicate_inverse == b.header.predicate_inverse &&
+           a.bits1.da1.flag_reg_nr == b.bits1.da1.flag_reg_nr &&
+           a.bits1.da1.flag_sub_reg_nr == b.bits1.da1.flag_sub_reg_nr;
+  }
+
+  static bool sameChannels(const Gen8NativeInstruction &a, const Gen8NativeInstruction &b) {
+    return a.header.execution_size == b.header.execution_size &&
+           a.header.quarter_control == b.header.quarter_control &&
+           a.header.nib_ctrl == b.header.nib_ctrl &&
+           a.bits1.da1.mask_control == b.bits1.da1.mask_control;
+  }
+
+  /*! mov g10<1>:D g10<8,8,1>:D */
+  static bool isSelfCopy(const Gen8NativeInstruction &insn) {
+    if (!isPlainMov(insn) || !isDirectGRFSrc0(insn) || hasSrc0Modifier(insn) ||
+        insn.header.saturate ||
+        insn.bits1.da1.dest_reg_type != insn.bits1.da1.src0_reg_type)
+      return false;
+    for (uint32_t i = 0; i < execWidth(insn); i++)
+      if (dstOffset(insn, i) != src0Offset(insn, i))
+        return false;
+    return true;
+  }
+
+  static bool isSend(const Gen8NativeInstruction &insn) {
+    return insn.header.opcode == GEN_OPCODE_SEND || insn.header.opcode == GEN_OPCODE_SENDC ||
+           insn.header.opcode == GEN_OPCODE_SENDS;
+  }
+
+  /*! Flag the GRFs a SEND writes back. A self copy of one of them afterwards
+   *  is how a fence or a sampler flush waits for its reply, it must stay */
+  static void markSendDst(const Gen8NativeInstruction &insn, uint8_t sendDst[GEN_MAX_GRF]) {
+    const Gen9NativeInstruction &gen9 = (const Gen9NativeInstruction &)insn;
+    uint32_t reg, regNum = 32;   // the whole tail when the descriptor is a register
+    if (insn.header.opcode == GEN_OPCODE_SENDS) {
+      reg = gen9.bits1.sends.dest_reg_nr;
+      if (!gen9.bits2.sends.sel_reg32_desc)
+        regNum = insn.bits3.generic_gen5.response_length;
+    } else {
+      reg = insn.bits1.da1.dest_reg_nr;
+      if (insn.bits2.da1.src1_reg_file == GEN_IMMEDIATE_VALUE)
+        regNum = insn.bits3.generic_gen5.response_length;
+    }
+    regNum = std::max(regNum, 1u);
+    for (uint32_t i = reg; i < std::min(reg + regNum, (uint32_t)GEN_MAX_GRF); i++)
+      sendDst[i] = 1;
+  }
+
+  static bool readsSendDst(const Gen8NativeInstruction &insn, const uint8_t sendDst[GEN_MAX_GRF]) {
+    const ByteRange range = dstRange(insn);
+    for (uint32_t reg = range.begin / GEN_REG_SIZE; reg <= (range.end - 1) / GEN_REG_SIZE; reg++)
+      if (reg >= GEN_MAX_GRF || sendDst[reg])
+        return true;
+    return false;
+  }
+
+  /*! The same MOV twice in a row, the second one writes what is already there */
+  static bool isRepeatedCopy(const Gen8NativeInstruction &prev, const Gen8NativeInstruction &insn) {
+    if (!isPlainMov(insn) || std::memcmp(&prev, &insn, sizeof(insn)) != 0)
+      return false;
+    if (insn.bits1.da1.src0_reg_file == GEN_IMMEDIATE_VALUE)
+      return true;
+    return isDirectGRFSrc0(insn) && !dstRange(insn).overlaps(src0Range(insn));
+  }
+
+  /*! mov a b followed by mov b a, with the same channels and raw moves */
+  static bool isCopyBack(const Gen8NativeInstruction &prev, const Gen8NativeInstruction &insn) {
+    if (!isPlainMov(prev) || !isPlainMov(insn) ||
+        !isDirectGRFSrc0(prev) || !isDirectGRFSrc0(insn) ||
+        hasSrc0Modifier(prev) || hasSrc0Modifier(insn) ||
+        prev.header.saturate || insn.header.saturate ||
+        !samePredicate(prev, insn) || !sameChannels(prev, insn))
+      return false;
+    const uint32_t type = prev.bits1.da1.dest_reg_type;
+    if (prev.bits1.da1.src0_reg_type != type ||
+        insn.bits1.da1.dest_reg_type != type || insn.bits1.da1.src0_reg_type != type)
+      return false;
+    if (dstRange(prev).overlaps(src0Range(prev)))
+      return false;
+    for (uint32_t i = 0; i < execWidth(insn); i++)
+      if (dstOffset(insn, i) != src0Offset(prev, i) || src0Offset(insn, i) != dstOffset(prev, i))
+        return false;
+    return true;
+  }
+
+  /*! An operand of n bytes either stays in one GRF or covers exactly two */
+  static bool isValidSpan(uint32_t begin, uint32_t n) {
+    if (n <= GEN_REG_SIZE)
+      return begin % GEN_REG_SIZE + n <= GEN_REG_SIZE;
+    return begin % GEN_REG_SIZE == 0 && n == 2 * GEN_REG_SIZE;
+  }
+
+  /*! Try to turn prev into a MOV of its channels and the ones of insn */
+  static bool fuseMovs(Gen8NativeInstruction &prev, const Gen8NativeInstruction &insn) {
+    if (!isPlainMov(prev) || !isPlainMov(insn) ||
+        prev.header.predicate_control != GEN_PREDICATE_NONE ||
+        insn.header.predicate_control != GEN_PREDICATE_NONE ||
+        prev.header.saturate != insn.header.saturate ||
+        prev.header.execution_size != insn.header.execution_size ||
+        prev.bits1.da1.mask_control != insn.bits1.da1.mask_control ||
+        prev.bits1.da1.dest_reg_type != insn.bits1.da1.dest_reg_type ||
+        prev.bits1.da1.src0_reg_type != insn.bits1.da1.src0_reg_type ||
+        prev.bits1.da1.src0_reg_file != insn.bits1.da1.src0_reg_file ||
+        prev.bits2.da1.src0_abs != insn.bits2.da1.src0_abs ||
+        prev.bits2.da1.src0_negate != insn.bits2.da1.src0_negate)
+      return false;
+
+    const uint32_t n = execWidth(prev);
+    const uint32_t dstSize = regTypeSize(prev.bits1.da1.dest_reg_type);
+    if (n > 8 || dstSize < 2 || dstSize > 4)
+      return false;
+
+    // Without WE_all, the second MOV must run the next channels
+    uint32_t qtr = prev.header.quarter_control;
+    if (!prev.bits1.da1.mask_control) {
+      if (n == 8 && (qtr & 1) == 0 && prev.header.nib_ctrl == 0 &&
+          insn.header.quarter_control == qtr + 1 && insn.header.nib_ctrl == 0)
+        ;
+      else if (n == 4 && prev.header.nib_ctrl == 0 && insn.header.nib_ctrl == 1 &&
+               insn.header.quarter_control == qtr)
+        ;
+      else
+        return false;
+    }
+
+    const uint32_t dstBegin = dstOffset(prev, 0);
+    if ((n > 1 && (prev.bits1.da1.dest_horiz_stride != GEN_HORIZONTAL_STRIDE_1 ||
+                   insn.bits1.da1.dest_horiz_stride != GEN_HORIZONTAL_STRIDE_1)) ||
+        dstOffset(insn, 0) != dstBegin + n * dstSize ||
+        !isValidSpan(dstBegin, 2 * n * dstSize))
+      return false;
+    const ByteRange dst = {dstBegin, dstBegin + 2 * n * dstSize};
+
+    Gen8NativeInstruction fused = prev;
+    if (prev.bits1.da1.src0_reg_file == GEN_IMMEDIATE_VALUE) {
+      const uint32_t type = prev.bits1.da1.src0_reg_type;
+      // packed vectors give each channel its own value
+      if (type != GEN_TYPE_UD && type != GEN_TYPE_D && type != GEN_TYPE_UW &&
+          type != GEN_TYPE_W && type != GEN_TYPE_F)
+        return false;
+      if (prev.bits2.ud != insn.bits2.ud || prev.bits3.ud != insn.bits3.ud)
+        return false;
+    } else {
+      if (!isDirectGRFSrc0(prev) || !isDirectGRFSrc0(insn))
+        return false;
+      const uint32_t srcSize = regTypeSize(prev.bits1.da1.src0_reg_type);
+      if (srcSize != dstSize)
+        return false;
+      bool contiguous = true, scalar = true;
+      const uint32_t srcBegin = src0Offset(prev, 0);
+      for (uint32_t i = 0; i < n; i++) {
+        contiguous = contiguous && src0Offset(prev, i) == srcBegin + i * srcSize &&
+                     src0Offset(insn, i) == srcBegin + (n + i) * srcSize;
+        scalar = scalar && src0Offset(prev, i) == srcBegin && src0Offset(insn, i) == srcBegin;
+      }
+      ByteRange src;
+      if (contiguous) {
+        if (!isValidSpan(srcBegin, 2 * n * srcSize))
+          return false;
+        const uint32_t width = std::min(2 * n, 8u);
+        fused.bits2.da1.src0_vert_stride = __builtin_ctz(width) + 1;
+        fused.bits2.da1.src0_width = __builtin_ctz(width);
+        fused.bits2.da1.src0_horiz_stride = GEN_HORIZONTAL_STRIDE_1;
+        src = {srcBegin, srcBegin + 2 * n * srcSize};
+      } else if (scalar) {
+        fused.bits2.da1.src0_vert_stride = GEN_VERTICAL_STRIDE_0;
+        fused.bits2.da1.src0_width = GEN_WIDTH_1;
+        fused.bits2.da1.src0_horiz_stride = GEN_HORIZONTAL_STRIDE_0;
+        src = {srcBegin, srcBegin + srcSize};
+      } else
+        return false;
+      if (src.overlaps(dst))
+        return false;
+    }
+
+    fused.header.execution_size = prev.header.execution_size + 1;
+    fused.header.quarter_control = qtr;
+    fused.header.nib_ctrl = 0;
+    fused.bits1.da1.dest_horiz_stride = GEN_HORIZONTAL_STRIDE_1;
+    prev = fused;
+    return true;
+  }
+
+  /*! Instructions which may carry NoDDClr / NoDDChk: plain ALU ones writing
+   *  part of a single GRF, without any flag or accumulator side effect */
+  static bool isHintCandidate(const Gen8NativeInstruction &insn) {
+    switch (insn.header.opcode) {
+      case GEN_OPCODE_MOV: case GEN_OPCODE_SEL: case GEN_OPCODE_NOT:
+      case GEN_OPCODE_AND: case GEN_OPCODE_OR: case GEN_OPCODE_XOR:
+      case GEN_OPCODE_SHR: case GEN_OPCODE_SHL: case GEN_OPCODE_ASR:
+      case GEN_OPCODE_ADD: case GEN_OPCODE_MUL: case GEN_OPCODE_AVG:
+      case GEN_OPCODE_FRC: case GEN_OPCODE_RNDU: case GEN_OPCODE_RNDD:
+      case GEN_OPCODE_RNDE: case GEN_OPCODE_RNDZ: case GEN_OPCODE_LZD:
+      case GEN_OPCODE_FBH: case GEN_OPCODE_FBL: case GEN_OPCODE_CBIT:
+      case GEN_OPCODE_BFREV:
+        break;
+      default:
+        return false;
+    }
+    if (insn.header.access_mode != GEN_ALIGN_1 ||
+        insn.header.predicate_control != GEN_PREDICATE_NONE ||
+        insn.header.destreg_or_condmod != GEN_CONDITIONAL_NONE ||
+        insn.header.acc_wr_control || insn.header.debug_control ||
+        insn.header.dependency_control || insn.header.thread_control ||
+        !isDirectGRFDst(insn) || regTypeSize(insn.bits1.da1.dest_reg_type) > 4)
+      return false;
+    const ByteRange dst = dstRange(insn);
+    if (dst.begin / GEN_REG_SIZE != (dst.end - 1) / GEN_REG_SIZE)
+      return false;
+    // the sources are read through their byte ranges, any indirect access
+    // could read anything
+    if (insn.bits1.da1.src0_reg_file == GEN_GENERAL_REGISTER_FILE &&
+        insn.bits2.da1.src0_address_mode != GEN_ADDRESS_DIRECT)
+      return false;
+    if (insn.header.opcode != GEN_OPCODE_MOV && insn.header.opcode != GEN_OPCODE_NOT &&
+        insn.bits2.da1.src1_reg_file == GEN_GENERAL_REGISTER_FILE &&
+        insn.bits3.da1.src1_address_mode != GEN_ADDRESS_DIRECT)
+      return false;
+    return true;
+  }
+
+  /*! Bytes of its GRF the destination writes */
+  static uint32_t dstByteMask(const Gen8NativeInstruction &insn) {
+    const ByteRange dst = dstRange(insn);
+    const uint32_t begin = dst.begin % GEN_REG_SIZE, n = dst.end - dst.begin;
+    return (n == 32 ? 0xffffffffu : ((1u << n) - 1)) << begin;
+  }
+
+  static bool readsGRF(const Gen8NativeInstruction &insn, uint32_t nr) {
+    const ByteRange reg = {nr * GEN_REG_SIZE, (nr + 1) * GEN_REG_SIZE};
+    if (insn.bits1.da1.src0_reg_file == GEN_GENERAL_REGISTER_FILE && src0Range(insn).overlaps(reg))
+      return true;
+    const bool twoSources = insn.header.opcode != GEN_OPCODE_MOV && insn.header.opcode != GEN_OPCODE_NOT &&
+                            insn.header.opcode != GEN_OPCODE_FRC && insn.header.opcode != GEN_OPCODE_LZD &&
+                            (insn.header.opcode < GEN_OPCODE_RNDU || insn.header.opcode > GEN_OPCODE_RNDZ) &&
+                            (insn.header.opcode < GEN_OPCODE_FBH || insn.header.opcode > GEN_OPCODE_CBIT) &&
+                            insn.header.opcode != GEN_OPCODE_BFREV;
+    return twoSources && insn.bits2.da1.src1_reg_file == GEN_GENERAL_REGISTER_FILE &&
+           src1Range(insn).overlaps(reg);
+  }
+
+  uint32_t peepholeInstructions(GenEncoder *p, vector<uint32_t> &posMap,
+                                uint32_t &removedNum, uint32_t &fusedNum, uint32_t &hintNum) {
+    removedNum = fusedNum = hintNum = 0;
+    if (p->getCompactVersion() < 8)
+      return 0;
+    vector<GenInstruction> &store = p->store;
+    const uint32_t insnNum = store.size();
+    vector<uint8_t> isTarget;
+    if (!getBranchTargets(store, isTarget))
+      return 0;
+
+    vector<PeepholeInsn> insns;
+    for (uint32_t insnID = 0; insnID < insnNum; ) {
+      PeepholeInsn insn;
+      GenCompactInstruction *cmp = (GenCompactInstruction *)&store[insnID];
+      if (cmp->bits1.cmpt_control == 1) {
+        decompactInstruction(cmp, &insn.insn, 8);
+        insn.insn.header.cmpt_control = 0;
+        insn.size = 1;
+      } else {
+        GBE_ASSERT(insnID + 1 < insnNum);
+        std::memcpy(&insn.insn, &store[insnID], sizeof(insn.insn));
+        insn.size = 2;
+      }
+      insn.pos = insnID;
+      insn.removed = insn.modified = false;
+      insns.push_back(insn);
+      insnID += insn.size;
+    }
+
+    // Removals and fusions. prev is the last instruction kept, the removed
+    // ones in between did nothing
+    PeepholeInsn *prev = NULL;
+    uint8_t sendDst[GEN_MAX_GRF] = {0};
+    for (auto &insn : insns) {
+      const bool movable = !isTarget[insn.pos] &&
+        (prev == NULL || !(prev->insn.header.dependency_control & NO_DD_CLEAR));
+      if (isSend(insn.insn))
+        markSendDst(insn.insn, sendDst);
+      if (movable && isSelfCopy(insn.insn) && !readsSendDst(insn.insn, sendDst))
+        insn.removed = true;
+      else if (movable && prev && (isRepeatedCopy(prev->insn, insn.insn) ||
+                                   isCopyBack(prev->insn, insn.insn)))
+        insn.removed = true;
+      else if (movable && prev && fuseMovs(prev->insn, insn.insn)) {
+        insn.removed = true;
+        prev->modified = true;
+        fusedNum++;
+        continue;
+      }
+      if (insn.removed)
+        removedNum++;
+      else
+        prev = &insn;
+    }
+
+    // Dependency hints on the chains of writes to the same GRF. An
+    // instruction skipping the check must not touch any byte written by the
+    // chain so far, hence the mask of these bytes
+    prev = NULL;
+    bool prevCandidate = false;
+    uint32_t chainBytes = 0;
+    for (auto &insn : insns) {
+      if (insn.removed)
+        continue;
+      const bool candidate = isHintCandidate(insn.insn);
+      bool chained = false;
+      if (candidate && prevCandidate && !isTarget[insn.pos]) {
+        const uint32_t nr = prev->insn.bits1.da1.dest_reg_nr;
+        const uint32_t bytes = dstByteMask(insn.insn);
+        if (insn.insn.bits1.da1.dest_reg_nr == nr && (bytes & chainBytes) == 0 &&
+            !readsGRF(insn.insn, nr)) {
+          if (prev->insn.header.dependency_control == 0)
+            hintNum++;
+          prev->insn.header.dependency_control |= NO_DD_CLEAR;
+          insn.insn.header.dependency_control = NO_DD_CHECK;
+          prev->modified = insn.modified = true;
+          hintNum++;
+          chainBytes |= bytes;
+          chained = true;
+        }
+      }
+      if (!chained)
+        chainBytes = candidate ? dstByteMask(insn.insn) : 0;
+      prevCandidate = candidate;
+      prev = &insn;
+    }
+    if (removedNum + fusedNum + hintNum == 0)
+      return 0;
+
+    // Where every instruction moves. A removed one forwards to the next
+    // instruction kept, the second half of a native one is never a position
+    uint32_t newNum = 0;
+    posMap.assign(insnNum + 1, 0xffffffff);
+    for (const auto &insn : insns) {
+      posMap[insn.pos] = newNum;
+      if (!insn.removed)
+        newNum += insn.modified ? 2 : insn.size;
+    }
+    posMap[insnNum] = newNum;
+    if (!remapBranches(store, posMap)) {
+      removedNum = fusedNum = hintNum = 0;
+      return 0;
+    }
+
+    // Rebuild the stream (and the debug info which follows it)
+    const bool hasDBGInfo = p->storedbg.size() == insnNum;
+    vector<GenInstruction> newStore;
+    vector<DebugInfo> newDBGInfo;
+    newStore.reserve(newNum);
+    for (const auto &insn : insns) {
+      if (insn.removed)
+        continue;
+      if (insn.modified) {
+        const GenNativeInstruction *native = (const GenNativeInstruction *)&insn.insn;
+        newStore.push_back(native->low);
+        newStore.push_back(native->high);
+        if (hasDBGInfo) {
+          newDBGInfo.push_back(p->storedbg[insn.pos]);
+          newDBGInfo.push_back(p->storedbg[insn.pos]);
+        }
+      } else {
+        for (uint32_t i = 0; i < insn.size; ++i) {
+          newStore.push_back(store[insn.pos + i]);
+          if (hasDBGInfo) newDBGInfo.push_back(p->storedbg[insn.pos + i]);
+        }
+      }
+    }
+    GBE_ASSERT(newStore.size() == newNum);
+    store.swap(newStore);
+    if (hasDBGInfo)
+      p->storedbg.swap(newDBGInfo);
+    return removedNum + fusedNum + hintNum;
+  }
+
+#undef NO_DD_CLEAR
+#undef NO_DD_CHECK
+
+} /* namespace gbe */
+
@@ -170,7 +170,68 @@ namespace gbe {
     {16, 16, false},
   };
 
+  /*! Create the code generation context matching the device */
+  static GenContext *createGenContext(const ir::Unit &unit, const std::string &name,
+                                      uint32_t deviceID, bool relaxMath) {
+    if (IS_GEN6(deviceID)) {
+      return GBE_NEW(Gen6Context, unit, name, deviceID, relaxMath);
+    } else if (IS_IVYBRIDGE(deviceID)) {
+      return GBE_NEW(GenContext, unit, name, deviceID, relaxMath);
+    } else if (IS_HASWELL(deviceID)) {
+      return GBE_NEW(Gen75Context, unit, name, deviceID, relaxMath);
+    } else if (IS_BROADWELL(deviceID)) {
+      return GBE_NEW(Gen8Context, unit, name, deviceID, relaxMath);
+    } else if (IS_CHERRYVIEW(deviceID)) {
+      return GBE_NEW(ChvContext, unit, name, deviceID, relaxMath);
+    } else if (IS_SKYLAKE(deviceID)) {
+      return GBE_NEW(Gen9Context, unit, name, deviceID, relaxMath);
+    } else if (IS_BROXTON(deviceID)) {
+      return GBE_NEW(BxtContext, unit, name, deviceID, relaxMath);
+    } else if (IS_KABYLAKE(deviceID)) {
+      return GBE_NEW(KblContext, unit, name, deviceID, relaxMath);
+    } else if (IS_COFFEELAKE(deviceID)) {
+      return GBE_NEW(KblContext, unit, name, deviceID, relaxMath);
+    } else if (IS_GEMINILAKE(deviceID)) {
+      return GBE_NEW(GlkContext, unit, name, deviceID, relaxMath);
+    }
+    return NULL;
+  }
+
   IVAR(OCL_SIMD_WIDTH, 8, 15, 16);
+  BVAR(OCL_SIMD_DUAL_VARIANT, false);
+
+  /*! Compile the SIMD8 variant of a kernel already compiled in SIMD16 without
+   *  spilling. The runtime picks between the two at enqueue time. Images,
+   *  printf and device enqueue bind state per kernel and are not supported */
+  static Kernel *compileSIMD8Variant(const ir::Unit &unit, const std::string &name,
+                                     uint32_t deviceID, bool relaxMath) {
+    ir::Function *simdFn = unit.getFunction(name);
+    if (!simdFn->getImageSet()->empty() ||
+        simdFn->getPrintfSet()->getPrintfNum() != 0 ||
+        simdFn->getUseDeviceEnqueue())
+      return NULL;
+
+    GenContext *ctx = createGenContext(unit, name, deviceID, relaxMath);
+    GBE_ASSERTM(ctx != NULL, "Fail to create the gen context\n");
+    Kernel *variant = NULL;
+    simdFn->setSimdWidth(8);
+    for (;;) {
+      ctx->startNewCG(8, 0, false);
+      variant = ctx->compileKernel();
+      if (variant != NULL) {
+        variant->setOclVersion(unit.getOclVersion());
+        break;
+      }
+      if (ctx->getErrCode() != OUT_OF_RANGE_IF_ENDIF || ctx->getIFENDIFFix())
+        break;
+      ctx->setIFENDIFFix(true);
+    }
+    simdFn->setSimdWidth(16);
+    if (variant == NULL)
+      GBE_DELETE(ctx);
+    return variant;
+  }
+
   Kernel *GenProgram::compileKernel(const ir::Unit &unit, const std::string &name,
                                     bool relaxMath, int profiling) {
 #ifdef GBE_COMPILER_AVAILABLE
@@ -195,30 +256,12 @@ namespace gbe {
       codeGen = 0;
     } else
       GBE_ASSERTM(0, "unsupported SIMD width!");
+    const bool dualVariant = OCL_SIMD_DUAL_VARIANT && !profiling &&
+                             fn->getSimdWidth() == 0 && OCL_SIMD_WIDTH == 15;
     Kernel *kernel = NULL;
 
     // Stop when compilation is successful
-    if (IS_GEN6(deviceID)) {
-      ctx = GBE_NEW(Gen6Context, unit, name, deviceID, relaxMath);
-    } else if (IS_IVYBRIDGE(deviceID)) {
-      ctx = GBE_NEW(GenContext, unit, name, deviceID, relaxMath);
-    } else if (IS_HASWELL(deviceID)) {
-      ctx = GBE_NEW(Gen75Context, unit, name, deviceID, relaxMath);
-    } else if (IS_BROADWELL(deviceID)) {
-      ctx = GBE_NEW(Gen8Context, unit, name, deviceID, relaxMath);
-    } else if (IS_CHERRYVIEW(deviceID)) {
-      ctx = GBE_NEW(ChvContext, unit, name, deviceID, relaxMath);
-    } else if (IS_SKYLAKE(deviceID)) {
-      ctx = GBE_NEW(Gen9Context, unit, name, deviceID, relaxMath);
-    } else if (IS_BROXTON(deviceID)) {
-      ctx = GBE_NEW(BxtContext, unit, name, deviceID, relaxMath);
-    } else if (IS_KABYLAKE(deviceID)) {
-      ctx = GBE_NEW(KblContext, unit, name, deviceID, relaxMath);
-    } else if (IS_COFFEELAKE(deviceID)) {
-      ctx = GBE_NEW(KblContext, unit, name, deviceID, relaxMath);
-    } else if (IS_GEMINILAKE(deviceID)) {
-      ctx = GBE_NEW(GlkContext, unit, name, deviceID, relaxMath);
-    }
+    ctx = createGenContext(unit, name, deviceID, relaxMath);
     GBE_ASSERTM(ctx != NULL, "Fail to create the gen context\n");
 
     if (profiling) {
@@ -255,6 +298,10 @@ namespace gbe {
         GBE_ASSERT(!(ctx->getErrCode() == OUT_OF_RANGE_IF_ENDIF && ctx->getIFENDIFFix()));
     }
 
+    // Keep a SIMD8 version of the kernels the runtime may run at either width
+    if (kernel != NULL && dualVariant && codeGen == 0)
+      kernel->setSIMDVariant(compileSIMD8Variant(unit, name, deviceID, relaxMath));
+
     //GBE_ASSERTM(kernel != NULL, "Fail to compile kernel, may need to increase reserved registers for spilling.");
     return kernel;
 #else
@@ -95,6 +95,8 @@ namespace gbe
     }
     /*! Output the register allocation */
     void outputAllocation(void);
+    /*! Number of GRF bank conflicts left in the three-source instructions */
+    INLINE uint32_t getBankConflictNum(void) const { return bankConflictNum; }
     INLINE void getRegAttrib(ir::Register reg, uint32_t &regSize, ir::RegisterFamily *regFamily = NULL) const {
       // Note that byte vector registers use two bytes per byte (and can be
       // interleaved)
@@ -190,6 +192,17 @@ namespace gbe
     uint32_t expiringID;
     /*! Hole regs that can be reused */
     map<uint32_t, vector<HoleRegTag>> HoleRegPool;
+    /*! Other GRF sources (with their conflict weight) read together with a
+     *  register by the three-source instructions (MAD, LRP) */
+    map<ir::Register, vector<std::pair<ir::Register, uint32_t>>> bankPartners;
+    /*! Bank conflicts left in the three-source instructions after allocation */
+    uint32_t bankConflictNum;
+    /*! Get the GRF offset of an allocated register. Return false if not allocated */
+    INLINE bool getAllocatedOffset(ir::Register reg, uint32_t &offset) const;
+    /*! Bank the register should go in to avoid its three-source partners, -1 if no preference */
+    INLINE int32_t getPreferredBank(ir::Register reg) const;
+    /*! Count the potential bank conflicts left in the three-source instructions */
+    uint32_t countBankConflicts(Selection &selection);
     INLINE void insertNewReg(const Selection &selection, ir::Register reg, uint32_t grfOffset, bool isVector = false);
     INLINE bool expireReg(ir::Register reg);
     INLINE bool spillAtInterval(GenRegInterval interval, int size, uint32_t alignment);
@@ -228,7 +241,7 @@ namespace gbe
   };
 
 
-  GenRegAllocator::Opaque::Opaque(GenContext &ctx) : ctx(ctx) {
+  GenRegAllocator::Opaque::Opaque(GenContext &ctx) : ctx(ctx), bankConflictNum(0) {
 #if USE_PHASE5A_OPTIMIZATIONS
     // Phase 5A: Initialize high-performance data structures
     registerMap_.reserve(1024);  // Hint: typical kernel has ~1000 registers
@@ -378,7 +391,43 @@ namespace gbe
     return IDFitness(regstID, holeregstID) + IDFitness(holeregendID, regendID);
   }
 
+  /*! The register file is split in two banks, the three-source instructions
+   *  pay extra read cycles when their sources sit in the same one */
+  INLINE int32_t getGRFBank(uint32_t grfOffset) {
+    return grfOffset < HALF_REGISTER_FILE_OFFSET ? 0 : 1;
+  }
+
+  INLINE bool GenRegAllocator::Opaque::getAllocatedOffset(ir::Register reg, uint32_t &offset) const {
+#if USE_PHASE5A_OPTIMIZATIONS
+    if (!registerMap_.contains(reg))
+      return false;
+    offset = registerMap_.get(reg);
+#else
+    auto it = RA.find(reg);
+    if (it == RA.end())
+      return false;
+    offset = it->second;
+#endif
+    return true;
+  }
+
+  INLINE int32_t GenRegAllocator::Opaque::getPreferredBank(ir::Register reg) const {
+    auto it = bankPartners.find(reg);
+    if (it == bankPartners.end())
+      return -1;
+    uint32_t bankWeight[2] = {0, 0};
+    for (auto &partner : it->second) {
+      uint32_t offset;
+      if (getAllocatedOffset(partner.first, offset))
+        bankWeight[getGRFBank(offset)] += partner.second;
+    }
+    if (bankWeight[0] == bankWeight[1])
+      return -1;
+    return bankWeight[0] < bankWeight[1] ? 0 : 1;
+  }
+
   BVAR(OCL_REUSE_HOLE_REG, 1);
+  BVAR(OCL_BANK_AWARE_REG_ALLOC, true);
   bool GenRegAllocator::Opaque::createGenReg(const Selection &selection, GenRegInterval &interval) {
     using namespace ir;
     const ir::Register reg = interval.reg;
@@ -395,12 +444,18 @@ namespace gbe
         auto &holepoolvec = holepool->second;
         HoleRegTag* holeregbest = NULL;
         float lastfitness = 0;
+        // Holes in the bank of the three-source partners are less fit
+        const int32_t preferredBank = OCL_BANK_AWARE_REG_ALLOC ? getPreferredBank(reg) : -1;
         for (auto itr = holepoolvec.begin() ; itr != holepoolvec.end(); ++itr) {
           if (regSize != itr->regSize)
             continue;
           float fitness = getHoleRegFitness(interval, *itr);
           // reg out of range of holepool reg
           if (fitness > 2.0f) continue;
+          uint32_t holeOffset;
+          if (preferredBank >= 0 && getAllocatedOffset(itr->reg, holeOffset) &&
+              getGRFBank(holeOffset) != preferredBank)
+            fitness *= 0.5f;
           if (fitness > lastfitness) {
             lastfitness = fitness;
             holeregbest = &*itr;
@@ -1486,6 +1541,12 @@ namespace gbe
       }
 #endif
     }
+    if (OCL_BANK_AWARE_REG_ALLOC) {
+      // Weight all the three-source partners, not only the first conflicting one.
+      const int32_t preferredBank = getPreferredBank(interval.reg);
+      if (preferredBank >= 0)
+        direction = preferredBank == 0;
+    }
     if (interval.b3OpAlign != 0) {
       alignment = (alignment + 15) & ~15;
     }
@@ -1572,7 +1633,25 @@ namespace gbe
       for (auto &insn : block.insnList) {
         const uint32_t srcNum = insn.srcNum, dstNum = insn.dstNum;
         assert(insnID == (int32_t)insn.ID);
-        bool is3SrcOp = insn.opcode == SEL_OP_MAD;
+        bool is3SrcOp = insn.opcode == SEL_OP_MAD || insn.opcode == SEL_OP_LRP;
+        if (is3SrcOp) {
+          // src1/src2 in the same bank is the costly case, src0 only matters
+          // when all three sources share the bank.
+          for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
+            if (insn.src(srcID).file != GEN_GENERAL_REGISTER_FILE ||
+                insn.src(srcID).physical)
+              continue;
+            for (uint32_t otherID = 0; otherID < srcNum; ++otherID) {
+              if (otherID == srcID ||
+                  insn.src(otherID).file != GEN_GENERAL_REGISTER_FILE ||
+                  insn.src(otherID).physical ||
+                  insn.src(otherID).reg() == insn.src(srcID).reg())
+                continue;
+              const uint32_t weight = (srcID != 0 && otherID != 0) ? 2 : 1;
+              bankPartners[insn.src(srcID).reg()].push_back(std::make_pair(insn.src(otherID).reg(), weight));
+            }
+          }
+        }
         for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
           const GenRegister &selReg = insn.src(srcID);
           const ir::Register reg = selReg.reg();
@@ -1831,7 +1910,38 @@ do { \
 
     // Allocate all the GRFs now (regular register and boolean that are not in
     // flag registers)
-    return this->allocateGRFs(selection);
+    if (this->allocateGRFs(selection) == false)
+      return false;
+    this->bankConflictNum = this->countBankConflicts(selection);
+    return true;
+  }
+
+  uint32_t GenRegAllocator::Opaque::countBankConflicts(Selection &selection) {
+    uint32_t conflictNum = 0;
+    for (auto &block : *selection.blockList)
+      for (auto &insn : block.insnList) {
+        if (insn.opcode != SEL_OP_MAD && insn.opcode != SEL_OP_LRP)
+          continue;
+        int32_t bank[3], nr[3];
+        for (uint32_t srcID = 0; srcID < 3; ++srcID) {
+          const GenRegister &src = insn.src(srcID);
+          bank[srcID] = nr[srcID] = -1;
+          if (src.file != GEN_GENERAL_REGISTER_FILE)
+            continue;
+          if (src.physical == 0 && this->isAllocated(src.reg()) == false)
+            continue;
+          const GenRegister physical = this->genReg(src);
+          nr[srcID] = physical.nr;
+          bank[srcID] = getGRFBank(physical.nr * GEN_REG_SIZE);
+        }
+        // Reading the same register twice is not a conflict
+        if (bank[1] < 0 || bank[1] != bank[2] || nr[1] == nr[2])
+          continue;
+        conflictNum++;
+        if (bank[0] == bank[1] && nr[0] != nr[1] && nr[0] != nr[2])
+          conflictNum++;
+      }
+    return conflictNum;
   }
 
   INLINE void GenRegAllocator::Opaque::outputAllocation(void) {
@@ -1853,6 +1963,8 @@ do { \
              << " -> " << setw(8) << this->intervals[(uint)vReg].maxID
              << "]" << setw(8) << "use count: " << this->intervals[(uint)vReg].accessCount << endl;
     }
+    if (bankConflictNum != 0)
+      cout << "## three-source bank conflicts: " << bankConflictNum << endl;
     if (!spilledRegs.empty())
       cout << "## spilled registers: " << spilledRegs.size() << endl;
     for(auto it = spilledRegs.begin(); it != spilledRegs.end(); it++) {
@@ -1942,6 +2054,10 @@ do { \
     this->opaque->outputAllocation();
   }
 
+  uint32_t GenRegAllocator::getBankConflictNum(void) const {
+    return this->opaque->getBankConflictNum();
+  }
+
   uint32_t GenRegAllocator::getRegSize(ir::Register reg) {
     uint32_t regSize;
     gbe_curbe_type curbeType = GBE_GEN_REG;
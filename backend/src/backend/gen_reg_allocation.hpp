@@ -69,6 +69,8 @@ namespace gbe
     bool isAllocated(const ir::Register &reg);
     /*! Output the register allocation */
     void outputAllocation(void);
+    /*! Number of GRF bank conflicts left in the three-source instructions */
+    uint32_t getBankConflictNum(void) const;
     /*! Get register actual size in byte. */
     uint32_t getRegSize(ir::Register reg);
   private:
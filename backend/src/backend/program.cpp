@@ -80,7 +80,9 @@ namespace gbe {
   Kernel::Kernel(const std::string &name) :
     name(name), args(NULL), argNum(0), curbeSize(0), stackSize(0), useSLM(false),
         slmSize(0), ctx(NULL), samplerSet(NULL), imageSet(NULL), printfSet(NULL),
-        profilingInfo(NULL), useDeviceEnqueue(false) {}
+        profilingInfo(NULL), useDeviceEnqueue(false), simdVariant(NULL) {
+    std::memset(stats, 0, sizeof(stats));
+  }
 
   Kernel::~Kernel(void) {
     if(ctx) GBE_DELETE(ctx);
@@ -88,6 +90,7 @@ namespace gbe {
     if(imageSet) GBE_DELETE(imageSet);
     if(printfSet) GBE_DELETE(printfSet);
     if(profilingInfo) GBE_DELETE(profilingInfo);
+    if(simdVariant) GBE_DELETE(simdVariant);
     GBE_SAFE_DELETE_ARRAY(args);
   }
   int32_t Kernel::getCurbeOffset(gbe_curbe_type type, uint32_t subType) const {
@@ -176,6 +179,15 @@ namespace gbe {
       kernel->setPrintfSet(pair.second->getPrintfSet());
       kernel->setCompileWorkGroupSize(pair.second->getCompileWorkGroupSize());
       kernel->setFunctionAttributes(pair.second->getFunctionAttributes());
+      // The variant needs its own copies, the sets are deleted with the kernel
+      if (Kernel *variant = kernel->getSIMDVariant()) {
+        variant->setSamplerSet(new ir::SamplerSet(*pair.second->getSamplerSet()));
+        variant->setProfilingInfo(new ir::ProfilingInfo(*unit.getProfilingInfo()));
+        variant->setImageSet(new ir::ImageSet(*pair.second->getImageSet()));
+        variant->setPrintfSet(new ir::PrintfSet(*pair.second->getPrintfSet()));
+        variant->setCompileWorkGroupSize(pair.second->getCompileWorkGroupSize());
+        variant->setFunctionAttributes(pair.second->getFunctionAttributes());
+      }
       kernels.insert(std::make_pair(name, kernel));
     }
     return true;
@@ -1411,6 +1423,18 @@ EXTEND_QUOTE:
     return kernel->getScratchSize();
   }
 
+  static uint32_t kernelGetStat(gbe_kernel genKernel, gbe_kernel_stat stat) {
+    if (genKernel == NULL) return 0;
+    const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
+    return kernel->getStat(stat);
+  }
+
+  static gbe_kernel kernelGetSIMDVariant(gbe_kernel genKernel) {
+    if (genKernel == NULL) return NULL;
+    const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
+    return (gbe_kernel) kernel->getSIMDVariant();
+  }
+
   static int32_t kernelUseSLM(gbe_kernel genKernel) {
     if (genKernel == NULL) return 0;
     const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
@@ -1487,6 +1511,13 @@ EXTEND_QUOTE:
     ps->outputPrintf(buf_addr);
   }
 
+  static void kernelSetPrintfOutput(void * printf_info, gbe_printf_output_fn *fn, void *user_data)
+  {
+    if (printf_info == NULL) return;
+    ir::PrintfSet *ps = (ir::PrintfSet *)printf_info;
+    ps->setOutput(fn, user_data);
+  }
+
   static void kernelGetCompileWorkGroupSize(gbe_kernel gbeKernel, size_t wg_size[3]) {
     if (gbeKernel == NULL) return;
     const gbe::Kernel *kernel = (const gbe::Kernel*) gbeKernel;
@@ -1581,7 +1612,10 @@ GBE_EXPORT_SYMBOL gbe_dup_printfset_cb *gbe_dup_printfset = NULL;
 GBE_EXPORT_SYMBOL gbe_get_printf_buf_bti_cb *gbe_get_printf_buf_bti = NULL;
 GBE_EXPORT_SYMBOL gbe_release_printf_info_cb *gbe_release_printf_info = NULL;
 GBE_EXPORT_SYMBOL gbe_output_printf_cb *gbe_output_printf = NULL;
+GBE_EXPORT_SYMBOL gbe_set_printf_output_cb *gbe_set_printf_output = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_use_device_enqueue_cb *gbe_kernel_use_device_enqueue = NULL;
+GBE_EXPORT_SYMBOL gbe_kernel_get_stat_cb *gbe_kernel_get_stat = NULL;
+GBE_EXPORT_SYMBOL gbe_kernel_get_simd_variant_cb *gbe_kernel_get_simd_variant = NULL;
 
 #ifdef GBE_COMPILER_AVAILABLE
 namespace gbe
@@ -1637,7 +1671,10 @@ namespace gbe
       gbe_dup_printfset = gbe::kernelDupPrintfSet;
       gbe_release_printf_info = gbe::kernelReleasePrintfSet;
       gbe_output_printf = gbe::kernelOutputPrintf;
+      gbe_set_printf_output = gbe::kernelSetPrintfOutput;
       gbe_kernel_use_device_enqueue = gbe::kernelUseDeviceEnqueue;
+      gbe_kernel_get_stat = gbe::kernelGetStat;
+      gbe_kernel_get_simd_variant = gbe::kernelGetSIMDVariant;
       genSetupCallBacks();
     }
 
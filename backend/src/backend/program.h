@@ -180,6 +180,11 @@ extern gbe_dup_printfset_cb *gbe_dup_printfset;
 typedef void (gbe_output_printf_cb) (void* printf_info, void* buf_addr);
 extern gbe_output_printf_cb* gbe_output_printf;
 
+/*! Redirect the decoded printf output of one launch to fn (NULL restores stdout) */
+typedef void (gbe_printf_output_fn)(const char *buf, size_t sz, void *user_data);
+typedef void (gbe_set_printf_output_cb) (void* printf_info, gbe_printf_output_fn *fn, void *user_data);
+extern gbe_set_printf_output_cb* gbe_set_printf_output;
+
 
 /*! Create a new program from the llvm file (zero terminated string) */
 typedef gbe_program (gbe_program_new_from_llvm_file_cb)(uint32_t deviceID,
@@ -392,6 +397,27 @@ extern gbe_kernel_get_ocl_version_cb *gbe_kernel_get_ocl_version;
 typedef uint32_t (gbe_kernel_use_device_enqueue_cb)(gbe_kernel);
 extern gbe_kernel_use_device_enqueue_cb *gbe_kernel_use_device_enqueue;
 
+/*! Compile time statistics gathered by the code generator for each kernel.
+ *  They are not serialized, a kernel loaded from a binary reports zero */
+enum gbe_kernel_stat {
+  GBE_KERNEL_STAT_BANK_CONFLICT_NUM = 0, /* three-source insns with GRF bank conflicts left */
+  GBE_KERNEL_STAT_INSN_NUM,              /* instructions in the final code */
+  GBE_KERNEL_STAT_COMPACT_INSN_NUM,      /* how many of them are 8 bytes compact ones */
+  GBE_KERNEL_STAT_PEEPHOLE_REMOVED_NUM,  /* MOVs removed by the peephole pass */
+  GBE_KERNEL_STAT_PEEPHOLE_FUSED_NUM,    /* MOV pairs it fused into one */
+  GBE_KERNEL_STAT_PEEPHOLE_HINT_NUM,     /* instructions it gave NoDDClr/NoDDChk */
+  GBE_KERNEL_STAT_ASM_ROUNDTRIP_NUM,     /* instructions reassembled unchanged from the dump */
+  GBE_KERNEL_STAT_NUM
+};
+/*! Get one of the compile time statistics of the kernel */
+typedef uint32_t (gbe_kernel_get_stat_cb)(gbe_kernel, enum gbe_kernel_stat stat);
+extern gbe_kernel_get_stat_cb *gbe_kernel_get_stat;
+
+/*! Get the same kernel compiled at the other SIMD width. NULL when the kernel
+ *  was only compiled once. The variant is owned by the kernel */
+typedef gbe_kernel (gbe_kernel_get_simd_variant_cb)(gbe_kernel);
+extern gbe_kernel_get_simd_variant_cb *gbe_kernel_get_simd_variant;
+
 /*mutex to lock global llvmcontext access.*/
 extern void acquireLLVMContextLock();
 extern void releaseLLVMContextLock();
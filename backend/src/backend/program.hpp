@@ -238,6 +238,19 @@ namespace gbe {
     INLINE bool setUseDeviceEnqueue(bool useDeviceEnqueue) {
       return this->useDeviceEnqueue = useDeviceEnqueue;
     }
+    /*! Get a compile time statistic of the kernel */
+    INLINE uint32_t getStat(gbe_kernel_stat stat) const {
+      return stat < GBE_KERNEL_STAT_NUM ? this->stats[stat] : 0;
+    }
+    /*! Set a compile time statistic of the kernel */
+    INLINE void setStat(gbe_kernel_stat stat, uint32_t value) {
+      GBE_ASSERT(stat < GBE_KERNEL_STAT_NUM);
+      this->stats[stat] = value;
+    }
+    /*! Same kernel compiled at the other SIMD width (NULL if none) */
+    INLINE Kernel *getSIMDVariant(void) const { return this->simdVariant; }
+    /*! The kernel owns its variant and deletes it with itself */
+    INLINE void setSIMDVariant(Kernel *variant) { this->simdVariant = variant; }
 
   protected:
     friend class Context;      //!< Owns the kernels
@@ -261,6 +274,8 @@ namespace gbe {
     uint32_t compileWgSize[3]; //!< required work group size by kernel attribute.
     std::string functionAttributes; //!< function attribute qualifiers combined.
     bool useDeviceEnqueue;          //!< Has device enqueue?
+    uint32_t stats[GBE_KERNEL_STAT_NUM]; //!< Compile time statistics (not serialized)
+    Kernel *simdVariant;            //!< Other SIMD width variant (not serialized)
     GBE_CLASS(Kernel);         //!< Use custom allocators
   };
 
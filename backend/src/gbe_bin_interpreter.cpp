@@ -78,7 +78,10 @@ struct BinInterpCallBackInitializer
     gbe_dup_printfset = gbe::kernelDupPrintfSet;
     gbe_release_printf_info = gbe::kernelReleasePrintfSet;
     gbe_output_printf = gbe::kernelOutputPrintf;
+    gbe_set_printf_output = gbe::kernelSetPrintfOutput;
     gbe_kernel_use_device_enqueue = gbe::kernelUseDeviceEnqueue;
+    gbe_kernel_get_stat = gbe::kernelGetStat;
+    gbe_kernel_get_simd_variant = gbe::kernelGetSIMDVariant;
   }
 
   ~BinInterpCallBackInitializer() {
@@ -22,8 +22,12 @@
  */
 
 #include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "printf.hpp"
 #include "ir/unit.hpp"
+#include "sys/cvar.hpp"
 
 namespace gbe
 {
@@ -32,7 +36,10 @@ namespace gbe
 
     pthread_mutex_t PrintfSet::lock = PTHREAD_MUTEX_INITIALIZER;
 
-    static void generatePrintfFmtString(PrintfState& state, std::string& str)
+    /* Write the printf output of the kernels to this file instead of stdout */
+    SVAR(OCL_PRINTF_OUTPUT, "");
+
+    static void generatePrintfFmtString(const PrintfState& state, std::string& str)
     {
       char num_str[16];
       str = "%";
@@ -84,124 +91,202 @@ namespace gbe
       }
     }
 
-#define PRINT_SOMETHING(target_ty, conv)  do {                          \
-      if (!vec_i)                                                       \
-        pf_str = pf_str + std::string(#conv);                           \
-      printf(pf_str.c_str(), log.getData<target_ty>());                 \
-    } while (0)
+    static void compileValue(const PrintfState& state, uint32_t type, const char *conv,
+                             PrintfProgram& prog)
+    {
+      PrintfOp op;
+      generatePrintfFmtString(state, op.str);
+      op.str += conv;
+      op.type = type;
+      op.vec_n = state.vector_n > 0 ? state.vector_n : 1;
+      prog.ops.push_back(op);
+    }
+
+    static void compileText(const std::string& str, PrintfProgram& prog)
+    {
+      /* Adjacent text is merged into one copy */
+      if (!prog.ops.empty() && prog.ops.back().type == PRINTF_OP_STRING) {
+        prog.ops.back().str += str;
+        return;
+      }
+      PrintfOp op;
+      op.type = PRINTF_OP_STRING;
+      op.vec_n = 1;
+      op.str = str;
+      prog.ops.push_back(op);
+    }
 
-    static void printOutOneStatement(PrintfSet::PrintfFmt& fmt, PrintfLog& log)
+    void PrintfSet::compile(const PrintfFmt& fmt, PrintfProgram& prog)
     {
-      std::string pf_str = "";
+      std::string pf_str;
+      prog.ops.clear();
+      prog.valid = true;
       for (auto& slot : fmt) {
         if (slot.type == PRINTF_SLOT_TYPE_STRING) {
-          printf("%s", slot.str.c_str());
+          compileText(slot.str, prog);
           continue;
         }
         assert(slot.type == PRINTF_SLOT_TYPE_STATE);
 
-        generatePrintfFmtString(slot.state, pf_str);
+        const bool isLong = slot.state.length_modifier == PRINTF_LM_L;
+        const uint32_t intType = isLong ? PRINTF_OP_LONG : PRINTF_OP_INT;
+        switch (slot.state.conversion_specifier) {
+          case PRINTF_CONVERSION_D:
+          case PRINTF_CONVERSION_I: compileValue(slot.state, intType, "d", prog); break;
+          case PRINTF_CONVERSION_O: compileValue(slot.state, intType, "o", prog); break;
+          case PRINTF_CONVERSION_U: compileValue(slot.state, intType, "u", prog); break;
+          case PRINTF_CONVERSION_X: compileValue(slot.state, intType, "X", prog); break;
+          case PRINTF_CONVERSION_x: compileValue(slot.state, intType, "x", prog); break;
+          case PRINTF_CONVERSION_C: compileValue(slot.state, PRINTF_OP_CHAR, "c", prog); break;
+          case PRINTF_CONVERSION_F: compileValue(slot.state, PRINTF_OP_FLOAT, "F", prog); break;
+          case PRINTF_CONVERSION_f: compileValue(slot.state, PRINTF_OP_FLOAT, "f", prog); break;
+          case PRINTF_CONVERSION_E: compileValue(slot.state, PRINTF_OP_FLOAT, "E", prog); break;
+          case PRINTF_CONVERSION_e: compileValue(slot.state, PRINTF_OP_FLOAT, "e", prog); break;
+          case PRINTF_CONVERSION_G: compileValue(slot.state, PRINTF_OP_FLOAT, "G", prog); break;
+          case PRINTF_CONVERSION_g: compileValue(slot.state, PRINTF_OP_FLOAT, "g", prog); break;
+          case PRINTF_CONVERSION_A: compileValue(slot.state, PRINTF_OP_FLOAT, "A", prog); break;
+          case PRINTF_CONVERSION_a: compileValue(slot.state, PRINTF_OP_FLOAT, "a", prog); break;
+          case PRINTF_CONVERSION_P: compileValue(slot.state, PRINTF_OP_INT, "p", prog); break;
+
+          case PRINTF_CONVERSION_S:
+          {
+            /* The string is a constant, format it right away */
+            const int vec_num = slot.state.vector_n > 0 ? slot.state.vector_n : 1;
+            generatePrintfFmtString(slot.state, pf_str);
+            pf_str += "s";
+            const int sz = snprintf(NULL, 0, pf_str.c_str(), slot.state.str.c_str());
+            std::string one(sz > 0 ? sz : 0, '\0');
+            if (sz > 0)
+              snprintf(&one[0], sz + 1, pf_str.c_str(), slot.state.str.c_str());
+            for (int vec_i = 0; vec_i < vec_num; vec_i++)
+              compileText(vec_i ? "," + one : one, prog);
+            break;
+          }
+
+          default:
+            assert(0);
+            return;
+        }
+      }
+    }
 
-        int vec_num;
-        vec_num = slot.state.vector_n > 0 ? slot.state.vector_n : 1;
+    template <typename T>
+    static void appendValue(std::string& out, const char *fmt, T value)
+    {
+      const size_t at = out.size();
+      size_t room = 64;
+      for (;;) {
+        out.resize(at + room);
+        const int sz = snprintf(&out[at], room, fmt, value);
+        if (sz < 0) {
+          out.resize(at);
+          return;
+        }
+        if ((size_t)sz < room) {
+          out.resize(at + sz);
+          return;
+        }
+        room = sz + 1;
+      }
+    }
 
-        for (int vec_i = 0; vec_i < vec_num; vec_i++) {
+    static void decodeStatement(const PrintfProgram& prog, PrintfLog& log, std::string& out)
+    {
+      for (auto& op : prog.ops) {
+        if (op.type == PRINTF_OP_STRING) {
+          out += op.str;
+          continue;
+        }
+        const char *fmt = op.str.c_str();
+        for (uint32_t vec_i = 0; vec_i < op.vec_n; vec_i++) {
           if (vec_i)
-            printf(",");
-
-          switch (slot.state.conversion_specifier) {
-            case PRINTF_CONVERSION_D:
-            case PRINTF_CONVERSION_I:
-              if (slot.state.length_modifier == PRINTF_LM_L)
-                PRINT_SOMETHING(uint64_t, d);
-              else
-                PRINT_SOMETHING(int, d);
-              break;
-
-            case PRINTF_CONVERSION_O:
-              if (slot.state.length_modifier == PRINTF_LM_L)
-                PRINT_SOMETHING(uint64_t, o);
-              else
-                PRINT_SOMETHING(int, o);
-              break;
-            case PRINTF_CONVERSION_U:
-              if (slot.state.length_modifier == PRINTF_LM_L)
-                PRINT_SOMETHING(uint64_t, u);
-              else
-                PRINT_SOMETHING(int, u);
-              break;
-            case PRINTF_CONVERSION_X:
-              if (slot.state.length_modifier == PRINTF_LM_L)
-                PRINT_SOMETHING(uint64_t, X);
-              else
-                PRINT_SOMETHING(int, X);
-              break;
-            case PRINTF_CONVERSION_x:
-              if (slot.state.length_modifier == PRINTF_LM_L)
-                PRINT_SOMETHING(uint64_t, x);
-              else
-                PRINT_SOMETHING(int, x);
-              break;
-
-            case PRINTF_CONVERSION_C:
-              PRINT_SOMETHING(char, c);
-              break;
-
-            case PRINTF_CONVERSION_F:
-              PRINT_SOMETHING(float, F);
-              break;
-            case PRINTF_CONVERSION_f:
-              PRINT_SOMETHING(float, f);
-              break;
-            case PRINTF_CONVERSION_E:
-              PRINT_SOMETHING(float, E);
-              break;
-            case PRINTF_CONVERSION_e:
-              PRINT_SOMETHING(float, e);
-              break;
-            case PRINTF_CONVERSION_G:
-              PRINT_SOMETHING(float, G);
-              break;
-            case PRINTF_CONVERSION_g:
-              PRINT_SOMETHING(float, g);
-              break;
-            case PRINTF_CONVERSION_A:
-              PRINT_SOMETHING(float, A);
-              break;
-            case PRINTF_CONVERSION_a:
-              PRINT_SOMETHING(float, a);
-              break;
-            case PRINTF_CONVERSION_P:
-              PRINT_SOMETHING(int, p);
-              break;
-
-            case PRINTF_CONVERSION_S:
-              pf_str = pf_str + "s";
-              printf(pf_str.c_str(), slot.state.str.c_str());
-              break;
-
-            default:
-              assert(0);
-              return;
+            out += ',';
+          switch (op.type) {
+            case PRINTF_OP_INT: appendValue(out, fmt, log.getData<int>()); break;
+            case PRINTF_OP_LONG: appendValue(out, fmt, log.getData<uint64_t>()); break;
+            case PRINTF_OP_CHAR: appendValue(out, fmt, log.getData<char>()); break;
+            case PRINTF_OP_FLOAT: appendValue(out, fmt, log.getData<float>()); break;
+            default: assert(0); return;
           }
         }
+      }
+    }
+
+    /* Output buffers are reused across launches, decoding runs unlocked */
+    static std::vector<std::string *> outputPool;
+    static int outputFile = -1;
+
+    void PrintfSet::emit(const char *buf, size_t sz)
+    {
+      LockOutput lock;
+      if (outputFn) {
+        outputFn(buf, sz, outputData);
+        return;
+      }
 
+      int fd = STDOUT_FILENO;
+      if (!OCL_PRINTF_OUTPUT.empty()) {
+        if (outputFile < 0)
+          outputFile = open(OCL_PRINTF_OUTPUT.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (outputFile >= 0)
+          fd = outputFile;
+      }
+      /* Keep the order with what the host already printed */
+      if (fd == STDOUT_FILENO)
+        fflush(stdout);
+      while (sz > 0) {
+        const ssize_t n = write(fd, buf, sz);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n <= 0)
+          break;
+        buf += n;
+        sz -= n;
       }
     }
 
     void PrintfSet::outputPrintf(void* buf_addr)
     {
-      LockOutput lock;
       uint32_t totalSZ = ((uint32_t *)buf_addr)[0];
       char* p = (char*)buf_addr + sizeof(uint32_t);
+      std::string *out = NULL;
+
+      {
+        LockOutput lock;
+        if (!outputPool.empty()) {
+          out = outputPool.back();
+          outputPool.pop_back();
+        }
+      }
+      if (out == NULL)
+        out = new std::string;
+      out->clear();
 
+      /* The buffer is written by the kernel: stop at the first log which does
+       * not fit in it or names no known statement, rather than decode garbage */
+      const vector<PrintfProgram>& table = *progs;
+      const uint32_t headerSZ = 3 * sizeof(uint32_t);
       for (uint32_t parsed = 4; parsed < totalSZ; ) {
+        if (totalSZ - parsed < headerSZ || *((uint32_t *)p) != 0xAABBCCDD)
+          break;
         PrintfLog log(p);
-        GBE_ASSERT(fmts.find(log.statementNum) != fmts.end());
-        printOutOneStatement(fmts[log.statementNum], log);
+        if (log.size < headerSZ || log.size > totalSZ - parsed ||
+            log.statementNum >= table.size() || !table[log.statementNum].valid)
+          break;
+        decodeStatement(table[log.statementNum], log, *out);
         parsed += log.size;
         p += log.size;
       }
+
+      if (!out->empty())
+        emit(out->data(), out->size());
+
+      LockOutput lock;
+      /* Do not keep huge buffers of a one time burst around */
+      if (outputPool.size() < 4 && out->capacity() <= (16u << 20))
+        outputPool.push_back(out);
+      else
+        delete out;
     }
   } /* namespace ir */
 } /* namespace gbe */
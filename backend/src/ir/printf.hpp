@@ -24,6 +24,7 @@
 #define __GBE_IR_PRINTF_HPP__
 
 #include <string.h>
+#include <memory>
 #include "sys/map.hpp"
 #include "sys/vector.hpp"
 
@@ -169,17 +170,48 @@ namespace gbe
       }
     };
 
+    /* A printf statement compiled at build time. Literal text (with the %s
+     * arguments already folded in) is kept as is, every value conversion keeps
+     * the complete snprintf format of one element and the type to read. */
+    enum {
+      PRINTF_OP_STRING,
+      PRINTF_OP_INT,
+      PRINTF_OP_LONG,
+      PRINTF_OP_CHAR,
+      PRINTF_OP_FLOAT
+    };
+
+    struct PrintfOp {
+      uint32_t type;
+      uint32_t vec_n;
+      std::string str;
+    };
+
+    struct PrintfProgram {
+      bool valid;
+      vector<PrintfOp> ops;
+      PrintfProgram(void) : valid(false) {}
+    };
+
     class Context;
 
     class PrintfSet //: public Serializable
     {
     public:
+      /*! Receives the decoded output of one launch */
+      typedef void (OutputFn)(const char *buf, size_t sz, void *data);
+
+      /*! The compiled programs are shared, a copy per launch stays cheap */
       PrintfSet(const PrintfSet& other) {
-        fmts = other.fmts;
+        progs = other.progs;
+        printfNum = other.printfNum;
         btiBuf = other.btiBuf;
+        outputFn = other.outputFn;
+        outputData = other.outputData;
       }
 
-      PrintfSet(void) = default;
+      PrintfSet(void) : progs(std::make_shared<vector<PrintfProgram>>()),
+                        printfNum(0), btiBuf(0), outputFn(NULL), outputData(NULL) {}
 
       struct LockOutput {
         LockOutput(void) {
@@ -193,13 +225,23 @@ namespace gbe
 
       typedef vector<PrintfSlot> PrintfFmt;
 
+      /*! Only called at build time, before the set gets copied */
       void append(uint32_t num, PrintfFmt* fmt) {
-        GBE_ASSERT(fmts.find(num) == fmts.end());
-        fmts.insert(std::pair<uint32_t, PrintfFmt>(num, *fmt));
+        if (num >= progs->size())
+          progs->resize(num + 1);
+        GBE_ASSERT(!(*progs)[num].valid);
+        compile(*fmt, (*progs)[num]);
+        printfNum++;
       }
 
       uint32_t getPrintfNum(void) const {
-        return fmts.size();
+        return printfNum;
+      }
+
+      /*! Send the output to fn instead of stdout or OCL_PRINTF_OUTPUT */
+      void setOutput(OutputFn *fn, void *data) {
+        outputFn = fn;
+        outputData = data;
       }
 
       void setBufBTI(uint8_t b)      { btiBuf = b; }
@@ -246,9 +288,14 @@ namespace gbe
       void outputPrintf(void* buf_addr);
 
     private:
-      std::map<uint32_t, PrintfFmt> fmts;
+      static void compile(const PrintfFmt& fmt, PrintfProgram& prog);
+      void emit(const char *buf, size_t sz);
+      std::shared_ptr<vector<PrintfProgram>> progs;
+      uint32_t printfNum;
       friend struct LockOutput;
       uint8_t btiBuf;
+      OutputFn *outputFn;
+      void *outputData;
       static pthread_mutex_t lock;
       GBE_CLASS(PrintfSet);
     };
@@ -0,0 +1,175 @@
+#include "utests/utest_helper.hpp"
+#include "benchmark_helper.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+/* Host side cost of the runtime API. Every call is timed on its own so the
+ * distribution can be reported, which makes these benchmarks meaningful with
+ * any driver backend (including OCL_NULL_DRIVER=1). For each benchmark one
+ * JSON line is printed and, if OCL_BENCHMARK_JSON names a file, appended to
+ * it. The returned value is the mean cost of one operation. */
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+  size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static double report_api_samples(const char *name, std::vector<double> &samples, double wall_ns)
+{
+  OCL_ASSERT(samples.size() > 0);
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (size_t i = 0; i < samples.size(); i++)
+    sum += samples[i];
+  const double mean = sum / samples.size();
+
+  char line[512];
+  snprintf(line, sizeof(line),
+           "{\"benchmark\": \"%s\", \"ops\": %zu, \"mean_ns\": %.1f, \"min_ns\": %.1f,"
+           " \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f,"
+           " \"ops_per_sec\": %.1f}",
+           name, samples.size(), mean, samples.front(), percentile(samples, 0.5),
+           percentile(samples, 0.9), percentile(samples, 0.99), samples.back(),
+           wall_ns > 0 ? samples.size() * 1e9 / wall_ns : 0.0);
+  benchmark_report_json(line);
+  return mean;
+}
+
+static void api_setup_copy_kernel(size_t n)
+{
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(float), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(float), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  globals[0] = n;
+  locals[0] = 16;
+}
+
+double benchmark_api_set_kernel_arg(void)
+{
+  const size_t iter = 100000;
+  std::vector<double> samples(iter);
+
+  api_setup_copy_kernel(64);
+  const double start = benchmark_now_ns();
+  for (size_t i = 0; i < iter; i++) {
+    const double t0 = benchmark_now_ns();
+    OCL_ASSERT(clSetKernelArg(kernel, i & 1, sizeof(cl_mem), &buf[(i >> 1) & 1]) == CL_SUCCESS);
+    samples[i] = benchmark_now_ns() - t0;
+  }
+  return report_api_samples("api_set_kernel_arg", samples, benchmark_now_ns() - start);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_api_set_kernel_arg, "ns/op");
+
+double benchmark_api_enqueue_ndrange(void)
+{
+  const size_t iter = 20000, drain = 1000;
+  std::vector<double> samples(iter);
+  double wall = 0;
+
+  api_setup_copy_kernel(64);
+  /* Warm up: the first launch uploads the kernel binary */
+  OCL_NDRANGE(1);
+  OCL_FINISH();
+
+  for (size_t i = 0; i < iter; i += drain) {
+    const double start = benchmark_now_ns();
+    for (size_t j = i; j < std::min(i + drain, iter); j++) {
+      const double t0 = benchmark_now_ns();
+      OCL_ASSERT(clEnqueueNDRangeKernel(queue, kernel, 1, NULL, globals, locals, 0, NULL, NULL) == CL_SUCCESS);
+      samples[j] = benchmark_now_ns() - t0;
+    }
+    wall += benchmark_now_ns() - start;
+    /* Keep the queue depth bounded, out of the measured time */
+    OCL_FINISH();
+  }
+  return report_api_samples("api_enqueue_ndrange", samples, wall);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_api_enqueue_ndrange, "ns/op");
+
+double benchmark_api_create_release_buffer(void)
+{
+  const size_t iter = 20000;
+  std::vector<double> samples(iter);
+
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  const double start = benchmark_now_ns();
+  for (size_t i = 0; i < iter; i++) {
+    cl_int status;
+    const double t0 = benchmark_now_ns();
+    cl_mem mem = clCreateBuffer(ctx, CL_MEM_READ_WRITE, 4096, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    OCL_ASSERT(clReleaseMemObject(mem) == CL_SUCCESS);
+    samples[i] = benchmark_now_ns() - t0;
+  }
+  return report_api_samples("api_create_release_buffer", samples, benchmark_now_ns() - start);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_api_create_release_buffer, "ns/op");
+
+double benchmark_api_event_chain(void)
+{
+  const size_t iter = 10000;
+  std::vector<double> samples(iter);
+
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  const double start = benchmark_now_ns();
+  for (size_t i = 0; i < iter; i++) {
+    cl_event user_event, marker;
+    const double t0 = benchmark_now_ns();
+    /* user event -> marker -> wait, then release the whole chain */
+    OCL_CREATE_USER_EVENT(user_event);
+    OCL_ASSERT(clEnqueueMarkerWithWaitList(queue, 1, &user_event, &marker) == CL_SUCCESS);
+    OCL_SET_USER_EVENT_STATUS(user_event, CL_COMPLETE);
+    OCL_ASSERT(clWaitForEvents(1, &marker) == CL_SUCCESS);
+    OCL_ASSERT(clReleaseEvent(marker) == CL_SUCCESS);
+    OCL_ASSERT(clReleaseEvent(user_event) == CL_SUCCESS);
+    samples[i] = benchmark_now_ns() - t0;
+  }
+  return report_api_samples("api_event_chain", samples, benchmark_now_ns() - start);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_api_event_chain, "ns/op");
+
+double benchmark_api_map_buffer(void)
+{
+  const size_t iter = 20000;
+  std::vector<double> samples(iter);
+
+  api_setup_copy_kernel(1024);
+  const double start = benchmark_now_ns();
+  for (size_t i = 0; i < iter; i++) {
+    cl_int status;
+    const double t0 = benchmark_now_ns();
+    void *ptr = clEnqueueMapBuffer(queue, buf[0], CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                   0, 1024 * sizeof(float), 0, NULL, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS && ptr != NULL);
+    OCL_ASSERT(clEnqueueUnmapMemObject(queue, buf[0], ptr, 0, NULL, NULL) == CL_SUCCESS);
+    samples[i] = benchmark_now_ns() - t0;
+  }
+  OCL_FINISH();
+  return report_api_samples("api_map_unmap_buffer", samples, benchmark_now_ns() - start);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_api_map_buffer, "ns/op");
+
+double benchmark_api_finish(void)
+{
+  const size_t iter = 5000;
+  std::vector<double> samples(iter);
+
+  api_setup_copy_kernel(64);
+  OCL_NDRANGE(1);
+  OCL_FINISH();
+  const double start = benchmark_now_ns();
+  for (size_t i = 0; i < iter; i++) {
+    /* Only the clFinish of one outstanding tiny launch is timed */
+    OCL_NDRANGE(1);
+    const double t0 = benchmark_now_ns();
+    OCL_ASSERT(clFinish(queue) == CL_SUCCESS);
+    samples[i] = benchmark_now_ns() - t0;
+  }
+  return report_api_samples("api_finish", samples, benchmark_now_ns() - start);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_api_finish, "ns/op");
@@ -0,0 +1,79 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+#include <cstdio>
+
+/* Build the program from source and report, for every kernel, the code
+ * generator statistics. Returns the build time in ms. */
+static double benchmark_generic_compile(const char *file_name,
+                                        const char **kernel_names,
+                                        size_t kernel_num)
+{
+  struct timeval start, stop;
+  cl_uint total_conflicts = 0, total_insns = 0, total_compact_insns = 0;
+  cl_uint total_removed = 0, total_fused = 0, total_hints = 0;
+
+  /* Make sure the program is really rebuilt */
+  cl_kernel_destroy(true);
+
+  gettimeofday(&start, 0);
+  OCL_CALL(cl_kernel_init, file_name, kernel_names[0], SOURCE, NULL);
+  gettimeofday(&stop, 0);
+  double elapsed = time_subtract(&stop, &start, 0);
+
+  for (size_t i = 0; i < kernel_num; i++) {
+    cl_uint conflicts = 0, insns = 0, compact_insns = 0, removed = 0, fused = 0, hints = 0;
+    OCL_CALL(cl_kernel_init, file_name, kernel_names[i], SOURCE, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_BANK_CONFLICT_COUNT_INTEL,
+             sizeof(conflicts), &conflicts, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_INSTRUCTION_COUNT_INTEL,
+             sizeof(insns), &insns, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_COMPACT_INSTRUCTION_COUNT_INTEL,
+             sizeof(compact_insns), &compact_insns, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_PEEPHOLE_REMOVED_COUNT_INTEL,
+             sizeof(removed), &removed, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_PEEPHOLE_FUSED_COUNT_INTEL,
+             sizeof(fused), &fused, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_PEEPHOLE_HINT_COUNT_INTEL,
+             sizeof(hints), &hints, NULL);
+    printf("\n\t%-24s bank conflicts: %u, compacted: %u/%u (%.1f%%), peephole: %u removed, %u fused, %u hinted",
+           kernel_names[i], conflicts, compact_insns, insns, insns ? 100.0 * compact_insns / insns : 0.0,
+           removed, fused, hints);
+    total_conflicts += conflicts;
+    total_insns += insns;
+    total_compact_insns += compact_insns;
+    total_removed += removed;
+    total_fused += fused;
+    total_hints += hints;
+  }
+  printf("\n\ttotal bank conflicts: %u, compacted: %u/%u, peephole: %u removed, %u fused, %u hinted\n",
+         total_conflicts, total_compact_insns, total_insns, total_removed, total_fused, total_hints);
+
+  cl_kernel_destroy(true);
+  return elapsed;
+}
+
+double benchmark_compile_math(void)
+{
+  const char *kernels[] = {
+    "bench_math_pow", "bench_math_exp2", "bench_math_exp", "bench_math_exp10",
+    "bench_math_log2", "bench_math_log", "bench_math_log10", "bench_math_sqrt",
+    "bench_math_sin", "bench_math_cos", "bench_math_tan", "bench_math_asin",
+    "bench_math_acos"
+  };
+  return benchmark_generic_compile("bench_math.cl", kernels, sizeof(kernels) / sizeof(kernels[0]));
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_compile_math, "ms");
+
+double benchmark_compile_box_blur(void)
+{
+  const char *kernels[] = { "compiler_box_blur_float" };
+  return benchmark_generic_compile("compiler_box_blur_float.cl", kernels, 1);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_compile_box_blur, "ms");
+
+double benchmark_compile_box_blur_image(void)
+{
+  const char *kernels[] = { "compiler_box_blur_image" };
+  return benchmark_generic_compile("compiler_box_blur_image.cl", kernels, 1);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_compile_box_blur_image, "ms");
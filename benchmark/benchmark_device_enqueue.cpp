@@ -0,0 +1,57 @@
+#include "utests/utest_helper.hpp"
+#include "benchmark_helper.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/* Throughput of device side enqueue: one work item of the parent kernel
+ * enqueues child_n tiny children, for several child_n. One JSON line is
+ * printed per point and, if OCL_BENCHMARK_JSON names a file, appended to it.
+ * The returned value is the children per second of the largest point. */
+
+static double report_enqueue_point(uint32_t child_n, size_t iter, double ns)
+{
+  const double children_per_s = child_n * (double)iter * 1e9 / ns;
+  char line[256];
+  snprintf(line, sizeof(line),
+           "{\"benchmark\": \"device_enqueue\", \"children_per_launch\": %u, \"iter\": %zu,"
+           " \"us_per_launch\": %.1f, \"children_per_s\": %.1f}",
+           child_n, iter, ns / iter / 1e3, children_per_s);
+  benchmark_report_json(line);
+  return children_per_s;
+}
+
+double benchmark_device_enqueue(void)
+{
+  const size_t iter = 200;
+  double children_per_s = 0;
+  uint32_t zero = 0;
+
+  if (!cl_check_ocl20(false))
+    return 0;
+  OCL_CALL(cl_kernel_init, "bench_device_enqueue.cl", "bench_device_enqueue", SOURCE, "-cl-std=CL2.0");
+  OCL_CREATE_BUFFER(buf[0], 0, sizeof(uint32_t), NULL);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[0]);
+  globals[0] = 16;
+  locals[0] = 16;
+
+  for (uint32_t child_n = 1; child_n <= 256; child_n *= 4) {
+    OCL_SET_ARG(0, sizeof(uint32_t), &child_n);
+    OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, sizeof(zero), &zero, 0, NULL, NULL);
+    /* Warm up: the first launch builds the children */
+    OCL_NDRANGE(1);
+    OCL_FINISH();
+
+    const double start = benchmark_now_ns();
+    for (size_t i = 0; i < iter; i++)
+      OCL_NDRANGE(1);
+    OCL_FINISH();
+    const double ns = benchmark_now_ns() - start;
+
+    uint32_t count = 0;
+    OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, sizeof(count), &count, 0, NULL, NULL);
+    OCL_ASSERT(count == child_n * (iter + 1));
+    children_per_s = report_enqueue_point(child_n, iter, ns);
+  }
+  return children_per_s;
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_device_enqueue, "children/s");
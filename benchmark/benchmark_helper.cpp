@@ -0,0 +1,43 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "benchmark_helper.hpp"
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+
+double benchmark_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void benchmark_report_json(const char *line)
+{
+  printf("\n\t%s", line);
+
+  const char *path = getenv("OCL_BENCHMARK_JSON");
+  if (path && *path) {
+    FILE *f = fopen(path, "a");
+    if (f) {
+      fprintf(f, "%s\n", line);
+      fclose(f);
+    }
+  }
+}
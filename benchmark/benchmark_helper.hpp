@@ -0,0 +1,29 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __BENCHMARK_HELPER_HPP__
+#define __BENCHMARK_HELPER_HPP__
+
+/* Monotonic time in nanoseconds */
+double benchmark_now_ns(void);
+
+/* Print one JSON result line and, if OCL_BENCHMARK_JSON names a file,
+ * append it there */
+void benchmark_report_json(const char *line);
+
+#endif /* __BENCHMARK_HELPER_HPP__ */
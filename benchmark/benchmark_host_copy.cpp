@@ -0,0 +1,129 @@
+#include "utests/utest_helper.hpp"
+#include "benchmark_helper.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* Bandwidth of the host side copies of read/write buffer commands against
+ * the transfer size and the row pitch. Run with OCL_NULL_DRIVER=1 the
+ * buffers are host memory and only the runtime copy engine is measured;
+ * OCL_HOST_COPY_THRESHOLD, OCL_HOST_COPY_NT_THRESHOLD and OCL_HOST_WORKERS
+ * tune it. One JSON line is printed per point and, if OCL_BENCHMARK_JSON
+ * names a file, appended to it. The returned value is the bandwidth of the
+ * largest point. */
+
+static double report_copy_point(const char *name, size_t bytes, size_t row_sz,
+                                size_t row_pitch, size_t iter, double ns)
+{
+  const double gbps = bytes * (double)iter / ns;
+  char line[256];
+  snprintf(line, sizeof(line),
+           "{\"benchmark\": \"%s\", \"bytes\": %zu, \"row_bytes\": %zu,"
+           " \"row_pitch\": %zu, \"iter\": %zu, \"gb_per_s\": %.2f}",
+           name, bytes, row_sz, row_pitch, iter, gbps);
+  benchmark_report_json(line);
+  return gbps;
+}
+
+/* Enough iterations for about 1GB per point */
+static size_t copy_iter(size_t bytes)
+{
+  size_t iter = (1ul << 30) / bytes;
+  return iter < 4 ? 4 : iter;
+}
+
+static double host_copy_buffer(bool read)
+{
+  const size_t max_sz = 256 << 20;
+  const char *name = read ? "host_copy_read_buffer" : "host_copy_write_buffer";
+  std::vector<char> host(max_sz);
+  double gbps = 0;
+
+  memset(&host[0], 1, max_sz);
+  OCL_CREATE_BUFFER(buf[0], 0, max_sz, NULL);
+  for (size_t sz = 64 << 10; sz <= max_sz; sz <<= 2) {
+    const size_t iter = copy_iter(sz);
+    /* Warm up: first touch of the pages */
+    if (read)
+      OCL_ASSERT(clEnqueueReadBuffer(queue, buf[0], CL_TRUE, 0, sz, &host[0], 0, NULL, NULL) == CL_SUCCESS);
+    else
+      OCL_ASSERT(clEnqueueWriteBuffer(queue, buf[0], CL_TRUE, 0, sz, &host[0], 0, NULL, NULL) == CL_SUCCESS);
+
+    const double start = benchmark_now_ns();
+    for (size_t i = 0; i < iter; i++) {
+      if (read)
+        OCL_ASSERT(clEnqueueReadBuffer(queue, buf[0], CL_TRUE, 0, sz, &host[0], 0, NULL, NULL) == CL_SUCCESS);
+      else
+        OCL_ASSERT(clEnqueueWriteBuffer(queue, buf[0], CL_TRUE, 0, sz, &host[0], 0, NULL, NULL) == CL_SUCCESS);
+    }
+    gbps = report_copy_point(name, sz, sz, sz, iter, benchmark_now_ns() - start);
+  }
+  printf("\n");
+  return gbps;
+}
+
+double benchmark_host_copy_read_buffer(void)
+{
+  return host_copy_buffer(true);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_host_copy_read_buffer, "GB/S");
+
+double benchmark_host_copy_write_buffer(void)
+{
+  return host_copy_buffer(false);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_host_copy_write_buffer, "GB/S");
+
+static void enqueue_copy_rect(bool read, size_t row_sz, size_t row_pitch, size_t row_n, void *host)
+{
+  const size_t origin[3] = { 0, 0, 0 };
+  const size_t region[3] = { row_sz, row_n, 1 };
+  cl_int status;
+
+  if (read)
+    status = clEnqueueReadBufferRect(queue, buf[0], CL_TRUE, origin, origin, region,
+                                     row_pitch, 0, row_sz, 0, host, 0, NULL, NULL);
+  else
+    status = clEnqueueWriteBufferRect(queue, buf[0], CL_TRUE, origin, origin, region,
+                                      row_pitch, 0, row_sz, 0, host, 0, NULL, NULL);
+  OCL_ASSERT(status == CL_SUCCESS);
+}
+
+static double host_copy_buffer_rect(bool read)
+{
+  /* Same 64MB region read with narrowing rows, the buffer side pitch
+   * pads each row by one cache line */
+  const size_t bytes = 64 << 20;
+  const size_t row_bytes[] = { 64, 256, 4096, 65536, 1 << 20 };
+  const char *name = read ? "host_copy_read_buffer_rect" : "host_copy_write_buffer_rect";
+  std::vector<char> host(bytes);
+  double gbps = 0;
+
+  memset(&host[0], 1, bytes);
+  OCL_CREATE_BUFFER(buf[0], 0, bytes + (bytes / row_bytes[0]) * 64, NULL);
+  for (size_t i = 0; i < sizeof(row_bytes) / sizeof(row_bytes[0]); i++) {
+    const size_t row_sz = row_bytes[i], row_pitch = row_sz + 64;
+    const size_t iter = copy_iter(bytes);
+
+    enqueue_copy_rect(read, row_sz, row_pitch, bytes / row_sz, &host[0]);
+    const double start = benchmark_now_ns();
+    for (size_t j = 0; j < iter; j++)
+      enqueue_copy_rect(read, row_sz, row_pitch, bytes / row_sz, &host[0]);
+    gbps = report_copy_point(name, bytes, row_sz, row_pitch, iter, benchmark_now_ns() - start);
+  }
+  printf("\n");
+  return gbps;
+}
+
+double benchmark_host_copy_read_buffer_rect(void)
+{
+  return host_copy_buffer_rect(true);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_host_copy_read_buffer_rect, "GB/S");
+
+double benchmark_host_copy_write_buffer_rect(void)
+{
+  return host_copy_buffer_rect(false);
+}
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_host_copy_write_buffer_rect, "GB/S");
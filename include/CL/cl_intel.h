@@ -203,6 +203,35 @@ typedef CL_API_ENTRY cl_int
 #define CL_KERNEL_SPILL_MEM_SIZE_INTEL                  0x4109
 #define CL_KERNEL_COMPILE_SUB_GROUP_SIZE_INTEL          0x410A
 
+/* beignet kernel compile statistics, queried through clGetKernelWorkGroupInfo */
+#define CL_KERNEL_BANK_CONFLICT_COUNT_INTEL             0x4190
+/* cl_ulong[2]: launches run at SIMD8 and at SIMD16 */
+#define CL_KERNEL_SIMD_LAUNCH_COUNT_INTEL               0x4191
+#define CL_KERNEL_INSTRUCTION_COUNT_INTEL               0x4192
+#define CL_KERNEL_COMPACT_INSTRUCTION_COUNT_INTEL       0x4193
+#define CL_KERNEL_PEEPHOLE_REMOVED_COUNT_INTEL          0x4194
+#define CL_KERNEL_PEEPHOLE_FUSED_COUNT_INTEL            0x4195
+#define CL_KERNEL_PEEPHOLE_HINT_COUNT_INTEL             0x4196
+/* instructions of a -dump-opt-asm kernel which reassemble to the same binary */
+#define CL_KERNEL_ASM_ROUNDTRIP_COUNT_INTEL             0x4197
+
+/* beignet queue runtime statistics, queried through clGetCommandQueueInfo */
+/* cl_ulong[2]: gpgpu states reused from the queue pool and newly allocated */
+#define CL_QUEUE_GPGPU_POOL_STATS_INTEL                 0x41A0
+/* cl_ulong[2]: batch submissions and NDRange batches they carried */
+#define CL_QUEUE_SUBMIT_STATS_INTEL                     0x41A1
+/* cl_ulong[3]: non-blocking writes staged, bytes staged, writes not staged */
+#define CL_QUEUE_WRITE_STAGING_STATS_INTEL              0x41A3
+/* cl_ulong[2]: scratch, stack and printf buffers reused and newly allocated */
+#define CL_QUEUE_BO_CACHE_STATS_INTEL                   0x41A4
+/* cl_ulong[4]: enqueued buffer copies done on the host and by a kernel, then fills */
+#define CL_QUEUE_HOST_PATH_STATS_INTEL                  0x41A5
+
+/* beignet context runtime statistics, queried through clGetContextInfo */
+/* cl_ulong[6]: slab BOs, their bytes, bytes in live chunks, bytes requested,
+ * freed bytes waiting for the GPU, buffers ever suballocated */
+#define CL_CONTEXT_BUFFER_SLAB_STATS_INTEL              0x41A2
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,16 @@
+void bench_child(__global uint *counter)
+{
+  atomic_inc(counter);
+}
+
+kernel void bench_device_enqueue(uint child_n, __global uint *counter)
+{
+  if (get_global_id(0) != 0)
+    return;
+
+  queue_t q = get_default_queue();
+  for (uint i = 0; i < child_n; i++) {
+    void (^child)(void) = ^{ bench_child(counter); };
+    enqueue_kernel(q, CLK_ENQUEUE_FLAGS_WAIT_KERNEL, ndrange_1D(1), child);
+  }
+}
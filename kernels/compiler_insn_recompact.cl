@@ -0,0 +1,16 @@
+__kernel void
+compiler_insn_recompact(__global int *src, __global int *dst, int n)
+{
+  int id = (int)get_global_id(0);
+  int sum = 0;
+  for (int i = 0; i < n; i++) {
+    int v = src[(id + i) % 16];
+    if (v > id)
+      sum += v * 3;
+    else if (v & 1)
+      sum -= v;
+    else
+      sum ^= i;
+  }
+  dst[id] = sum;
+}
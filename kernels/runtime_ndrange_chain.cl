@@ -0,0 +1,6 @@
+__kernel void
+runtime_ndrange_chain(__global uint *dst, uint k)
+{
+  int id = (int)get_global_id(0);
+  dst[id] = dst[id] * 3 + k + id;
+}
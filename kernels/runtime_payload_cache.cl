@@ -0,0 +1,7 @@
+__kernel void
+runtime_payload_cache(__global int *dst, int a, int b)
+{
+  int id = (int)(get_global_id(1) * get_global_size(0) + get_global_id(0));
+  int lid = (int)(get_local_id(1) * get_local_size(0) + get_local_id(0));
+  dst[id] = a + b * lid + 100000 * (int)get_local_size(0);
+}
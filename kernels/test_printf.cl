@@ -90,3 +90,10 @@ test_printf_4(void)
     printf("@@ Long result is %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n",
 	   a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q, r, s, t);
 }
+
+__kernel void
+test_printf_cond(int id)
+{
+  if ((int)get_global_id(0) == id)
+    printf("@@ work item %d\n", id);
+}
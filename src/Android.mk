@@ -113,6 +113,12 @@ LOCAL_SRC_FILES:= \
     cl_command_queue.h \
     cl_command_queue_gen7.c \
     cl_command_queue_enqueue.c \
+    cl_host_worker.c \
+    cl_host_copy.c \
+    cl_image_tiling.c \
+    cl_mem_slab.c \
+    cl_staging_ring.c \
+    cl_mem_registry.c \
     cl_device_enqueue.c \
     cl_utils.c \
     cl_driver.h \
@@ -121,6 +127,7 @@ LOCAL_SRC_FILES:= \
     intel/intel_gpgpu.c \
     intel/intel_batchbuffer.c \
     intel/intel_driver.c \
+    null/null_driver.c \
     performance.c
 
 LOCAL_SHARED_LIBRARIES := \
@@ -18,6 +18,7 @@
 #include "cl_command_queue.h"
 #include "cl_device_id.h"
 #include "CL/cl.h"
+#include "CL/cl_intel.h"
 #include <stdio.h>
 
 /* Depreciated in 2.0 later */
@@ -136,6 +137,11 @@ clGetCommandQueueInfo(cl_command_queue command_queue,
   const void *src_ptr = NULL;
   size_t src_size = 0;
   cl_int ref;
+  cl_ulong pool_stats[2];
+  cl_ulong submit_stats[2];
+  cl_ulong staging_stats[3];
+  cl_ulong bo_cache_stats[2];
+  cl_ulong host_path_stats[4];
 
   if (!CL_OBJECT_IS_COMMAND_QUEUE(command_queue)) {
     return CL_INVALID_COMMAND_QUEUE;
@@ -157,6 +163,26 @@ clGetCommandQueueInfo(cl_command_queue command_queue,
   } else if (param_name == CL_QUEUE_SIZE) {
     src_ptr = &command_queue->size;
     src_size = sizeof(command_queue->size);
+  } else if (param_name == CL_QUEUE_GPGPU_POOL_STATS_INTEL) {
+    cl_gpgpu_pool_get_stats(command_queue->gpgpu_pool, pool_stats);
+    src_ptr = pool_stats;
+    src_size = sizeof(pool_stats);
+  } else if (param_name == CL_QUEUE_SUBMIT_STATS_INTEL) {
+    cl_command_queue_get_submit_stats(command_queue, submit_stats);
+    src_ptr = submit_stats;
+    src_size = sizeof(submit_stats);
+  } else if (param_name == CL_QUEUE_WRITE_STAGING_STATS_INTEL) {
+    cl_staging_ring_get_stats(command_queue->staging, staging_stats);
+    src_ptr = staging_stats;
+    src_size = sizeof(staging_stats);
+  } else if (param_name == CL_QUEUE_BO_CACHE_STATS_INTEL) {
+    cl_gpgpu_pool_get_bo_cache_stats(command_queue->gpgpu_pool, bo_cache_stats);
+    src_ptr = bo_cache_stats;
+    src_size = sizeof(bo_cache_stats);
+  } else if (param_name == CL_QUEUE_HOST_PATH_STATS_INTEL) {
+    cl_command_queue_get_host_path_stats(command_queue, host_path_stats);
+    src_ptr = host_path_stats;
+    src_size = sizeof(host_path_stats);
   } else {
     return CL_INVALID_VALUE;
   }
@@ -19,6 +19,7 @@
 #include "cl_context.h"
 #include "cl_device_id.h"
 #include "cl_alloc.h"
+#include "CL/cl_intel.h"
 
 cl_context
 clCreateContext(const cl_context_properties *properties,
@@ -140,6 +141,8 @@ clGetContextInfo(cl_context context,
   size_t src_size = 0;
   cl_uint n, ref;
   cl_context_properties p;
+  cl_mem_slab_stats slab_stats;
+  cl_ulong slab_info[6];
 
   if (!CL_OBJECT_IS_CONTEXT(context)) {
     return CL_INVALID_CONTEXT;
@@ -165,6 +168,16 @@ clGetContextInfo(cl_context context,
       src_ptr = &p;
       src_size = sizeof(cl_context_properties);
     }
+  } else if (param_name == CL_CONTEXT_BUFFER_SLAB_STATS_INTEL) {
+    cl_mem_slab_get_stats(&context->buffer_slabs, &slab_stats);
+    slab_info[0] = slab_stats.slab_n;
+    slab_info[1] = slab_stats.slab_bytes;
+    slab_info[2] = slab_stats.used_bytes;
+    slab_info[3] = slab_stats.requested_bytes;
+    slab_info[4] = slab_stats.retired_bytes;
+    slab_info[5] = slab_stats.alloc_n;
+    src_ptr = slab_info;
+    src_size = sizeof(slab_info);
   } else {
     return CL_INVALID_VALUE;
   }
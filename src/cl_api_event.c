@@ -203,6 +203,9 @@ clWaitForEvents(cl_uint num_events,
       err = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
       return err;
     }
+    /* Implicit flush of the batches held by the queue */
+    if (event_list[i]->queue)
+      cl_command_queue_submit_chain(event_list[i]->queue);
   }
 
   err = cl_event_wait_for_events_list(num_events, event_list);
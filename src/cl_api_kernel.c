@@ -24,6 +24,7 @@
 #include "cl_program.h"
 #include "cl_alloc.h"
 #include "CL/cl.h"
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -217,71 +218,61 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
       fixed_global_sz[0] % fixed_local_sz[0],
       fixed_global_sz[1] % fixed_local_sz[1],
       fixed_global_sz[2] % fixed_local_sz[2]};
-    cl_uint count;
-    count = global_wk_sz_rem[0] ? 2 : 1;
-    count *= global_wk_sz_rem[1] ? 2 : 1;
-    count *= global_wk_sz_rem[2] ? 2 : 1;
 
     const size_t *global_wk_all[2] = {global_wk_sz_div, global_wk_sz_rem};
-    cl_bool allow_immediate_submit = cl_command_queue_allow_bypass_submit(command_queue);
-    /* Go through the at most 8 cases and euque if there is work items left */
+    cl_ndrange_walker walkers[8];
+    cl_uint walker_n = 0;
+    /* Go through the at most 8 cases and keep the ones with work items left.
+       They all run in the same batch, one walker each */
     for (i = 0; i < 2; i++) {
       for (j = 0; j < 2; j++) {
         for (k = 0; k < 2; k++) {
-          size_t global_wk_sz_use[3] = {global_wk_all[k][0], global_wk_all[j][1], global_wk_all[i][2]};
-          size_t global_dim_off[3] = {
-            k * global_wk_sz_div[0] / fixed_local_sz[0],
-            j * global_wk_sz_div[1] / fixed_local_sz[1],
-            i * global_wk_sz_div[2] / fixed_local_sz[2]};
-          size_t local_wk_sz_use[3] = {
-            k ? global_wk_sz_rem[0] : fixed_local_sz[0],
-            j ? global_wk_sz_rem[1] : fixed_local_sz[1],
-            i ? global_wk_sz_rem[2] : fixed_local_sz[2]};
-          if (local_wk_sz_use[0] == 0 || local_wk_sz_use[1] == 0 || local_wk_sz_use[2] == 0)
-            continue;
-
-          e = cl_event_create(command_queue->ctx, command_queue, num_events_in_wait_list,
-                              event_wait_list, CL_COMMAND_NDRANGE_KERNEL, &err);
-          if (err != CL_SUCCESS) {
-            break;
-          }
+          cl_ndrange_walker *w = &walkers[walker_n];
+          w->global_wk_sz_use[0] = global_wk_all[k][0];
+          w->global_wk_sz_use[1] = global_wk_all[j][1];
+          w->global_wk_sz_use[2] = global_wk_all[i][2];
+          w->global_dim_off[0] = k * global_wk_sz_div[0] / fixed_local_sz[0];
+          w->global_dim_off[1] = j * global_wk_sz_div[1] / fixed_local_sz[1];
+          w->global_dim_off[2] = i * global_wk_sz_div[2] / fixed_local_sz[2];
+          w->local_wk_sz_use[0] = k ? global_wk_sz_rem[0] : fixed_local_sz[0];
+          w->local_wk_sz_use[1] = j ? global_wk_sz_rem[1] : fixed_local_sz[1];
+          w->local_wk_sz_use[2] = i ? global_wk_sz_rem[2] : fixed_local_sz[2];
+          if (w->local_wk_sz_use[0] && w->local_wk_sz_use[1] && w->local_wk_sz_use[2])
+            walker_n++;
+        }
+      }
+    }
+    assert(walker_n > 0 && walker_n <= CL_GPGPU_MAX_DISPATCH);
 
-          /* Do device specific checks are enqueue the kernel */
-          err = cl_command_queue_ND_range(command_queue, kernel, e, work_dim,
-                                          fixed_global_off, global_dim_off, fixed_global_sz,
-                                          global_wk_sz_use, fixed_local_sz, local_wk_sz_use);
-          if (err != CL_SUCCESS) {
-            break;
-          }
-          e->exec_data.mid_event_of_enq = (count > 1);
-          count--;
-
-          /* We will flush the ndrange if no event depend. Else we will add it to queue list.
-             The finish or Complete status will always be done in queue list. */
-          event_status = cl_event_is_ready(e);
-          if (event_status < CL_COMPLETE) { // Error happend, cancel.
-            err = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
-            break;
-          }
+    e = cl_event_create(command_queue->ctx, command_queue, num_events_in_wait_list,
+                        event_wait_list, CL_COMMAND_NDRANGE_KERNEL, &err);
+    if (err != CL_SUCCESS) {
+      break;
+    }
 
-          err = cl_event_exec(e, ((allow_immediate_submit && event_status == CL_COMPLETE) ? CL_SUBMITTED : CL_QUEUED), CL_FALSE);
-          if (err != CL_SUCCESS) {
-            break;
-          }
+    /* Do device specific checks are enqueue the kernel */
+    err = cl_command_queue_ND_range_walkers(command_queue, kernel, e, work_dim,
+                                            fixed_global_off, fixed_global_sz, fixed_local_sz,
+                                            walkers, walker_n);
+    if (err != CL_SUCCESS) {
+      break;
+    }
 
-          cl_command_queue_enqueue_event(command_queue, e);
+    /* We will flush the ndrange if no event depend. Else we will add it to queue list.
+       The finish or Complete status will always be done in queue list. */
+    event_status = cl_event_is_ready(e);
+    if (event_status < CL_COMPLETE) { // Error happend, cancel.
+      err = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
+      break;
+    }
 
-          if (e->exec_data.mid_event_of_enq)
-            cl_event_delete(e);
-        }
-        if (err != CL_SUCCESS) {
-          break;
-        }
-      }
-      if (err != CL_SUCCESS) {
-        break;
-      }
+    err = cl_event_exec(e, ((cl_command_queue_allow_bypass_submit(command_queue) &&
+                             event_status == CL_COMPLETE) ? CL_SUBMITTED : CL_QUEUED), CL_FALSE);
+    if (err != CL_SUCCESS) {
+      break;
     }
+
+    cl_command_queue_enqueue_event(command_queue, e);
   } while (0);
 
   if (err == CL_SUCCESS && event) {
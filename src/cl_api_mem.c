@@ -616,6 +616,7 @@ clEnqueueWriteBuffer(cl_command_queue command_queue,
   enqueue_data *data = NULL;
   cl_int e_status;
   cl_event e = NULL;
+  void *staged;
 
   do {
     if (!CL_OBJECT_IS_COMMAND_QUEUE(command_queue)) {
@@ -687,6 +688,13 @@ clEnqueueWriteBuffer(cl_command_queue command_queue,
         break;
       }
     } else {
+      /* Copy the data now, so the application can reuse ptr on return */
+      if (!blocking_write && command_queue->staging &&
+          (staged = cl_staging_ring_put(command_queue->staging, ptr, size)) != NULL) {
+        data->const_ptr = staged;
+        data->staging = command_queue->staging;
+      }
+
       err = cl_event_exec(e, CL_QUEUED, CL_FALSE);
       if (err != CL_SUCCESS) {
         break;
@@ -32,8 +32,21 @@ cl_object_init_base(cl_base_object obj, cl_ulong magic)
   list_node_init(&obj->node);
 }
 
+/* Make a retired object alive again, its mutex and cond are kept */
 LOCAL void
-cl_object_destroy_base(cl_base_object obj)
+cl_object_reuse_base(cl_base_object obj, cl_ulong magic)
+{
+  assert(!CL_OBJECT_IS_VALID(obj));
+  obj->magic = magic;
+  obj->ref = 1;
+  obj->owner = invalid_thread_id;
+  list_node_init(&obj->node);
+}
+
+/* Invalidate the object like destroy, but keep its mutex and cond so the
+   memory can be reused for an object of the same kind */
+LOCAL void
+cl_object_retire_base(cl_base_object obj)
 {
   int ref = CL_OBJECT_GET_REF(obj);
   if (ref != 0) {
@@ -61,6 +74,21 @@ cl_object_destroy_base(cl_base_object obj)
   }
 
   obj->magic = CL_OBJECT_INVALID_MAGIC;
+}
+
+LOCAL void
+cl_object_destroy_base(cl_base_object obj)
+{
+  cl_object_retire_base(obj);
+  pthread_mutex_destroy(&obj->mutex);
+  pthread_cond_destroy(&obj->cond);
+}
+
+/* Destroy an object retired by cl_object_retire_base */
+LOCAL void
+cl_object_destroy_retired_base(cl_base_object obj)
+{
+  assert(!CL_OBJECT_IS_VALID(obj));
   pthread_mutex_destroy(&obj->mutex);
   pthread_cond_destroy(&obj->cond);
 }
@@ -67,6 +67,9 @@ typedef struct _cl_base_object *cl_base_object;
 
 extern void cl_object_init_base(cl_base_object obj, cl_ulong magic);
 extern void cl_object_destroy_base(cl_base_object obj);
+extern void cl_object_retire_base(cl_base_object obj);
+extern void cl_object_reuse_base(cl_base_object obj, cl_ulong magic);
+extern void cl_object_destroy_retired_base(cl_base_object obj);
 extern cl_int cl_object_take_ownership(cl_base_object obj, cl_int wait, cl_bool withlock);
 extern void cl_object_release_ownership(cl_base_object obj, cl_bool withlock);
 extern void cl_object_wait_on_cond(cl_base_object obj);
@@ -74,6 +77,9 @@ extern void cl_object_notify_cond(cl_base_object obj);
 
 #define CL_OBJECT_INIT_BASE(obj, magic) (cl_object_init_base((cl_base_object)obj, magic))
 #define CL_OBJECT_DESTROY_BASE(obj) (cl_object_destroy_base((cl_base_object)obj))
+#define CL_OBJECT_RETIRE_BASE(obj) (cl_object_retire_base((cl_base_object)obj))
+#define CL_OBJECT_REUSE_BASE(obj, magic) (cl_object_reuse_base((cl_base_object)obj, magic))
+#define CL_OBJECT_DESTROY_RETIRED_BASE(obj) (cl_object_destroy_retired_base((cl_base_object)obj))
 #define CL_OBJECT_TAKE_OWNERSHIP(obj, wait) (cl_object_take_ownership((cl_base_object)obj, wait, CL_FALSE))
 #define CL_OBJECT_RELEASE_OWNERSHIP(obj) (cl_object_release_ownership((cl_base_object)obj, CL_FALSE))
 #define CL_OBJECT_TAKE_OWNERSHIP_WITHLOCK(obj, wait) (cl_object_take_ownership((cl_base_object)obj, wait, CL_TRUE))
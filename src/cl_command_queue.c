@@ -34,7 +34,155 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+static cl_gpgpu_pool
+cl_gpgpu_pool_new(cl_driver drv)
+{
+  cl_gpgpu_pool pool = cl_calloc(1, sizeof(_cl_gpgpu_pool));
+  if (pool == NULL)
+    return NULL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->drv = drv;
+  pool->ref_n = 1;
+  pool->bo_cache = cl_gpgpu_bo_cache_new(drv);
+  return pool;
+}
+
+static void
+cl_gpgpu_pool_free(cl_gpgpu_pool pool)
+{
+  assert(pool->idle_n == 0);
+  pthread_mutex_destroy(&pool->lock);
+  cl_free(pool);
+}
+
+/* Called when the queue goes away: the idle states are released at once and
+ * the ones still in flight are deleted along with their event */
+static void
+cl_gpgpu_pool_close(cl_gpgpu_pool pool)
+{
+  cl_gpgpu idle[CL_GPGPU_POOL_SIZE];
+  cl_uint i, idle_n;
+  cl_bool last;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->closed = CL_TRUE;
+  idle_n = pool->idle_n;
+  memcpy(idle, pool->idle, idle_n * sizeof(cl_gpgpu));
+  pool->idle_n = 0;
+  last = --pool->ref_n == 0;
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 0; i < idle_n; i++)
+    cl_gpgpu_delete(idle[i]);
+  /* The states still in flight keep it until they are deleted */
+  cl_gpgpu_bo_cache_close(pool->bo_cache);
+  if (last)
+    cl_gpgpu_pool_free(pool);
+}
+
+LOCAL cl_gpgpu
+cl_gpgpu_pool_get(cl_gpgpu_pool pool)
+{
+  cl_gpgpu gpgpu = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  /* States come back in submission order, so only the oldest one needs to be
+   * checked: if it is still busy, all the others are too */
+  if (pool->idle_n > 0 && cl_gpgpu_is_idle(pool->idle[0])) {
+    gpgpu = pool->idle[0];
+    pool->idle_n--;
+    memmove(pool->idle, pool->idle + 1, pool->idle_n * sizeof(cl_gpgpu));
+    pool->hit_n++;
+  } else
+    pool->miss_n++;
+  pool->ref_n++;
+  pthread_mutex_unlock(&pool->lock);
+
+  if (gpgpu == NULL) {
+    if ((gpgpu = cl_gpgpu_new(pool->drv)) == NULL)
+      cl_gpgpu_pool_put(pool, NULL);
+    else
+      cl_gpgpu_set_bo_cache(gpgpu, pool->bo_cache);
+  }
+  return gpgpu;
+}
+
+LOCAL void
+cl_gpgpu_pool_put(cl_gpgpu_pool pool, cl_gpgpu gpgpu)
+{
+  cl_gpgpu drop = NULL;
+  cl_bool last;
+
+  pthread_mutex_lock(&pool->lock);
+  if (gpgpu) {
+    if (!pool->closed && pool->idle_n < CL_GPGPU_POOL_SIZE)
+      pool->idle[pool->idle_n++] = gpgpu;
+    else
+      drop = gpgpu;
+  }
+  last = --pool->ref_n == 0;
+  pthread_mutex_unlock(&pool->lock);
+
+  if (drop)
+    cl_gpgpu_delete(drop);
+  if (last)
+    cl_gpgpu_pool_free(pool);
+}
+
+LOCAL void
+cl_gpgpu_pool_get_bo_cache_stats(cl_gpgpu_pool pool, cl_ulong stats[2])
+{
+  cl_gpgpu_bo_cache_get_stats(pool->bo_cache, stats);
+}
+
+LOCAL void
+cl_gpgpu_pool_get_stats(cl_gpgpu_pool pool, cl_ulong stats[2])
+{
+  pthread_mutex_lock(&pool->lock);
+  stats[0] = pool->hit_n;
+  stats[1] = pool->miss_n;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void
+cl_command_queue_chain_init(_cl_command_queue_chain *chain)
+{
+  const char *env;
+
+  pthread_condattr_t attr;
+
+  pthread_mutex_init(&chain->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&chain->flushed, &attr);
+  pthread_condattr_destroy(&attr);
+  env = getenv("OCL_NDRANGE_COALESCE");
+  chain->max = env ? atoi(env) : 0;
+  env = getenv("OCL_NDRANGE_COALESCE_US");
+  chain->timeout_ns = (env ? atoi(env) : 100) * 1000ull;
+}
+
+static void
+cl_command_queue_chain_destroy(_cl_command_queue_chain *chain)
+{
+  pthread_cond_destroy(&chain->flushed);
+  pthread_mutex_destroy(&chain->lock);
+  cl_free(chain->status);
+}
+
+static void
+cl_command_queue_host_path_init(_cl_command_queue_host_path *host_path, cl_context ctx)
+{
+  const char *env = getenv("OCL_HOST_PATH_THRESHOLD");
+
+  host_path->max = env ? strtoul(env, NULL, 0) : 4096;
+  if (!ctx->devices[0]->host_unified_memory)
+    host_path->max = 0;
+}
 
 static cl_command_queue
 cl_command_queue_new(cl_context ctx)
@@ -47,10 +195,23 @@ cl_command_queue_new(cl_context ctx)
     return NULL;
 
   CL_OBJECT_INIT_BASE(queue, CL_OBJECT_COMMAND_QUEUE_MAGIC);
+  cl_command_queue_chain_init(&queue->chain);
+  cl_command_queue_host_path_init(&queue->host_path, ctx);
+  queue->gpgpu_pool = cl_gpgpu_pool_new(ctx->drv);
+  if (queue->gpgpu_pool == NULL) {
+    cl_command_queue_chain_destroy(&queue->chain);
+    CL_OBJECT_DESTROY_BASE(queue);
+    cl_free(queue);
+    return NULL;
+  }
   if (cl_command_queue_init_enqueue(queue) != CL_SUCCESS) {
+    cl_gpgpu_pool_close(queue->gpgpu_pool);
+    cl_command_queue_chain_destroy(&queue->chain);
+    CL_OBJECT_DESTROY_BASE(queue);
     cl_free(queue);
     return NULL;
   }
+  queue->staging = cl_staging_ring_new();
 
   /* Append the command queue in the list */
   cl_context_add_queue(ctx, queue);
@@ -88,6 +249,10 @@ cl_command_queue_delete(cl_command_queue queue)
   cl_context_remove_queue(queue->ctx, queue);
 
   cl_command_queue_destroy_enqueue(queue);
+  cl_gpgpu_pool_close(queue->gpgpu_pool);
+  cl_staging_ring_close(queue->staging);
+  assert(queue->chain.head == NULL);
+  cl_command_queue_chain_destroy(&queue->chain);
 
   cl_mem_delete(queue->perf);
   if (queue->barrier_events) {
@@ -201,6 +366,41 @@ cl_command_queue_bind_surface(cl_command_queue queue, cl_kernel k, cl_gpgpu gpgp
   return CL_SUCCESS;
 }
 
+static cl_mem_slab
+cl_command_queue_arg_slab(cl_mem mem)
+{
+  if (mem == NULL)
+    return NULL;
+  if (mem->type == CL_MEM_SUBBUFFER_TYPE)
+    mem = &((struct _cl_mem_buffer *)mem)->parent->base;
+  return mem->slab;
+}
+
+/* The buffers may be released before the batch is even submitted, when it
+ * waits for a user event or is held in a chain. Their chunks must not be
+ * handed out again before it completes */
+LOCAL cl_int
+cl_command_queue_pin_slabs(cl_command_queue queue, cl_kernel k, cl_event event)
+{
+  cl_mem_slab *slabs;
+  uint32_t i, n = 0;
+
+  for (i = 0; i < k->arg_n; i++)
+    if (cl_command_queue_arg_slab(k->args[i].mem))
+      n++;
+  if (n == 0)
+    return CL_SUCCESS;
+  if ((slabs = cl_calloc(n, sizeof(cl_mem_slab))) == NULL)
+    return CL_OUT_OF_HOST_MEMORY;
+  for (i = 0, n = 0; i < k->arg_n; i++)
+    if ((slabs[n] = cl_command_queue_arg_slab(k->args[i].mem)) != NULL)
+      n++;
+  cl_mem_slab_pin(&queue->ctx->buffer_slabs, slabs, n);
+  event->exec_data.slabs = slabs;
+  event->exec_data.slab_n = n;
+  return CL_SUCCESS;
+}
+
 LOCAL cl_int
 cl_command_queue_bind_exec_info(cl_command_queue queue, cl_kernel k, cl_gpgpu gpgpu, uint32_t *max_bti)
 {
@@ -229,9 +429,9 @@ cl_command_queue_bind_exec_info(cl_command_queue queue, cl_kernel k, cl_gpgpu gp
   return CL_SUCCESS;
 }
 
-extern cl_int cl_command_queue_ND_range_gen7(cl_command_queue, cl_kernel, cl_event, 
-                                             uint32_t, const size_t *, const size_t *,const size_t *,
-                                             const size_t *, const size_t *, const size_t *);
+extern cl_int cl_command_queue_ND_range_gen7(cl_command_queue, cl_kernel, cl_event,
+                                             uint32_t, const size_t *, const size_t *, const size_t *,
+                                             const cl_ndrange_walker *, uint32_t);
 
 static cl_int
 cl_kernel_check_args(cl_kernel k)
@@ -244,16 +444,15 @@ cl_kernel_check_args(cl_kernel k)
 }
 
 LOCAL cl_int
-cl_command_queue_ND_range(cl_command_queue queue,
-                          cl_kernel k,
-                          cl_event event,
-                          const uint32_t work_dim,
-                          const size_t *global_wk_off,
-                          const size_t *global_dim_off,
-                          const size_t *global_wk_sz,
-                          const size_t *global_wk_sz_use,
-                          const size_t *local_wk_sz,
-                          const size_t *local_wk_sz_use)
+cl_command_queue_ND_range_walkers(cl_command_queue queue,
+                                  cl_kernel k,
+                                  cl_event event,
+                                  const uint32_t work_dim,
+                                  const size_t *global_wk_off,
+                                  const size_t *global_wk_sz,
+                                  const size_t *local_wk_sz,
+                                  const cl_ndrange_walker *walkers,
+                                  uint32_t walker_n)
 {
   if(b_output_kernel_perf)
     time_start(queue->ctx, cl_kernel_get_name(k), queue);
@@ -267,8 +466,8 @@ cl_command_queue_ND_range(cl_command_queue queue,
   if (ver == 7 || ver == 75 || ver == 8 || ver == 9)
     //TRY (cl_command_queue_ND_range_gen7, queue, k, work_dim, global_wk_off, global_wk_sz, local_wk_sz);
     TRY (cl_command_queue_ND_range_gen7, queue, k, event, work_dim,
-                                global_wk_off, global_dim_off, global_wk_sz,
-                                global_wk_sz_use, local_wk_sz, local_wk_sz_use);
+                                global_wk_off, global_wk_sz, local_wk_sz,
+                                walkers, walker_n);
 
   else
     FATAL ("Unknown Gen Device");
@@ -277,6 +476,26 @@ error:
   return err;
 }
 
+LOCAL cl_int
+cl_command_queue_ND_range(cl_command_queue queue,
+                          cl_kernel k,
+                          cl_event event,
+                          const uint32_t work_dim,
+                          const size_t *global_wk_off,
+                          const size_t *global_dim_off,
+                          const size_t *global_wk_sz,
+                          const size_t *global_wk_sz_use,
+                          const size_t *local_wk_sz,
+                          const size_t *local_wk_sz_use)
+{
+  cl_ndrange_walker walker;
+  memcpy(walker.global_dim_off, global_dim_off, sizeof(walker.global_dim_off));
+  memcpy(walker.global_wk_sz_use, global_wk_sz_use, sizeof(walker.global_wk_sz_use));
+  memcpy(walker.local_wk_sz_use, local_wk_sz_use, sizeof(walker.local_wk_sz_use));
+  return cl_command_queue_ND_range_walkers(queue, k, event, work_dim, global_wk_off,
+                                           global_wk_sz, local_wk_sz, &walker, 1);
+}
+
 LOCAL int
 cl_command_queue_flush_gpgpu(cl_gpgpu gpgpu)
 {
@@ -307,6 +526,193 @@ cl_command_queue_flush_gpgpu(cl_gpgpu gpgpu)
   return CL_SUCCESS;
 }
 
+/* Printf, profiling and device enqueue read their results back right after
+ * the flush, so those batches are never held */
+static cl_bool
+cl_command_queue_can_chain(cl_command_queue queue, cl_gpgpu gpgpu)
+{
+  void *printf_info;
+
+  if ((queue->chain.max <= 1 && queue->chain.hold == 0) || cl_gpgpu_chain == NULL ||
+      (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+    return CL_FALSE;
+  printf_info = cl_gpgpu_get_printf_info(gpgpu);
+  if (printf_info && interp_get_printf_num(printf_info))
+    return CL_FALSE;
+  return cl_gpgpu_get_profiling_info(gpgpu) == NULL && cl_gpgpu_get_kernel(gpgpu) == NULL;
+}
+
+/* Batches held at most, a hold allows more than OCL_NDRANGE_COALESCE */
+#define CL_COMMAND_QUEUE_HOLD_MAX 64
+
+static cl_uint
+cl_command_queue_chain_max(_cl_command_queue_chain *chain)
+{
+  if (chain->hold && chain->max < CL_COMMAND_QUEUE_HOLD_MAX)
+    return CL_COMMAND_QUEUE_HOLD_MAX;
+  return chain->max;
+}
+
+static cl_ulong
+cl_command_queue_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (cl_ulong)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Must be called with the chain lock. The batches behind the head only run
+ * if it does, they all get the status of the submission */
+static cl_int
+cl_command_queue_flush_chain(_cl_command_queue_chain *chain)
+{
+  cl_int err = CL_SUCCESS;
+  cl_uint i;
+
+  if (chain->head == NULL)
+    return CL_SUCCESS;
+  if (cl_gpgpu_flush(chain->head) < 0)
+    err = CL_OUT_OF_RESOURCES;
+  for (i = 0; i < chain->n; i++)
+    *chain->status[i] = err;
+  chain->submitted_seq = chain->seq;
+  chain->submit_n++;
+  chain->batch_n += chain->n;
+  chain->head = chain->tail = NULL;
+  chain->n = 0;
+  pthread_cond_broadcast(&chain->flushed);
+  return err;
+}
+
+LOCAL cl_int
+cl_command_queue_submit_chain(cl_command_queue queue)
+{
+  _cl_command_queue_chain *chain = &queue->chain;
+  cl_int err;
+
+  /* A hold chains the batches whatever OCL_NDRANGE_COALESCE says */
+  if (chain->max <= 1 && chain->hold == 0)
+    return CL_SUCCESS;
+  pthread_mutex_lock(&chain->lock);
+  err = cl_command_queue_flush_chain(chain);
+  pthread_mutex_unlock(&chain->lock);
+  return err;
+}
+
+LOCAL void
+cl_command_queue_hold_chain(cl_command_queue queue)
+{
+  pthread_mutex_lock(&queue->chain.lock);
+  queue->chain.hold++;
+  pthread_mutex_unlock(&queue->chain.lock);
+}
+
+LOCAL cl_int
+cl_command_queue_release_chain(cl_command_queue queue)
+{
+  _cl_command_queue_chain *chain = &queue->chain;
+  cl_int err = CL_SUCCESS;
+
+  pthread_mutex_lock(&chain->lock);
+  assert(chain->hold > 0);
+  chain->hold--;
+  err = cl_command_queue_flush_chain(chain);
+  pthread_mutex_unlock(&chain->lock);
+  return err;
+}
+
+LOCAL cl_int
+cl_command_queue_submit_gpgpu(cl_command_queue queue, cl_gpgpu gpgpu, cl_ulong *seq, cl_int *status)
+{
+  _cl_command_queue_chain *chain = &queue->chain;
+  cl_int err = CL_SUCCESS;
+
+  *seq = 0;
+  *status = CL_SUCCESS;
+  if (!cl_command_queue_can_chain(queue, gpgpu)) {
+    /* Whatever is held must reach the GPU first, its failure is reported
+     * to the batches held */
+    pthread_mutex_lock(&chain->lock);
+    err = cl_command_queue_flush_chain(chain);
+    chain->submit_n++;
+    chain->batch_n++;
+    pthread_mutex_unlock(&chain->lock);
+    if (err == CL_SUCCESS)
+      err = cl_command_queue_flush_gpgpu(gpgpu);
+    return err;
+  }
+
+  pthread_mutex_lock(&chain->lock);
+  if (chain->n == chain->status_cap) {
+    const cl_uint cap = chain->status_cap ? 2 * chain->status_cap : 16;
+    cl_int **status_list = cl_realloc(chain->status, cap * sizeof(cl_int *));
+    if (status_list == NULL) {
+      pthread_mutex_unlock(&chain->lock);
+      return CL_OUT_OF_HOST_MEMORY;
+    }
+    chain->status = status_list;
+    chain->status_cap = cap;
+  }
+  if (chain->head == NULL || cl_gpgpu_chain(chain->tail, gpgpu) != 0) {
+    cl_command_queue_flush_chain(chain);
+    chain->head = gpgpu;
+    chain->start_ns = cl_command_queue_now_ns();
+  }
+  chain->tail = gpgpu;
+  chain->status[chain->n++] = status;
+  *seq = ++chain->seq;
+  if (chain->n >= cl_command_queue_chain_max(chain))
+    err = cl_command_queue_flush_chain(chain);
+  pthread_mutex_unlock(&chain->lock);
+  return err;
+}
+
+LOCAL cl_int
+cl_command_queue_wait_chain(cl_command_queue queue, cl_ulong seq, const cl_int *status)
+{
+  _cl_command_queue_chain *chain = &queue->chain;
+  cl_int err;
+
+  if (seq == 0)
+    return CL_SUCCESS;
+  pthread_mutex_lock(&chain->lock);
+  /* Give the following launches a chance to join the submission. Any flush
+   * of the chain wakes the waiters up at once */
+  while (chain->submitted_seq < seq) {
+    const cl_ulong deadline = chain->start_ns + chain->timeout_ns;
+    struct timespec ts;
+
+    if (cl_command_queue_now_ns() >= deadline) {
+      cl_command_queue_flush_chain(chain);
+      break;
+    }
+    ts.tv_sec = deadline / 1000000000ull;
+    ts.tv_nsec = deadline % 1000000000ull;
+    pthread_cond_timedwait(&chain->flushed, &chain->lock, &ts);
+  }
+  err = *status;
+  pthread_mutex_unlock(&chain->lock);
+  return err;
+}
+
+LOCAL void
+cl_command_queue_get_submit_stats(cl_command_queue queue, cl_ulong stats[2])
+{
+  pthread_mutex_lock(&queue->chain.lock);
+  stats[0] = queue->chain.submit_n;
+  stats[1] = queue->chain.batch_n;
+  pthread_mutex_unlock(&queue->chain.lock);
+}
+
+LOCAL void
+cl_command_queue_get_host_path_stats(cl_command_queue queue, cl_ulong stats[4])
+{
+  stats[0] = atomic_read(&queue->host_path.copy_n[0]);
+  stats[1] = atomic_read(&queue->host_path.copy_n[1]);
+  stats[2] = atomic_read(&queue->host_path.fill_n[0]);
+  stats[3] = atomic_read(&queue->host_path.fill_n[1]);
+}
+
 LOCAL void
 cl_command_queue_insert_barrier_event(cl_command_queue queue, cl_event event)
 {
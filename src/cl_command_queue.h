@@ -23,6 +23,7 @@
 #include "cl_internals.h"
 #include "cl_driver.h"
 #include "cl_base_object.h"
+#include "cl_staging_ring.h"
 #include "CL/cl.h"
 #include <stdint.h>
 
@@ -31,14 +32,64 @@ struct intel_gpgpu;
 typedef struct _cl_command_queue_enqueue_worker {
   cl_command_queue queue;
   pthread_t tid;
-  cl_uint cookie;
   cl_bool quit;
   list_head enqueued_events;
+  list_head ready_events; /* Out of order: enqueued events whose dependencies completed */
+  list_head host_events;  /* Out of order: host commands running on the host worker pool */
+  cl_uint host_running;   /* Host commands not retired by the pool yet */
   cl_uint in_exec_status; // Same value as CL_COMPLETE, CL_SUBMITTED ...
 } _cl_command_queue_enqueue_worker;
 
 typedef _cl_command_queue_enqueue_worker *cl_command_queue_enqueue_worker;
 
+/* Max number of retired gpgpu states kept per queue */
+#define CL_GPGPU_POOL_SIZE 16
+
+/* Recycled gpgpu states of one queue. The events still holding a state keep
+ * the pool alive, so it may outlive its queue */
+typedef struct _cl_gpgpu_pool {
+  pthread_mutex_t lock;
+  cl_driver drv;                       /* Driver the states come from */
+  cl_gpgpu idle[CL_GPGPU_POOL_SIZE];   /* Released states, oldest first */
+  cl_uint idle_n;
+  cl_uint ref_n;                       /* The queue plus one per state in use */
+  cl_bool closed;                      /* The queue is gone, stop caching */
+  cl_ulong hit_n;                      /* States reused */
+  cl_ulong miss_n;                     /* States allocated */
+  cl_gpgpu_bo_cache bo_cache;          /* Scratch, stack and printf buffers of the states */
+} _cl_gpgpu_pool;
+
+typedef _cl_gpgpu_pool *cl_gpgpu_pool;
+
+/* NDRange batches held to be submitted together: each one jumps into the next
+ * and only the first one is flushed (OCL_NDRANGE_COALESCE) */
+typedef struct _cl_command_queue_chain {
+  pthread_mutex_t lock;
+  pthread_cond_t flushed;              /* Broadcast when the held batches are submitted */
+  cl_gpgpu head;                       /* Batch to flush, NULL if none held */
+  cl_gpgpu tail;                       /* Last batch chained */
+  cl_int **status;                     /* Submission status of each held batch */
+  cl_uint status_cap;                  /* Size of status */
+  cl_uint n;                           /* Batches held */
+  cl_uint max;                         /* Submit when that many are held, <= 1 disables */
+  cl_uint hold;                        /* Non zero while launches are batched whatever max */
+  cl_ulong timeout_ns;                 /* Max time a batch is held once waited for */
+  cl_ulong start_ns;                   /* When head was held */
+  cl_ulong seq;                        /* Sequence number of the last batch held */
+  cl_ulong submitted_seq;              /* Last batch submitted */
+  cl_ulong submit_n;                   /* Batch submissions to the driver */
+  cl_ulong batch_n;                    /* NDRange batches they carried */
+} _cl_command_queue_chain;
+
+/* Buffer copies and fills of at most max bytes are done by the CPU rather
+ * than by an internal kernel, on devices sharing memory with the host
+ * (OCL_HOST_PATH_THRESHOLD) */
+typedef struct _cl_command_queue_host_path {
+  size_t max;                          /* Largest size done on the host, 0 disables */
+  atomic_t copy_n[2];                  /* Enqueued buffer copies done on the host, by a kernel */
+  atomic_t fill_n[2];                  /* Enqueued buffer fills done on the host, by a kernel */
+} _cl_command_queue_host_path;
+
 /* Basically, this is a (kind-of) batch buffer */
 typedef struct _cl_command_queue {
   _cl_base_object base;
@@ -51,6 +102,10 @@ typedef struct _cl_command_queue {
   cl_command_queue_properties props;   /* Queue properties */
   cl_mem perf;                         /* Where to put the perf counters */
   cl_uint size;                        /* Store the specified size for queueu */
+  cl_gpgpu_pool gpgpu_pool;            /* Retired gpgpu states to reuse */
+  _cl_command_queue_chain chain;       /* NDRanges coalesced in one submission */
+  cl_staging_ring staging;             /* Copies of non-blocking writes, NULL if off */
+  _cl_command_queue_host_path host_path; /* Small copies and fills done on the host */
 } _cl_command_queue;;
 
 #define CL_OBJECT_COMMAND_QUEUE_MAGIC 0x83650a12b79ce4efLL
@@ -66,6 +121,14 @@ extern cl_command_queue cl_create_command_queue(cl_context, cl_device_id,
 extern void cl_command_queue_delete(cl_command_queue);
 /* Keep one more reference on the queue */
 extern void cl_command_queue_add_ref(cl_command_queue);
+/* One sub-range of an ND range, run by its own walker. The non-uniform
+ * remainders of an ND range have a smaller local size than the main part */
+typedef struct cl_ndrange_walker {
+  size_t global_dim_off[3];   /* offset in work groups of the sub-range */
+  size_t global_wk_sz_use[3]; /* work items of the sub-range */
+  size_t local_wk_sz_use[3];  /* local size of its work groups */
+} cl_ndrange_walker;
+
 /* Map ND range kernel from OCL API */
 extern cl_int cl_command_queue_ND_range(cl_command_queue queue,
                                         cl_kernel ker,
@@ -77,17 +140,55 @@ extern cl_int cl_command_queue_ND_range(cl_command_queue queue,
                                         const size_t *global_wk_sz_use,
                                         const size_t *local_wk_sz,
                                         const size_t *local_wk_sz_use);
+/* Same, with up to CL_GPGPU_MAX_DISPATCH sub-ranges run in one batch */
+extern cl_int cl_command_queue_ND_range_walkers(cl_command_queue queue,
+                                                cl_kernel ker,
+                                                cl_event event,
+                                                const uint32_t work_dim,
+                                                const size_t *global_wk_off,
+                                                const size_t *global_wk_sz,
+                                                const size_t *local_wk_sz,
+                                                const cl_ndrange_walker *walkers,
+                                                uint32_t walker_n);
 
 /* The memory object where to report the performance */
 extern cl_int cl_command_queue_set_report_buffer(cl_command_queue, cl_mem);
 /* Flush for the specified gpgpu */
 extern int cl_command_queue_flush_gpgpu(cl_gpgpu);
+/* Submit the batch of gpgpu, possibly held to be chained with the next ones.
+ * seq is 0 if it was flushed at once. Otherwise *status is set once the
+ * chain is submitted, a failed submission fails every batch of the chain */
+extern cl_int cl_command_queue_submit_gpgpu(cl_command_queue, cl_gpgpu, cl_ulong *seq, cl_int *status);
+/* Submit the batches held by the queue */
+extern cl_int cl_command_queue_submit_chain(cl_command_queue);
+/* Hold the batches of the following launches, until the matching release
+ * submits them all at once */
+extern void cl_command_queue_hold_chain(cl_command_queue);
+extern cl_int cl_command_queue_release_chain(cl_command_queue);
+/* Make sure the batch held with seq is submitted, after the coalescing delay,
+ * and return the status of its submission */
+extern cl_int cl_command_queue_wait_chain(cl_command_queue, cl_ulong seq, const cl_int *status);
+/* Batch submissions and NDRange batches they carried */
+extern void cl_command_queue_get_submit_stats(cl_command_queue, cl_ulong stats[2]);
+/* Get the copies and fills done on the host and by a kernel */
+extern void cl_command_queue_get_host_path_stats(cl_command_queue, cl_ulong stats[4]);
 /* Bind all the surfaces in the GPGPU state */
 extern cl_int cl_command_queue_bind_surface(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 /* Bind all the image surfaces in the GPGPU state */
 extern cl_int cl_command_queue_bind_image(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 /* Bind all exec info to bind table */
 extern cl_int cl_command_queue_bind_exec_info(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
+/* Pin the slabs of the buffer arguments for the batch of the event */
+extern cl_int cl_command_queue_pin_slabs(cl_command_queue, cl_kernel, cl_event);
+
+/* Get a gpgpu state from the queue pool, a new one if none has retired */
+extern cl_gpgpu cl_gpgpu_pool_get(cl_gpgpu_pool);
+/* Give back a state got from the pool (NULL only drops the reference) */
+extern void cl_gpgpu_pool_put(cl_gpgpu_pool, cl_gpgpu);
+/* Reused and allocated states of the pool */
+extern void cl_gpgpu_pool_get_stats(cl_gpgpu_pool, cl_ulong stats[2]);
+/* Reused and allocated scratch, stack and printf buffers of the states */
+extern void cl_gpgpu_pool_get_bo_cache_stats(cl_gpgpu_pool, cl_ulong stats[2]);
 
 /* Insert a user event to command's wait_events */
 extern void cl_command_queue_insert_event(cl_command_queue, cl_event);
@@ -95,7 +196,8 @@ extern void cl_command_queue_insert_event(cl_command_queue, cl_event);
 extern void cl_command_queue_remove_event(cl_command_queue, cl_event);
 extern void cl_command_queue_insert_barrier_event(cl_command_queue queue, cl_event event);
 extern void cl_command_queue_remove_barrier_event(cl_command_queue queue, cl_event event);
-extern void cl_command_queue_notify(cl_command_queue queue);
+/* The last event the enqueued event depends on completed */
+extern void cl_command_queue_event_ready(cl_command_queue queue, cl_event event);
 extern void cl_command_queue_enqueue_event(cl_command_queue queue, cl_event event);
 extern cl_int cl_command_queue_init_enqueue(cl_command_queue queue);
 extern void cl_command_queue_destroy_enqueue(cl_command_queue queue);
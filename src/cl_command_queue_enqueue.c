@@ -20,19 +20,55 @@
 #include "cl_command_queue.h"
 #include "cl_event.h"
 #include "cl_alloc.h"
+#include "cl_host_worker.h"
 #include <stdio.h>
 
+/* Host side commands, which do not wait for a GPU batch */
+static cl_bool
+cl_event_is_host_command(cl_event e)
+{
+  return e->exec_data.gpgpu == NULL &&
+         e->exec_data.type != EnqueueMarker &&
+         e->exec_data.type != EnqueueBarrier &&
+         e->exec_data.type != EnqueueReturnSuccesss;
+}
+
+/* Run by the host worker pool: execute the command and retire it */
+static void
+cl_command_queue_run_host_event(cl_host_job job)
+{
+  cl_event e = list_entry(job, _cl_event, host_job);
+  cl_command_queue queue = e->queue;
+
+  cl_event_exec(e, CL_COMPLETE, CL_FALSE);
+
+  CL_OBJECT_LOCK(queue);
+  list_node_del(&e->enqueue_node);
+  CL_OBJECT_UNLOCK(queue);
+  cl_event_delete(e);
+
+  /* The queue may be destroyed once the last one retired */
+  CL_OBJECT_LOCK(queue);
+  queue->worker.host_running--;
+  CL_OBJECT_NOTIFY_COND(queue);
+  CL_OBJECT_UNLOCK(queue);
+}
+
 static void *
 worker_thread_function(void *Arg)
 {
   cl_command_queue_enqueue_worker worker = (cl_command_queue_enqueue_worker)Arg;
   cl_command_queue queue = worker->queue;
   cl_event e;
-  cl_uint cookie = -1;
   list_node *pos;
   list_node *n;
   list_head ready_list;
+  list_head host_list;
   cl_int exec_status;
+  cl_bool use_host_worker = CL_FALSE;
+
+  if (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+    use_host_worker = cl_host_worker_get_n() > 0;
 
   CL_OBJECT_LOCK(queue);
 
@@ -44,34 +80,49 @@ worker_thread_function(void *Arg)
       return NULL;
     }
 
-    if (list_empty(&worker->enqueued_events)) {
-      CL_OBJECT_WAIT_ON_COND(queue);
-      continue;
-    }
-
-    /* The cookie will change when event status change or something happend to
-       this command queue. If we already checked the event list and do not find
-       anything to exec, we need to wait the cookie update, to avoid loop for ever. */
-    if (cookie == worker->cookie) {
-      CL_OBJECT_WAIT_ON_COND(queue);
-      continue;
-    }
-
-    /* Here we hold lock to check event status, to avoid missing the status notify*/
+    /* Here we hold lock to take the ready events, to avoid missing the ready
+       notify. Events become ready when the last event they depend on completes,
+       see cl_command_queue_event_ready. */
     list_init(&ready_list);
-    list_for_each_safe(pos, n, &worker->enqueued_events)
-    {
-      e = list_entry(pos, _cl_event, enqueue_node);
-      if (cl_event_is_ready(e) <= CL_COMPLETE) {
+    list_init(&host_list);
+    if (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+      list_for_each_safe(pos, n, &worker->ready_events)
+      {
+        e = list_entry(pos, _cl_event, ready_node);
+        list_node_del(&e->ready_node);
+        if (use_host_worker && cl_event_is_host_command(e)) {
+          /* Stays visible to finish and markers until the pool retires it */
+          list_node_del(&e->enqueue_node);
+          list_add_tail(&worker->host_events, &e->enqueue_node);
+          list_add_tail(&host_list, &e->host_job.node);
+          worker->host_running++;
+          continue;
+        }
+        list_node_del(&e->enqueue_node);
+        list_add_tail(&ready_list, &e->enqueue_node);
+      }
+    } else {
+      list_for_each_safe(pos, n, &worker->enqueued_events)
+      {
+        e = list_entry(pos, _cl_event, enqueue_node);
+        if (atomic_read(&e->pending_n) > 0)
+          break; /* in in-order mode, can't skip over non-ready events */
         list_node_del(&e->enqueue_node);
         list_add_tail(&ready_list, &e->enqueue_node);
-      } else if(!(queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)){
-        break; /* in in-order mode, can't skip over non-ready events */
       }
     }
 
+    /* Host commands overlap with the GPU work of the queue */
+    list_for_each_safe(pos, n, &host_list)
+    {
+      e = list_entry(pos, _cl_event, host_job.node);
+      list_node_del(&e->host_job.node);
+      e->host_job.run = cl_command_queue_run_host_event;
+      cl_host_worker_submit(&e->host_job);
+    }
+
     if (list_empty(&ready_list)) { /* Nothing to do, just wait. */
-      cookie = worker->cookie;
+      CL_OBJECT_WAIT_ON_COND(queue);
       continue;
     }
 
@@ -119,31 +170,47 @@ worker_thread_function(void *Arg)
   }
 }
 
-LOCAL void
-cl_command_queue_notify(cl_command_queue queue)
+/* Must be called with the queue's lock. Both the enqueue and the completion
+   of the last dependency may find the event ready, it is pushed once. */
+static void
+cl_command_queue_push_ready(cl_command_queue queue, cl_event event)
 {
-  if (CL_OBJECT_GET_REF(queue) < 1) {
-    return;
+  if (queue->props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+    if (event->in_ready)
+      return;
+    event->in_ready = CL_TRUE;
+    list_add_tail(&queue->worker.ready_events, &event->ready_node);
   }
+  /* In order, the worker only looks at the head of the enqueued list */
+  CL_OBJECT_NOTIFY_COND(queue);
+}
 
+LOCAL void
+cl_command_queue_event_ready(cl_command_queue queue, cl_event event)
+{
   assert(queue && (((cl_base_object)queue)->magic == CL_OBJECT_COMMAND_QUEUE_MAGIC));
   CL_OBJECT_LOCK(queue);
-  queue->worker.cookie++;
-  CL_OBJECT_NOTIFY_COND(queue);
+  /* If not enqueued yet, cl_command_queue_enqueue_event will push it */
+  if (!list_node_out_of_list(&event->enqueue_node))
+    cl_command_queue_push_ready(queue, event);
   CL_OBJECT_UNLOCK(queue);
 }
 
 LOCAL void
 cl_command_queue_enqueue_event(cl_command_queue queue, cl_event event)
 {
+  /* Host commands wait for the batches before them anyway */
+  if (event->exec_data.gpgpu == NULL)
+    cl_command_queue_submit_chain(queue);
+
   CL_OBJECT_INC_REF(event);
   assert(CL_OBJECT_IS_COMMAND_QUEUE(queue));
   CL_OBJECT_LOCK(queue);
   assert(queue->worker.quit == CL_FALSE);
   assert(list_node_out_of_list(&event->enqueue_node));
   list_add_tail(&queue->worker.enqueued_events, &event->enqueue_node);
-  queue->worker.cookie++;
-  CL_OBJECT_NOTIFY_COND(queue);
+  if (atomic_read(&event->pending_n) == 0)
+    cl_command_queue_push_ready(queue, event);
   CL_OBJECT_UNLOCK(queue);
 }
 
@@ -154,8 +221,10 @@ cl_command_queue_init_enqueue(cl_command_queue queue)
   worker->queue = queue;
   worker->quit = CL_FALSE;
   worker->in_exec_status = CL_COMPLETE;
-  worker->cookie = 8;
   list_init(&worker->enqueued_events);
+  list_init(&worker->ready_events);
+  list_init(&worker->host_events);
+  worker->host_running = 0;
 
   if (pthread_create(&worker->tid, NULL, worker_thread_function, worker)) {
     DEBUGP(DL_ERROR, "Can not create worker thread for queue %p...\n", queue);
@@ -183,6 +252,12 @@ cl_command_queue_destroy_enqueue(cl_command_queue queue)
 
   pthread_join(worker->tid, NULL);
 
+  /* The host commands given to the pool still reference the queue */
+  CL_OBJECT_LOCK(queue);
+  while (worker->host_running > 0)
+    CL_OBJECT_WAIT_ON_COND(queue);
+  CL_OBJECT_UNLOCK(queue);
+
   /* We will wait for finish before destroy the command queue. */
   if (!list_empty(&worker->enqueued_events)) {
     DEBUGP(DL_WARNING, "There are still some enqueued works in the queue %p when this"
@@ -193,6 +268,8 @@ cl_command_queue_destroy_enqueue(cl_command_queue queue)
     {
       e = list_entry(pos, _cl_event, enqueue_node);
       list_node_del(&e->enqueue_node);
+      if (!list_node_out_of_list(&e->ready_node))
+        list_node_del(&e->ready_node);
       cl_event_set_status(e, -1); // Give waiters a chance to wakeup.
       cl_event_delete(e);
     }
@@ -214,6 +291,10 @@ cl_command_queue_record_in_queue_events(cl_command_queue queue, cl_uint *list_nu
   {
     event_num++;
   }
+  list_for_each(pos, &worker->host_events)
+  {
+    event_num++;
+  }
   assert(event_num > 0);
 
   enqueued_list = cl_calloc(event_num, sizeof(cl_event));
@@ -227,6 +308,13 @@ cl_command_queue_record_in_queue_events(cl_command_queue queue, cl_uint *list_nu
     enqueued_list[i] = tmp_e;
     i++;
   }
+  list_for_each(pos, &worker->host_events)
+  {
+    tmp_e = list_entry(pos, _cl_event, enqueue_node);
+    cl_event_add_ref(tmp_e);
+    enqueued_list[i] = tmp_e;
+    i++;
+  }
   assert(i == event_num);
 
   *list_num = event_num;
@@ -241,6 +329,8 @@ cl_command_queue_wait_flush(cl_command_queue queue)
   cl_uint enqueued_num = 0;
   int i;
 
+  cl_command_queue_submit_chain(queue);
+
   CL_OBJECT_LOCK(queue);
 
   if (worker->quit) { // already destroy the queue?
@@ -248,7 +338,7 @@ cl_command_queue_wait_flush(cl_command_queue queue)
     return CL_INVALID_COMMAND_QUEUE;
   }
 
-  if (!list_empty(&worker->enqueued_events)) {
+  if (!list_empty(&worker->enqueued_events) || !list_empty(&worker->host_events)) {
     enqueued_list = cl_command_queue_record_in_queue_events(queue, &enqueued_num);
     assert(enqueued_num > 0);
     assert(enqueued_list);
@@ -269,7 +359,7 @@ cl_command_queue_wait_flush(cl_command_queue queue)
   for (i = 0; i < enqueued_num; i++) {
     CL_OBJECT_LOCK(enqueued_list[i]);
     while (enqueued_list[i]->status > CL_SUBMITTED) {
-      CL_OBJECT_WAIT_ON_COND(enqueued_list[i]);
+      CL_EVENT_WAIT_ON_COND(enqueued_list[i]);
     }
     CL_OBJECT_UNLOCK(enqueued_list[i]);
   }
@@ -291,6 +381,8 @@ cl_command_queue_wait_finish(cl_command_queue queue)
   cl_uint enqueued_num = 0;
   int i;
 
+  cl_command_queue_submit_chain(queue);
+
   CL_OBJECT_LOCK(queue);
 
   if (worker->quit) { // already destroy the queue?
@@ -298,7 +390,7 @@ cl_command_queue_wait_finish(cl_command_queue queue)
     return CL_INVALID_COMMAND_QUEUE;
   }
 
-  if (!list_empty(&worker->enqueued_events)) {
+  if (!list_empty(&worker->enqueued_events) || !list_empty(&worker->host_events)) {
     enqueued_list = cl_command_queue_record_in_queue_events(queue, &enqueued_num);
     assert(enqueued_num > 0);
     assert(enqueued_list);
@@ -319,7 +411,7 @@ cl_command_queue_wait_finish(cl_command_queue queue)
   for (i = 0; i < enqueued_num; i++) {
     CL_OBJECT_LOCK(enqueued_list[i]);
     while (enqueued_list[i]->status > CL_COMPLETE) {
-      CL_OBJECT_WAIT_ON_COND(enqueued_list[i]);
+      CL_EVENT_WAIT_ON_COND(enqueued_list[i]);
     }
     CL_OBJECT_UNLOCK(enqueued_list[i]);
   }
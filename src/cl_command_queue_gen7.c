@@ -39,90 +39,197 @@ static INLINE size_t cl_kernel_compute_batch_sz(cl_kernel k) { return 256+256; }
 /* "Varing" payload is the part of the curbe that changes accross threads in the
  *  same work group. Right now, it consists in local IDs and block IPs
  */
-static cl_int
-cl_set_varying_payload(const cl_kernel ker,
+typedef struct cl_varying_offsets {
+  int32_t id[3];
+  int32_t ip;
+  int32_t dw_ip;
+  int32_t tid;
+} cl_varying_offsets;
+
+static void
+cl_get_varying_offsets(const cl_kernel ker, cl_varying_offsets *off)
+{
+  off->id[0] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_X, 0);
+  off->id[1] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Y, 0);
+  off->id[2] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Z, 0);
+  off->ip = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_BLOCK_IP, 0);
+  off->tid = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_THREAD_ID, 0);
+  off->dw_ip = -1;
+  if (off->ip < 0)
+    off->dw_ip = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_DW_BLOCK_IP, 0);
+  assert(off->ip < 0 || off->dw_ip < 0);
+  assert(off->ip >= 0 || off->dw_ip >= 0);
+}
+
+/* Lanes are walked in x, y, z order with running counters. Each run of lanes
+ * staying on the same row is written with plain loops the compiler turns
+ * into vector stores; the lanes past the work group are disabled */
+static void
+cl_set_varying_payload(const cl_varying_offsets *off,
                        char *data,
                        const size_t *local_wk_sz,
                        size_t simd_sz,
                        size_t cst_sz,
                        size_t thread_n)
 {
-  uint32_t *ids[3] = {NULL,NULL,NULL};
-  uint16_t *block_ips = NULL;
-  uint32_t *thread_ids = NULL;
-  size_t i, j, k, curr = 0;
-  int32_t id_offset[3], ip_offset, tid_offset;
-  cl_int err = CL_SUCCESS;
-  int32_t dw_ip_offset = -1;
-
-  id_offset[0] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_X, 0);
-  id_offset[1] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Y, 0);
-  id_offset[2] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Z, 0);
-  ip_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_BLOCK_IP, 0);
-  tid_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_THREAD_ID, 0);
-  if (ip_offset < 0)
-    dw_ip_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_DW_BLOCK_IP, 0);
-  assert(ip_offset < 0 || dw_ip_offset < 0);
-  assert(ip_offset >= 0 || dw_ip_offset >= 0);
-
-  if (id_offset[0] >= 0)
-    TRY_ALLOC(ids[0], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  if (id_offset[1] >= 0)
-    TRY_ALLOC(ids[1], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  if (id_offset[2] >= 0)
-    TRY_ALLOC(ids[2], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  TRY_ALLOC(block_ips, (uint16_t*) alloca(sizeof(uint16_t)*thread_n*simd_sz));
-  if (tid_offset >= 0) {
-    TRY_ALLOC(thread_ids, (uint32_t*) alloca(sizeof(uint32_t)*thread_n));
-    memset(thread_ids, 0, sizeof(uint32_t)*thread_n);
+  const size_t local_sz = local_wk_sz[0] * local_wk_sz[1] * local_wk_sz[2];
+  uint32_t x = 0, y = 0, z = 0;
+  size_t t, j, l, run, curr = 0;
+
+  for (t = 0; t < thread_n; ++t, data += cst_sz) {
+    uint32_t *ids0 = off->id[0] >= 0 ? (uint32_t *) (data + off->id[0]) : NULL;
+    uint32_t *ids1 = off->id[1] >= 0 ? (uint32_t *) (data + off->id[1]) : NULL;
+    uint32_t *ids2 = off->id[2] >= 0 ? (uint32_t *) (data + off->id[2]) : NULL;
+    uint16_t *ips = off->ip >= 0 ? (uint16_t *) (data + off->ip) : NULL;
+    uint32_t *dw_ips = off->dw_ip >= 0 ? (uint32_t *) (data + off->dw_ip) : NULL;
+
+    if (off->tid >= 0)
+      *(uint32_t *)(data + off->tid) = t;
+
+    for (j = 0; j < simd_sz; j += run, curr += run) {
+      if (curr >= local_sz) {
+        /* 0xffff means that the lane is inactivated */
+        run = simd_sz - j;
+        for (l = j; l < simd_sz; ++l) {
+          if (ids0) ids0[l] = 0;
+          if (ids1) ids1[l] = 0;
+          if (ids2) ids2[l] = 0;
+          if (ips) ips[l] = 0xffff;
+          if (dw_ips) dw_ips[l] = 0xffff;
+        }
+        break;
+      }
+      run = local_wk_sz[0] - x;
+      if (run > simd_sz - j)
+        run = simd_sz - j;
+      if (ids0)
+        for (l = 0; l < run; ++l) ids0[j + l] = x + l;
+      if (ids1)
+        for (l = 0; l < run; ++l) ids1[j + l] = y;
+      if (ids2)
+        for (l = 0; l < run; ++l) ids2[j + l] = z;
+      if (ips)
+        memset(ips + j, 0, run * sizeof(uint16_t));
+      if (dw_ips)
+        memset(dw_ips + j, 0, run * sizeof(uint32_t));
+      x += run;
+      if (x == local_wk_sz[0]) {
+        x = 0;
+        if (++y == local_wk_sz[1]) {
+          y = 0;
+          ++z;
+        }
+      }
+    }
   }
-  /* 0xffff means that the lane is inactivated */
-  memset(block_ips, 0xff, sizeof(int16_t)*thread_n*simd_sz);
-
-
-  /* Compute the IDs and the block IPs */
-  for (k = 0; k < local_wk_sz[2]; ++k)
-  for (j = 0; j < local_wk_sz[1]; ++j)
-  for (i = 0; i < local_wk_sz[0]; ++i, ++curr) {
-    if (id_offset[0] >= 0)
-      ids[0][curr] = i;
-    if (id_offset[1] >= 0)
-      ids[1][curr] = j;
-    if (id_offset[2] >= 0)
-      ids[2][curr] = k;
-    block_ips[curr] = 0;
-    if (thread_ids)
-      thread_ids[curr/simd_sz] = curr/simd_sz;
+}
+
+static void
+cl_mark_varying(uint64_t *mask, int32_t offset, size_t size)
+{
+  if (offset >= 0)
+    memset((char *) mask + offset, 0xff, size);
+}
+
+/* Build the CURBEs of all the threads of a work group from scratch */
+static cl_int
+cl_build_thread_payload(const cl_kernel ker, cl_thread_payload *p)
+{
+  const size_t cst_sz = p->cst_sz, simd_sz = p->simd_sz;
+  cl_varying_offsets off;
+  size_t i;
+
+  TRY_ALLOC_NO_ERR(p->data, cl_aligned_malloc(p->thread_n * cst_sz, 64));
+  TRY_ALLOC_NO_ERR(p->curbe, cl_malloc(cst_sz));
+  TRY_ALLOC_NO_ERR(p->mask, cl_calloc(1, cst_sz));
+
+  cl_get_varying_offsets(ker, &off);
+  for (i = 0; i < 3; ++i)
+    cl_mark_varying(p->mask, off.id[i], simd_sz * sizeof(uint32_t));
+  cl_mark_varying(p->mask, off.ip, simd_sz * sizeof(uint16_t));
+  cl_mark_varying(p->mask, off.dw_ip, simd_sz * sizeof(uint32_t));
+  cl_mark_varying(p->mask, off.tid, sizeof(uint32_t));
+
+  memcpy(p->curbe, ker->curbe, cst_sz);
+  for (i = 0; i < p->thread_n; ++i)
+    memcpy(p->data + cst_sz * i, ker->curbe, cst_sz);
+  cl_set_varying_payload(&off, p->data, p->local_wk_sz, simd_sz, cst_sz, p->thread_n);
+  return CL_SUCCESS;
+
+error:
+  return CL_OUT_OF_HOST_MEMORY;
+}
+
+/* Copy into every thread CURBE the uniform bytes changed since the last
+ * launch. The comparison is done per register, and only the registers that
+ * differ are merged, leaving the varying bytes untouched */
+static void
+cl_patch_thread_payload(const cl_kernel ker, cl_thread_payload *p)
+{
+  const size_t word_n = p->cst_sz / sizeof(uint64_t);
+  const size_t reg_words = 32 / sizeof(uint64_t);
+  const uint64_t *src = (const uint64_t *) ker->curbe;
+  uint64_t *old = (uint64_t *) p->curbe;
+  size_t w, t, k;
+
+  for (w = 0; w < word_n; w += reg_words) {
+    const size_t n = word_n - w < reg_words ? word_n - w : reg_words;
+    if (memcmp(src + w, old + w, n * sizeof(uint64_t)) == 0)
+      continue;
+    for (t = 0; t < p->thread_n; ++t) {
+      uint64_t *dst = (uint64_t *) (p->data + p->cst_sz * t) + w;
+      for (k = 0; k < n; ++k)
+        dst[k] = (dst[k] & p->mask[w + k]) | (src[w + k] & ~p->mask[w + k]);
+    }
+    memcpy(old + w, src + w, n * sizeof(uint64_t));
   }
+}
 
-  /* Copy them to the curbe buffer */
-  curr = 0;
-  for (i = 0; i < thread_n; ++i, data += cst_sz) {
-    uint32_t *ids0 = (uint32_t *) (data + id_offset[0]);
-    uint32_t *ids1 = (uint32_t *) (data + id_offset[1]);
-    uint32_t *ids2 = (uint32_t *) (data + id_offset[2]);
-    uint16_t *ips  = (uint16_t *) (data + ip_offset);
-    uint32_t *dw_ips  = (uint32_t *) (data + dw_ip_offset);
-
-    if (thread_ids)
-      *(uint32_t *)(data + tid_offset) = thread_ids[i];
-
-    for (j = 0; j < simd_sz; ++j, ++curr) {
-      if (id_offset[0] >= 0)
-        ids0[j] = ids[0][curr];
-      if (id_offset[1] >= 0)
-        ids1[j] = ids[1][curr];
-      if (id_offset[2] >= 0)
-        ids2[j] = ids[2][curr];
-      if (ip_offset >= 0)
-        ips[j] = block_ips[curr];
-      if (dw_ip_offset >= 0)
-        dw_ips[j] = block_ips[curr];
+/* Get the CURBEs of all the threads for this launch. They are cached per
+ * local size so a repeated launch only pays for the uniform values that
+ * changed. The caller holds the kernel lock and copies the data out before
+ * releasing it, another launch may patch or replace the slot afterwards */
+static const char *
+cl_get_thread_payload(cl_kernel ker,
+                      const size_t *local_wk_sz,
+                      size_t simd_sz,
+                      size_t cst_sz,
+                      size_t thread_n)
+{
+  cl_thread_payload *p = NULL;
+  uint32_t i;
+
+  assert(cst_sz % sizeof(uint64_t) == 0);
+  for (i = 0; i < CL_KERNEL_PAYLOAD_CACHE_SIZE; ++i) {
+    p = &ker->payloads[i];
+    if (p->data && p->simd_sz == simd_sz && p->cst_sz == cst_sz &&
+        p->local_wk_sz[0] == local_wk_sz[0] && p->local_wk_sz[1] == local_wk_sz[1] &&
+        p->local_wk_sz[2] == local_wk_sz[2]) {
+      assert(p->thread_n == thread_n);
+      cl_patch_thread_payload(ker, p);
+      return p->data;
     }
   }
 
-error:
-  return err;
+  /* Miss: replace the slots in turn */
+  p = &ker->payloads[ker->payload_next];
+  ker->payload_next = (ker->payload_next + 1) % CL_KERNEL_PAYLOAD_CACHE_SIZE;
+  if (p->data) cl_free(p->data);
+  if (p->curbe) cl_free(p->curbe);
+  if (p->mask) cl_free(p->mask);
+  memset(p, 0, sizeof(*p));
+  memcpy(p->local_wk_sz, local_wk_sz, sizeof(p->local_wk_sz));
+  p->simd_sz = simd_sz;
+  p->cst_sz = cst_sz;
+  p->thread_n = thread_n;
+  if (cl_build_thread_payload(ker, p) != CL_SUCCESS) {
+    if (p->data) cl_free(p->data);
+    if (p->curbe) cl_free(p->curbe);
+    if (p->mask) cl_free(p->mask);
+    memset(p, 0, sizeof(*p));
+    return NULL;
+  }
+  return p->data;
 }
 
 static int
@@ -204,10 +311,9 @@ cl_upload_constant_buffer(cl_command_queue queue, cl_kernel ker, cl_gpgpu gpgpu)
         continue;
       *(uint32_t *) (ker->curbe + curbe_offset) = offset;
 
-      cl_buffer_map(mem->bo, 1);
-      void * addr = cl_buffer_get_virtual(mem->bo);
+      void * addr = cl_mem_map(mem, 1);
       memcpy(cst_addr + offset, addr, mem->size);
-      cl_buffer_unmap(mem->bo);
+      cl_mem_unmap(mem);
       offset += mem->size;
     }
   }
@@ -354,30 +460,38 @@ cl_alloc_printf(cl_gpgpu gpgpu, cl_kernel ker, void* printf_info, int printf_num
 
 LOCAL cl_int
 cl_command_queue_ND_range_gen7(cl_command_queue queue,
-                               cl_kernel ker,
+                               cl_kernel user_ker,
                                cl_event event,
                                const uint32_t work_dim,
                                const size_t *global_wk_off,
-                               const size_t *global_dim_off,
                                const size_t *global_wk_sz,
-                               const size_t *global_wk_sz_use,
                                const size_t *local_wk_sz,
-                               const size_t *local_wk_sz_use)
+                               const cl_ndrange_walker *walkers,
+                               uint32_t walker_n)
 {
-  cl_gpgpu gpgpu = cl_gpgpu_new(queue->ctx->drv);
+  /* Run the SIMD width that best fits the main sub-range when both were
+   * compiled. The remainders are run at the same width */
+  cl_kernel ker = cl_kernel_select_simd_variant(user_ker, queue->ctx->devices[0],
+                                                walkers[0].global_wk_sz_use,
+                                                walkers[0].local_wk_sz_use);
+  cl_gpgpu gpgpu = NULL;
   cl_context ctx = queue->ctx;
-  char *final_curbe = NULL;  /* Includes them and one sub-buffer per group */
-  cl_gpgpu_kernel kernel;
+  const char *final_curbe = NULL;  /* Includes them and one sub-buffer per group */
+  cl_gpgpu_kernel kernels[CL_GPGPU_MAX_DISPATCH];
+  size_t thread_n[CL_GPGPU_MAX_DISPATCH];
   const uint32_t simd_sz = cl_kernel_get_simd_width(ker);
-  size_t i, batch_sz = 0u, local_sz = 0u;
+  size_t batch_sz = 0u, local_sz = 0u, main_local_sz = 0u;
   size_t cst_sz = interp_kernel_get_curbe_size(ker->opaque);
   int32_t scratch_sz = interp_kernel_get_scratch_size(ker->opaque);
-  size_t thread_n = 0u;
   int printf_num = 0;
   cl_int err = CL_SUCCESS;
   size_t global_size = global_wk_sz[0] * global_wk_sz[1] * global_wk_sz[2];
   void* printf_info = NULL;
   uint32_t max_bti = 0;
+  uint32_t w;
+
+  assert(walker_n >= 1 && walker_n <= CL_GPGPU_MAX_DISPATCH);
+  atomic_inc(&user_ker->simd_launch_n[simd_sz == 16 ? 1 : 0]);
 
   if (ker->exec_info_n > 0) {
     cst_sz += ker->exec_info_n * sizeof(void *);
@@ -386,36 +500,43 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   }
   ker->curbe_sz = cst_sz;
 
-  /* Setup kernel */
-  kernel.name = interp_kernel_get_name(ker->opaque);
-  kernel.grf_blocks = 128;
-  kernel.bo = ker->bo;
-  kernel.barrierID = 0;
-  kernel.slm_sz = 0;
-  kernel.use_slm = interp_kernel_use_slm(ker->opaque);
-
-  /* Compute the number of HW threads we need */
-  if(UNLIKELY(err = cl_kernel_work_group_sz(ker, local_wk_sz_use, 3, &local_sz) != CL_SUCCESS)) {
-    DEBUGP(DL_ERROR, "Work group size exceed Kernel's work group size.");
-    return err;
-  }
-  kernel.thread_n = thread_n = (local_sz + simd_sz - 1) / simd_sz;
-  kernel.curbe_sz = cst_sz;
-
   if (scratch_sz > ker->program->ctx->devices[0]->scratch_mem_size) {
     DEBUGP(DL_ERROR, "Out of scratch memory %d.", scratch_sz);
     return CL_OUT_OF_RESOURCES;
   }
-  /* Curbe step 1: fill the constant urb buffer data shared by all threads */
-  if (ker->curbe) {
-    kernel.slm_sz = cl_curbe_fill(ker, work_dim, global_wk_off, global_wk_sz,local_wk_sz_use ,local_wk_sz, thread_n);
-    if (kernel.slm_sz > ker->program->ctx->devices[0]->local_mem_size) {
-      DEBUGP(DL_ERROR, "Out of shared local memory %d.", kernel.slm_sz);
-      return CL_OUT_OF_RESOURCES;
+
+  /* Setup one kernel per walker, they only differ by their local size */
+  for (w = 0; w < walker_n; ++w) {
+    cl_gpgpu_kernel *kernel = &kernels[w];
+    kernel->name = interp_kernel_get_name(ker->opaque);
+    kernel->grf_blocks = 128;
+    kernel->bo = ker->bo;
+    kernel->barrierID = 0;
+    kernel->slm_sz = 0;
+    kernel->use_slm = interp_kernel_use_slm(ker->opaque);
+
+    /* Compute the number of HW threads we need */
+    if(UNLIKELY(err = cl_kernel_work_group_sz(ker, walkers[w].local_wk_sz_use, 3, &local_sz) != CL_SUCCESS)) {
+      DEBUGP(DL_ERROR, "Work group size exceed Kernel's work group size.");
+      return err;
     }
+    if (w == 0)
+      main_local_sz = local_sz;
+    kernel->thread_n = thread_n[w] = (local_sz + simd_sz - 1) / simd_sz;
+    kernel->curbe_sz = cst_sz;
   }
 
+  /* Reuse a retired state of this queue when there is one */
+  gpgpu = cl_gpgpu_pool_get(queue->gpgpu_pool);
+  if (gpgpu == NULL)
+    return CL_OUT_OF_HOST_MEMORY;
+  /* A recycled state still knows the kernel of its previous launch */
+  cl_gpgpu_set_kernel(gpgpu, NULL);
+  cl_gpgpu_set_dispatch_n(gpgpu, walker_n);
+
   printf_info = interp_dup_printfset(ker->opaque);
+  if (printf_info && ctx->props.printf_callback)
+    interp_set_printf_output(printf_info, cl_context_printf_output, ctx);
   cl_gpgpu_set_printf_info(gpgpu, printf_info);
 
   /* Setup the kernel */
@@ -431,7 +552,7 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
       goto error;
   }
   if (interp_get_profiling_bti(ker->opaque) != 0) {
-    if (cl_bind_profiling(gpgpu, simd_sz, ker, global_size, local_sz, interp_get_profiling_bti(ker->opaque)))
+    if (cl_bind_profiling(gpgpu, simd_sz, ker, global_size, main_local_sz, interp_get_profiling_bti(ker->opaque)))
       goto error;
     cl_gpgpu_set_profiling_info(gpgpu, interp_dup_profiling(ker->opaque));
   } else {
@@ -441,12 +562,14 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   /* Bind user buffers */
   cl_command_queue_bind_surface(queue, ker, gpgpu, &max_bti);
   /* Bind user images */
-  if(UNLIKELY(err = cl_command_queue_bind_image(queue, ker, gpgpu, &max_bti) != CL_SUCCESS))
+  if(UNLIKELY(err = cl_command_queue_bind_image(queue, ker, gpgpu, &max_bti) != CL_SUCCESS)) {
+    cl_gpgpu_pool_put(queue->gpgpu_pool, gpgpu);
     return err;
+  }
   /* Bind all exec infos */
   cl_command_queue_bind_exec_info(queue, ker, gpgpu, &max_bti);
   /* Bind device enqueue buffer */
-  cl_device_enqueue_bind_buffer(gpgpu, ker, &max_bti, &kernel);
+  cl_device_enqueue_bind_buffer(gpgpu, ker, &max_bti, &kernels[0]);
   /* Bind all samplers */
   if (ker->vme)
     cl_gpgpu_bind_vme_state(gpgpu, ker->accel);
@@ -462,40 +585,75 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   if (cl_upload_constant_buffer(queue, ker, gpgpu) != 0)
     goto error;
 
-  cl_gpgpu_states_setup(gpgpu, &kernel);
+  /* Surfaces, samplers, scratch and constants are shared. Every walker gets
+   * its own CURBE and interface descriptor */
+  for (w = 0; w < walker_n; ++w) {
+    cl_gpgpu_select_dispatch(gpgpu, w);
+
+    /* The CURBE and the payload cache of the kernel are shared by every
+     * launch of it, they are only used under the kernel lock until the
+     * payload is copied into the batch */
+    CL_OBJECT_LOCK(ker);
+
+    /* Curbe step 1: fill the constant urb buffer data shared by all threads */
+    if (ker->curbe) {
+      kernels[w].slm_sz = cl_curbe_fill(ker, work_dim, global_wk_off, global_wk_sz,
+                                        walkers[w].local_wk_sz_use, local_wk_sz, thread_n[w]);
+      if (kernels[w].slm_sz > ker->program->ctx->devices[0]->local_mem_size) {
+        DEBUGP(DL_ERROR, "Out of shared local memory %d.", kernels[w].slm_sz);
+        CL_OBJECT_UNLOCK(ker);
+        goto error;
+      }
+    }
 
-  /* Curbe step 2. Give the localID and upload it to video memory */
-  if (ker->curbe) {
-    assert(cst_sz > 0);
-    TRY_ALLOC (final_curbe, (char*) alloca(thread_n * cst_sz));
-    for (i = 0; i < thread_n; ++i) {
-        memcpy(final_curbe + cst_sz * i, ker->curbe, cst_sz);
+    if (cl_gpgpu_states_setup(gpgpu, &kernels[w]) != 0) {
+      CL_OBJECT_UNLOCK(ker);
+      goto error;
+    }
+
+    /* Curbe step 2. Give the localID and upload it to video memory */
+    err = CL_SUCCESS;
+    if (ker->curbe) {
+      assert(cst_sz > 0);
+      final_curbe = cl_get_thread_payload(ker, walkers[w].local_wk_sz_use, simd_sz, cst_sz, thread_n[w]);
+      if (final_curbe == NULL ||
+          cl_gpgpu_upload_curbes(gpgpu, final_curbe, thread_n[w]*cst_sz) != 0)
+        err = CL_OUT_OF_RESOURCES;
     }
-    TRY (cl_set_varying_payload, ker, final_curbe, local_wk_sz_use, simd_sz, cst_sz, thread_n);
-    if (cl_gpgpu_upload_curbes(gpgpu, final_curbe, thread_n*cst_sz) != 0)
+    CL_OBJECT_UNLOCK(ker);
+    if (err != CL_SUCCESS)
       goto error;
   }
 
   /* Start a new batch buffer */
-  batch_sz = cl_kernel_compute_batch_sz(ker);
+  batch_sz = cl_kernel_compute_batch_sz(ker) * walker_n;
+  cl_gpgpu_select_dispatch(gpgpu, 0);
   if (cl_gpgpu_batch_reset(gpgpu, batch_sz) != 0)
     goto error;
   //cl_set_thread_batch_buf(queue, cl_gpgpu_ref_batch_buf(gpgpu));
   cl_gpgpu_batch_start(gpgpu);
 
-  /* Issue the GPGPU_WALKER command */
-  cl_gpgpu_walker(gpgpu, simd_sz, thread_n, global_wk_off,global_dim_off, global_wk_sz_use, local_wk_sz_use);
+  /* Issue one GPGPU_WALKER command per sub-range */
+  for (w = 0; w < walker_n; ++w) {
+    cl_gpgpu_select_dispatch(gpgpu, w);
+    cl_gpgpu_walker(gpgpu, simd_sz, thread_n[w], global_wk_off, walkers[w].global_dim_off,
+                    walkers[w].global_wk_sz_use, walkers[w].local_wk_sz_use);
+  }
 
   /* Close the batch buffer and submit it */
   cl_gpgpu_batch_end(gpgpu, 0);
 
+  if (cl_command_queue_pin_slabs(queue, ker, event) != CL_SUCCESS)
+    goto error;
   event->exec_data.queue = queue;
   event->exec_data.gpgpu = gpgpu;
+  event->exec_data.gpgpu_pool = queue->gpgpu_pool;
   event->exec_data.type = EnqueueNDRangeKernel;
 
   return CL_SUCCESS;
 
 error:
+  cl_gpgpu_pool_put(queue->gpgpu_pool, gpgpu);
   /* only some command/buffer internal error reach here, so return error code OOR */
   return CL_OUT_OF_RESOURCES;
 }
@@ -39,6 +39,67 @@
 #include <stdint.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
+
+/* Gen binaries of the internal programs, shared by all the contexts of a
+ * device. Only the first context builds an internal program from its LLVM
+ * binary, the others load the code generated for it. Kept until exit. */
+typedef struct cl_internal_binary {
+  cl_device_id device;
+  cl_int index;
+  char *binary;
+  size_t binary_sz;
+  struct cl_internal_binary *next;
+} cl_internal_binary;
+
+static pthread_mutex_t internal_binary_lock = PTHREAD_MUTEX_INITIALIZER;
+static cl_internal_binary *internal_binaries = NULL;
+
+static const char *
+cl_internal_binary_find(cl_device_id device, cl_int index, size_t *size)
+{
+  cl_internal_binary *b;
+  const char *binary = NULL;
+
+  pthread_mutex_lock(&internal_binary_lock);
+  for (b = internal_binaries; b != NULL; b = b->next) {
+    if (b->device == device && b->index == index) {
+      binary = b->binary;
+      *size = b->binary_sz;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&internal_binary_lock);
+  return binary;
+}
+
+static void
+cl_internal_binary_add(cl_device_id device, cl_int index, cl_program p)
+{
+  cl_internal_binary *b;
+  char *binary = NULL;
+  size_t binary_sz;
+
+  if (compiler_program_serialize_to_binary == NULL)
+    return;
+  binary_sz = compiler_program_serialize_to_binary(p->opaque, &binary, 0);
+  if (binary == NULL || binary_sz == 0)
+    return;
+  b = cl_calloc(1, sizeof(cl_internal_binary));
+  if (b == NULL) {
+    free(binary);
+    return;
+  }
+  b->device = device;
+  b->index = index;
+  b->binary = binary;
+  b->binary_sz = binary_sz;
+
+  pthread_mutex_lock(&internal_binary_lock);
+  b->next = internal_binaries;
+  internal_binaries = b;
+  pthread_mutex_unlock(&internal_binary_lock);
+}
 
 LOCAL void
 cl_context_add_queue(cl_context ctx, cl_command_queue queue) {
@@ -46,9 +107,6 @@ cl_context_add_queue(cl_context ctx, cl_command_queue queue) {
   cl_context_add_ref(ctx);
 
   CL_OBJECT_LOCK(ctx);
-  while (ctx->queue_modify_disable) {
-    CL_OBJECT_WAIT_ON_COND(ctx);
-  }
   list_add_tail(&ctx->queues, &queue->base.node);
   ctx->queue_num++;
   CL_OBJECT_UNLOCK(ctx);
@@ -61,9 +119,6 @@ cl_context_remove_queue(cl_context ctx, cl_command_queue queue) {
   assert(queue->ctx == ctx);
 
   CL_OBJECT_LOCK(ctx);
-  while (ctx->queue_modify_disable) {
-    CL_OBJECT_WAIT_ON_COND(ctx);
-  }
   list_node_del(&queue->base.node);
   ctx->queue_num--;
   CL_OBJECT_UNLOCK(ctx);
@@ -72,31 +127,35 @@ cl_context_remove_queue(cl_context ctx, cl_command_queue queue) {
   queue->ctx = NULL;
 }
 
-LOCAL void
+LOCAL cl_int
 cl_context_add_mem(cl_context ctx, cl_mem mem) {
+  cl_int err;
+
   assert(mem->ctx == NULL);
   cl_context_add_ref(ctx);
 
-  CL_OBJECT_LOCK(ctx);
-  list_add_tail(&ctx->mem_objects, &mem->base.node);
-  ctx->mem_object_num++;
-  CL_OBJECT_UNLOCK(ctx);
+  err = cl_mem_registry_add(&ctx->mem_objects, mem);
 
+  /* Even on failure, so that cl_mem_delete can undo the creation */
   mem->ctx = ctx;
+  return err;
 }
 
 LOCAL void
 cl_context_remove_mem(cl_context ctx, cl_mem mem) {
   assert(mem->ctx == ctx);
-  CL_OBJECT_LOCK(ctx);
-  list_node_del(&mem->base.node);
-  ctx->mem_object_num--;
-  CL_OBJECT_UNLOCK(ctx);
+  cl_mem_registry_remove(&ctx->mem_objects, mem);
 
   cl_context_delete(ctx);
   mem->ctx = NULL;
 }
 
+LOCAL cl_int
+cl_context_set_mem_host_ptr(cl_context ctx, cl_mem mem, void *host_ptr) {
+  assert(mem->ctx == ctx);
+  return cl_mem_registry_set_host_ptr(&ctx->mem_objects, mem, host_ptr);
+}
+
 LOCAL void
 cl_context_add_sampler(cl_context ctx, cl_sampler sampler) {
   assert(sampler->ctx == NULL);
@@ -122,29 +181,104 @@ cl_context_remove_sampler(cl_context ctx, cl_sampler sampler) {
   sampler->ctx = NULL;
 }
 
-LOCAL void
-cl_context_add_event(cl_context ctx, cl_event event) {
-  assert(event->ctx == NULL);
-  cl_context_add_ref(ctx);
+static cl_uint
+cl_context_event_shard_index(void)
+{
+  uintptr_t tid = (uintptr_t)pthread_self();
+  return ((tid >> 12) ^ (tid >> 20)) % CL_CONTEXT_EVENT_SHARD_N;
+}
 
-  CL_OBJECT_LOCK(ctx);
-  list_add_tail(&ctx->events, &event->base.node);
-  ctx->event_num++;
-  CL_OBJECT_UNLOCK(ctx);
+LOCAL cl_event
+cl_context_alloc_event(cl_context ctx) {
+  const cl_uint index = cl_context_event_shard_index();
+  _cl_context_event_shard *shard = &ctx->event_shards[index];
+  cl_event event = NULL;
+
+  pthread_mutex_lock(&shard->lock);
+  if (!list_empty(&shard->free_events)) {
+    event = list_entry(shard->free_events.head_node.n, _cl_event, base.node);
+    list_node_del(&event->base.node);
+    shard->free_n--;
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  if (event) {
+    /* Everything but the base object, which keeps its mutex and cond */
+    memset((char *)event + sizeof(_cl_base_object), 0, sizeof(_cl_event) - sizeof(_cl_base_object));
+    CL_OBJECT_REUSE_BASE(event, CL_OBJECT_EVENT_MAGIC);
+  } else {
+    event = cl_calloc(1, sizeof(_cl_event));
+    if (event == NULL)
+      return NULL;
+    CL_OBJECT_INIT_BASE(event, CL_OBJECT_EVENT_MAGIC);
+  }
 
+  cl_context_add_ref(ctx);
   event->ctx = ctx;
+  event->ctx_shard = index;
+
+  pthread_mutex_lock(&shard->lock);
+  list_add_tail(&shard->events, &event->base.node);
+  pthread_mutex_unlock(&shard->lock);
+  atomic_inc(&ctx->event_num);
+
+  return event;
 }
 
 LOCAL void
-cl_context_remove_event(cl_context ctx, cl_event event) {
+cl_context_free_event(cl_context ctx, cl_event event) {
+  _cl_context_event_shard *shard = &ctx->event_shards[event->ctx_shard];
+  cl_bool cached = CL_FALSE;
+
   assert(event->ctx == ctx);
-  CL_OBJECT_LOCK(ctx);
+  atomic_dec(&ctx->event_num);
+
+  pthread_mutex_lock(&shard->lock);
   list_node_del(&event->base.node);
-  ctx->event_num--;
-  CL_OBJECT_UNLOCK(ctx);
+  CL_OBJECT_RETIRE_BASE(event);
+  if (shard->free_n < CL_CONTEXT_EVENT_CACHE_SIZE) {
+    list_add(&shard->free_events, &event->base.node);
+    shard->free_n++;
+    cached = CL_TRUE;
+  }
+  pthread_mutex_unlock(&shard->lock);
 
+  if (!cached) {
+    CL_OBJECT_DESTROY_RETIRED_BASE(event);
+    cl_free(event);
+  }
+
+  /* May free the context, retired events included */
   cl_context_delete(ctx);
-  event->ctx = NULL;
+}
+
+static void
+cl_context_init_event_shards(cl_context ctx) {
+  int i;
+  for (i = 0; i < CL_CONTEXT_EVENT_SHARD_N; i++) {
+    pthread_mutex_init(&ctx->event_shards[i].lock, NULL);
+    list_init(&ctx->event_shards[i].events);
+    list_init(&ctx->event_shards[i].free_events);
+  }
+}
+
+static void
+cl_context_destroy_event_shards(cl_context ctx) {
+  _cl_context_event_shard *shard;
+  cl_event event;
+  int i;
+
+  for (i = 0; i < CL_CONTEXT_EVENT_SHARD_N; i++) {
+    shard = &ctx->event_shards[i];
+    assert(list_empty(&shard->events));
+    while (!list_empty(&shard->free_events)) {
+      event = list_entry(shard->free_events.head_node.n, _cl_event, base.node);
+      list_node_del(&event->base.node);
+      CL_OBJECT_DESTROY_RETIRED_BASE(event);
+      cl_free(event);
+    }
+    pthread_mutex_destroy(&shard->lock);
+  }
 }
 
 LOCAL void
@@ -188,11 +322,13 @@ cl_context_properties_process(const cl_context_properties *prop,
       set_cl_egl_display_khr = 0,
       set_cl_glx_display_khr = 0,
       set_cl_wgl_hdc_khr = 0,
-      set_cl_cgl_sharegroup_khr = 0;
+      set_cl_cgl_sharegroup_khr = 0,
+      set_cl_printf_callback_arm = 0;
   cl_int err = CL_SUCCESS;
 
   cl_props->gl_type = CL_GL_NOSHARE;
   cl_props->platform_id = 0;
+  cl_props->printf_callback = NULL;
 
   if (prop == NULL)
     goto exit;
@@ -232,6 +368,14 @@ cl_context_properties_process(const cl_context_properties *prop,
       cl_props->gl_type = CL_GL_CGL_SHAREGROUP;
       cl_props->cgl_sharegroup = *(prop + 1);
       break;
+    case CL_PRINTF_CALLBACK_ARM:
+      CHECK (set_cl_printf_callback_arm);
+      cl_props->printf_callback = (void (CL_CALLBACK *)(const char *, unsigned int, size_t, void *))*(prop + 1);
+      if (UNLIKELY(cl_props->printf_callback == NULL)) {
+        err = CL_INVALID_PROPERTY;
+        goto error;
+      }
+      break;
     default:
       err = CL_INVALID_PROPERTY;
       goto error;
@@ -331,14 +475,14 @@ cl_context_new(struct _cl_context_prop *props, cl_uint dev_num, cl_device_id* al
 
   TRY_ALLOC_NO_ERR (ctx, CALLOC(struct _cl_context));
   CL_OBJECT_INIT_BASE(ctx, CL_OBJECT_CONTEXT_MAGIC);
+  cl_context_init_event_shards(ctx);
   ctx->devices = all_dev;
   ctx->device_num = dev_num;
   list_init(&ctx->queues);
-  list_init(&ctx->mem_objects);
+  cl_mem_registry_init(&ctx->mem_objects);
+  cl_mem_slab_pool_init(&ctx->buffer_slabs);
   list_init(&ctx->samplers);
-  list_init(&ctx->events);
   list_init(&ctx->programs);
-  ctx->queue_modify_disable = CL_FALSE;
   TRY_ALLOC_NO_ERR (ctx->drv, cl_driver_new(props));
   ctx->props = *props;
   ctx->ver = cl_driver_get_ver(ctx->drv);
@@ -386,6 +530,8 @@ cl_context_delete(cl_context ctx)
 
   /* delete the internal programs. */
   for (i = CL_INTERNAL_KERNEL_MIN; i < CL_INTERNAL_KERNEL_MAX; i++) {
+    while (ctx->internal_idle_n[i] > 0)
+      cl_kernel_delete(ctx->internal_idle[i][--ctx->internal_idle_n[i]]);
     if (ctx->internal_kernels[i]) {
       cl_kernel k = ctx->internal_kernels[i];
       ctx->internal_kernels[i] = NULL;
@@ -402,7 +548,10 @@ cl_context_delete(cl_context ctx)
 
   cl_free(ctx->prop_user);
   cl_free(ctx->devices);
+  cl_mem_slab_pool_destroy(&ctx->buffer_slabs);
   cl_driver_delete(ctx->drv);
+  cl_context_destroy_event_shards(ctx);
+  cl_mem_registry_destroy(&ctx->mem_objects);
   CL_OBJECT_DESTROY_BASE(ctx);
   cl_free(ctx);
 }
@@ -430,8 +579,16 @@ cl_context_get_static_kernel_from_bin(cl_context ctx, cl_int index,
 
   CL_OBJECT_TAKE_OWNERSHIP(ctx, 1);
   if (ctx->internal_prgs[index] == NULL) {
-    ctx->internal_prgs[index] = cl_program_create_from_binary(ctx, 1, &ctx->devices[0],
-      &size, (const unsigned char **)&str_kernel, &binary_status, &ret);
+    size_t shared_sz = 0;
+    const char *shared = cl_internal_binary_find(ctx->devices[0], index, &shared_sz);
+    if (shared)
+      ctx->internal_prgs[index] = cl_program_create_from_binary(ctx, 1, &ctx->devices[0],
+        &shared_sz, (const unsigned char **)&shared, &binary_status, &ret);
+    if (!ctx->internal_prgs[index]) {
+      shared = NULL;
+      ctx->internal_prgs[index] = cl_program_create_from_binary(ctx, 1, &ctx->devices[0],
+        &size, (const unsigned char **)&str_kernel, &binary_status, &ret);
+    }
 
     if (!ctx->internal_prgs[index]) {
       ker = NULL;
@@ -444,6 +601,8 @@ cl_context_get_static_kernel_from_bin(cl_context ctx, cl_int index,
     }
 
     ctx->internal_prgs[index]->is_built = 1;
+    if (shared == NULL && ctx->internal_prgs[index]->source_type != FROM_BINARY)
+      cl_internal_binary_add(ctx->devices[0], index, ctx->internal_prgs[index]);
 
     if (index == CL_ENQUEUE_FILL_BUFFER_ALIGN8_8) {
       ctx->internal_kernels[index] = cl_program_create_kernel(ctx->internal_prgs[index],
@@ -462,43 +621,58 @@ cl_context_get_static_kernel_from_bin(cl_context ctx, cl_int index,
     }
   }
   ker = ctx->internal_kernels[index];
+  /* Launch an instance given back by a previous copy or fill if there is one */
+  if (ker && ctx->internal_idle_n[index] > 0) {
+    ker = ctx->internal_idle[index][--ctx->internal_idle_n[index]];
+    CL_OBJECT_RELEASE_OWNERSHIP(ctx);
+    return ker;
+  }
 
 unlock:
   CL_OBJECT_RELEASE_OWNERSHIP(ctx);
-  return cl_kernel_dup(ker);
+  ker = cl_kernel_dup(ker);
+  if (ker)
+    ker->internal_index = index;
+  return ker;
+}
+
+LOCAL void
+cl_context_put_static_kernel(cl_context ctx, cl_kernel ker)
+{
+  cl_int index;
+
+  if (ker == NULL)
+    return;
+  index = ker->internal_index;
+  cl_kernel_release_args(ker);
+  CL_OBJECT_TAKE_OWNERSHIP(ctx, 1);
+  if (index >= CL_INTERNAL_KERNEL_MIN && index < CL_INTERNAL_KERNEL_MAX &&
+      ctx->internal_idle_n[index] < CL_INTERNAL_KERNEL_IDLE_N) {
+    ctx->internal_idle[index][ctx->internal_idle_n[index]++] = ker;
+    ker = NULL;
+  }
+  CL_OBJECT_RELEASE_OWNERSHIP(ctx);
+  if (ker)
+    cl_kernel_delete(ker);
+}
+
+LOCAL void
+cl_context_printf_output(const char *buf, size_t sz, void *data)
+{
+  cl_context ctx = (cl_context)data;
+  /* The whole output of a launch is decoded before, it is always complete */
+  ctx->props.printf_callback(buf, (unsigned int)sz, 1, ctx->user_data);
 }
 
 
 cl_mem
 cl_context_get_svm_from_ptr(cl_context ctx, const void * p)
 {
-  struct list_node *pos;
-  cl_mem buf;
-
-  list_for_each (pos, (&ctx->mem_objects)) {
-    buf = (cl_mem)list_entry(pos, _cl_base_object, node);
-    if(buf->host_ptr == NULL) continue;
-    if(buf->is_svm == 0) continue;
-    if(buf->type != CL_MEM_SVM_TYPE) continue;
-    if((size_t)buf->host_ptr <= (size_t)p &&
-       (size_t)p < ((size_t)buf->host_ptr + buf->size))
-      return buf;
-  }
-  return NULL;
+  return cl_mem_registry_find_svm(&ctx->mem_objects, p);
 }
 
 cl_mem
 cl_context_get_mem_from_ptr(cl_context ctx, const void * p)
 {
-  struct list_node *pos;
-  cl_mem buf;
-
-  list_for_each (pos, (&ctx->mem_objects)) {
-    buf = (cl_mem)list_entry(pos, _cl_base_object, node);
-    if(buf->host_ptr == NULL) continue;
-    if((size_t)buf->host_ptr <= (size_t)p &&
-       (size_t)p < ((size_t)buf->host_ptr + buf->size))
-      return buf;
-  }
-  return NULL;
+  return cl_mem_registry_find_host_ptr(&ctx->mem_objects, p);
 }
@@ -25,6 +25,8 @@
 #include "cl_internals.h"
 #include "cl_driver.h"
 #include "cl_base_object.h"
+#include "cl_mem_registry.h"
+#include "cl_mem_slab.h"
 
 #include <stdint.h>
 #include <pthread.h>
@@ -88,6 +90,9 @@ enum _cl_internal_ker_type {
   CL_INTERNAL_KERNEL_MAX
 };
 
+/* Idle instances kept per internal kernel, enough for a few threads copying at once */
+#define CL_INTERNAL_KERNEL_IDLE_N 4
+
 struct _cl_context_prop {
   cl_context_properties platform_id;
   enum _cl_gl_context_type gl_type;
@@ -98,11 +103,26 @@ struct _cl_context_prop {
     cl_context_properties wgl_hdc;
     cl_context_properties cgl_sharegroup;
   };
+  /* cl_arm_printf: kernel printf output goes here instead of stdout */
+  void (CL_CALLBACK *printf_callback)(const char *, unsigned int, size_t, void *);
 };
 
 #define IS_EGL_CONTEXT(ctx)  (ctx->props.gl_type == CL_GL_EGL_DISPLAY)
 #define EGL_DISP(ctx)   (EGLDisplay)(ctx->props.egl_display)
 #define EGL_CTX(ctx)    (EGLContext)(ctx->props.gl_context)
+/* Events are spread over shards picked by the creating thread, so event
+ * creation and destruction do not contend on the context lock. Each shard
+ * keeps some retired events, mutex and cond included, for reuse */
+#define CL_CONTEXT_EVENT_SHARD_N 8
+#define CL_CONTEXT_EVENT_CACHE_SIZE 64
+
+typedef struct _cl_context_event_shard {
+  pthread_mutex_t lock;
+  list_head events;                 /* Live events of the shard */
+  list_head free_events;            /* Retired events kept for reuse */
+  cl_uint free_n;                   /* Number of retired events */
+} __attribute__((aligned(64))) _cl_context_event_shard;
+
 /* Encapsulate the whole device */
 struct _cl_context {
   _cl_base_object base;
@@ -111,13 +131,12 @@ struct _cl_context {
   cl_uint device_num;               /* Devices number of this context */
   list_head queues;                 /* All command queues currently allocated */
   cl_uint queue_num;                /* All queue number currently allocated */
-  cl_uint queue_modify_disable;     /* Temp disable queue list change. */
-  list_head mem_objects;            /* All memory object currently allocated */
-  cl_uint mem_object_num;           /* All memory number currently allocated */
+  cl_mem_registry mem_objects;      /* All memory object currently allocated */
+  cl_mem_slab_pool buffer_slabs;    /* Backing BOs shared by small buffers */
   list_head samplers;               /* All sampler object currently allocated */
   cl_uint sampler_num;              /* All sampler number currently allocated */
-  list_head events;                 /* All event object currently allocated */
-  cl_uint event_num;                /* All event number currently allocated */
+  _cl_context_event_shard event_shards[CL_CONTEXT_EVENT_SHARD_N]; /* All event object currently allocated */
+  atomic_t event_num;               /* All event number currently allocated */
   list_head programs;               /* All programs currently allocated */
   cl_uint program_num;              /* All program number currently allocated */
 
@@ -126,6 +145,9 @@ struct _cl_context {
                                     /* All programs internal used, for example clEnqueuexxx api use */
   cl_kernel  internal_kernels[CL_INTERNAL_KERNEL_MAX];
                                     /* All kernels  for clenqueuexxx api, for example clEnqueuexxx api use */
+  cl_kernel  internal_idle[CL_INTERNAL_KERNEL_MAX][CL_INTERNAL_KERNEL_IDLE_N];
+                                    /* Launched instances of the internal kernels, ready for reuse */
+  cl_uint    internal_idle_n[CL_INTERNAL_KERNEL_MAX];
   uint32_t ver;                     /* Gen version */
   struct _cl_context_prop props;
   cl_context_properties * prop_user; /* a copy of user passed context properties when create context */
@@ -143,12 +165,18 @@ struct _cl_context {
 
 extern void cl_context_add_queue(cl_context ctx, cl_command_queue queue);
 extern void cl_context_remove_queue(cl_context ctx, cl_command_queue queue);
-extern void cl_context_add_mem(cl_context ctx, cl_mem mem);
+/* CL_OUT_OF_HOST_MEMORY if mem can not be registered, it still belongs to
+ * the context and cl_mem_delete releases it */
+extern cl_int cl_context_add_mem(cl_context ctx, cl_mem mem);
 extern void cl_context_remove_mem(cl_context ctx, cl_mem mem);
+/* Set the host pointer of a memory object of the context */
+extern cl_int cl_context_set_mem_host_ptr(cl_context ctx, cl_mem mem, void *host_ptr);
 extern void cl_context_add_sampler(cl_context ctx, cl_sampler sampler);
 extern void cl_context_remove_sampler(cl_context ctx, cl_sampler sampler);
-extern void cl_context_add_event(cl_context ctx, cl_event sampler);
-extern void cl_context_remove_event(cl_context ctx, cl_event sampler);
+/* Get a zeroed event registered in the context, recycled when possible */
+extern cl_event cl_context_alloc_event(cl_context ctx);
+/* Unregister the event and retire or free it */
+extern void cl_context_free_event(cl_context ctx, cl_event event);
 extern void cl_context_add_program(cl_context ctx, cl_program program);
 extern void cl_context_remove_program(cl_context ctx, cl_program program);
 
@@ -184,6 +212,11 @@ extern cl_buffer_mgr cl_context_get_bufmgr(cl_context ctx);
 /* Get the internal used kernel from binary*/
 extern cl_kernel cl_context_get_static_kernel_from_bin(cl_context ctx, cl_int index,
                   const char * str_kernel, size_t size, const char * str_option);
+/* Give back an internal kernel once launched, its arguments are dropped */
+extern void cl_context_put_static_kernel(cl_context ctx, cl_kernel ker);
+
+/* Hand the printf output of one launch to the printf callback of the context */
+extern void cl_context_printf_output(const char *buf, size_t sz, void *ctx);
 
 /* Get the SVM from pointer, return NULL if pointer is not from SVM */
 extern cl_mem cl_context_get_svm_from_ptr(cl_context ctx, const void *p);
@@ -26,6 +26,8 @@
 #include "cl_command_queue.h"
 #include "cl_event.h"
 
+#include <string.h>
+
 LOCAL cl_int
 cl_device_enqueue_fix_offset(cl_kernel ker) {
   uint32_t i;
@@ -41,10 +43,11 @@ cl_device_enqueue_fix_offset(cl_kernel ker) {
     if(!ker->args[i].is_svm) {
       mem = ker->args[i].mem;
       ptr = cl_mem_map(mem, 0);
-      cl_buffer_set_softpin_offset(mem->bo, (size_t)ptr);
+      /* Slab buffers share the BO, pinned at its own address */
+      cl_buffer_set_softpin_offset(mem->bo, (size_t)cl_buffer_get_virtual(mem->bo));
       cl_buffer_set_bo_use_full_range(mem->bo, 1);
       cl_buffer_disable_reuse(mem->bo);
-      mem->host_ptr = ptr;
+      cl_context_set_mem_host_ptr(mem->ctx, mem, ptr);
       cl_mem_unmap(mem);
       ker->device_enqueue_infos[ker->device_enqueue_info_n++] = ptr;
     } else {
@@ -107,12 +110,47 @@ typedef struct Block_literal {
   // imported variables
 } Block_literal;
 
+/* Child kernels are built once per block index and kept by the parent.
+ * Queues running the parent at the same time share them, so this must be
+ * called with the parent lock, which is kept until the arguments of the
+ * child are in its batch. */
+static cl_kernel
+cl_device_enqueue_get_child(cl_kernel ker, uint32_t index)
+{
+  const char *kernel_name;
+  cl_kernel child_ker;
+
+  if (index >= ker->device_enqueue_child_n) {
+    uint32_t n = ker->device_enqueue_child_n ? ker->device_enqueue_child_n : 4;
+    cl_kernel *children;
+    while (n <= index)
+      n *= 2;
+    children = cl_realloc(ker->device_enqueue_children, n * sizeof(cl_kernel));
+    if (children == NULL)
+      return NULL;
+    memset(children + ker->device_enqueue_child_n, 0,
+           (n - ker->device_enqueue_child_n) * sizeof(cl_kernel));
+    ker->device_enqueue_children = children;
+    ker->device_enqueue_child_n = n;
+  }
+
+  if (ker->device_enqueue_children[index] == NULL) {
+    kernel_name = interp_program_get_device_enqueue_kernel_name(ker->program->opaque, index);
+    child_ker = cl_program_create_kernel(ker->program, kernel_name, NULL);
+    if (child_ker == NULL)
+      return NULL;
+    cl_kernel_set_exec_info(child_ker, ker->device_enqueue_info_n * sizeof(void *),
+                            ker->device_enqueue_infos);
+    ker->device_enqueue_children[index] = child_ker;
+  }
+  return ker->device_enqueue_children[index];
+}
+
 LOCAL cl_int
 cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
 {
   cl_mem mem;
   int size, type, dim, i;
-  const char * kernel_name;
   cl_kernel child_ker;
   cl_event evt = NULL;
 
@@ -132,6 +170,8 @@ cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
 
   size =  *(int *)ptr;
   ptr += 4;
+  /* All the children go to the GPU in one submission */
+  cl_command_queue_hold_chain(queue);
   while(size > 0) {
     size_t fixed_global_off[] = {0,0,0};
     size_t fixed_global_sz[] = {1,1,1};
@@ -161,16 +201,15 @@ cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
     size -= slm_size;
     ptr += slm_size;
 
-    kernel_name = interp_program_get_device_enqueue_kernel_name(ker->program->opaque, block->index);
-    child_ker = cl_program_create_kernel(ker->program, kernel_name, NULL);
+    /* The child batch is built from the arguments during the enqueue */
+    CL_OBJECT_LOCK(ker);
+    child_ker = cl_device_enqueue_get_child(ker, block->index);
     assert(child_ker);
     cl_kernel_set_arg_svm_pointer(child_ker, 0, block);
     int index = 1;
     for(i=0; i<slm_size/sizeof(int); i++, index++) {
       cl_kernel_set_arg(child_ker, index, slm_sizes[i], NULL);
     }
-    cl_kernel_set_exec_info(child_ker, ker->device_enqueue_info_n * sizeof(void *),
-                            ker->device_enqueue_infos);
 
     if (evt != NULL) {
       clReleaseEvent(evt);
@@ -178,9 +217,9 @@ cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
     }
     clEnqueueNDRangeKernel(queue, child_ker, dim + 1, fixed_global_off,
                            fixed_global_sz, fixed_local_sz, 0, NULL, &evt);
-    cl_command_queue_flush_gpgpu(gpgpu);
-    cl_kernel_delete(child_ker);
+    CL_OBJECT_UNLOCK(ker);
   }
+  cl_command_queue_release_chain(queue);
 
   if (evt != NULL) {
     //Can't call clWaitForEvents here, it may cause dead lock.
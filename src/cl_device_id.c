@@ -17,6 +17,7 @@
  * Author: Benjamin Segovia <benjamin.segovia@intel.com>
  */
 
+#define _GNU_SOURCE /* dladdr, mkostemp */
 #include "cl_platform_id.h"
 #include "cl_device_id.h"
 #include "cl_internals.h"
@@ -29,12 +30,20 @@
 #include "CL/cl_intel.h"
 #include "cl_gbe_loader.h"
 #include "cl_alloc.h"
+#include "null/null_driver.h"
 
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <sys/utsname.h>
 
 #ifndef CL_VERSION_1_2
 #define CL_DEVICE_BUILT_IN_KERNELS 0x103F
@@ -992,11 +1001,7 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   "  barrier(CLK_LOCAL_MEM_FENCE);"
   "  buf[get_global_id(0)] = tmp[2 - get_local_id(0)] + buf[get_global_id(0)];"
   "}"; // using __local to catch the "no SLM on Haswell" problem
-  static int tested = 0;
-  static cl_self_test_res ret = SELF_TEST_OTHER_FAIL;
-  if (tested != 0)
-    return ret;
-  tested = 1;
+  cl_self_test_res ret = SELF_TEST_OTHER_FAIL;
   ctx = clCreateContext(NULL, 1, &device, NULL, NULL, &status);
   if(!ctx)
     return ret;
@@ -1029,9 +1034,8 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
                     }
                   }
                 } else{
-                  ret = SELF_TEST_ATOMIC_FAIL;
                   // Atomic fail need to test SLM again with atomic in L3 feature disabled.
-                  tested = 0;
+                  ret = SELF_TEST_ATOMIC_FAIL;
                 }
                 clReleaseEvent(kernel_finished);
               }
@@ -1049,6 +1053,168 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   return ret;
 }
 
+/* The self-test verdict only depends on the device, the kernel and the
+ * compiler, so it is kept in a cache file (OCL_SELF_TEST_CACHE, default
+ * $XDG_CACHE_HOME/beignet/self_test, empty to disable). Each line holds the
+ * device and driver, a tab, their version, a tab, then the atomic in L3
+ * result and the final result. A new verdict replaces the line of its device
+ * and driver, so the file does not grow with every update. */
+static int
+cl_self_test_cache_path(char *path, size_t size)
+{
+  const char *env = getenv("OCL_SELF_TEST_CACHE");
+  const char *dir;
+  char parent[PATH_MAX];
+
+  if (env)
+    return *env && snprintf(path, size, "%s", env) < size;
+
+  if ((dir = getenv("XDG_CACHE_HOME")) && *dir)
+    snprintf(parent, sizeof(parent), "%s", dir);
+  else if ((dir = getenv("HOME")) && *dir)
+    snprintf(parent, sizeof(parent), "%s/.cache", dir);
+  else
+    return 0;
+  mkdir(parent, 0700);
+  if (strlen(parent) + sizeof("/beignet/self_test") > size)
+    return 0;
+  snprintf(path, size, "%s/beignet", parent);
+  if (mkdir(path, 0700) != 0 && errno != EEXIST)
+    return 0;
+  strcat(path, "/self_test");
+  return 1;
+}
+
+static void
+cl_self_test_cache_key(cl_device_id device, char *id, size_t id_size,
+                       char *version, size_t version_size)
+{
+  struct utsname uts;
+  struct stat st;
+  Dl_info info;
+  const char *release = "unknown";
+
+  if (uname(&uts) == 0)
+    release = uts.release;
+  /* libgbe is identified by the file it was loaded from */
+  if (compiler_program_new_from_source &&
+      dladdr((void *)compiler_program_new_from_source, &info) && info.dli_fname &&
+      stat(info.dli_fname, &st) == 0) {
+    snprintf(id, id_size, "%04x %s", device->device_id, info.dli_fname);
+    snprintf(version, version_size, "%s %lld.%lld " LIBCL_DRIVER_VERSION_STRING BEIGNET_GIT_SHA1_STRING,
+             release, (long long)st.st_size, (long long)st.st_mtime);
+  } else {
+    snprintf(id, id_size, "%04x none", device->device_id);
+    snprintf(version, version_size, "%s " LIBCL_DRIVER_VERSION_STRING BEIGNET_GIT_SHA1_STRING,
+             release);
+  }
+}
+
+static int
+cl_self_test_cache_find(const char *id, const char *version, int *atomic_res, int *res)
+{
+  char path[PATH_MAX], line[PATH_MAX + 512];
+  const size_t id_len = strlen(id), version_len = strlen(version);
+  const char *v;
+  int found = 0;
+  FILE *f;
+
+  if (!cl_self_test_cache_path(path, sizeof(path)) || !(f = fopen(path, "re")))
+    return 0;
+  while (!found && fgets(line, sizeof(line), f)) {
+    if (strncmp(line, id, id_len) != 0 || line[id_len] != '\t')
+      continue;
+    v = line + id_len + 1;
+    if (strncmp(v, version, version_len) == 0 && v[version_len] == '\t' &&
+        sscanf(v + version_len + 1, "%d %d", atomic_res, res) == 2)
+      found = 1;
+  }
+  fclose(f);
+  return found;
+}
+
+static void
+cl_self_test_cache_add(const char *id, const char *version, int atomic_res, int res)
+{
+  char path[PATH_MAX], tmp[PATH_MAX + 8], line[PATH_MAX + 512];
+  const size_t id_len = strlen(id);
+  FILE *in, *out;
+  char *tab;
+  size_t len;
+  int fd;
+
+  if (!cl_self_test_cache_path(path, sizeof(path)) ||
+      snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp))
+    return;
+  /* The new file is renamed over the old one, so readers and concurrent
+   * writers always see a whole file */
+  if ((fd = mkostemp(tmp, O_CLOEXEC)) < 0)
+    return;
+  if (!(out = fdopen(fd, "w"))) {
+    close(fd);
+    unlink(tmp);
+    return;
+  }
+  /* Keep the well formed lines of the other devices and drivers */
+  if ((in = fopen(path, "re"))) {
+    while (fgets(line, sizeof(line), in)) {
+      len = strlen(line);
+      if (len == 0 || line[len - 1] != '\n' ||
+          !(tab = strchr(line, '\t')) || !strchr(tab + 1, '\t'))
+        continue;
+      if (tab - line == id_len && strncmp(line, id, id_len) == 0)
+        continue;
+      fputs(line, out);
+    }
+    fclose(in);
+  }
+  fprintf(out, "%s\t%s\t%d %d\n", id, version, atomic_res, res);
+  if (fclose(out) != 0 || rename(tmp, path) != 0) {
+    DEBUGP(DL_WARNING, "Beignet: failed to write the self-test cache %s", path);
+    unlink(tmp);
+  }
+}
+
+/* Run the self-test once per process, or take its verdict from the cache.
+ * When atomics in L3 fail, the second run without them gives the verdict,
+ * and both results are kept. */
+static cl_self_test_res
+cl_device_self_test(cl_device_id device)
+{
+  static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  static int verdict = -1;      /* Not run yet */
+  char id[PATH_MAX + 16], version[256];
+  int atomic_res, res;
+
+  pthread_mutex_lock(&lock);
+  if (verdict >= 0)
+    goto exit;
+
+  cl_self_test_cache_key(device, id, sizeof(id), version, sizeof(version));
+  if (cl_self_test_cache_find(id, version, &atomic_res, &res)) {
+    device->atomic_test_result = atomic_res;
+    if (atomic_res == SELF_TEST_ATOMIC_FAIL)
+      printf("Beignet: warning - disable atomic in L3 feature.\n");
+    verdict = res;
+    goto exit;
+  }
+
+  res = cl_self_test(device, SELF_TEST_PASS);
+  if (res == SELF_TEST_ATOMIC_FAIL) {
+    device->atomic_test_result = res;
+    res = cl_self_test(device, res);
+    printf("Beignet: warning - disable atomic in L3 feature.\n");
+  }
+  verdict = res;
+  /* Runtime API failures may be transient, do not keep them */
+  if (res == SELF_TEST_PASS || res == SELF_TEST_SLM_FAIL)
+    cl_self_test_cache_add(id, version, device->atomic_test_result, res);
+
+exit:
+  pthread_mutex_unlock(&lock);
+  return verdict;
+}
+
 LOCAL cl_int
 cl_get_device_ids(cl_platform_id    platform,
                   cl_device_type    device_type,
@@ -1060,13 +1226,9 @@ cl_get_device_ids(cl_platform_id    platform,
 
   /* Do we have a usable device? */
   device = cl_get_gt_device(device_type);
-  if (device) {
-    cl_self_test_res ret = cl_self_test(device, SELF_TEST_PASS);
-    if (ret == SELF_TEST_ATOMIC_FAIL) {
-      device->atomic_test_result = ret;
-      ret = cl_self_test(device, ret);
-      printf("Beignet: warning - disable atomic in L3 feature.\n");
-    }
+  /* Nothing runs on the null driver, the self-test would always fail */
+  if (device && !null_driver_enabled()) {
+    cl_self_test_res ret = cl_device_self_test(device);
 
     if(ret == SELF_TEST_SLM_FAIL) {
       int disable_self_test = 0;
@@ -1696,6 +1858,47 @@ cl_get_kernel_workgroup_info(cl_kernel kernel,
         *(cl_ulong*)param_value = (cl_ulong)interp_kernel_get_scratch_size(kernel->opaque);
       return CL_SUCCESS;
     }
+    case CL_KERNEL_BANK_CONFLICT_COUNT_INTEL:
+    case CL_KERNEL_INSTRUCTION_COUNT_INTEL:
+    case CL_KERNEL_COMPACT_INSTRUCTION_COUNT_INTEL:
+    case CL_KERNEL_PEEPHOLE_REMOVED_COUNT_INTEL:
+    case CL_KERNEL_PEEPHOLE_FUSED_COUNT_INTEL:
+    case CL_KERNEL_PEEPHOLE_HINT_COUNT_INTEL:
+    case CL_KERNEL_ASM_ROUNDTRIP_COUNT_INTEL:
+    {
+      enum gbe_kernel_stat stat = GBE_KERNEL_STAT_BANK_CONFLICT_NUM;
+      if (param_name == CL_KERNEL_INSTRUCTION_COUNT_INTEL)
+        stat = GBE_KERNEL_STAT_INSN_NUM;
+      else if (param_name == CL_KERNEL_COMPACT_INSTRUCTION_COUNT_INTEL)
+        stat = GBE_KERNEL_STAT_COMPACT_INSN_NUM;
+      else if (param_name == CL_KERNEL_PEEPHOLE_REMOVED_COUNT_INTEL)
+        stat = GBE_KERNEL_STAT_PEEPHOLE_REMOVED_NUM;
+      else if (param_name == CL_KERNEL_PEEPHOLE_FUSED_COUNT_INTEL)
+        stat = GBE_KERNEL_STAT_PEEPHOLE_FUSED_NUM;
+      else if (param_name == CL_KERNEL_PEEPHOLE_HINT_COUNT_INTEL)
+        stat = GBE_KERNEL_STAT_PEEPHOLE_HINT_NUM;
+      else if (param_name == CL_KERNEL_ASM_ROUNDTRIP_COUNT_INTEL)
+        stat = GBE_KERNEL_STAT_ASM_ROUNDTRIP_NUM;
+      if (param_value && param_value_size < sizeof(cl_uint))
+        return CL_INVALID_VALUE;
+      if (param_value_size_ret != NULL)
+        *param_value_size_ret = sizeof(cl_uint);
+      if (param_value)
+        *(cl_uint*)param_value = interp_kernel_get_stat(kernel->opaque, stat);
+      return CL_SUCCESS;
+    }
+    case CL_KERNEL_SIMD_LAUNCH_COUNT_INTEL:
+    {
+      if (param_value && param_value_size < 2 * sizeof(cl_ulong))
+        return CL_INVALID_VALUE;
+      if (param_value_size_ret != NULL)
+        *param_value_size_ret = 2 * sizeof(cl_ulong);
+      if (param_value) {
+        ((cl_ulong *)param_value)[0] = atomic_read(&kernel->simd_launch_n[0]);
+        ((cl_ulong *)param_value)[1] = atomic_read(&kernel->simd_launch_n[1]);
+      }
+      return CL_SUCCESS;
+    }
 
     default:
       return CL_INVALID_VALUE;
@@ -143,6 +143,43 @@ extern cl_gpgpu_delete_cb *cl_gpgpu_delete;
 typedef void (cl_gpgpu_sync_cb)(void*);
 extern cl_gpgpu_sync_cb *cl_gpgpu_sync;
 
+/* Max number of walkers in one gpgpu state, each with its own CURBE */
+#define CL_GPGPU_MAX_DISPATCH 8
+
+/* Number of walkers the next state_init makes room for (1 by default). Each
+ * one gets its own CURBE and interface descriptor, the surfaces, samplers,
+ * scratch and constant buffer being shared */
+typedef void (cl_gpgpu_set_dispatch_n_cb)(cl_gpgpu, uint32_t n);
+extern cl_gpgpu_set_dispatch_n_cb *cl_gpgpu_set_dispatch_n;
+
+/* Select the walker the following states_setup, upload_curbes and walker
+ * calls apply to */
+typedef void (cl_gpgpu_select_dispatch_cb)(cl_gpgpu, uint32_t index);
+extern cl_gpgpu_select_dispatch_cb *cl_gpgpu_select_dispatch;
+
+/* Tell if the last batch of the gpgpu state retired, so the state can be reused */
+typedef int (cl_gpgpu_is_idle_cb)(cl_gpgpu);
+extern cl_gpgpu_is_idle_cb *cl_gpgpu_is_idle;
+
+/* Cache of the scratch, stack and printf buffers of one queue. A gpgpu state
+ * attached to it takes them from the cache and gives them back on its next
+ * state_init or on delete. The states keep the cache alive, so it may
+ * outlive the queue. NULL if the driver has none */
+typedef cl_gpgpu_bo_cache (cl_gpgpu_bo_cache_new_cb)(cl_driver);
+extern cl_gpgpu_bo_cache_new_cb *cl_gpgpu_bo_cache_new;
+
+/* Drop the reference of the queue */
+typedef void (cl_gpgpu_bo_cache_close_cb)(cl_gpgpu_bo_cache);
+extern cl_gpgpu_bo_cache_close_cb *cl_gpgpu_bo_cache_close;
+
+/* Attach the gpgpu state to a cache */
+typedef void (cl_gpgpu_set_bo_cache_cb)(cl_gpgpu, cl_gpgpu_bo_cache);
+extern cl_gpgpu_set_bo_cache_cb *cl_gpgpu_set_bo_cache;
+
+/* cl_ulong[2]: buffers reused from the cache and newly allocated */
+typedef void (cl_gpgpu_bo_cache_get_stats_cb)(cl_gpgpu_bo_cache, cl_ulong stats[2]);
+extern cl_gpgpu_bo_cache_get_stats_cb *cl_gpgpu_bo_cache_get_stats;
+
 /* Bind a regular unformatted buffer */
 typedef void (cl_gpgpu_bind_buf_cb)(cl_gpgpu, cl_buffer, uint32_t offset, uint32_t internal_offset, size_t size, uint8_t bti);
 extern cl_gpgpu_bind_buf_cb *cl_gpgpu_bind_buf;
@@ -219,8 +256,8 @@ extern cl_gpgpu_upload_curbes_cb *cl_gpgpu_upload_curbes;
 typedef cl_buffer (cl_gpgpu_alloc_constant_buffer_cb)(cl_gpgpu, uint32_t size, uint8_t bti);
 extern cl_gpgpu_alloc_constant_buffer_cb *cl_gpgpu_alloc_constant_buffer;
 
-/* Setup all indirect states */
-typedef void (cl_gpgpu_states_setup_cb)(cl_gpgpu, cl_gpgpu_kernel *kernel);
+/* Setup all indirect states, non zero if they could not be written */
+typedef int (cl_gpgpu_states_setup_cb)(cl_gpgpu, cl_gpgpu_kernel *kernel);
 extern cl_gpgpu_states_setup_cb *cl_gpgpu_states_setup;
 
 /* Upload the constant samplers as specified inside the OCL kernel */
@@ -247,6 +284,13 @@ extern cl_gpgpu_batch_end_cb *cl_gpgpu_batch_end;
 typedef int (cl_gpgpu_flush_cb)(cl_gpgpu);
 extern cl_gpgpu_flush_cb *cl_gpgpu_flush;
 
+/* Chain the batch of next after the one of the first state (Gen8+): next is
+ * terminated without being submitted and runs when the first batch of the
+ * chain is flushed. Returns -1 if it cannot be chained. NULL if the driver
+ * does not support it */
+typedef int (cl_gpgpu_chain_cb)(cl_gpgpu, cl_gpgpu next);
+extern cl_gpgpu_chain_cb *cl_gpgpu_chain;
+
 /* new a event for a batch buffer */
 typedef cl_gpgpu_event (cl_gpgpu_event_new_cb)(cl_gpgpu);
 extern cl_gpgpu_event_new_cb *cl_gpgpu_event_new;
@@ -431,12 +475,21 @@ extern cl_buffer_get_subdata_cb *cl_buffer_get_subdata;
 typedef int (cl_buffer_wait_rendering_cb) (cl_buffer);
 extern cl_buffer_wait_rendering_cb *cl_buffer_wait_rendering;
 
+/* Tell if a submitted batch still uses the buffer */
+typedef int (cl_buffer_is_busy_cb) (cl_buffer);
+extern cl_buffer_is_busy_cb *cl_buffer_is_busy;
+
 typedef int (cl_buffer_get_fd_cb)(cl_buffer, int *fd);
 extern cl_buffer_get_fd_cb *cl_buffer_get_fd;
 
 typedef int (cl_buffer_get_tiling_align_cb)(cl_context ctx, uint32_t tiling_mode, uint32_t dim);
 extern cl_buffer_get_tiling_align_cb *cl_buffer_get_tiling_align;
 
+/* Tell if a CPU (non GTT) map of a tiled buffer shows its raw tiles with no
+ * bit 6 swizzling, so the host can tile and detile it itself */
+typedef int (cl_buffer_can_host_tile_cb)(cl_buffer);
+extern cl_buffer_can_host_tile_cb *cl_buffer_can_host_tile;
+
 typedef cl_buffer (cl_buffer_get_buffer_from_fd_cb)(cl_context ctx, int fd, int size);
 extern cl_buffer_get_buffer_from_fd_cb *cl_buffer_get_buffer_from_fd;
 
@@ -53,10 +53,12 @@ LOCAL cl_buffer_unpin_cb *cl_buffer_unpin = NULL;
 LOCAL cl_buffer_subdata_cb *cl_buffer_subdata = NULL;
 LOCAL cl_buffer_get_subdata_cb *cl_buffer_get_subdata = NULL;
 LOCAL cl_buffer_wait_rendering_cb *cl_buffer_wait_rendering = NULL;
+LOCAL cl_buffer_is_busy_cb *cl_buffer_is_busy = NULL;
 LOCAL cl_buffer_get_buffer_from_libva_cb *cl_buffer_get_buffer_from_libva = NULL;
 LOCAL cl_buffer_get_image_from_libva_cb *cl_buffer_get_image_from_libva = NULL;
 LOCAL cl_buffer_get_fd_cb *cl_buffer_get_fd = NULL;
 LOCAL cl_buffer_get_tiling_align_cb *cl_buffer_get_tiling_align = NULL;
+LOCAL cl_buffer_can_host_tile_cb *cl_buffer_can_host_tile = NULL;
 LOCAL cl_buffer_get_buffer_from_fd_cb *cl_buffer_get_buffer_from_fd = NULL;
 LOCAL cl_buffer_get_image_from_fd_cb *cl_buffer_get_image_from_fd = NULL;
 
@@ -64,6 +66,11 @@ LOCAL cl_buffer_get_image_from_fd_cb *cl_buffer_get_image_from_fd = NULL;
 LOCAL cl_gpgpu_new_cb *cl_gpgpu_new = NULL;
 LOCAL cl_gpgpu_delete_cb *cl_gpgpu_delete = NULL;
 LOCAL cl_gpgpu_sync_cb *cl_gpgpu_sync = NULL;
+LOCAL cl_gpgpu_is_idle_cb *cl_gpgpu_is_idle = NULL;
+LOCAL cl_gpgpu_bo_cache_new_cb *cl_gpgpu_bo_cache_new = NULL;
+LOCAL cl_gpgpu_bo_cache_close_cb *cl_gpgpu_bo_cache_close = NULL;
+LOCAL cl_gpgpu_set_bo_cache_cb *cl_gpgpu_set_bo_cache = NULL;
+LOCAL cl_gpgpu_bo_cache_get_stats_cb *cl_gpgpu_bo_cache_get_stats = NULL;
 LOCAL cl_gpgpu_bind_buf_cb *cl_gpgpu_bind_buf = NULL;
 LOCAL cl_gpgpu_set_stack_cb *cl_gpgpu_set_stack = NULL;
 LOCAL cl_gpgpu_set_scratch_cb *cl_gpgpu_set_scratch = NULL;
@@ -80,6 +87,9 @@ LOCAL cl_gpgpu_batch_reset_cb *cl_gpgpu_batch_reset = NULL;
 LOCAL cl_gpgpu_batch_start_cb *cl_gpgpu_batch_start = NULL;
 LOCAL cl_gpgpu_batch_end_cb *cl_gpgpu_batch_end = NULL;
 LOCAL cl_gpgpu_flush_cb *cl_gpgpu_flush = NULL;
+LOCAL cl_gpgpu_set_dispatch_n_cb *cl_gpgpu_set_dispatch_n = NULL;
+LOCAL cl_gpgpu_select_dispatch_cb *cl_gpgpu_select_dispatch = NULL;
+LOCAL cl_gpgpu_chain_cb *cl_gpgpu_chain = NULL;
 LOCAL cl_gpgpu_walker_cb *cl_gpgpu_walker = NULL;
 LOCAL cl_gpgpu_bind_sampler_cb *cl_gpgpu_bind_sampler = NULL;
 LOCAL cl_gpgpu_bind_vme_state_cb *cl_gpgpu_bind_vme_state = NULL;
@@ -19,6 +19,9 @@ typedef struct _cl_driver *cl_driver;
 /* Encapsulates the gpgpu stream of commands */
 typedef struct _cl_gpgpu *cl_gpgpu;
 
+/* Encapsulates the internal buffers recycled across the launches of a queue */
+typedef struct _cl_gpgpu_bo_cache *cl_gpgpu_bo_cache;
+
 /* Encapsulates the event  of a command stream */
 typedef struct _cl_gpgpu_event *cl_gpgpu_event;
 
@@ -25,7 +25,10 @@
 #include "cl_utils.h"
 #include "cl_alloc.h"
 #include "cl_device_enqueue.h"
+#include "cl_host_copy.h"
+#include "cl_image_tiling.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
@@ -46,7 +49,7 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
   //and it is randomly. So temporary disable it, use map/copy/unmap to read.
   //Should re-enable it after find root cause.
   if (0 && !mem->is_userptr) {
-    if (cl_buffer_get_subdata(mem->bo, data->offset + buffer->sub_offset,
+    if (cl_buffer_get_subdata(mem->bo, mem->offset + data->offset + buffer->sub_offset,
                               data->size, data->ptr) != 0)
       err = CL_MAP_FAILURE;
   } else {
@@ -57,7 +60,7 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
       //sometimes, application invokes read buffer, instead of map buffer, even if userptr is enabled
       //memcpy is not necessary for this case
       if (data->ptr != (char *)src_ptr + data->offset + buffer->sub_offset)
-        memcpy(data->ptr, (char *)src_ptr + data->offset + buffer->sub_offset, data->size);
+        cl_host_copy(data->ptr, (char *)src_ptr + data->offset + buffer->sub_offset, data->size);
       cl_mem_unmap_auto(mem);
     }
   }
@@ -97,20 +100,11 @@ cl_enqueue_read_buffer_rect(enqueue_data *data, cl_int status)
 
   if (data->row_pitch == region[0] && data->row_pitch == data->host_row_pitch &&
       (region[2] == 1 || (data->slice_pitch == region[0] * region[1] && data->slice_pitch == data->host_slice_pitch))) {
-    memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_host_copy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
   } else {
-    cl_uint y, z;
-    for (z = 0; z < region[2]; z++) {
-      const char *src = src_ptr;
-      char *dst = dst_ptr;
-      for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, region[0]);
-        src += data->row_pitch;
-        dst += data->host_row_pitch;
-      }
-      src_ptr = (char *)src_ptr + data->slice_pitch;
-      dst_ptr = (char *)dst_ptr + data->host_slice_pitch;
-    }
+    cl_host_copy_rect(dst_ptr, data->host_row_pitch, data->host_slice_pitch,
+                      src_ptr, data->row_pitch, data->slice_pitch,
+                      region[0], region[1], region[2]);
   }
 
   err = cl_mem_unmap_auto(mem);
@@ -136,15 +130,21 @@ cl_enqueue_write_buffer(enqueue_data *data, cl_int status)
     if (dst_ptr == NULL)
       err = CL_MAP_FAILURE;
     else {
-      memcpy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size);
+      cl_host_copy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size);
       cl_mem_unmap_auto(mem);
     }
   } else {
-    if (cl_buffer_subdata(mem->bo, data->offset + buffer->sub_offset,
+    if (cl_buffer_subdata(mem->bo, mem->offset + data->offset + buffer->sub_offset,
                           data->size, data->const_ptr) != 0)
       err = CL_MAP_FAILURE;
   }
 
+  /* The staged copy is consumed, no need to wait for the event release */
+  if (data->staging) {
+    cl_staging_ring_release(data->staging, data->const_ptr);
+    data->staging = NULL;
+    data->const_ptr = NULL;
+  }
   return err;
 }
 
@@ -180,20 +180,11 @@ cl_enqueue_write_buffer_rect(enqueue_data *data, cl_int status)
 
   if (data->row_pitch == region[0] && data->row_pitch == data->host_row_pitch &&
       (region[2] == 1 || (data->slice_pitch == region[0] * region[1] && data->slice_pitch == data->host_slice_pitch))) {
-    memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_host_copy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
   } else {
-    cl_uint y, z;
-    for (z = 0; z < region[2]; z++) {
-      const char *src = src_ptr;
-      char *dst = dst_ptr;
-      for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, region[0]);
-        src += data->host_row_pitch;
-        dst += data->row_pitch;
-      }
-      src_ptr = (char *)src_ptr + data->host_slice_pitch;
-      dst_ptr = (char *)dst_ptr + data->slice_pitch;
-    }
+    cl_host_copy_rect(dst_ptr, data->row_pitch, data->slice_pitch,
+                      src_ptr, data->host_row_pitch, data->host_slice_pitch,
+                      region[0], region[1], region[2]);
   }
 
   err = cl_mem_unmap_auto(mem);
@@ -202,6 +193,35 @@ error:
   return err;
 }
 
+/* A GTT map detiles every access through a fence, and reads through it are
+ * uncached. When the CPU map shows the raw tiles, read and write image
+ * convert them on the host instead (OCL_IMAGE_HOST_TILING=0 disables it). */
+static pthread_once_t host_tiling_once = PTHREAD_ONCE_INIT;
+static int host_tiling_enabled;
+
+static void
+cl_enqueue_image_host_tiling_init(void)
+{
+  const char *env = getenv("OCL_IMAGE_HOST_TILING");
+  host_tiling_enabled = env ? atoi(env) : 1;
+}
+
+static cl_bool
+cl_enqueue_image_host_tiling(struct _cl_mem_image *image)
+{
+  pthread_once(&host_tiling_once, cl_enqueue_image_host_tiling_init);
+  if (!host_tiling_enabled || image->tiling == CL_NO_TILE || image->base.is_userptr)
+    return CL_FALSE;
+  if (image->image_type != CL_MEM_OBJECT_IMAGE2D &&
+      image->image_type != CL_MEM_OBJECT_IMAGE2D_ARRAY &&
+      image->image_type != CL_MEM_OBJECT_IMAGE3D)
+    return CL_FALSE;
+  /* Sub images of a bigger surface keep the GTT path */
+  if (image->offset || image->tile_x || image->tile_y || image->slice_pitch % image->row_pitch)
+    return CL_FALSE;
+  return cl_buffer_can_host_tile(image->base.bo) != 0;
+}
+
 static cl_int
 cl_enqueue_read_image(enqueue_data *data, cl_int status)
 {
@@ -216,6 +236,18 @@ cl_enqueue_read_image(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
+  if (cl_enqueue_image_host_tiling(image)) {
+    if (!(src_ptr = cl_mem_map(mem, 0))) {
+      err = CL_MAP_FAILURE;
+      goto error;
+    }
+    cl_image_detile(data->ptr, data->row_pitch, data->slice_pitch,
+                    src_ptr, image->tiling, image->row_pitch, image->slice_pitch,
+                    image->bpp, origin, region);
+    err = cl_mem_unmap(mem);
+    goto error;
+  }
+
   if (!(src_ptr = cl_mem_map_auto(mem, 0))) {
     err = CL_MAP_FAILURE;
     goto error;
@@ -226,20 +258,11 @@ cl_enqueue_read_image(enqueue_data *data, cl_int status)
 
   if (!origin[0] && region[0] == image->w && data->row_pitch == image->row_pitch &&
       (region[2] == 1 || (!origin[1] && region[1] == image->h && data->slice_pitch == image->slice_pitch))) {
-    memcpy(data->ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_host_copy(data->ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
   } else {
-    cl_uint y, z;
-    for (z = 0; z < region[2]; z++) {
-      const char *src = src_ptr;
-      char *dst = data->ptr;
-      for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, image->bpp * region[0]);
-        src += image->row_pitch;
-        dst += data->row_pitch;
-      }
-      src_ptr = (char *)src_ptr + image->slice_pitch;
-      data->ptr = (char *)data->ptr + data->slice_pitch;
-    }
+    cl_host_copy_rect(data->ptr, data->row_pitch, data->slice_pitch,
+                      src_ptr, image->row_pitch, image->slice_pitch,
+                      image->bpp * region[0], region[1], region[2]);
   }
 
   err = cl_mem_unmap_auto(mem);
@@ -261,6 +284,17 @@ cl_enqueue_write_image(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
+  if (cl_enqueue_image_host_tiling(image)) {
+    if (!(dst_ptr = cl_mem_map(mem, 1))) {
+      err = CL_MAP_FAILURE;
+      goto error;
+    }
+    cl_image_tile(dst_ptr, image->tiling, image->row_pitch, image->slice_pitch, image->bpp,
+                  data->origin, data->region, data->const_ptr, data->row_pitch, data->slice_pitch);
+    err = cl_mem_unmap(mem);
+    goto error;
+  }
+
   if (!(dst_ptr = cl_mem_map_auto(mem, 1))) {
     err = CL_MAP_FAILURE;
     goto error;
@@ -562,23 +596,86 @@ cl_int cl_enqueue_svm_mem_fill(enqueue_data *data, cl_int status) {
   return CL_SUCCESS;
 }
 
+static cl_int
+cl_enqueue_copy_buffer_host(enqueue_data *data, cl_int status)
+{
+  cl_mem src = data->src_mem;
+  cl_mem dst = data->mem_obj;
+  char *src_ptr, *dst_ptr;
+
+  if (status != CL_COMPLETE)
+    return CL_SUCCESS;
+
+  assert(src->type == CL_MEM_BUFFER_TYPE || src->type == CL_MEM_SUBBUFFER_TYPE);
+  assert(dst->type == CL_MEM_BUFFER_TYPE || dst->type == CL_MEM_SUBBUFFER_TYPE);
+  if (!(src_ptr = cl_mem_map_auto(src, 0)))
+    return CL_MAP_FAILURE;
+  if (!(dst_ptr = cl_mem_map_auto(dst, 1))) {
+    cl_mem_unmap_auto(src);
+    return CL_MAP_FAILURE;
+  }
+  src_ptr += ((struct _cl_mem_buffer *)src)->sub_offset + data->src_offset;
+  dst_ptr += ((struct _cl_mem_buffer *)dst)->sub_offset + data->offset;
+  /* Both may be views of the same BO */
+  memmove(dst_ptr, src_ptr, data->size);
+  cl_mem_unmap_auto(dst);
+  cl_mem_unmap_auto(src);
+  return CL_SUCCESS;
+}
+
+static cl_int
+cl_enqueue_fill_buffer_host(enqueue_data *data, cl_int status)
+{
+  cl_mem mem = data->mem_obj;
+  char *ptr;
+  size_t i;
+
+  if (status != CL_COMPLETE)
+    return CL_SUCCESS;
+
+  assert(mem->type == CL_MEM_BUFFER_TYPE || mem->type == CL_MEM_SUBBUFFER_TYPE);
+  if (!(ptr = cl_mem_map_auto(mem, 1)))
+    return CL_MAP_FAILURE;
+  ptr += ((struct _cl_mem_buffer *)mem)->sub_offset + data->offset;
+  for (i = 0; i < data->size; i += data->pattern_size)
+    memcpy(ptr + i, data->const_ptr, data->pattern_size);
+  cl_mem_unmap_auto(mem);
+  return CL_SUCCESS;
+}
+
+static void
+cl_enqueue_unpin_slabs(enqueue_data *data)
+{
+  if (data->slabs == NULL)
+    return;
+  cl_mem_slab_unpin(&data->queue->ctx->buffer_slabs, data->slabs, data->slab_n);
+  cl_free(data->slabs);
+  data->slabs = NULL;
+  data->slab_n = 0;
+}
+
 static cl_int
 cl_enqueue_ndrange(enqueue_data *data, cl_int status)
 {
   cl_int err = CL_SUCCESS;
 
   if (status == CL_SUBMITTED) {
-    err = cl_command_queue_flush_gpgpu(data->gpgpu);
-    //if it is the last ndrange of an cl enqueue api,
-    //check the device enqueue information.
-    if (data->mid_event_of_enq == 0) {
-      assert(data->queue);
-      cl_device_enqueue_parse_result(data->queue, data->gpgpu);
-    }
+    if (data->queue)
+      err = cl_command_queue_submit_gpgpu(data->queue, data->gpgpu, &data->chain_seq, &data->chain_status);
+    else
+      err = cl_command_queue_flush_gpgpu(data->gpgpu);
+    //then check the device enqueue information.
+    assert(data->queue);
+    cl_device_enqueue_parse_result(data->queue, data->gpgpu);
   } else if (status == CL_COMPLETE) {
-    void *batch_buf = cl_gpgpu_ref_batch_buf(data->gpgpu);
+    void *batch_buf;
+    if (data->queue &&
+        (err = cl_command_queue_wait_chain(data->queue, data->chain_seq, &data->chain_status)) != CL_SUCCESS)
+      return err;
+    batch_buf = cl_gpgpu_ref_batch_buf(data->gpgpu);
     cl_gpgpu_sync(batch_buf);
     cl_gpgpu_unref_batch_buf(batch_buf);
+    cl_enqueue_unpin_slabs(data);
   }
 
   return err;
@@ -596,6 +693,13 @@ cl_enqueue_delete(enqueue_data *data)
   if (data == NULL)
     return;
 
+  /* A staged write which never ran */
+  if (data->staging) {
+    cl_staging_ring_release(data->staging, data->const_ptr);
+    data->staging = NULL;
+    data->const_ptr = NULL;
+  }
+
   if (data->type == EnqueueCopyBufferRect ||
       data->type == EnqueueCopyBuffer ||
       data->type == EnqueueCopyImage ||
@@ -604,13 +708,35 @@ cl_enqueue_delete(enqueue_data *data)
       data->type == EnqueueNDRangeKernel ||
       data->type == EnqueueFillBuffer ||
       data->type == EnqueueFillImage) {
-    if (data->gpgpu) {
+    /* Never completed */
+    cl_enqueue_unpin_slabs(data);
+    if (data->gpgpu_pool) {
+      cl_gpgpu_pool_put(data->gpgpu_pool, data->gpgpu);
+      data->gpgpu_pool = NULL;
+      data->gpgpu = NULL;
+    } else if (data->gpgpu) {
       cl_gpgpu_delete(data->gpgpu);
       data->gpgpu = NULL;
     }
     return;
   }
 
+  if (data->type == EnqueueCopyBufferHost || data->type == EnqueueFillBufferHost) {
+    if (data->src_mem) {
+      cl_mem_delete(data->src_mem);
+      data->src_mem = NULL;
+    }
+    if (data->mem_obj) {
+      cl_mem_delete(data->mem_obj);
+      data->mem_obj = NULL;
+    }
+    if (data->const_ptr) {
+      cl_free((void*)data->const_ptr);
+      data->const_ptr = NULL;
+    }
+    return;
+  }
+
   if (data->type == EnqueueNativeKernel) {
     if (data->mem_list) {
       cl_free((void*)data->mem_list);
@@ -657,6 +783,10 @@ cl_enqueue_handle(enqueue_data *data, cl_int status)
     return cl_enqueue_svm_mem_copy(data, status);
   case EnqueueSVMMemFill:
     return cl_enqueue_svm_mem_fill(data, status);
+  case EnqueueCopyBufferHost:
+    return cl_enqueue_copy_buffer_host(data, status);
+  case EnqueueFillBufferHost:
+    return cl_enqueue_fill_buffer_host(data, status);
   case EnqueueMarker:
   case EnqueueBarrier:
     return cl_enqueue_marker_or_barrier(data, status);
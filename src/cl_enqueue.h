@@ -49,12 +49,16 @@ typedef enum {
   EnqueueSVMFree,
   EnqueueSVMMemCopy,
   EnqueueSVMMemFill,
+  EnqueueCopyBufferHost,     /* Small buffer copy done by the CPU */
+  EnqueueFillBufferHost,     /* Small buffer fill done by the CPU */
   EnqueueInvalid
 } enqueue_type;
 
 typedef struct _enqueue_data {
   enqueue_type type;         /* Command type */
   cl_mem mem_obj;            /* Enqueue's cl_mem */
+  cl_mem src_mem;            /* Source buffer of a host copy */
+  size_t src_offset;         /* Source offset of a host copy */
   cl_command_queue queue;    /* Command queue */
   size_t offset;             /* Mem object's offset */
   size_t size;               /* Size */
@@ -71,16 +75,19 @@ typedef struct _enqueue_data {
   uint8_t unsync_map;        /* Indicate the clEnqueueMapBuffer/Image is unsync map */
   uint8_t write_map;         /* Indicate if the clEnqueueMapBuffer is write enable */
   void ** pointers;          /* The svm_pointers of clEnqueueSVMFree  */
-  size_t  pattern_size;      /* the pattern_size of clEnqueueSVMMemFill */
+  size_t  pattern_size;      /* the pattern_size of clEnqueueSVMMemFill and host fills */
   void (*user_func)(void *); /* pointer to a host-callable user function */
   void (CL_CALLBACK *free_func)( cl_command_queue queue,
                                  cl_uint num_svm_pointers,
                                  void *svm_pointers[],
                                  void *user_data);  /* pointer to pfn_free_func of clEnqueueSVMFree */
   cl_gpgpu gpgpu;
-  cl_bool mid_event_of_enq;  /* For non-uniform ndrange, one enqueue have a sequence event, the
-                                last event need to parse device enqueue information.
-                                0 : last event; 1: non-last event */
+  struct _cl_gpgpu_pool *gpgpu_pool; /* Where gpgpu goes back once retired */
+  struct _cl_staging_ring *staging;  /* Ring const_ptr was staged in, if any */
+  cl_ulong chain_seq;        /* Non zero if the batch was held to be coalesced */
+  cl_int chain_status;       /* Submission status of the coalesced batch */
+  struct _cl_mem_slab **slabs; /* Slabs of the buffers of the batch, pinned until it completes */
+  cl_uint slab_n;
 } enqueue_data;
 
 /* Do real enqueue commands */
@@ -149,18 +149,16 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
              cl_uint num_events, cl_event *event_list)
 {
   int i;
-  cl_event e = cl_calloc(1, sizeof(_cl_event));
+  /* Zeroed, and appended in the context event list */
+  cl_event e = cl_context_alloc_event(ctx);
   if (e == NULL)
     return NULL;
 
-  CL_OBJECT_INIT_BASE(e, CL_OBJECT_EVENT_MAGIC);
-
-  /* Append the event in the context event list */
-  cl_context_add_event(ctx, e);
   e->queue = queue;
 
   list_init(&e->callbacks);
   list_node_init(&e->enqueue_node);
+  list_node_init(&e->ready_node);
 
   assert(type >= CL_COMMAND_NDRANGE_KERNEL && type <= CL_COMMAND_SVM_UNMAP);
   e->event_type = type;
@@ -176,6 +174,7 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
 
   e->depend_events = event_list;
   e->depend_event_num = num_events;
+  e->pending_n = num_events;
   for (i = 0; i < 4; i++) {
     e->timestamp[i] = CL_EVENT_INVALID_TIMESTAMP;
   }
@@ -183,6 +182,73 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
   return e;
 }
 
+/* Register event as a successor of dep, so dep counts it down when it
+   completes. If dep already completed, count it down at once. */
+static cl_int
+cl_event_add_successor(cl_event dep, cl_event event)
+{
+  cl_event *successors;
+  cl_uint cap;
+
+  CL_OBJECT_LOCK(dep);
+  if (dep->status <= CL_COMPLETE) {
+    if (dep->status < CL_COMPLETE)
+      event->depend_error = dep->status;
+    CL_OBJECT_UNLOCK(dep);
+    atomic_dec(&event->pending_n);
+    return CL_SUCCESS;
+  }
+
+  if (dep->successor_n == dep->successor_cap) {
+    cap = dep->successor_cap ? dep->successor_cap * 2 : 4;
+    successors = cl_realloc(dep->successors, cap * sizeof(cl_event));
+    if (successors == NULL) {
+      CL_OBJECT_UNLOCK(dep);
+      return CL_OUT_OF_HOST_MEMORY;
+    }
+    dep->successors = successors;
+    dep->successor_cap = cap;
+  }
+  dep->successors[dep->successor_n++] = event;
+  CL_OBJECT_UNLOCK(dep);
+  return CL_SUCCESS;
+}
+
+static void
+cl_event_remove_successor(cl_event dep, cl_event event)
+{
+  cl_uint i;
+
+  CL_OBJECT_LOCK(dep);
+  for (i = 0; i < dep->successor_n; i++) {
+    if (dep->successors[i] == event) {
+      dep->successors[i] = dep->successors[--dep->successor_n];
+      break;
+    }
+  }
+  CL_OBJECT_UNLOCK(dep);
+}
+
+/* Must be called with the lock of event, once it completed or failed. Count
+   down all its successors, the ones whose last dependency this was become
+   ready and are handed to their queue. The lock keeps the successors from
+   being destroyed meanwhile. */
+static void
+cl_event_release_successors(cl_event event)
+{
+  cl_event s;
+  cl_uint i;
+
+  for (i = 0; i < event->successor_n; i++) {
+    s = event->successors[i];
+    if (event->status < CL_COMPLETE)
+      s->depend_error = event->status;
+    if (atomic_dec(&s->pending_n) == 1 && s->queue)
+      cl_command_queue_event_ready(s->queue, s);
+  }
+  event->successor_n = 0;
+}
+
 /* This exists to prevent long chains of events from filling up memory (https://bugs.launchpad.net/ubuntu/+source/beignet/+bug/1354086).  Call only after the dependencies are complete, or failed and marked as such in this event's status, or when this event is being destroyed */
 LOCAL void
 cl_event_delete_depslist(cl_event event)
@@ -196,6 +262,9 @@ cl_event_delete_depslist(cl_event event)
   if (old_depend_events) {
     assert(depend_count);
     for (int i = 0; i < depend_count; i++) {
+      /* Still registered if it is destroyed before its dependencies completed */
+      if (atomic_read(&event->pending_n) > 0)
+        cl_event_remove_successor(old_depend_events[i], event);
       cl_event_delete(old_depend_events[i]);
     }
     cl_free(old_depend_events);
@@ -217,8 +286,11 @@ cl_event_delete(cl_event event)
   cl_enqueue_delete(&event->exec_data);
 
   assert(list_node_out_of_list(&event->enqueue_node));
+  assert(list_node_out_of_list(&event->ready_node));
 
   cl_event_delete_depslist(event);
+  assert(event->successor_n == 0);
+  cl_free(event->successors);
 
   /* Free all the callbacks. Last ref, no need to lock. */
   while (!list_empty(&event->callbacks)) {
@@ -227,12 +299,9 @@ cl_event_delete(cl_event event)
     cl_free(cb);
   }
 
-  /* Remove it from the list */
+  /* Remove it from the list, the context keeps it for reuse */
   assert(event->ctx);
-  cl_context_remove_event(event->ctx, event);
-
-  CL_OBJECT_DESTROY_BASE(event);
-  cl_free(event);
+  cl_context_free_event(event->ctx, event);
 }
 
 LOCAL cl_event
@@ -300,6 +369,17 @@ cl_event_create(cl_context ctx, cl_command_queue queue, cl_uint num_events,
         break;
       }
       depend_events = NULL;
+
+      for (i = 0; i < total_events; i++) {
+        err = cl_event_add_successor(e->depend_events[i], e);
+        if (err != CL_SUCCESS)
+          break;
+      }
+      if (err != CL_SUCCESS) {
+        cl_event_delete(e);
+        e = NULL;
+        break;
+      }
     }
   } while (0);
 
@@ -312,7 +392,7 @@ cl_event_create(cl_context ctx, cl_command_queue queue, cl_uint num_events,
     }
 
     // if set depend_events, must succeed.
-    assert(e->depend_events == NULL);
+    assert(e == NULL || e->depend_events == NULL);
     cl_event_delete(e);
   }
 
@@ -435,38 +515,16 @@ cl_event_set_status(cl_event event, cl_int status)
 
   if (event->status <= CL_COMPLETE) {
     notify_queue = CL_TRUE;
+    /* Only the queues of the events waiting for this one need to know */
+    cl_event_release_successors(event);
   }
 
   CL_OBJECT_UNLOCK(event);
 
-  /* Need to notify all the command queue within the same context. */
-  if (notify_queue) {
-    cl_command_queue queue = NULL;
-
-    /*First, we need to remove it from queue's barrier list. */
-    if (CL_EVENT_IS_BARRIER(event)) {
-      assert(event->queue);
-      cl_command_queue_remove_barrier_event(event->queue, event);
-    }
-
-    /* Then, notify all the queues within the same context. */
-    CL_OBJECT_LOCK(event->ctx);
-    /* Disable remove and add queue to the context temporary. We need to
-       make sure all the queues in the context currently are valid. */
-    event->ctx->queue_modify_disable++;
-    CL_OBJECT_UNLOCK(event->ctx);
-    list_for_each(pos, &event->ctx->queues)
-    {
-      queue = (cl_command_queue)(list_entry(pos, _cl_base_object, node));
-      assert(queue != NULL);
-      cl_command_queue_notify(queue);
-    }
-    CL_OBJECT_LOCK(event->ctx);
-    /* Disable remove and add queue to the context temporary. We need to
-       make sure all the queues in the context currently are valid. */
-    event->ctx->queue_modify_disable--;
-    CL_OBJECT_NOTIFY_COND(event->ctx);
-    CL_OBJECT_UNLOCK(event->ctx);
+  /* Remove it from queue's barrier list. */
+  if (notify_queue && CL_EVENT_IS_BARRIER(event)) {
+    assert(event->queue);
+    cl_command_queue_remove_barrier_event(event->queue, event);
   }
 
   return CL_SUCCESS;
@@ -493,7 +551,7 @@ cl_event_wait_for_events_list(cl_uint num_events, const cl_event *event_list)
 
     CL_OBJECT_LOCK(e);
     while (e->status > CL_COMPLETE) {
-      CL_OBJECT_WAIT_ON_COND(e);
+      CL_EVENT_WAIT_ON_COND(e);
     }
 
     assert(e->status <= CL_COMPLETE);
@@ -620,23 +678,10 @@ cl_event_exec(cl_event event, cl_int exec_to_status, cl_bool ignore_depends)
 LOCAL cl_int
 cl_event_is_ready(cl_event event)
 {
-  int i;
-  int status;
-  int ret_status = CL_COMPLETE;
-
-  for (i = 0; i < event->depend_event_num; i++) {
-    status = cl_event_get_status(event->depend_events[i]);
-
-    if (status > CL_COMPLETE) { // Find some not ready, just OK
-      return status;
-    }
-
-    if (status < CL_COMPLETE) { // Record some error.
-      ret_status = status;
-    }
-  }
+  if (atomic_read(&event->pending_n) > 0)
+    return CL_QUEUED;
 
-  return ret_status;
+  return event->depend_error;
 }
 
 LOCAL cl_event
@@ -688,7 +733,7 @@ cl_event_create_marker_or_barrier(cl_command_queue queue, cl_uint num_events_in_
 
     event_num = 0;
     depend_events = NULL;
-    if (!list_empty(&worker->enqueued_events)) {
+    if (!list_empty(&worker->enqueued_events) || !list_empty(&worker->host_events)) {
       depend_events = cl_command_queue_record_in_queue_events(queue, &event_num);
     }
 
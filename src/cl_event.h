@@ -23,6 +23,7 @@
 
 #include "cl_base_object.h"
 #include "cl_enqueue.h"
+#include "cl_host_worker.h"
 #include "CL/cl.h"
 
 typedef void(CL_CALLBACK *cl_event_notify_cb)(cl_event event, cl_int event_command_exec_status, void *user_data);
@@ -40,14 +41,23 @@ typedef _cl_event_user_callback *cl_event_user_callback;
 typedef struct _cl_event {
   _cl_base_object base;
   cl_context ctx;             /* The context associated with event */
+  cl_uint ctx_shard;          /* The event shard of the context it lives in */
   cl_command_queue queue;     /* The command queue associated with event */
   cl_command_type event_type; /* Event type. */
   cl_bool is_barrier;         /* Is this event a barrier */
   cl_int status;              /* The execution status */
   cl_event *depend_events;    /* The events must complete before this. May disappear after they have completed - see cl_event_delete_depslist*/
   cl_uint depend_event_num;   /* The depend events number. */
+  atomic_t pending_n;         /* Depend events not completed yet */
+  cl_int depend_error;        /* Error status of a failed depend event */
+  cl_event *successors;       /* Events waiting for this one to complete */
+  cl_uint successor_n;        /* Number of successors */
+  cl_uint successor_cap;      /* Allocated size of successors */
   list_head callbacks;        /* The events The event callback functions */
   list_node enqueue_node;     /* The node in the enqueue list. */
+  list_node ready_node;       /* The node in the ready list of the queue. */
+  cl_bool in_ready;           /* Already pushed in the ready list, under queue lock */
+  _cl_host_job host_job;      /* Runs it on the host worker pool */
   cl_ulong timestamp[5];      /* The time stamps for profiling. */
   enqueue_data exec_data; /* Context for execute this event. */
 } _cl_event;
@@ -57,6 +67,11 @@ typedef struct _cl_event {
          ((cl_base_object)obj)->magic == CL_OBJECT_EVENT_MAGIC &&  \
          CL_OBJECT_GET_REF(obj) >= 1))
 
+/* Wait for a status change of the event, with its lock. Safe on the host
+ * worker pool, see cl_host_worker_wait */
+#define CL_EVENT_WAIT_ON_COND(e) \
+  (cl_host_worker_wait(&((cl_base_object)(e))->cond, &((cl_base_object)(e))->mutex))
+
 #define CL_EVENT_STATE_UNKNOWN 0x4
 
 #define CL_EVENT_IS_MARKER(E) (E->event_type == CL_COMMAND_MARKER)
@@ -77,8 +77,11 @@ gbe_get_printf_buf_bti_cb* interp_get_printf_buf_bti = NULL;
 gbe_dup_printfset_cb* interp_dup_printfset = NULL;
 gbe_release_printf_info_cb* interp_release_printf_info = NULL;
 gbe_output_printf_cb* interp_output_printf = NULL;
+gbe_set_printf_output_cb* interp_set_printf_output = NULL;
 gbe_kernel_get_arg_info_cb *interp_kernel_get_arg_info = NULL;
 gbe_kernel_use_device_enqueue_cb *interp_kernel_use_device_enqueue = NULL;
+gbe_kernel_get_stat_cb *interp_kernel_get_stat = NULL;
+gbe_kernel_get_simd_variant_cb *interp_kernel_get_simd_variant = NULL;
 
 struct GbeLoaderInitializer
 {
@@ -268,6 +271,10 @@ struct GbeLoaderInitializer
     if (interp_output_printf == NULL)
       return false;
 
+    interp_set_printf_output = *(gbe_set_printf_output_cb**)dlsym(dlhInterp, "gbe_set_printf_output");
+    if (interp_set_printf_output == NULL)
+      return false;
+
     interp_kernel_get_arg_info = *(gbe_kernel_get_arg_info_cb**)dlsym(dlhInterp, "gbe_kernel_get_arg_info");
     if (interp_kernel_get_arg_info == NULL)
       return false;
@@ -276,6 +283,14 @@ struct GbeLoaderInitializer
     if (interp_kernel_use_device_enqueue == NULL)
       return false;
 
+    interp_kernel_get_stat = *(gbe_kernel_get_stat_cb**)dlsym(dlhInterp, "gbe_kernel_get_stat");
+    if (interp_kernel_get_stat == NULL)
+      return false;
+
+    interp_kernel_get_simd_variant = *(gbe_kernel_get_simd_variant_cb**)dlsym(dlhInterp, "gbe_kernel_get_simd_variant");
+    if (interp_kernel_get_simd_variant == NULL)
+      return false;
+
     return true;
   }
 
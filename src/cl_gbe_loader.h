@@ -77,8 +77,11 @@ extern gbe_get_printf_buf_bti_cb* interp_get_printf_buf_bti;
 extern gbe_dup_printfset_cb* interp_dup_printfset;
 extern gbe_release_printf_info_cb* interp_release_printf_info;
 extern gbe_output_printf_cb* interp_output_printf;
+extern gbe_set_printf_output_cb* interp_set_printf_output;
 extern gbe_kernel_get_arg_info_cb *interp_kernel_get_arg_info;
 extern gbe_kernel_use_device_enqueue_cb * interp_kernel_use_device_enqueue;
+extern gbe_kernel_get_stat_cb * interp_kernel_get_stat;
+extern gbe_kernel_get_simd_variant_cb * interp_kernel_get_simd_variant;
 
 int CompilerSupported();
 #ifdef __cplusplus
@@ -0,0 +1,306 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_host_copy.h"
+#include "cl_host_worker.h"
+#include "cl_utils.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define CL_HOST_COPY_CHUNK (1 << 20)        /* Bytes handed out at once */
+#define CL_HOST_COPY_HELPER_MAX 8
+#define CL_HOST_COPY_DEFAULT_THRESHOLD (4 << 20)
+#define CL_HOST_COPY_DEFAULT_LLC (8 << 20)
+
+static struct {
+  pthread_once_t once;
+  size_t threshold;          /* Smaller transfers are not split */
+  size_t stream_threshold;   /* Larger destinations bypass the cache */
+} host_copy = { PTHREAD_ONCE_INIT };
+
+typedef struct _cl_host_copy_work _cl_host_copy_work;
+
+typedef struct _cl_host_copy_helper {
+  _cl_host_job job;          /* Must be first */
+  _cl_host_copy_work *work;
+} _cl_host_copy_helper;
+
+/* A transfer is a sequence of lines, row_n lines per slice, cut in chunks
+ * of chunk_lines lines. Every thread takes the next chunk until none is
+ * left, so the caller never waits for a helper which did not start. */
+struct _cl_host_copy_work {
+  char *dst;
+  const char *src;
+  size_t dst_row_pitch, dst_slice_pitch;
+  size_t src_row_pitch, src_slice_pitch;
+  size_t row_sz, row_n, slice_n;
+  size_t line_n;
+  size_t chunk_lines;
+  int chunk_n;
+  atomic_t next_chunk;
+  int stream;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  cl_uint running;           /* Helpers not done yet */
+  _cl_host_copy_helper helpers[CL_HOST_COPY_HELPER_MAX];
+};
+
+static void
+cl_host_copy_init(void)
+{
+  const char *env;
+  long llc = 0;
+
+  env = getenv("OCL_HOST_COPY_THRESHOLD");
+  host_copy.threshold = env ? strtoul(env, NULL, 0) : CL_HOST_COPY_DEFAULT_THRESHOLD;
+
+  env = getenv("OCL_HOST_COPY_NT_THRESHOLD");
+  if (env) {
+    host_copy.stream_threshold = strtoul(env, NULL, 0);
+  } else {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    host_copy.stream_threshold = llc > 0 ? llc : CL_HOST_COPY_DEFAULT_LLC;
+  }
+  /* 0 means never */
+  if (host_copy.stream_threshold == 0)
+    host_copy.stream_threshold = SIZE_MAX;
+}
+
+static void
+cl_host_copy_line(char *dst, const char *src, size_t size, int stream)
+{
+#ifdef __SSE2__
+  if (stream && size >= 64) {
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+    for (; size >= 64; size -= 64, dst += 64, src += 64) {
+      __m128i a = _mm_loadu_si128((const __m128i *)src);
+      __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+      __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+      __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+      _mm_stream_si128((__m128i *)dst, a);
+      _mm_stream_si128((__m128i *)(dst + 16), b);
+      _mm_stream_si128((__m128i *)(dst + 32), c);
+      _mm_stream_si128((__m128i *)(dst + 48), d);
+    }
+  }
+#endif
+  memcpy(dst, src, size);
+}
+
+static void
+cl_host_copy_run(_cl_host_copy_work *work)
+{
+  int chunk;
+
+  while ((chunk = atomic_inc(&work->next_chunk)) < work->chunk_n) {
+    size_t line = (size_t)chunk * work->chunk_lines;
+    size_t end = line + work->chunk_lines;
+    size_t y = line % work->row_n;
+    size_t z = line / work->row_n;
+
+    if (end > work->line_n)
+      end = work->line_n;
+    for (; line < end; line++) {
+      cl_host_copy_line(work->dst + z * work->dst_slice_pitch + y * work->dst_row_pitch,
+                        work->src + z * work->src_slice_pitch + y * work->src_row_pitch,
+                        work->row_sz, work->stream);
+      if (++y == work->row_n) {
+        y = 0;
+        z++;
+      }
+    }
+  }
+#ifdef __SSE2__
+  /* Streaming stores are weakly ordered, publish them before we report */
+  if (work->stream)
+    _mm_sfence();
+#endif
+}
+
+/* Lines in order, backwards when the destination is after the source: as
+ * memmove when both layouts have the same pitches */
+static void
+cl_host_copy_move(_cl_host_copy_work *work)
+{
+  const size_t line_n = work->row_n * work->slice_n;
+  size_t i, line;
+
+  for (i = 0; i < line_n; i++) {
+    line = work->dst > work->src ? line_n - 1 - i : i;
+    memmove(work->dst + line / work->row_n * work->dst_slice_pitch + line % work->row_n * work->dst_row_pitch,
+            work->src + line / work->row_n * work->src_slice_pitch + line % work->row_n * work->src_row_pitch,
+            work->row_sz);
+  }
+}
+
+static void
+cl_host_copy_helper_run(cl_host_job job)
+{
+  _cl_host_copy_work *work = ((_cl_host_copy_helper *)job)->work;
+
+  cl_host_copy_run(work);
+
+  pthread_mutex_lock(&work->lock);
+  if (--work->running == 0)
+    pthread_cond_signal(&work->cond);
+  pthread_mutex_unlock(&work->lock);
+}
+
+static void
+cl_host_copy_exec(_cl_host_copy_work *work, size_t total)
+{
+  size_t chunk_n;
+  cl_uint helper_n = 0, i;
+
+  work->line_n = work->row_n * work->slice_n;
+  work->chunk_lines = work->row_sz >= CL_HOST_COPY_CHUNK ? 1 : CL_HOST_COPY_CHUNK / work->row_sz;
+  chunk_n = (work->line_n + work->chunk_lines - 1) / work->chunk_lines;
+  if (chunk_n >= INT_MAX) {
+    work->chunk_lines = work->line_n;
+    chunk_n = 1;
+  }
+  work->chunk_n = chunk_n;
+  work->next_chunk = 0;
+
+  if (total >= host_copy.threshold && chunk_n > 1) {
+    helper_n = cl_host_worker_get_n();
+    if (helper_n > chunk_n - 1)
+      helper_n = chunk_n - 1;
+    if (helper_n > CL_HOST_COPY_HELPER_MAX)
+      helper_n = CL_HOST_COPY_HELPER_MAX;
+  }
+
+  if (helper_n == 0) {
+    cl_host_copy_run(work);
+    return;
+  }
+
+  pthread_mutex_init(&work->lock, NULL);
+  pthread_cond_init(&work->cond, NULL);
+  work->running = helper_n;
+  for (i = 0; i < helper_n; i++) {
+    work->helpers[i].job.run = cl_host_copy_helper_run;
+    work->helpers[i].work = work;
+    cl_host_worker_submit(&work->helpers[i].job);
+  }
+
+  cl_host_copy_run(work);
+
+  /* All the chunks are taken: helpers still queued (the pool may be busy,
+   * possibly with this very copy) have nothing left to do */
+  pthread_mutex_lock(&work->lock);
+  for (i = 0; i < helper_n; i++) {
+    if (cl_host_worker_cancel(&work->helpers[i].job))
+      work->running--;
+  }
+  while (work->running > 0)
+    pthread_cond_wait(&work->cond, &work->lock);
+  pthread_mutex_unlock(&work->lock);
+
+  pthread_cond_destroy(&work->cond);
+  pthread_mutex_destroy(&work->lock);
+}
+
+LOCAL void
+cl_host_copy(void *dst, const void *src, size_t size)
+{
+  _cl_host_copy_work work;
+  size_t tail;
+
+  /* A read into the host memory of a CL_MEM_USE_HOST_PTR buffer, say */
+  if ((char *)dst < (const char *)src + size && (const char *)src < (char *)dst + size) {
+    if (dst != src)
+      memmove(dst, src, size);
+    return;
+  }
+
+  pthread_once(&host_copy.once, cl_host_copy_init);
+  if (size < host_copy.threshold && size < host_copy.stream_threshold) {
+    memcpy(dst, src, size);
+    return;
+  }
+
+  /* Whole chunks as lines of one slice, the caller copies the tail */
+  work.stream = size >= host_copy.stream_threshold;
+  work.dst = dst;
+  work.src = src;
+  work.row_sz = CL_HOST_COPY_CHUNK;
+  work.dst_row_pitch = work.src_row_pitch = CL_HOST_COPY_CHUNK;
+  work.dst_slice_pitch = work.src_slice_pitch = 0;
+  work.row_n = size / CL_HOST_COPY_CHUNK;
+  work.slice_n = 1;
+  tail = size - work.row_n * CL_HOST_COPY_CHUNK;
+  cl_host_copy_line((char *)dst + size - tail, (const char *)src + size - tail, tail, work.stream);
+  if (work.row_n == 0) {
+    work.row_n = 1;
+    work.slice_n = 0;
+  }
+  cl_host_copy_exec(&work, size);
+}
+
+LOCAL void
+cl_host_copy_rect(void *dst, size_t dst_row_pitch, size_t dst_slice_pitch,
+                  const void *src, size_t src_row_pitch, size_t src_slice_pitch,
+                  size_t row_sz, size_t row_n, size_t slice_n)
+{
+  _cl_host_copy_work work;
+  const size_t total = row_sz * row_n * slice_n;
+  size_t dst_span, src_span;
+
+  if (total == 0)
+    return;
+  if (row_sz == dst_row_pitch && row_sz == src_row_pitch &&
+      (slice_n == 1 || (dst_slice_pitch == row_sz * row_n && src_slice_pitch == row_sz * row_n))) {
+    cl_host_copy(dst, src, total);
+    return;
+  }
+
+  work.dst = dst;
+  work.src = src;
+  work.row_sz = row_sz;
+  work.dst_row_pitch = dst_row_pitch;
+  work.dst_slice_pitch = dst_slice_pitch;
+  work.src_row_pitch = src_row_pitch;
+  work.src_slice_pitch = src_slice_pitch;
+  work.row_n = row_n;
+  work.slice_n = slice_n;
+
+  dst_span = (slice_n - 1) * dst_slice_pitch + (row_n - 1) * dst_row_pitch + row_sz;
+  src_span = (slice_n - 1) * src_slice_pitch + (row_n - 1) * src_row_pitch + row_sz;
+  if (work.dst < work.src + src_span && work.src < work.dst + dst_span) {
+    cl_host_copy_move(&work);
+    return;
+  }
+
+  pthread_once(&host_copy.once, cl_host_copy_init);
+  work.stream = total >= host_copy.stream_threshold;
+  cl_host_copy_exec(&work, total);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_HOST_COPY_H__
+#define __CL_HOST_COPY_H__
+
+#include <stddef.h>
+
+/* Host copy engine used by the read/write/copy commands. Transfers of at
+ * least OCL_HOST_COPY_THRESHOLD bytes (default 4MB) are split in chunks
+ * copied by the calling thread and the host worker pool together, smaller
+ * ones are a plain memcpy. Destinations of at least OCL_HOST_COPY_NT_THRESHOLD
+ * bytes (default: the size of the last level cache) are written with
+ * non-temporal stores, so they do not evict the whole cache. */
+
+/* Copy size bytes from src to dst. Overlapping ranges are copied as by
+ * memmove, on the calling thread */
+extern void cl_host_copy(void *dst, const void *src, size_t size);
+
+/* Copy slice_n slices of row_n rows of row_sz bytes between two pitched
+ * layouts. When the ranges overlap, the lines are copied one by one on the
+ * calling thread, in the order of memmove: exact for equal pitches */
+extern void cl_host_copy_rect(void *dst, size_t dst_row_pitch, size_t dst_slice_pitch,
+                              const void *src, size_t src_row_pitch, size_t src_slice_pitch,
+                              size_t row_sz, size_t row_n, size_t slice_n);
+
+#endif /* __CL_HOST_COPY_H__ */
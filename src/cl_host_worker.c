@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_host_worker.h"
+#include "cl_alloc.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CL_HOST_WORKER_MAX 4
+/* How often a waiting pool thread looks for jobs queued in the meantime */
+#define CL_HOST_WORKER_POLL_NS 1000000
+
+static struct {
+  pthread_once_t once;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  list_head jobs;
+  cl_uint thread_n;
+} host_worker = { PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/* Set on the threads of the pool */
+static __thread cl_bool host_worker_self = CL_FALSE;
+
+/* Must be called with the pool's lock */
+static cl_host_job
+cl_host_worker_take(void)
+{
+  cl_host_job job;
+
+  if (list_empty(&host_worker.jobs))
+    return NULL;
+  job = list_entry(host_worker.jobs.head_node.n, _cl_host_job, node);
+  list_node_del(&job->node);
+  return job;
+}
+
+static void *
+cl_host_worker_thread(void *arg)
+{
+  cl_host_job job;
+
+  host_worker_self = CL_TRUE;
+  pthread_mutex_lock(&host_worker.lock);
+  while (1) {
+    job = cl_host_worker_take();
+    if (job == NULL) {
+      pthread_cond_wait(&host_worker.cond, &host_worker.lock);
+      continue;
+    }
+    pthread_mutex_unlock(&host_worker.lock);
+
+    job->run(job);
+
+    pthread_mutex_lock(&host_worker.lock);
+  }
+  return NULL;
+}
+
+static void
+cl_host_worker_init(void)
+{
+  const char *env = getenv("OCL_HOST_WORKERS");
+  long n;
+  pthread_t tid;
+  pthread_attr_t attr;
+
+  if (env) {
+    n = atoi(env);
+  } else {
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > CL_HOST_WORKER_MAX)
+      n = CL_HOST_WORKER_MAX;
+  }
+
+  list_init(&host_worker.jobs);
+  /* The threads live as long as the process */
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (; n > 0; n--) {
+    if (pthread_create(&tid, &attr, cl_host_worker_thread, NULL)) {
+      DEBUGP(DL_WARNING, "Can not create host worker thread %d", host_worker.thread_n);
+      break;
+    }
+    host_worker.thread_n++;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+LOCAL cl_uint
+cl_host_worker_get_n(void)
+{
+  pthread_once(&host_worker.once, cl_host_worker_init);
+  return host_worker.thread_n;
+}
+
+LOCAL void
+cl_host_worker_submit(cl_host_job job)
+{
+  assert(host_worker.thread_n > 0);
+  pthread_mutex_lock(&host_worker.lock);
+  list_add_tail(&host_worker.jobs, &job->node);
+  pthread_cond_signal(&host_worker.cond);
+  pthread_mutex_unlock(&host_worker.lock);
+}
+
+LOCAL cl_bool
+cl_host_worker_cancel(cl_host_job job)
+{
+  cl_bool pending;
+
+  pthread_mutex_lock(&host_worker.lock);
+  /* A running job was unlinked by its thread */
+  pending = !list_node_out_of_list(&job->node);
+  if (pending)
+    list_node_del(&job->node);
+  pthread_mutex_unlock(&host_worker.lock);
+  return pending;
+}
+
+LOCAL void
+cl_host_worker_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  cl_host_job job;
+  struct timespec ts;
+
+  if (!host_worker_self) {
+    pthread_cond_wait(cond, mutex);
+    return;
+  }
+
+  /* A command run by the pool, a native kernel say, may wait for another
+   * one queued behind it. Run the pending jobs here rather than holding a
+   * thread the pool may lack to ever get there */
+  pthread_mutex_lock(&host_worker.lock);
+  job = cl_host_worker_take();
+  pthread_mutex_unlock(&host_worker.lock);
+  if (job) {
+    pthread_mutex_unlock(mutex);
+    job->run(job);
+    pthread_mutex_lock(mutex);
+    return;
+  }
+
+  /* Nothing to run yet, the job may still be on its way to the pool */
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_nsec += CL_HOST_WORKER_POLL_NS;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  pthread_cond_timedwait(cond, mutex, &ts);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_HOST_WORKER_H__
+#define __CL_HOST_WORKER_H__
+
+#include "cl_utils.h"
+#include "CL/cl.h"
+#include <pthread.h>
+
+/* Process wide pool of threads running the host side commands of out of
+ * order queues, so they overlap with the GPU work of the queue. Its size is
+ * OCL_HOST_WORKERS (default: online CPUs, at most 4), 0 disables it. */
+
+typedef struct _cl_host_job {
+  list_node node;                           /* In the pending job list */
+  void (*run)(struct _cl_host_job *job);    /* Called on a pool thread */
+} _cl_host_job;
+
+typedef _cl_host_job *cl_host_job;
+
+/* Number of threads of the pool, started on the first call */
+extern cl_uint cl_host_worker_get_n(void);
+/* Queue the job to the pool, which must have threads */
+extern void cl_host_worker_submit(cl_host_job job);
+/* Take back a job no thread picked yet, tell if it was still pending */
+extern cl_bool cl_host_worker_cancel(cl_host_job job);
+/* pthread_cond_wait, except that a pool thread runs the pending jobs while
+ * it waits, as what it waits for may be one of them. Wakes up spuriously */
+extern void cl_host_worker_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+
+#endif /* __CL_HOST_WORKER_H__ */
@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_image_tiling.h"
+#include "cl_utils.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define CL_TILING_X86 1
+#include <immintrin.h>
+#endif
+
+/* Both tile kinds are 4KB. An X tile is 8 rows of 512 bytes stored row
+ * after row. A Y tile is 32 rows of 128 bytes stored as 8 columns of 16
+ * bytes (OWords), each column being its 32 rows one after the other. */
+#define TILE_SZ 4096
+#define TILE_X_W 512
+#define TILE_X_H 8
+#define TILE_Y_W 128
+#define TILE_Y_H 32
+#define OWORD 16
+
+LOCAL size_t
+cl_image_tiling_offset(cl_image_tiling_t tiling, size_t pitch, size_t x, size_t y)
+{
+  switch (tiling) {
+  case CL_TILE_X:
+    return (y / TILE_X_H) * pitch * TILE_X_H + (x / TILE_X_W) * TILE_SZ +
+           (y % TILE_X_H) * TILE_X_W + x % TILE_X_W;
+  case CL_TILE_Y:
+    return (y / TILE_Y_H) * pitch * TILE_Y_H + (x / TILE_Y_W) * TILE_SZ +
+           (x % TILE_Y_W / OWORD) * OWORD * TILE_Y_H + (y % TILE_Y_H) * OWORD + x % OWORD;
+  default:
+    return y * pitch + x;
+  }
+}
+
+static INLINE void
+cl_tiling_copy16(void *dst, const void *src)
+{
+#ifdef CL_TILING_X86
+  _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+#else
+  memcpy(dst, src, OWORD);
+#endif
+}
+
+/* Bytes [x0, x1) of surface row y from / to the linear row lin. An X tile
+ * row is contiguous, so each tile is one memcpy. */
+static void
+cl_tiling_x_row(char *tiled, size_t pitch, size_t y, char *lin,
+                size_t x0, size_t x1, int to_tiled)
+{
+  char *row = tiled + (y / TILE_X_H) * pitch * TILE_X_H + (y % TILE_X_H) * TILE_X_W;
+
+  while (x0 < x1) {
+    const size_t end = MIN(x1, (x0 & ~(size_t)(TILE_X_W - 1)) + TILE_X_W);
+    char *t = row + (x0 / TILE_X_W) * TILE_SZ + x0 % TILE_X_W;
+    if (to_tiled)
+      memcpy(t, lin, end - x0);
+    else
+      memcpy(lin, t, end - x0);
+    lin += end - x0;
+    x0 = end;
+  }
+}
+
+/* Same for a Y tile row, which is one OWord out of each column */
+static void
+cl_tiling_y_row(char *tiled, size_t pitch, size_t y, char *lin,
+                size_t x0, size_t x1, int to_tiled)
+{
+  char *row = tiled + (y / TILE_Y_H) * pitch * TILE_Y_H + (y % TILE_Y_H) * OWORD;
+
+  while (x0 < x1) {
+    const size_t end = MIN(x1, (x0 & ~(size_t)(OWORD - 1)) + OWORD);
+    char *t = row + (x0 / TILE_Y_W) * TILE_SZ + (x0 % TILE_Y_W / OWORD) * OWORD * TILE_Y_H + x0 % OWORD;
+    if (end - x0 == OWORD) {
+      if (to_tiled)
+        cl_tiling_copy16(t, lin);
+      else
+        cl_tiling_copy16(lin, t);
+    } else {
+      if (to_tiled)
+        memcpy(t, lin, end - x0);
+      else
+        memcpy(lin, t, end - x0);
+    }
+    lin += end - x0;
+    x0 = end;
+  }
+}
+
+#ifdef CL_TILING_X86
+/* Rows y and y + 1 of a Y tile (y even): the OWords of both rows of one
+ * column are adjacent, so each pair is a single 32 bytes access */
+__attribute__((target("avx2"))) static void
+cl_tiling_y_row2_avx2(char *tiled, size_t pitch, size_t y, char *lin0, char *lin1,
+                      size_t x0, size_t x1, int to_tiled)
+{
+  char *row = tiled + (y / TILE_Y_H) * pitch * TILE_Y_H + (y % TILE_Y_H) * OWORD;
+  const size_t xa = ALIGN(x0, OWORD), xb = x1 & ~(size_t)(OWORD - 1);
+  size_t x;
+
+  if (xa >= xb) {
+    cl_tiling_y_row(tiled, pitch, y, lin0, x0, x1, to_tiled);
+    cl_tiling_y_row(tiled, pitch, y + 1, lin1, x0, x1, to_tiled);
+    return;
+  }
+
+  cl_tiling_y_row(tiled, pitch, y, lin0, x0, xa, to_tiled);
+  cl_tiling_y_row(tiled, pitch, y + 1, lin1, x0, xa, to_tiled);
+  for (x = xa; x < xb; x += OWORD) {
+    char *t = row + (x / TILE_Y_W) * TILE_SZ + (x % TILE_Y_W / OWORD) * OWORD * TILE_Y_H;
+    __m128i *l0 = (__m128i *)(lin0 + x - x0), *l1 = (__m128i *)(lin1 + x - x0);
+    if (to_tiled) {
+      __m256i v = _mm256_castsi128_si256(_mm_loadu_si128(l0));
+      v = _mm256_inserti128_si256(v, _mm_loadu_si128(l1), 1);
+      _mm256_storeu_si256((__m256i *)t, v);
+    } else {
+      __m256i v = _mm256_loadu_si256((const __m256i *)t);
+      _mm_storeu_si128(l0, _mm256_castsi256_si128(v));
+      _mm_storeu_si128(l1, _mm256_extracti128_si256(v, 1));
+    }
+  }
+  cl_tiling_y_row(tiled, pitch, y, lin0 + xb - x0, xb, x1, to_tiled);
+  cl_tiling_y_row(tiled, pitch, y + 1, lin1 + xb - x0, xb, x1, to_tiled);
+}
+#endif
+
+static void
+cl_image_tiling_copy(char *tiled, cl_image_tiling_t tiling,
+                     size_t pitch, size_t slice_pitch, size_t bpp,
+                     const size_t *origin, const size_t *region,
+                     char *lin, size_t lin_row_pitch, size_t lin_slice_pitch, int to_tiled)
+{
+  const size_t x0 = origin[0] * bpp, x1 = x0 + region[0] * bpp;
+  const size_t slice_rows = slice_pitch / pitch;
+  int pair = 0;
+  size_t y, z;
+
+  assert(tiling == CL_TILE_X || tiling == CL_TILE_Y);
+  assert(pitch % (tiling == CL_TILE_X ? TILE_X_W : TILE_Y_W) == 0);
+  assert(region[2] == 1 || slice_pitch % pitch == 0);
+#ifdef CL_TILING_X86
+  pair = tiling == CL_TILE_Y && __builtin_cpu_supports("avx2");
+#endif
+
+  for (z = 0; z < region[2]; z++) {
+    char *lin_row = lin + z * lin_slice_pitch;
+    const size_t row0 = (origin[2] + z) * slice_rows + origin[1];
+    for (y = 0; y < region[1]; y++, lin_row += lin_row_pitch) {
+#ifdef CL_TILING_X86
+      if (pair && (row0 + y) % 2 == 0 && y + 1 < region[1]) {
+        cl_tiling_y_row2_avx2(tiled, pitch, row0 + y, lin_row, lin_row + lin_row_pitch,
+                              x0, x1, to_tiled);
+        y++;
+        lin_row += lin_row_pitch;
+        continue;
+      }
+#endif
+      if (tiling == CL_TILE_X)
+        cl_tiling_x_row(tiled, pitch, row0 + y, lin_row, x0, x1, to_tiled);
+      else
+        cl_tiling_y_row(tiled, pitch, row0 + y, lin_row, x0, x1, to_tiled);
+    }
+  }
+}
+
+LOCAL void
+cl_image_detile(void *dst, size_t dst_row_pitch, size_t dst_slice_pitch,
+                const void *tiled, cl_image_tiling_t tiling,
+                size_t pitch, size_t slice_pitch, size_t bpp,
+                const size_t *origin, const size_t *region)
+{
+  cl_image_tiling_copy((char *)tiled, tiling, pitch, slice_pitch, bpp, origin, region,
+                       dst, dst_row_pitch, dst_slice_pitch, 0);
+}
+
+LOCAL void
+cl_image_tile(void *tiled, cl_image_tiling_t tiling,
+              size_t pitch, size_t slice_pitch, size_t bpp,
+              const size_t *origin, const size_t *region,
+              const void *src, size_t src_row_pitch, size_t src_slice_pitch)
+{
+  cl_image_tiling_copy(tiled, tiling, pitch, slice_pitch, bpp, origin, region,
+                       (char *)src, src_row_pitch, src_slice_pitch, 1);
+}
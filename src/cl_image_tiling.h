@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_IMAGE_TILING_H__
+#define __CL_IMAGE_TILING_H__
+
+#include "cl_mem.h"
+#include <stddef.h>
+
+/* Conversion between linear host layouts and the raw X / Y major tiles of
+ * an image, as seen through a CPU (non GTT) map of its buffer without bit 6
+ * swizzling. A tiled surface is pitch bytes wide and its slices are
+ * slice_pitch bytes apart in the linear (fenced) view, so slice z starts at
+ * row z * slice_pitch / pitch of one tall surface. Regions and origins are
+ * in pixels of bpp bytes, any sub-rectangle is allowed. */
+
+/* Scalar reference: offset of byte x of row y in the tiled surface */
+extern size_t cl_image_tiling_offset(cl_image_tiling_t tiling, size_t pitch, size_t x, size_t y);
+
+/* Copy a region of a tiled surface to a linear layout */
+extern void cl_image_detile(void *dst, size_t dst_row_pitch, size_t dst_slice_pitch,
+                            const void *tiled, cl_image_tiling_t tiling,
+                            size_t pitch, size_t slice_pitch, size_t bpp,
+                            const size_t *origin, const size_t *region);
+
+/* Copy a linear layout to a region of a tiled surface */
+extern void cl_image_tile(void *tiled, cl_image_tiling_t tiling,
+                          size_t pitch, size_t slice_pitch, size_t bpp,
+                          const size_t *origin, const size_t *region,
+                          const void *src, size_t src_row_pitch, size_t src_slice_pitch);
+
+#endif /* __CL_IMAGE_TILING_H__ */
@@ -36,6 +36,34 @@
 #include <stdint.h>
 #include <assert.h>
 
+LOCAL void
+cl_kernel_clear_payloads(cl_kernel k)
+{
+  uint32_t i;
+  for (i = 0; i < CL_KERNEL_PAYLOAD_CACHE_SIZE; ++i) {
+    cl_thread_payload *p = &k->payloads[i];
+    if (p->data) cl_free(p->data);
+    if (p->curbe) cl_free(p->curbe);
+    if (p->mask) cl_free(p->mask);
+    memset(p, 0, sizeof(*p));
+  }
+  k->payload_next = 0;
+}
+
+LOCAL void
+cl_kernel_release_args(cl_kernel k)
+{
+  uint32_t i;
+  for (i = 0; i < k->arg_n; ++i) {
+    if (k->args[i].mem != NULL)
+      cl_mem_delete(k->args[i].mem);
+    k->args[i].mem = NULL;
+    k->args[i].is_set = 0;
+  }
+  if (k->simd_variant)
+    cl_kernel_release_args(k->simd_variant);
+}
+
 LOCAL void
 cl_kernel_delete(cl_kernel k)
 {
@@ -61,6 +89,7 @@ cl_kernel_delete(cl_kernel k)
   if (k->ref_its_program) cl_program_delete(k->program);
   /* Release the curbe if allocated */
   if (k->curbe) cl_free(k->curbe);
+  cl_kernel_clear_payloads(k);
   /* Release the argument array if required */
   if (k->args) {
     for (i = 0; i < k->arg_n; ++i)
@@ -78,6 +107,13 @@ cl_kernel_delete(cl_kernel k)
     cl_mem_svm_delete(k->program->ctx, k->device_enqueue_ptr);
   if (k->device_enqueue_infos)
     cl_free(k->device_enqueue_infos);
+  if (k->device_enqueue_children) {
+    for (i = 0; i < k->device_enqueue_child_n; ++i)
+      cl_kernel_delete(k->device_enqueue_children[i]);
+    cl_free(k->device_enqueue_children);
+  }
+  if (k->simd_variant)
+    cl_kernel_delete(k->simd_variant);
 
   CL_OBJECT_DESTROY_BASE(k);
 
@@ -92,6 +128,7 @@ cl_kernel_new(cl_program p)
   CL_OBJECT_INIT_BASE(k, CL_OBJECT_KERNEL_MAGIC);
   k->program = p;
   k->cmrt_kernel = NULL;
+  k->internal_index = -1;
 
 exit:
   return k;
@@ -121,17 +158,15 @@ cl_kernel_add_ref(cl_kernel k)
   CL_OBJECT_INC_REF(k);
 }
 
-LOCAL cl_int
-cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
+/* Validate an argument without touching the kernel */
+static cl_int
+cl_kernel_check_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
 {
-  int32_t offset;            /* where to patch */
   enum gbe_arg_type arg_type; /* kind of argument */
   size_t arg_sz;              /* size of the argument */
   cl_mem mem = NULL;          /* for __global, __constant and image arguments */
   cl_context ctx = k->program->ctx;
 
-  if (UNLIKELY(index >= k->arg_n))
-    return CL_INVALID_ARG_INDEX;
   arg_type = interp_kernel_get_arg_type(k->opaque, index);
   arg_sz = interp_kernel_get_arg_size(k->opaque, index);
 
@@ -190,6 +225,17 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
           return CL_INVALID_ARG_VALUE;
     }
   }
+  return CL_SUCCESS;
+}
+
+/* Store a checked argument, this can not fail */
+static void
+cl_kernel_store_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
+{
+  int32_t offset;            /* where to patch */
+  enum gbe_arg_type arg_type = interp_kernel_get_arg_type(k->opaque, index);
+  size_t arg_sz = interp_kernel_get_arg_size(k->opaque, index);
+  cl_mem mem = NULL;
 
   /* Copy the structure or the value directly into the curbe */
   if (arg_type == GBE_ARG_VALUE) {
@@ -205,7 +251,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
       k->args[index].is_set = 1;
       k->args[index].mem = NULL;
       k->accel = accel;
-      return CL_SUCCESS;
+      return;
     } else {
       offset = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, index);
       if (offset >= 0) {
@@ -215,7 +261,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
       k->args[index].local_sz = 0;
       k->args[index].is_set = 1;
       k->args[index].mem = NULL;
-      return CL_SUCCESS;
+      return;
     }
   }
 
@@ -224,7 +270,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
     k->args[index].local_sz = sz;
     k->args[index].is_set = 1;
     k->args[index].mem = NULL;
-    return CL_SUCCESS;
+    return;
   }
 
   /* Is it a sampler*/
@@ -241,7 +287,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
       assert(offset + 4 <= k->curbe_sz);
       memcpy(k->curbe + offset, &sampler->clkSamplerValue, 4);
     }
-    return CL_SUCCESS;
+    return;
   }
 
   if(value != NULL)
@@ -259,7 +305,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
     k->args[index].mem = NULL;
     k->args[index].is_set = 1;
     k->args[index].local_sz = 0;
-    return CL_SUCCESS;
+    return;
   }
 
   mem = *(cl_mem*) value;
@@ -274,9 +320,24 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
     k->args[index].ptr = mem->host_ptr;
   k->args[index].local_sz = 0;
   k->args[index].bti = interp_kernel_get_arg_bti(k->opaque, index);
-  return CL_SUCCESS;
 }
 
+LOCAL cl_int
+cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
+{
+  cl_int err;
+
+  if (UNLIKELY(index >= k->arg_n))
+    return CL_INVALID_ARG_INDEX;
+  /* Check first, so that both widths always end up with the same arguments */
+  err = cl_kernel_check_arg(k, index, sz, value);
+  if (err != CL_SUCCESS)
+    return err;
+  if (k->simd_variant)
+    cl_kernel_store_arg(k->simd_variant, index, sz, value);
+  cl_kernel_store_arg(k, index, sz, value);
+  return CL_SUCCESS;
+}
 
 LOCAL cl_int
 cl_kernel_set_arg_svm_pointer(cl_kernel k, cl_uint index, const void *value)
@@ -297,6 +358,10 @@ cl_kernel_set_arg_svm_pointer(cl_kernel k, cl_uint index, const void *value)
   if(mem == NULL)
     return CL_INVALID_ARG_VALUE;
 
+  /* Checked, it can not fail on the other width */
+  if (k->simd_variant)
+    cl_kernel_set_arg_svm_pointer(k->simd_variant, index, value);
+
   cl_mem_add_ref(mem);
   if (k->args[index].mem)
     cl_mem_delete(k->args[index].mem);
@@ -314,14 +379,23 @@ LOCAL cl_int
 cl_kernel_set_exec_info(cl_kernel k, size_t n, const void *value)
 {
   cl_int err = CL_SUCCESS;
+  void *exec_info = NULL;
   assert(k != NULL);
 
   if (n == 0) return err;
-  TRY_ALLOC(k->exec_info, cl_calloc(n, 1));
-  memcpy(k->exec_info, value, n);
+  TRY_ALLOC(exec_info, cl_calloc(n, 1));
+  /* Only replace both copies once the other width has its own */
+  if (k->simd_variant)
+    TRY (cl_kernel_set_exec_info, k->simd_variant, n, value);
+  memcpy(exec_info, value, n);
+  if (k->exec_info)
+    cl_free(k->exec_info);
+  k->exec_info = exec_info;
   k->exec_info_n = n / sizeof(void *);
+  return err;
 
 error:
+  cl_free(exec_info);
   return err;
 }
 
@@ -421,6 +495,37 @@ cl_kernel_get_simd_width(cl_kernel k)
   return interp_kernel_get_simd_width(k->opaque);
 }
 
+LOCAL cl_kernel
+cl_kernel_select_simd_variant(cl_kernel k, cl_device_id device,
+                              const size_t *global_wk_sz,
+                              const size_t *local_wk_sz)
+{
+  cl_kernel simd8 = k, simd16 = k->simd_variant;
+  size_t local_sz, group_n, simd8_thread_n;
+
+  if (k->simd_variant == NULL)
+    return k;
+  if (cl_kernel_get_simd_width(k) == 16) {
+    simd8 = k->simd_variant;
+    simd16 = k;
+  }
+
+  local_sz = local_wk_sz[0] * local_wk_sz[1] * local_wk_sz[2];
+  if (local_sz > cl_get_kernel_max_wg_sz(simd8))
+    return simd16;
+  /* Small or odd work groups leave SIMD16 lanes idle */
+  if (ALIGN(local_sz, 16) - local_sz > ALIGN(local_sz, 8) - local_sz)
+    return simd8;
+  /* Otherwise SIMD16 wins once SIMD8 threads would not fit on the EUs at once */
+  group_n = (global_wk_sz[0] / local_wk_sz[0]) *
+            (global_wk_sz[1] / local_wk_sz[1]) *
+            (global_wk_sz[2] / local_wk_sz[2]);
+  simd8_thread_n = group_n * ((local_sz + 7) / 8);
+  if (simd8_thread_n > device->max_compute_unit * device->max_thread_per_unit)
+    return simd16;
+  return simd8;
+}
+
 LOCAL void
 cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
 {
@@ -466,6 +571,18 @@ cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
     interp_kernel_get_image_data(k->opaque, k->images);
   } else
     k->images = NULL;
+
+  /* The same kernel may also have been compiled at the other SIMD width */
+  gbe_kernel variant = interp_kernel_get_simd_variant(opaque);
+  if (variant != NULL) {
+    k->simd_variant = cl_kernel_new(k->program);
+    if (k->simd_variant)
+      cl_kernel_setup(k->simd_variant, variant);
+    if (k->simd_variant && k->simd_variant->bo == NULL) {
+      cl_kernel_delete(k->simd_variant);
+      k->simd_variant = NULL;
+    }
+  }
   return;
 error:
   cl_buffer_unreference(k->bo);
@@ -492,6 +609,7 @@ cl_kernel_dup(cl_kernel from)
   to->exec_info_n = from->exec_info_n;
   memcpy(to->compile_wg_sz, from->compile_wg_sz, sizeof(from->compile_wg_sz));
   to->stack_size = from->stack_size;
+  to->internal_index = -1;
   if (to->sampler_sz)
     memcpy(to->samplers, from->samplers, to->sampler_sz * sizeof(uint32_t));
   if (to->image_sz) {
@@ -516,6 +634,9 @@ cl_kernel_dup(cl_kernel from)
   cl_program_add_ref(from->program);
   to->ref_its_program = CL_TRUE;
 
+  if (from->simd_variant)
+    TRY_ALLOC_NO_ERR(to->simd_variant, cl_kernel_dup(from->simd_variant));
+
 exit:
   return to;
 error:
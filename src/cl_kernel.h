@@ -47,6 +47,22 @@ typedef struct cl_argument {
   uint32_t is_svm:1;    /* Indicate this argument is SVMPointer */
 } cl_argument;
 
+/* Number of per-thread payloads kept per kernel, enough for the 8 sub-ranges
+ * of a non-uniform ND range */
+#define CL_KERNEL_PAYLOAD_CACHE_SIZE 8
+
+/* The CURBEs of all the threads of one work group, local IDs and block IPs
+ * included, as built for one local size */
+typedef struct cl_thread_payload {
+  size_t local_wk_sz[3];
+  uint32_t simd_sz;
+  uint32_t thread_n;
+  size_t cst_sz;        /* Size of one thread CURBE */
+  char *data;           /* thread_n CURBEs, ready to upload */
+  char *curbe;          /* Uniform CURBE the data was last patched with */
+  uint64_t *mask;       /* All ones on the bytes owned by the varying payload */
+} cl_thread_payload;
+
 /* One OCL function */
 struct _cl_kernel {
   _cl_base_object base;
@@ -78,6 +94,13 @@ struct _cl_kernel {
   void* device_enqueue_ptr;     /* device_enqueue buffer*/
   uint32_t device_enqueue_info_n; /* count of parent kernel's arguments buffers, as child enqueues' exec info */
   void** device_enqueue_infos;   /* parent kernel's arguments buffers, as child enqueues' exec info   */
+  struct _cl_kernel **device_enqueue_children; /* Child kernels by block index, built on first use */
+  uint32_t device_enqueue_child_n; /* Size of device_enqueue_children */
+  struct _cl_kernel *simd_variant; /* Same kernel at the other SIMD width, arguments kept in sync */
+  atomic_t simd_launch_n[2];     /* Launches run at SIMD8 and SIMD16 */
+  cl_thread_payload payloads[CL_KERNEL_PAYLOAD_CACHE_SIZE]; /* Built per local size */
+  uint32_t payload_next;         /* Next payload slot to replace */
+  int32_t internal_index;        /* Context internal kernel slot it is recycled to, -1 if none */
 };
 
 #define CL_OBJECT_KERNEL_MAGIC 0x1234567890abedefLL
@@ -85,6 +108,12 @@ struct _cl_kernel {
          ((cl_base_object)obj)->magic == CL_OBJECT_KERNEL_MAGIC &&  \
          CL_OBJECT_GET_REF(obj) >= 1))
 
+/* Release the cached per-thread payloads */
+extern void cl_kernel_clear_payloads(cl_kernel);
+
+/* Drop the memory objects held by the arguments, leaving them unset */
+extern void cl_kernel_release_args(cl_kernel);
+
 /* Allocate an empty kernel */
 extern cl_kernel cl_kernel_new(cl_program);
 
@@ -103,6 +132,11 @@ extern const char *cl_kernel_get_attributes(cl_kernel k);
 /* Get the simd width as used in the code */
 extern uint32_t cl_kernel_get_simd_width(cl_kernel k);
 
+/* Get the kernel (itself or its SIMD variant) best suited to the launch */
+extern cl_kernel cl_kernel_select_simd_variant(cl_kernel k, cl_device_id device,
+                                               const size_t *global_wk_sz,
+                                               const size_t *local_wk_sz);
+
 /* When a kernel is created from outside, we just duplicate the structure we
  * have internally and give it back to the user
  */
@@ -29,6 +29,8 @@
 #include "cl_command_queue.h"
 #include "cl_cmrt.h"
 #include "cl_enqueue.h"
+#include "cl_event.h"
+#include "cl_host_copy.h"
 
 #include "CL/cl.h"
 #include "CL/cl_intel.h"
@@ -102,6 +104,21 @@ cl_get_pipe_info(cl_mem mem,
   return CL_SUCCESS;
 }
 
+/* Plain buffers with the default alignment may come from the context slabs */
+static cl_buffer
+cl_mem_alloc_bo(cl_context ctx, cl_buffer_mgr bufmgr, enum cl_mem_type type,
+                cl_mem_flags flags, size_t sz, size_t alignment, cl_mem mem)
+{
+  cl_buffer bo = NULL;
+
+  if (type == CL_MEM_BUFFER_TYPE && alignment == 64 &&
+      !(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR)))
+    bo = cl_mem_slab_alloc(&ctx->buffer_slabs, bufmgr, sz, &mem->offset, &mem->slab);
+  if (bo == NULL)
+    bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+  return bo;
+}
+
 LOCAL cl_mem
 cl_mem_allocate(enum cl_mem_type type,
                 cl_context ctx,
@@ -148,6 +165,7 @@ cl_mem_allocate(enum cl_mem_type type,
   mem->flags = flags;
   mem->is_userptr = 0;
   mem->offset = 0;
+  mem->slab = NULL;
   mem->is_svm = 0;
   mem->cmrt_mem = NULL;
   if (mem->type == CL_MEM_IMAGE_TYPE) {
@@ -242,14 +260,14 @@ cl_mem_allocate(enum cl_mem_type type,
     }
 
     if (!bufCreated)
-      mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+      mem->bo = cl_mem_alloc_bo(ctx, bufmgr, type, flags, sz, alignment, mem);
 #else
     if(type == CL_MEM_IMAGE_TYPE && buffer != NULL) {
       // if the image if created from buffer, should use the bo directly to share same bo.
       mem->bo = buffer->bo;
       cl_mem_image(mem)->is_image_from_buffer = 1;
     } else
-      mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
+      mem->bo = cl_mem_alloc_bo(ctx, bufmgr, type, flags, sz, alignment, mem);
 #endif
 
     if (UNLIKELY(mem->bo == NULL)) {
@@ -260,7 +278,8 @@ cl_mem_allocate(enum cl_mem_type type,
   }
 
   /* Append the buffer in the context buffer list */
-  cl_context_add_mem(ctx, mem);
+  if ((err = cl_context_add_mem(ctx, mem)) != CL_SUCCESS)
+    goto error;
 
 exit:
   if (errcode)
@@ -276,25 +295,11 @@ error:
 LOCAL cl_int
 cl_mem_is_valid(cl_mem mem, cl_context ctx)
 {
-  struct list_node *pos;
-  cl_base_object pbase_object;
-
-  CL_OBJECT_LOCK(ctx);
-  list_for_each (pos, (&ctx->mem_objects)) {
-    pbase_object = list_entry(pos, _cl_base_object, node);
-    if (pbase_object == (cl_base_object)mem) {
-      if (UNLIKELY(!CL_OBJECT_IS_MEM(mem))) {
-        CL_OBJECT_UNLOCK(ctx);
-        return CL_INVALID_MEM_OBJECT;
-      }
-
-      CL_OBJECT_UNLOCK(ctx);
-      return CL_SUCCESS;
-    }
-  }
-
-  CL_OBJECT_UNLOCK(ctx);
-  return CL_INVALID_MEM_OBJECT;
+  if (!cl_mem_registry_contains(&ctx->mem_objects, mem))
+    return CL_INVALID_MEM_OBJECT;
+  if (UNLIKELY(!CL_OBJECT_IS_MEM(mem)))
+    return CL_INVALID_MEM_OBJECT;
+  return CL_SUCCESS;
 }
 
 LOCAL cl_mem
@@ -373,14 +378,15 @@ cl_mem_new_buffer(cl_context ctx,
     if (mem->is_userptr)
       memcpy(mem->host_ptr, data, sz);
     else
-      cl_buffer_subdata(mem->bo, 0, sz, data);
+      cl_buffer_subdata(mem->bo, mem->offset, sz, data);
   }
 
   if ((flags & CL_MEM_USE_HOST_PTR) && !mem->is_userptr)
-    cl_buffer_subdata(mem->bo, 0, sz, data);
+    cl_buffer_subdata(mem->bo, mem->offset, sz, data);
 
-  if (flags & CL_MEM_USE_HOST_PTR)
-    mem->host_ptr = data;
+  if ((flags & CL_MEM_USE_HOST_PTR) &&
+      (err = cl_context_set_mem_host_ptr(ctx, mem, data)) != CL_SUCCESS)
+    goto error;
 
 exit:
   if (errcode_ret)
@@ -482,7 +488,8 @@ cl_mem_new_sub_buffer(cl_mem buffer,
   }
 
   /* Append the buffer in the context buffer list */
-  cl_context_add_mem(buffer->ctx, mem);
+  if ((err = cl_context_add_mem(buffer->ctx, mem)) != CL_SUCCESS)
+    goto error;
 
 exit:
   if (errcode_ret)
@@ -556,6 +563,43 @@ error:
 
 }
 
+LOCAL cl_int
+cl_mem_evict_slab(cl_mem mem)
+{
+  struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem, *sub;
+  cl_buffer bo;
+  void *src;
+
+  if (mem->type == CL_MEM_SUBBUFFER_TYPE) {
+    buffer = buffer->parent;
+    mem = &buffer->base;
+  }
+  if (mem->slab == NULL)
+    return CL_SUCCESS;
+  /* Mapped pointers would be left in the slab */
+  if (mem->map_ref > 0)
+    return CL_INVALID_OPERATION;
+
+  bo = cl_buffer_alloc(cl_context_get_bufmgr(mem->ctx), "CL memory object", mem->size, 64);
+  if (bo == NULL)
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  src = cl_mem_map(mem, 0);
+  cl_buffer_subdata(bo, 0, mem->size, src);
+  cl_mem_unmap(mem);
+
+  cl_mem_slab_free(&mem->ctx->buffer_slabs, mem->slab, mem->offset, mem->size);
+  mem->slab = NULL;
+  mem->offset = 0;
+  mem->bo = bo;
+  pthread_mutex_lock(&buffer->sub_lock);
+  for (sub = buffer->subs; sub; sub = sub->sub_next) {
+    sub->base.bo = bo;
+    sub->base.offset = 0;
+  }
+  pthread_mutex_unlock(&buffer->sub_lock);
+  return CL_SUCCESS;
+}
+
 void cl_mem_replace_buffer(cl_mem buffer, cl_buffer new_bo)
 {
   cl_buffer_unreference(buffer->bo);
@@ -642,7 +686,10 @@ void* cl_mem_svm_allocate(cl_context ctx, cl_svm_mem_flags flags,
   cl_buffer_set_bo_use_full_range(mem->bo, 1);
 
   /* Append the svm in the context buffer list */
-  cl_context_add_mem(ctx, mem);
+  if (cl_context_add_mem(ctx, mem) != CL_SUCCESS) {
+    cl_mem_delete(mem);
+    return NULL;
+  }
 #endif
 
   return ptr;
@@ -665,21 +712,11 @@ cl_mem_copy_image_region(const size_t *origin, const size_t *region,
   if (!origin[0] && region[0] == image->w && dst_row_pitch == src_row_pitch &&
       (region[2] == 1 || (!origin[1] && region[1] == image->h && dst_slice_pitch == src_slice_pitch)))
   {
-    memcpy(dst, src, region[2] == 1 ? src_row_pitch*region[1] : src_slice_pitch*region[2]);
+    cl_host_copy(dst, src, region[2] == 1 ? src_row_pitch*region[1] : src_slice_pitch*region[2]);
   }
   else {
-    cl_uint y, z;
-    for (z = 0; z < region[2]; z++) {
-      const char* src_ptr = src;
-      char* dst_ptr = dst;
-      for (y = 0; y < region[1]; y++) {
-        memcpy(dst_ptr, src_ptr, image->bpp*region[0]);
-        src_ptr += src_row_pitch;
-        dst_ptr += dst_row_pitch;
-      }
-      src = (char*)src + src_slice_pitch;
-      dst = (char*)dst + dst_slice_pitch;
-    }
+    cl_host_copy_rect(dst, dst_row_pitch, dst_slice_pitch, src, src_row_pitch, src_slice_pitch,
+                      image->bpp*region[0], region[1], region[2]);
   }
 }
 
@@ -693,18 +730,9 @@ cl_mem_copy_image_to_image(const size_t *dst_origin,const size_t *src_origin, co
   size_t src_offset = src_image->bpp * src_origin[0] + src_image->row_pitch * src_origin[1] + src_image->slice_pitch * src_origin[2];
   dst= (char*)dst+ dst_offset;
   src= (char*)src+ src_offset;
-  cl_uint y, z;
-  for (z = 0; z < region[2]; z++) {
-    const char* src_ptr = src;
-    char* dst_ptr = dst;
-    for (y = 0; y < region[1]; y++) {
-      memcpy(dst_ptr, src_ptr, src_image->bpp*region[0]);
-      src_ptr += src_image->row_pitch;
-      dst_ptr += dst_image->row_pitch;
-    }
-    src = (char*)src + src_image->slice_pitch;
-    dst = (char*)dst + dst_image->slice_pitch;
-  }
+  cl_host_copy_rect(dst, dst_image->row_pitch, dst_image->slice_pitch,
+                    src, src_image->row_pitch, src_image->slice_pitch,
+                    src_image->bpp*region[0], region[1], region[2]);
 
   cl_mem_unmap_auto((cl_mem)src_image);
   cl_mem_unmap_auto((cl_mem)dst_image);
@@ -826,7 +854,11 @@ _cl_new_image_copy_from_host_ptr(cl_context ctx,
 
   clReleaseMemObject(buf);
   if (flags & CL_MEM_USE_HOST_PTR && data) {
-    mem->host_ptr = data;
+    if ((err = cl_context_set_mem_host_ptr(ctx, mem, data)) != CL_SUCCESS) {
+      *errcode_ret = err;
+      clReleaseMemObject(mem);
+      return NULL;
+    }
     cl_mem_image(mem)->host_row_pitch = pitch;
     cl_mem_image(mem)->host_slice_pitch = slice_pitch;
   }
@@ -1078,7 +1110,8 @@ _cl_mem_new_image(cl_context ctx,
     cl_mem_copy_image(cl_mem_image(mem), pitch, slice_pitch, data);
 
   if (flags & CL_MEM_USE_HOST_PTR && data) {
-    mem->host_ptr = data;
+    if ((err = cl_context_set_mem_host_ptr(ctx, mem, data)) != CL_SUCCESS)
+      goto error;
     cl_mem_image(mem)->host_row_pitch = pitch;
     cl_mem_image(mem)->host_slice_pitch = slice_pitch;
     if (!enableUserptr)
@@ -1309,6 +1342,10 @@ _cl_mem_new_image_from_buffer(cl_context ctx,
     merged_flags &= ~(CL_MEM_HOST_WRITE_ONLY|CL_MEM_HOST_READ_ONLY|CL_MEM_HOST_NO_ACCESS);
     merged_flags |= flags & (CL_MEM_HOST_WRITE_ONLY|CL_MEM_HOST_READ_ONLY|CL_MEM_HOST_NO_ACCESS);
   }
+  /* The image surface starts at the BO, which must be the buffer's own */
+  if ((err = cl_mem_evict_slab(buffer)) != CL_SUCCESS)
+    goto error;
+
   struct _cl_mem_buffer *mem_buffer = (struct _cl_mem_buffer*)buffer;
   if (buffer->type == CL_MEM_SUBBUFFER_TYPE) {
     offset = ((struct _cl_mem_buffer *)buffer)->sub_offset;
@@ -1366,8 +1403,9 @@ _cl_mem_new_image_from_buffer(cl_context ctx,
   if (image_desc->image_type == CL_MEM_OBJECT_IMAGE1D_BUFFER)
     cl_mem_replace_buffer(buffer, image->bo);
   /* Now point to the right offset if buffer is a SUB_BUFFER. */
-  if (buffer->flags & CL_MEM_USE_HOST_PTR)
-    image->host_ptr = buffer->host_ptr + offset;
+  if ((buffer->flags & CL_MEM_USE_HOST_PTR) &&
+      (err = cl_context_set_mem_host_ptr(image->ctx, image, buffer->host_ptr + offset)) != CL_SUCCESS)
+    goto error;
   cl_mem_image(image)->offset = offset;
   cl_mem_add_ref(buffer);
   cl_mem_image(image)->buffer_1d = buffer;
@@ -1528,6 +1566,8 @@ cl_mem_delete(cl_mem mem)
     cl_mem svm_mem = cl_context_get_svm_from_ptr(mem->ctx, mem->host_ptr);
     if (svm_mem != NULL)
       cl_mem_delete(svm_mem);
+  } else if (mem->slab) {
+    cl_mem_slab_free(&mem->ctx->buffer_slabs, mem->slab, mem->offset, mem->size);
   } else if (LIKELY(mem->bo != NULL)) {
     cl_buffer_unreference(mem->bo);
   }
@@ -1556,6 +1596,15 @@ cl_mem_add_ref(cl_mem mem)
 #define LOCAL_SZ_1   4
 #define LOCAL_SZ_2   4
 
+/* Small enough for the CPU to do it when the command runs, which saves the
+ * whole GPU state setup and submission of an internal kernel */
+static cl_bool
+cl_mem_use_host_path(cl_command_queue queue, cl_event event, cl_mem mem, size_t size)
+{
+  return event != NULL && size <= queue->host_path.max &&
+         (mem->type == CL_MEM_BUFFER_TYPE || mem->type == CL_MEM_SUBBUFFER_TYPE);
+}
+
 LOCAL cl_int
 cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_buf,
             size_t src_offset, size_t dst_offset, size_t cb)
@@ -1576,6 +1625,24 @@ cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_b
   /* We use one kernel to copy the data. The kernel is lazily created. */
   assert(src_buf->ctx == dst_buf->ctx);
 
+  if (cl_mem_use_host_path(queue, event, src_buf, cb) &&
+      cl_mem_use_host_path(queue, event, dst_buf, cb)) {
+    enqueue_data *data = &event->exec_data;
+    cl_mem_add_ref(src_buf);
+    cl_mem_add_ref(dst_buf);
+    data->type = EnqueueCopyBufferHost;
+    data->src_mem = src_buf;
+    data->src_offset = src_offset;
+    data->mem_obj = dst_buf;
+    data->offset = dst_offset;
+    data->size = cb;
+    atomic_inc(&queue->host_path.copy_n[0]);
+    return ret;
+  }
+  /* Internal copies, without an event of their own, can not go to the host */
+  if (event != NULL)
+    atomic_inc(&queue->host_path.copy_n[1]);
+
   /* All 16 bytes aligned, fast and easy one. */
   if((cb % 16 == 0) && (src_offset % 16 == 0) && (dst_offset % 16 == 0)) {
     extern char cl_internal_copy_buf_align16_str[];
@@ -1612,7 +1679,7 @@ cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_b
     cl_kernel_set_arg(ker, 4, sizeof(int), &cb);
     ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
                                     global_off, global_sz, global_sz, local_sz, local_sz);
-    cl_kernel_delete(ker);
+    cl_context_put_static_kernel(queue->ctx, ker);
     return ret;
   }
 
@@ -1654,7 +1721,7 @@ cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_b
     cl_kernel_set_arg(ker, 6, sizeof(int), &last_mask);
     ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
                                     global_off, global_sz, global_sz, local_sz, local_sz);
-    cl_kernel_delete(ker);
+    cl_context_put_static_kernel(queue->ctx, ker);
     return ret;
   }
 
@@ -1685,7 +1752,7 @@ cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_b
     cl_kernel_set_arg(ker, 8, sizeof(int), &dw_mask);
     ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
                                     global_off, global_sz, global_sz, local_sz, local_sz);
-    cl_kernel_delete(ker);
+    cl_context_put_static_kernel(queue->ctx, ker);
     return ret;
   }
 
@@ -1718,7 +1785,7 @@ cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_b
     cl_kernel_set_arg(ker, 9, sizeof(int), &src_less);
     ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
                                     global_off, global_sz, global_sz, local_sz, local_sz);
-    cl_kernel_delete(ker);
+    cl_context_put_static_kernel(queue->ctx, ker);
     return ret;
   }
 
@@ -1811,7 +1878,7 @@ cl_image_fill(cl_command_queue queue, cl_event e, const void * pattern, struct _
 
   ret = cl_command_queue_ND_range(queue, ker, e, 3, global_off,
                                   global_off, global_sz, global_sz, local_sz, local_sz);
-  cl_kernel_delete(ker);
+  cl_context_put_static_kernel(queue->ctx, ker);
   src_image->intel_fmt = savedIntelFmt;
   return ret;
 }
@@ -1835,6 +1902,25 @@ cl_mem_fill(cl_command_queue queue, cl_event e, const void * pattern, size_t pat
   if (!size)
     return ret;
 
+  if (cl_mem_use_host_path(queue, e, buffer, size)) {
+    enqueue_data *data = &e->exec_data;
+    void *pattern_copy = cl_malloc(pattern_size);
+    if (pattern_copy == NULL)
+      return CL_OUT_OF_HOST_MEMORY;
+    memcpy(pattern_copy, pattern, pattern_size);
+    cl_mem_add_ref(buffer);
+    data->type = EnqueueFillBufferHost;
+    data->mem_obj = buffer;
+    data->offset = offset;
+    data->size = size;
+    data->const_ptr = pattern_copy;
+    data->pattern_size = pattern_size;
+    atomic_inc(&queue->host_path.fill_n[0]);
+    return ret;
+  }
+  if (e != NULL)
+    atomic_inc(&queue->host_path.fill_n[1]);
+
   if (pattern_size == 128) {
     /* 128 is according to pattern of double16, but double works not very
        well on some platform. We use two float16 to handle this. */
@@ -1916,7 +2002,7 @@ cl_mem_fill(cl_command_queue queue, cl_event e, const void * pattern, size_t pat
 
   ret = cl_command_queue_ND_range(queue, ker, e, 1, global_off,
                                   global_off, global_sz, global_sz, local_sz, local_sz);
-  cl_kernel_delete(ker);
+  cl_context_put_static_kernel(queue->ctx, ker);
   return ret;
 }
 
@@ -1990,7 +2076,7 @@ cl_mem_copy_buffer_rect(cl_command_queue queue, cl_event event, cl_mem src_buf,
 
   ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
                                   global_off, global_sz, global_sz, local_sz, local_sz);
-  cl_kernel_delete(ker);
+  cl_context_put_static_kernel(queue->ctx, ker);
   return ret;
 }
 
@@ -2145,7 +2231,7 @@ cl_mem_kernel_copy_image(cl_command_queue queue, cl_event event, struct _cl_mem_
 
 fail:
 
-  cl_kernel_delete(ker);
+  cl_context_put_static_kernel(queue->ctx, ker);
   if (fixupDataType) {
     src_image->intel_fmt = savedIntelFmt;
     dst_image->intel_fmt = savedIntelFmt;
@@ -2290,7 +2376,7 @@ cl_mem_copy_image_to_buffer(cl_command_queue queue, cl_event event, struct _cl_m
 
 fail:
 
-  cl_kernel_delete(ker);
+  cl_context_put_static_kernel(queue->ctx, ker);
   image->intel_fmt = intel_fmt;
   image->bpp = bpp;
   image->w = w_saved;
@@ -2400,7 +2486,7 @@ cl_mem_copy_buffer_to_image(cl_command_queue queue, cl_event event, cl_mem buffe
 
   ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
                                   global_off, global_sz, global_sz, local_sz, local_sz);
-  cl_kernel_delete(ker);
+  cl_context_put_static_kernel(queue->ctx, ker);
 
   image->intel_fmt = intel_fmt;
   image->bpp = bpp;
@@ -2410,12 +2496,20 @@ cl_mem_copy_buffer_to_image(cl_command_queue queue, cl_event event, cl_mem buffe
 }
 
 
+/* Offset of the data in the CPU map of the BO. Userptr objects keep their
+ * page offset: their maps return the page aligned address */
+static INLINE size_t
+cl_mem_bo_offset(cl_mem mem)
+{
+  return mem->is_userptr ? 0 : mem->offset;
+}
+
 LOCAL void*
 cl_mem_map(cl_mem mem, int write)
 {
   cl_buffer_map(mem->bo, write);
   assert(cl_buffer_get_virtual(mem->bo));
-  return cl_buffer_get_virtual(mem->bo);
+  return (char *)cl_buffer_get_virtual(mem->bo) + cl_mem_bo_offset(mem);
 }
 
 LOCAL cl_int
@@ -2431,7 +2525,7 @@ cl_mem_map_gtt(cl_mem mem)
   cl_buffer_map_gtt(mem->bo);
   assert(cl_buffer_get_virtual(mem->bo));
   mem->mapped_gtt = 1;
-  return cl_buffer_get_virtual(mem->bo);
+  return (char *)cl_buffer_get_virtual(mem->bo) + cl_mem_bo_offset(mem);
 }
 
 LOCAL void *
@@ -2439,7 +2533,7 @@ cl_mem_map_gtt_unsync(cl_mem mem)
 {
   cl_buffer_map_gtt_unsync(mem->bo);
   assert(cl_buffer_get_virtual(mem->bo));
-  return cl_buffer_get_virtual(mem->bo);
+  return (char *)cl_buffer_get_virtual(mem->bo) + cl_mem_bo_offset(mem);
 }
 
 LOCAL cl_int
@@ -2452,10 +2546,6 @@ cl_mem_unmap_gtt(cl_mem mem)
 LOCAL void*
 cl_mem_map_auto(cl_mem mem, int write)
 {
-  //if mem is not created from userptr, the offset should be always zero.
-  if (!mem->is_userptr)
-    assert(mem->offset == 0);
-
   if (IS_IMAGE(mem) && cl_mem_image(mem)->tiling != CL_NO_TILE)
     return cl_mem_map_gtt(mem);
   else {
@@ -2593,6 +2683,9 @@ cl_mem_get_fd(cl_mem mem,
               int* fd)
 {
   cl_int err = CL_SUCCESS;
+  /* Export the buffer alone, not its slab */
+  if ((err = cl_mem_evict_slab(mem)) != CL_SUCCESS)
+    return err;
   if(cl_buffer_get_fd(mem->bo, fd))
 	err = CL_INVALID_OPERATION;
   return err;
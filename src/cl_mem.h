@@ -100,7 +100,9 @@ typedef  struct _cl_mem {
   list_head dstr_cb_head;   /* All destroy callbacks. */
   uint8_t is_userptr;       /* CL_MEM_USE_HOST_PTR is enabled */
   cl_bool is_svm;           /* This object  is svm */
-  size_t offset;            /* offset of host_ptr to the page beginning, only for CL_MEM_USE_HOST_PTR*/
+  size_t offset;            /* offset of host_ptr to the page beginning for CL_MEM_USE_HOST_PTR, of the chunk in the slab BO for slab buffers */
+  struct _cl_mem_slab *slab;/* Slab the buffer is carved out of, NULL if it owns its BO */
+  cl_ulong registry_seq;    /* Registration order in the context */
 
   uint8_t cmrt_mem_type;    /* CmBuffer, CmSurface2D, ... */
   void* cmrt_mem;
@@ -354,6 +356,10 @@ extern cl_mem cl_mem_new_libva_image(cl_context ctx,
 
 extern cl_int cl_mem_get_fd(cl_mem mem, int* fd);
 
+/* Move a slab allocated buffer (or the parent of a sub-buffer) to a BO of
+ * its own, for the users of the whole BO */
+extern cl_int cl_mem_evict_slab(cl_mem mem);
+
 extern cl_mem cl_mem_new_buffer_from_fd(cl_context ctx,
                                         int fd,
                                         int buffer_sz,
@@ -0,0 +1,453 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_mem_registry.h"
+#include "cl_mem.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CL_MEM_REGISTRY_MIN_SLOTS 64
+#define CL_MEM_REGISTRY_DELETED ((cl_mem)(uintptr_t)1)
+
+static inline cl_uint
+cl_mem_registry_hash(cl_mem mem, cl_uint cap)
+{
+  uint64_t h = (uintptr_t)mem >> 4;
+  h *= 0x9E3779B97F4A7C15ull;
+  return (cl_uint)(h >> 32) & (cap - 1);
+}
+
+static int
+cl_mem_registry_rehash(cl_mem_registry *reg, cl_uint cap)
+{
+  cl_mem *slots = cl_calloc(cap, sizeof(cl_mem));
+  cl_uint i, j;
+
+  if (slots == NULL)
+    return -1;
+  for (i = 0; i < reg->slot_cap; i++) {
+    cl_mem mem = reg->slots[i];
+    if (mem == NULL || mem == CL_MEM_REGISTRY_DELETED)
+      continue;
+    j = cl_mem_registry_hash(mem, cap);
+    while (slots[j] != NULL)
+      j = (j + 1) & (cap - 1);
+    slots[j] = mem;
+  }
+  cl_free(reg->slots);
+  reg->slots = slots;
+  reg->slot_cap = cap;
+  reg->slot_used = reg->count;
+  return 0;
+}
+
+static cl_int
+cl_mem_registry_insert_slot(cl_mem_registry *reg, cl_mem mem)
+{
+  cl_uint i;
+
+  /* Keep the load, deleted markers included, under one half */
+  if ((reg->slot_used + 1) * 2 > reg->slot_cap) {
+    cl_uint cap = reg->slot_cap ? reg->slot_cap : CL_MEM_REGISTRY_MIN_SLOTS;
+    while ((reg->count + 1) * 4 > cap)
+      cap *= 2;
+    if (cl_mem_registry_rehash(reg, cap) != 0) {
+      DEBUGP(DL_ERROR, "Can not grow the memory object registry");
+      return -1;
+    }
+  }
+
+  i = cl_mem_registry_hash(mem, reg->slot_cap);
+  while (reg->slots[i] != NULL && reg->slots[i] != CL_MEM_REGISTRY_DELETED)
+    i = (i + 1) & (reg->slot_cap - 1);
+  if (reg->slots[i] == NULL)
+    reg->slot_used++;
+  reg->slots[i] = mem;
+  reg->count++;
+  return 0;
+}
+
+static cl_int
+cl_mem_registry_find_slot(cl_mem_registry *reg, cl_mem mem)
+{
+  cl_uint i, probe;
+
+  if (reg->slot_cap == 0)
+    return -1;
+  i = cl_mem_registry_hash(mem, reg->slot_cap);
+  for (probe = 0; probe < reg->slot_cap; probe++) {
+    if (reg->slots[i] == NULL)
+      return -1;
+    if (reg->slots[i] == mem)
+      return i;
+    i = (i + 1) & (reg->slot_cap - 1);
+  }
+  return -1;
+}
+
+static inline int
+cl_mem_range_height(const cl_mem_range *node)
+{
+  return node ? node->height : 0;
+}
+
+/* Recompute the summary of a node from its children */
+static void
+cl_mem_range_update(cl_mem_range *node)
+{
+  const cl_mem_range *kids[2] = {node->left, node->right};
+  int i, h = 0;
+
+  node->max_end = node->end;
+  node->min_seq = node->seq;
+  for (i = 0; i < 2; i++) {
+    if (kids[i] == NULL)
+      continue;
+    if (kids[i]->max_end > node->max_end)
+      node->max_end = kids[i]->max_end;
+    if (kids[i]->min_seq < node->min_seq)
+      node->min_seq = kids[i]->min_seq;
+    if (kids[i]->height > h)
+      h = kids[i]->height;
+  }
+  node->height = h + 1;
+}
+
+static cl_mem_range *
+cl_mem_range_rotate_right(cl_mem_range *node)
+{
+  cl_mem_range *top = node->left;
+  node->left = top->right;
+  top->right = node;
+  cl_mem_range_update(node);
+  cl_mem_range_update(top);
+  return top;
+}
+
+static cl_mem_range *
+cl_mem_range_rotate_left(cl_mem_range *node)
+{
+  cl_mem_range *top = node->right;
+  node->right = top->left;
+  top->left = node;
+  cl_mem_range_update(node);
+  cl_mem_range_update(top);
+  return top;
+}
+
+static cl_mem_range *
+cl_mem_range_balance(cl_mem_range *node)
+{
+  int diff;
+
+  cl_mem_range_update(node);
+  diff = cl_mem_range_height(node->left) - cl_mem_range_height(node->right);
+  if (diff > 1) {
+    if (cl_mem_range_height(node->left->left) < cl_mem_range_height(node->left->right))
+      node->left = cl_mem_range_rotate_left(node->left);
+    return cl_mem_range_rotate_right(node);
+  }
+  if (diff < -1) {
+    if (cl_mem_range_height(node->right->right) < cl_mem_range_height(node->right->left))
+      node->right = cl_mem_range_rotate_right(node->right);
+    return cl_mem_range_rotate_left(node);
+  }
+  return node;
+}
+
+static inline cl_bool
+cl_mem_range_before(uintptr_t start, cl_ulong seq, const cl_mem_range *node)
+{
+  return start < node->start || (start == node->start && seq < node->seq);
+}
+
+static cl_mem_range *
+cl_mem_range_insert_node(cl_mem_range *node, cl_mem_range *range)
+{
+  if (node == NULL)
+    return range;
+  if (cl_mem_range_before(range->start, range->seq, node))
+    node->left = cl_mem_range_insert_node(node->left, range);
+  else
+    node->right = cl_mem_range_insert_node(node->right, range);
+  return cl_mem_range_balance(node);
+}
+
+/* Unlink the first range of a subtree into *first */
+static cl_mem_range *
+cl_mem_range_unlink_first(cl_mem_range *node, cl_mem_range **first)
+{
+  if (node->left == NULL) {
+    *first = node;
+    return node->right;
+  }
+  node->left = cl_mem_range_unlink_first(node->left, first);
+  return cl_mem_range_balance(node);
+}
+
+static cl_mem_range *
+cl_mem_range_remove_node(cl_mem_range *node, uintptr_t start, cl_ulong seq, cl_mem_range **removed)
+{
+  cl_mem_range *next;
+
+  if (node == NULL)
+    return NULL;
+  if (start == node->start && seq == node->seq) {
+    *removed = node;
+    if (node->left == NULL || node->right == NULL)
+      return node->left ? node->left : node->right;
+    node->right = cl_mem_range_unlink_first(node->right, &next);
+    next->left = node->left;
+    next->right = node->right;
+    return cl_mem_range_balance(next);
+  }
+  if (cl_mem_range_before(start, seq, node))
+    node->left = cl_mem_range_remove_node(node->left, start, seq, removed);
+  else
+    node->right = cl_mem_range_remove_node(node->right, start, seq, removed);
+  return cl_mem_range_balance(node);
+}
+
+static void
+cl_mem_range_free_nodes(cl_mem_range *node)
+{
+  if (node == NULL)
+    return;
+  cl_mem_range_free_nodes(node->left);
+  cl_mem_range_free_nodes(node->right);
+  cl_free(node);
+}
+
+/* A sub-buffer inside the host range of its parent is never found, as the
+ * parent is older. Keeping it out of the index bounds the ranges a lookup
+ * walks when many sub-buffers share the host pointer of their parent. */
+static cl_bool
+cl_mem_range_shadowed(cl_mem mem)
+{
+  struct _cl_mem_buffer *parent;
+  uintptr_t start;
+
+  if (mem->type != CL_MEM_SUBBUFFER_TYPE)
+    return CL_FALSE;
+  parent = ((struct _cl_mem_buffer *)mem)->parent;
+  start = (uintptr_t)parent->base.host_ptr;
+  return start != 0 &&
+         (uintptr_t)mem->host_ptr >= start &&
+         (uintptr_t)mem->host_ptr + mem->size <= start + parent->base.size;
+}
+
+static cl_int
+cl_mem_range_insert(cl_mem_range_index *index, cl_mem mem, cl_ulong seq)
+{
+  cl_mem_range *range = cl_calloc(1, sizeof(cl_mem_range));
+
+  if (range == NULL) {
+    DEBUGP(DL_ERROR, "Can not grow the memory object range index");
+    return -1;
+  }
+  range->start = (uintptr_t)mem->host_ptr;
+  range->end = range->start + mem->size;
+  range->seq = seq;
+  range->mem = mem;
+  cl_mem_range_update(range);
+  index->root = cl_mem_range_insert_node(index->root, range);
+  index->n++;
+  return 0;
+}
+
+/* Does nothing if the range of mem is not in the index */
+static void
+cl_mem_range_remove(cl_mem_range_index *index, cl_mem mem)
+{
+  cl_mem_range *removed = NULL;
+
+  index->root = cl_mem_range_remove_node(index->root, (uintptr_t)mem->host_ptr,
+                                         mem->registry_seq, &removed);
+  if (removed) {
+    index->n--;
+    cl_free(removed);
+  }
+}
+
+/* Oldest range holding addr. A subtree is skipped when none of its ranges
+ * reaches addr or none is older than the best found so far, so the walk
+ * is O((k + 1) log n) for k ranges holding addr. */
+static void
+cl_mem_range_find_node(const cl_mem_range *node, uintptr_t addr, const cl_mem_range **best)
+{
+  while (node != NULL) {
+    if (node->max_end <= addr || (*best && node->min_seq >= (*best)->seq))
+      return;
+    if (node->start > addr) {
+      node = node->left;
+      continue;
+    }
+    if (node->end > addr && (*best == NULL || node->seq < (*best)->seq))
+      *best = node;
+    cl_mem_range_find_node(node->left, addr, best);
+    node = node->right;
+  }
+}
+
+static cl_mem
+cl_mem_range_find(const cl_mem_range_index *index, uintptr_t addr)
+{
+  const cl_mem_range *best = NULL;
+  cl_mem_range_find_node(index->root, addr, &best);
+  return best ? best->mem : NULL;
+}
+
+static inline cl_bool
+cl_mem_is_svm_alloc(cl_mem mem)
+{
+  return mem->host_ptr != NULL && mem->is_svm && mem->type == CL_MEM_SVM_TYPE;
+}
+
+LOCAL void
+cl_mem_registry_init(cl_mem_registry *reg)
+{
+  memset(reg, 0, sizeof(*reg));
+  pthread_rwlock_init(&reg->lock, NULL);
+}
+
+LOCAL void
+cl_mem_registry_destroy(cl_mem_registry *reg)
+{
+  assert(reg->count == 0);
+  cl_free(reg->slots);
+  cl_mem_range_free_nodes(reg->host_ranges.root);
+  cl_mem_range_free_nodes(reg->svm_ranges.root);
+  pthread_rwlock_destroy(&reg->lock);
+}
+
+/* Must be called with the write lock. Whatever part of mem is registered
+ * goes away */
+static void
+cl_mem_registry_remove_locked(cl_mem_registry *reg, cl_mem mem)
+{
+  cl_int i;
+
+  i = cl_mem_registry_find_slot(reg, mem);
+  if (i >= 0) {
+    reg->slots[i] = CL_MEM_REGISTRY_DELETED;
+    reg->count--;
+  }
+  if (mem->host_ptr)
+    cl_mem_range_remove(&reg->host_ranges, mem);
+  if (cl_mem_is_svm_alloc(mem))
+    cl_mem_range_remove(&reg->svm_ranges, mem);
+}
+
+LOCAL cl_int
+cl_mem_registry_add(cl_mem_registry *reg, cl_mem mem)
+{
+  cl_int err = CL_SUCCESS;
+
+  pthread_rwlock_wrlock(&reg->lock);
+  if (cl_mem_registry_insert_slot(reg, mem) != 0) {
+    err = CL_OUT_OF_HOST_MEMORY;
+    goto exit;
+  }
+  mem->registry_seq = ++reg->seq;
+  if ((mem->host_ptr && !cl_mem_range_shadowed(mem) &&
+       cl_mem_range_insert(&reg->host_ranges, mem, mem->registry_seq) != 0) ||
+      (cl_mem_is_svm_alloc(mem) &&
+       cl_mem_range_insert(&reg->svm_ranges, mem, mem->registry_seq) != 0)) {
+    cl_mem_registry_remove_locked(reg, mem);
+    err = CL_OUT_OF_HOST_MEMORY;
+  }
+exit:
+  pthread_rwlock_unlock(&reg->lock);
+  return err;
+}
+
+LOCAL void
+cl_mem_registry_remove(cl_mem_registry *reg, cl_mem mem)
+{
+  pthread_rwlock_wrlock(&reg->lock);
+  cl_mem_registry_remove_locked(reg, mem);
+  pthread_rwlock_unlock(&reg->lock);
+}
+
+LOCAL cl_int
+cl_mem_registry_set_host_ptr(cl_mem_registry *reg, cl_mem mem, void *host_ptr)
+{
+  cl_int err = CL_SUCCESS;
+
+  pthread_rwlock_wrlock(&reg->lock);
+  if (mem->host_ptr)
+    cl_mem_range_remove(&reg->host_ranges, mem);
+  mem->host_ptr = host_ptr;
+  if (mem->host_ptr && !cl_mem_range_shadowed(mem) &&
+      cl_mem_range_insert(&reg->host_ranges, mem, mem->registry_seq) != 0)
+    err = CL_OUT_OF_HOST_MEMORY;
+
+  /* The sub-buffers it shadowed may now be found, and the other way round */
+  if (mem->type == CL_MEM_BUFFER_TYPE) {
+    struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem;
+    struct _cl_mem_buffer *sub;
+    pthread_mutex_lock(&buffer->sub_lock);
+    for (sub = buffer->subs; sub != NULL; sub = sub->sub_next) {
+      if (sub->base.host_ptr == NULL)
+        continue;
+      cl_mem_range_remove(&reg->host_ranges, &sub->base);
+      if (!cl_mem_range_shadowed(&sub->base) &&
+          cl_mem_range_insert(&reg->host_ranges, &sub->base, sub->base.registry_seq) != 0)
+        err = CL_OUT_OF_HOST_MEMORY;
+    }
+    pthread_mutex_unlock(&buffer->sub_lock);
+  }
+  pthread_rwlock_unlock(&reg->lock);
+  return err;
+}
+
+LOCAL cl_bool
+cl_mem_registry_contains(cl_mem_registry *reg, cl_mem mem)
+{
+  cl_bool found;
+
+  pthread_rwlock_rdlock(&reg->lock);
+  found = cl_mem_registry_find_slot(reg, mem) >= 0;
+  pthread_rwlock_unlock(&reg->lock);
+  return found;
+}
+
+LOCAL cl_mem
+cl_mem_registry_find_host_ptr(cl_mem_registry *reg, const void *p)
+{
+  cl_mem mem;
+
+  pthread_rwlock_rdlock(&reg->lock);
+  mem = cl_mem_range_find(&reg->host_ranges, (uintptr_t)p);
+  pthread_rwlock_unlock(&reg->lock);
+  return mem;
+}
+
+LOCAL cl_mem
+cl_mem_registry_find_svm(cl_mem_registry *reg, const void *p)
+{
+  cl_mem mem;
+
+  pthread_rwlock_rdlock(&reg->lock);
+  mem = cl_mem_range_find(&reg->svm_ranges, (uintptr_t)p);
+  pthread_rwlock_unlock(&reg->lock);
+  return mem;
+}
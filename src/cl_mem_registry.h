@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_MEM_REGISTRY_H__
+#define __CL_MEM_REGISTRY_H__
+
+#include "cl_internals.h"
+#include "CL/cl.h"
+#include <stdint.h>
+#include <pthread.h>
+
+/* The memory objects of a context: a hash set answers if a handle is one of
+ * them, and two interval trees find the object holding a host or SVM
+ * pointer. Lookups take a read lock only. */
+
+/* One host address range [start, end) of a memory object, a node of an AVL
+ * tree sorted by (start, seq) */
+typedef struct _cl_mem_range {
+  uintptr_t start;
+  uintptr_t end;
+  uintptr_t max_end;            /* Max end of the ranges of this subtree */
+  cl_ulong seq;                 /* Registration order, older objects win */
+  cl_ulong min_seq;             /* Min seq of the ranges of this subtree */
+  cl_mem mem;
+  struct _cl_mem_range *left, *right;
+  int height;
+} cl_mem_range;
+
+typedef struct _cl_mem_range_index {
+  cl_mem_range *root;
+  cl_uint n;
+} cl_mem_range_index;
+
+typedef struct _cl_mem_registry {
+  pthread_rwlock_t lock;
+  cl_mem *slots;                /* Open addressing hash set */
+  cl_uint slot_cap;             /* Power of 2 */
+  cl_uint slot_used;            /* Live objects and deleted markers */
+  cl_uint count;                /* Live objects */
+  cl_ulong seq;
+  cl_mem_range_index host_ranges; /* Objects with a host pointer */
+  cl_mem_range_index svm_ranges;  /* SVM allocations */
+} cl_mem_registry;
+
+extern void cl_mem_registry_init(cl_mem_registry *reg);
+extern void cl_mem_registry_destroy(cl_mem_registry *reg);
+/* CL_OUT_OF_HOST_MEMORY if the registry can not grow, mem is not added */
+extern cl_int cl_mem_registry_add(cl_mem_registry *reg, cl_mem mem);
+extern void cl_mem_registry_remove(cl_mem_registry *reg, cl_mem mem);
+/* Change the host pointer of a registered object, CL_OUT_OF_HOST_MEMORY if
+ * the new range can not be indexed */
+extern cl_int cl_mem_registry_set_host_ptr(cl_mem_registry *reg, cl_mem mem, void *host_ptr);
+extern cl_bool cl_mem_registry_contains(cl_mem_registry *reg, cl_mem mem);
+/* Object whose host pointer range holds p, NULL if none */
+extern cl_mem cl_mem_registry_find_host_ptr(cl_mem_registry *reg, const void *p);
+/* SVM allocation holding p, NULL if none */
+extern cl_mem cl_mem_registry_find_svm(cl_mem_registry *reg, const void *p);
+
+#endif /* __CL_MEM_REGISTRY_H__ */
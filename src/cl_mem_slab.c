@@ -0,0 +1,246 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_mem_slab.h"
+#include "cl_driver.h"
+#include "cl_alloc.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CL_MEM_SLAB_DEFAULT_MAX (64 << 10)
+#define CL_MEM_SLAB_SIZE_MIN (64 << 10)
+#define CL_MEM_SLAB_SIZE_MAX (1 << 20)
+
+static size_t
+cl_mem_slab_class_size(uint32_t cls)
+{
+  return (size_t)1 << (cls + CL_MEM_SLAB_CLASS_MIN_SHIFT);
+}
+
+/* Slabs hold at least 64 chunks, and are between 64KB and 1MB */
+static size_t
+cl_mem_slab_size(uint32_t cls)
+{
+  size_t sz = cl_mem_slab_class_size(cls) * 64;
+  if (sz < CL_MEM_SLAB_SIZE_MIN)
+    sz = CL_MEM_SLAB_SIZE_MIN;
+  if (sz > CL_MEM_SLAB_SIZE_MAX)
+    sz = CL_MEM_SLAB_SIZE_MAX;
+  return sz;
+}
+
+LOCAL void
+cl_mem_slab_pool_init(cl_mem_slab_pool *pool)
+{
+  const char *env = getenv("OCL_BUFFER_SLAB_MAX");
+  uint32_t i;
+
+  memset(pool, 0, sizeof(*pool));
+  pthread_mutex_init(&pool->lock, NULL);
+  for (i = 0; i < CL_MEM_SLAB_CLASS_N; i++)
+    list_init(&pool->slabs[i]);
+  pool->max_sz = env ? strtoul(env, NULL, 0) : CL_MEM_SLAB_DEFAULT_MAX;
+  if (pool->max_sz > cl_mem_slab_class_size(CL_MEM_SLAB_CLASS_N - 1))
+    pool->max_sz = cl_mem_slab_class_size(CL_MEM_SLAB_CLASS_N - 1);
+}
+
+static void
+cl_mem_slab_release(cl_mem_slab_pool *pool, cl_mem_slab slab)
+{
+  list_node_del(&slab->node);
+  pool->slab_n[slab->cls]--;
+  pool->stats.slab_n--;
+  pool->stats.slab_bytes -= cl_mem_slab_size(slab->cls);
+  pool->stats.retired_bytes -= (cl_ulong)slab->retired_n * cl_mem_slab_class_size(slab->cls);
+  /* The BO lives on while batches still reference it */
+  cl_buffer_unreference(slab->bo);
+  cl_free(slab);
+}
+
+LOCAL void
+cl_mem_slab_pool_destroy(cl_mem_slab_pool *pool)
+{
+  uint32_t i;
+
+  for (i = 0; i < CL_MEM_SLAB_CLASS_N; i++) {
+    while (!list_empty(&pool->slabs[i])) {
+      cl_mem_slab slab = list_entry(pool->slabs[i].head_node.n, _cl_mem_slab, node);
+      assert(slab->used_n == 0 && slab->pin_n == 0);
+      cl_mem_slab_release(pool, slab);
+    }
+  }
+  pthread_mutex_destroy(&pool->lock);
+}
+
+static cl_mem_slab
+cl_mem_slab_new(cl_mem_slab_pool *pool, cl_buffer_mgr bufmgr, uint32_t cls)
+{
+  const size_t sz = cl_mem_slab_size(cls);
+  cl_mem_slab slab;
+  uint32_t i;
+
+  slab = cl_calloc(1, sizeof(_cl_mem_slab));
+  if (slab == NULL)
+    return NULL;
+  slab->bo = cl_buffer_alloc(bufmgr, "CL memory slab", sz, 4096);
+  if (slab->bo == NULL) {
+    cl_free(slab);
+    return NULL;
+  }
+  slab->cls = cls;
+  slab->chunk_n = sz / cl_mem_slab_class_size(cls);
+  slab->free_n = slab->chunk_n;
+  for (i = 0; i < slab->chunk_n; i++)
+    slab->free_map[i / 64] |= 1ull << (i % 64);
+
+  list_add(&pool->slabs[cls], &slab->node);
+  pool->slab_n[cls]++;
+  pool->stats.slab_n++;
+  pool->stats.slab_bytes += sz;
+  return slab;
+}
+
+/* Retired chunks become free once no command uses the slab anymore */
+static void
+cl_mem_slab_reclaim(cl_mem_slab_pool *pool, cl_mem_slab slab)
+{
+  uint32_t i;
+
+  if (slab->retired_n == 0 || slab->pin_n || cl_buffer_is_busy(slab->bo))
+    return;
+  for (i = 0; i < CL_MEM_SLAB_CHUNK_MAX / 64; i++) {
+    slab->free_map[i] |= slab->retired_map[i];
+    slab->retired_map[i] = 0;
+  }
+  pool->stats.retired_bytes -= (cl_ulong)slab->retired_n * cl_mem_slab_class_size(slab->cls);
+  slab->free_n += slab->retired_n;
+  slab->retired_n = 0;
+}
+
+LOCAL cl_buffer
+cl_mem_slab_alloc(cl_mem_slab_pool *pool, cl_buffer_mgr bufmgr, size_t sz,
+                  size_t *offset, cl_mem_slab *slab_ret)
+{
+  cl_mem_slab slab = NULL;
+  list_node *pos;
+  uint32_t cls = 0, i, chunk;
+
+  if (sz == 0 || sz > pool->max_sz)
+    return NULL;
+  while (cl_mem_slab_class_size(cls) < sz)
+    cls++;
+
+  pthread_mutex_lock(&pool->lock);
+  list_for_each(pos, &pool->slabs[cls]) {
+    cl_mem_slab it = list_entry(pos, _cl_mem_slab, node);
+    /* Full slabs are at the end */
+    if (it->free_n == 0 && it->retired_n == 0)
+      break;
+    cl_mem_slab_reclaim(pool, it);
+    if (it->free_n) {
+      slab = it;
+      break;
+    }
+  }
+  if (slab == NULL && (slab = cl_mem_slab_new(pool, bufmgr, cls)) == NULL) {
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+  }
+
+  for (i = 0; slab->free_map[i] == 0; i++)
+    ;
+  chunk = i * 64 + __builtin_ctzll(slab->free_map[i]);
+  slab->free_map[i] &= ~(1ull << (chunk % 64));
+  slab->free_n--;
+  slab->used_n++;
+  if (slab->free_n == 0 && slab->retired_n == 0) {
+    list_node_del(&slab->node);
+    list_add_tail(&pool->slabs[cls], &slab->node);
+  }
+
+  pool->stats.used_bytes += cl_mem_slab_class_size(cls);
+  pool->stats.requested_bytes += sz;
+  pool->stats.alloc_n++;
+  pthread_mutex_unlock(&pool->lock);
+
+  *offset = (size_t)chunk * cl_mem_slab_class_size(cls);
+  *slab_ret = slab;
+  return slab->bo;
+}
+
+LOCAL void
+cl_mem_slab_free(cl_mem_slab_pool *pool, cl_mem_slab slab, size_t offset, size_t sz)
+{
+  const size_t class_sz = cl_mem_slab_class_size(slab->cls);
+  const uint32_t chunk = offset / class_sz;
+
+  assert(offset % class_sz == 0 && chunk < slab->chunk_n);
+  pthread_mutex_lock(&pool->lock);
+  assert(!(slab->free_map[chunk / 64] & (1ull << (chunk % 64))));
+  slab->retired_map[chunk / 64] |= 1ull << (chunk % 64);
+  slab->retired_n++;
+  slab->used_n--;
+  pool->stats.used_bytes -= class_sz;
+  pool->stats.requested_bytes -= sz;
+  pool->stats.retired_bytes += class_sz;
+
+  if (slab->used_n == 0 && slab->pin_n == 0 && pool->slab_n[slab->cls] > 1) {
+    cl_mem_slab_release(pool, slab);
+  } else {
+    /* It has a chunk to hand out again */
+    list_node_del(&slab->node);
+    list_add(&pool->slabs[slab->cls], &slab->node);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+LOCAL void
+cl_mem_slab_pin(cl_mem_slab_pool *pool, cl_mem_slab *slabs, cl_uint n)
+{
+  cl_uint i;
+
+  pthread_mutex_lock(&pool->lock);
+  for (i = 0; i < n; i++)
+    slabs[i]->pin_n++;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+LOCAL void
+cl_mem_slab_unpin(cl_mem_slab_pool *pool, cl_mem_slab *slabs, cl_uint n)
+{
+  cl_uint i;
+
+  pthread_mutex_lock(&pool->lock);
+  for (i = 0; i < n; i++) {
+    cl_mem_slab slab = slabs[i];
+    assert(slab->pin_n > 0);
+    /* Only the last pin of a slab given twice may release it */
+    if (--slab->pin_n == 0 && slab->used_n == 0 && pool->slab_n[slab->cls] > 1)
+      cl_mem_slab_release(pool, slab);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+LOCAL void
+cl_mem_slab_get_stats(cl_mem_slab_pool *pool, cl_mem_slab_stats *stats)
+{
+  pthread_mutex_lock(&pool->lock);
+  *stats = pool->stats;
+  pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_MEM_SLAB_H__
+#define __CL_MEM_SLAB_H__
+
+#include "cl_internals.h"
+#include "cl_driver_type.h"
+#include "cl_utils.h"
+#include "CL/cl.h"
+#include <stdint.h>
+#include <pthread.h>
+
+/* Small buffers of a context are carved out of shared backing BOs (slabs)
+ * instead of getting one BO each. Every slab holds chunks of one power of
+ * two size class, from 64 bytes up to OCL_BUFFER_SLAB_MAX (default 64KB,
+ * 0 disables the slabs). A freed chunk is only handed out again once the
+ * commands pinning its slab completed and the GPU is done with it. A slab
+ * left empty is released unless it is the last one of its class. */
+
+#define CL_MEM_SLAB_CLASS_MIN_SHIFT 6          /* 64 bytes, the buffer alignment */
+#define CL_MEM_SLAB_CLASS_N 11                 /* Up to 64KB */
+#define CL_MEM_SLAB_CHUNK_MAX 1024             /* Chunks of a slab */
+
+typedef struct _cl_mem_slab {
+  list_node node;                              /* In the list of its class */
+  cl_buffer bo;                                /* Backing BO */
+  uint32_t cls;                                /* Size class */
+  uint32_t chunk_n;                            /* Chunks in the slab */
+  uint32_t used_n;                             /* Chunks held by live buffers */
+  uint32_t free_n;                             /* Chunks ready for reuse */
+  uint32_t retired_n;                          /* Freed chunks the GPU may still use */
+  uint32_t pin_n;                              /* Pins of commands not completed yet */
+  uint64_t free_map[CL_MEM_SLAB_CHUNK_MAX / 64];
+  uint64_t retired_map[CL_MEM_SLAB_CHUNK_MAX / 64];
+} _cl_mem_slab;
+
+typedef _cl_mem_slab *cl_mem_slab;
+
+/* Sizes of the slabs and of what they hold, in bytes */
+typedef struct _cl_mem_slab_stats {
+  cl_ulong slab_n;                             /* Backing BOs alive */
+  cl_ulong slab_bytes;                         /* Their total size */
+  cl_ulong used_bytes;                         /* Chunks held by live buffers */
+  cl_ulong requested_bytes;                    /* Size asked for by these buffers */
+  cl_ulong retired_bytes;                      /* Freed chunks waiting for the GPU */
+  cl_ulong alloc_n;                            /* Buffers ever carved out of slabs */
+} cl_mem_slab_stats;
+
+typedef struct _cl_mem_slab_pool {
+  pthread_mutex_t lock;
+  size_t max_sz;                               /* Larger buffers get their own BO */
+  list_head slabs[CL_MEM_SLAB_CLASS_N];        /* Slabs with available chunks first */
+  cl_uint slab_n[CL_MEM_SLAB_CLASS_N];
+  cl_mem_slab_stats stats;
+} cl_mem_slab_pool;
+
+extern void cl_mem_slab_pool_init(cl_mem_slab_pool *pool);
+/* Release the slabs, all their buffers must be freed */
+extern void cl_mem_slab_pool_destroy(cl_mem_slab_pool *pool);
+/* Carve sz bytes out of a slab, NULL if sz is too large for the slabs */
+extern cl_buffer cl_mem_slab_alloc(cl_mem_slab_pool *pool, cl_buffer_mgr bufmgr, size_t sz,
+                                   size_t *offset, cl_mem_slab *slab);
+/* Give back the chunk at offset of a buffer of sz bytes */
+extern void cl_mem_slab_free(cl_mem_slab_pool *pool, cl_mem_slab slab, size_t offset, size_t sz);
+/* A command using buffers of the slabs pins them from its enqueue to its
+ * completion: the batch may not be submitted yet, so the BO is not busy,
+ * while the buffers can already be released. A slab may be given twice */
+extern void cl_mem_slab_pin(cl_mem_slab_pool *pool, cl_mem_slab *slabs, cl_uint n);
+extern void cl_mem_slab_unpin(cl_mem_slab_pool *pool, cl_mem_slab *slabs, cl_uint n);
+extern void cl_mem_slab_get_stats(cl_mem_slab_pool *pool, cl_mem_slab_stats *stats);
+
+#endif /* __CL_MEM_SLAB_H__ */
@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_staging_ring.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CL_STAGING_ALIGN 64
+#define CL_STAGING_DEFAULT_MAX (64 << 10)
+
+/* Every block starts with a header, the ring end is skipped with a block
+ * already done when a write does not fit before it */
+typedef struct _cl_staging_block {
+  size_t len;                          /* Header included */
+  cl_bool done;                        /* Given back */
+} cl_staging_block;
+
+#define CL_STAGING_HEADER ALIGN(sizeof(cl_staging_block), CL_STAGING_ALIGN)
+
+LOCAL cl_staging_ring
+cl_staging_ring_new(void)
+{
+  const char *env = getenv("OCL_WRITE_STAGING_RING");
+  size_t size = env ? strtoul(env, NULL, 0) : 0;
+  cl_staging_ring ring;
+
+  size = ALIGN(size, CL_STAGING_ALIGN);
+  if (size == 0)
+    return NULL;
+  ring = cl_calloc(1, sizeof(_cl_staging_ring));
+  if (ring == NULL)
+    return NULL;
+  pthread_mutex_init(&ring->lock, NULL);
+  ring->size = size;
+  env = getenv("OCL_WRITE_STAGING_MAX");
+  ring->max_sz = env ? strtoul(env, NULL, 0) : CL_STAGING_DEFAULT_MAX;
+  ring->ref_n = 1;
+  return ring;
+}
+
+static void
+cl_staging_ring_unref(cl_staging_ring ring)
+{
+  cl_bool last;
+
+  pthread_mutex_lock(&ring->lock);
+  last = --ring->ref_n == 0;
+  pthread_mutex_unlock(&ring->lock);
+  if (!last)
+    return;
+
+  assert(ring->head == ring->tail);
+  pthread_mutex_destroy(&ring->lock);
+  cl_free(ring->mem);
+  cl_free(ring);
+}
+
+LOCAL void
+cl_staging_ring_close(cl_staging_ring ring)
+{
+  if (ring)
+    cl_staging_ring_unref(ring);
+}
+
+LOCAL void *
+cl_staging_ring_put(cl_staging_ring ring, const void *src, size_t size)
+{
+  const size_t len = CL_STAGING_HEADER + ALIGN(size, CL_STAGING_ALIGN);
+  cl_staging_block *block;
+  size_t pos, pad = 0;
+
+  pthread_mutex_lock(&ring->lock);
+  if (size > ring->max_sz || len > ring->size)
+    goto skip;
+  if (ring->mem == NULL) {
+    ring->mem = cl_aligned_malloc(ring->size, 4096);
+    if (ring->mem == NULL)
+      goto skip;
+    /* Fault the pages in now rather than on the first writes */
+    memset(ring->mem, 0, ring->size);
+  }
+
+  pos = ring->head % ring->size;
+  if (pos + len > ring->size)
+    pad = ring->size - pos;
+  if (ring->head - ring->tail + pad + len > ring->size)
+    goto skip;
+
+  if (pad) {
+    block = (cl_staging_block *)(ring->mem + pos);
+    block->len = pad;
+    block->done = CL_TRUE;
+    ring->head += pad;
+    pos = 0;
+  }
+  block = (cl_staging_block *)(ring->mem + pos);
+  block->len = len;
+  block->done = CL_FALSE;
+  ring->head += len;
+  ring->ref_n++;
+  ring->staged_n++;
+  ring->staged_bytes += size;
+  pthread_mutex_unlock(&ring->lock);
+
+  /* The block is ours, copy out of the lock */
+  memcpy((char *)block + CL_STAGING_HEADER, src, size);
+  return (char *)block + CL_STAGING_HEADER;
+
+skip:
+  ring->skip_n++;
+  pthread_mutex_unlock(&ring->lock);
+  return NULL;
+}
+
+LOCAL void
+cl_staging_ring_release(cl_staging_ring ring, const void *ptr)
+{
+  cl_staging_block *block = (cl_staging_block *)((char *)ptr - CL_STAGING_HEADER);
+
+  pthread_mutex_lock(&ring->lock);
+  block->done = CL_TRUE;
+  /* Blocks may come back out of order, the ring only moves past done ones */
+  while (ring->tail != ring->head) {
+    block = (cl_staging_block *)(ring->mem + ring->tail % ring->size);
+    if (!block->done)
+      break;
+    ring->tail += block->len;
+  }
+  pthread_mutex_unlock(&ring->lock);
+  cl_staging_ring_unref(ring);
+}
+
+LOCAL void
+cl_staging_ring_get_stats(cl_staging_ring ring, cl_ulong stats[3])
+{
+  if (ring == NULL) {
+    stats[0] = stats[1] = stats[2] = 0;
+    return;
+  }
+  pthread_mutex_lock(&ring->lock);
+  stats[0] = ring->staged_n;
+  stats[1] = ring->staged_bytes;
+  stats[2] = ring->skip_n;
+  pthread_mutex_unlock(&ring->lock);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_STAGING_RING_H__
+#define __CL_STAGING_RING_H__
+
+#include "cl_internals.h"
+#include "CL/cl.h"
+#include <stddef.h>
+#include <pthread.h>
+
+/* Host memory ring of a queue where non-blocking writes copy their data at
+ * enqueue time, so the application gets its pointer back at once. The write
+ * then reads from its block when it runs and gives the block back. Staging is
+ * opt-in: OCL_WRITE_STAGING_RING sets the ring size in bytes (default 0, off)
+ * and writes larger than OCL_WRITE_STAGING_MAX (default 64KB) or not fitting
+ * in the free space of the ring are not staged. The blocks in use keep the
+ * ring alive, so it may outlive its queue. */
+
+typedef struct _cl_staging_ring {
+  pthread_mutex_t lock;
+  char *mem;                           /* Allocated on first use */
+  size_t size;                         /* Ring size in bytes */
+  size_t max_sz;                       /* Larger writes are not staged */
+  size_t head;                         /* Bytes ever handed out */
+  size_t tail;                         /* Bytes ever given back, in ring order */
+  cl_uint ref_n;                       /* The queue plus one per block in use */
+  cl_ulong staged_n;                   /* Writes staged */
+  cl_ulong staged_bytes;               /* Bytes they carried */
+  cl_ulong skip_n;                     /* Writes too large or not fitting */
+} _cl_staging_ring;
+
+typedef _cl_staging_ring *cl_staging_ring;
+
+/* NULL if staging is disabled */
+extern cl_staging_ring cl_staging_ring_new(void);
+/* Called when the queue goes away */
+extern void cl_staging_ring_close(cl_staging_ring ring);
+/* Copy size bytes of src in a new block, NULL if they are not staged */
+extern void *cl_staging_ring_put(cl_staging_ring ring, const void *src, size_t size);
+/* Give back the block returned by cl_staging_ring_put */
+extern void cl_staging_ring_release(cl_staging_ring ring, const void *ptr);
+/* cl_ulong[3]: writes staged, bytes staged, writes not staged */
+extern void cl_staging_ring_get_stats(cl_staging_ring ring, cl_ulong stats[3]);
+
+#endif /* __CL_STAGING_RING_H__ */
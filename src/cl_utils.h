@@ -346,7 +346,7 @@ do {                                                    \
 typedef volatile int atomic_t;
 
 static INLINE int atomic_add(atomic_t *v, const int c) {
-  register int i = c;
+  int i = c;
   __asm__ __volatile__("lock ; xaddl %0, %1;"
       : "+r"(i), "+m"(*v)
       : "m"(*v), "r"(i));
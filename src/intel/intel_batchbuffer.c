@@ -57,7 +57,28 @@
 LOCAL int
 intel_batchbuffer_reset(intel_batchbuffer_t *batch, size_t sz)
 {
+  /* A retired batch buffer of a recycled gpgpu state is reused as is, only
+   * its relocations are dropped. On LLC it even stays mapped. */
+  if (batch->buffer != NULL && batch->buffer->size >= sz &&
+      !drm_intel_bo_busy(batch->buffer)) {
+    drm_intel_gem_bo_clear_relocs(batch->buffer, 0);
+    if (batch->map == NULL) {
+      if (dri_bo_map(batch->buffer, 1) != 0)
+        return -1;
+      batch->map = (uint8_t*) batch->buffer->virtual;
+    }
+    batch->size = batch->buffer->size;
+    batch->ptr = batch->map;
+    batch->atomic = 0;
+    batch->last_bo = batch->buffer;
+    batch->enable_slm = 0;
+    return 0;
+  }
+
   if (batch->buffer != NULL) {
+    if (batch->map)
+      dri_bo_unmap(batch->buffer);
+    batch->map = NULL;
     dri_bo_unreference(batch->buffer);
     batch->buffer = NULL;
     batch->last_bo = NULL;
@@ -82,6 +103,57 @@ intel_batchbuffer_reset(intel_batchbuffer_t *batch, size_t sz)
   return 0;
 }
 
+/* Gen8+: end the batch with a jump into next instead of submitting it on its
+ * own. next is closed (terminated but not submitted) and will run when the
+ * first batch of the chain is flushed. batch is either that first batch,
+ * still open, or a batch closed by a previous call. Returns -1 without
+ * touching anything if the jump does not fit */
+LOCAL int
+intel_batchbuffer_chain(intel_batchbuffer_t *batch, intel_batchbuffer_t *next)
+{
+  const uint32_t jump[3] = { MI_BATCH_BUFFER_START_GEN8, 0, 0 };
+  uint32_t offset, next_end;
+
+  if (batch->buffer == NULL || next->ptr == NULL)
+    return -1;
+  offset = batch->ptr ? batch->ptr - batch->map : batch->end_offset;
+  /* An open batch also needs room for its own MI_BATCH_BUFFER_END */
+  if (offset + sizeof(jump) + 8 > batch->buffer->size)
+    return -1;
+
+  /* Close next the way intel_batchbuffer_flush does */
+  next_end = next->ptr - next->map;
+  if ((next_end & 4) == 0) {
+    *(uint32_t*) next->ptr = 0;
+    next_end += 4;
+  }
+  *(uint32_t*)(next->map + next_end) = MI_BATCH_BUFFER_END;
+  next->end_offset = next_end;
+  if (next->intel->has_llc) {
+    next->ptr = NULL;
+  } else {
+    dri_bo_unmap(next->buffer);
+    next->ptr = next->map = NULL;
+  }
+
+  drm_intel_bo_emit_reloc(batch->buffer, offset + 4, next->buffer, 0,
+                          I915_GEM_DOMAIN_COMMAND, 0);
+  if (batch->ptr) {
+    memcpy(batch->ptr, jump, sizeof(jump));
+    *(uint64_t*)(batch->ptr + 4) = next->buffer->offset64;
+    batch->ptr += sizeof(jump);
+  } else {
+    uint32_t cmd[3];
+    memcpy(cmd, jump, sizeof(jump));
+    memcpy(cmd + 1, &next->buffer->offset64, sizeof(uint64_t));
+    if (batch->map)
+      memcpy(batch->map + offset, cmd, sizeof(cmd));
+    else
+      drm_intel_bo_subdata(batch->buffer, offset, sizeof(cmd), cmd);
+  }
+  return 0;
+}
+
 LOCAL void
 intel_batchbuffer_init(intel_batchbuffer_t *batch, intel_driver_t *intel)
 {
@@ -106,10 +178,13 @@ intel_batchbuffer_terminate(intel_batchbuffer_t *batch)
 LOCAL int
 intel_batchbuffer_flush(intel_batchbuffer_t *batch)
 {
-  uint32_t used = batch->ptr - batch->map;
+  uint32_t used;
   int is_locked = batch->intel->locked;
   int err = 0;
 
+  if (batch->ptr == NULL)
+    return 0;
+  used = batch->ptr - batch->map;
   if (used == 0)
     return 0;
 
@@ -121,8 +196,13 @@ intel_batchbuffer_flush(intel_batchbuffer_t *batch)
   *(uint32_t*)batch->ptr = MI_BATCH_BUFFER_END;
   batch->ptr += 4;
   used = batch->ptr - batch->map;
-  dri_bo_unmap(batch->buffer);
-  batch->ptr = batch->map = NULL;
+  if (batch->intel->has_llc) {
+    /* Keep the mapping for the next reset of this batch */
+    batch->ptr = NULL;
+  } else {
+    dri_bo_unmap(batch->buffer);
+    batch->ptr = batch->map = NULL;
+  }
 
   if (!is_locked)
     intel_driver_lock_hardware(batch->intel);
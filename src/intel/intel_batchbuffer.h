@@ -87,6 +87,8 @@ typedef struct intel_batchbuffer
    *  flag when call exec. */
   uint8_t enable_slm;
   int atomic;
+  /** Offset of MI_BATCH_BUFFER_END once closed by intel_batchbuffer_chain */
+  uint32_t end_offset;
 } intel_batchbuffer_t;
 
 extern intel_batchbuffer_t* intel_batchbuffer_new(struct intel_driver*);
@@ -100,6 +102,7 @@ extern void intel_batchbuffer_init(intel_batchbuffer_t*, struct intel_driver*);
 extern void intel_batchbuffer_terminate(intel_batchbuffer_t*);
 extern int intel_batchbuffer_flush(intel_batchbuffer_t*);
 extern int intel_batchbuffer_reset(intel_batchbuffer_t*, size_t sz);
+extern int intel_batchbuffer_chain(intel_batchbuffer_t*, intel_batchbuffer_t *next);
 
 static INLINE uint32_t
 intel_batchbuffer_space(const intel_batchbuffer_t *batch)
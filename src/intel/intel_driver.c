@@ -207,6 +207,9 @@ else if(IS_IGDNG(driver->device_id))
 else
   driver->gen_ver = 4;
 #endif /* EMULATE_GEN */
+/* The Atom parts have no LLC: a CPU mapping must be flushed on unmap */
+driver->has_llc = !(IS_BAYTRAIL_T(driver->device_id) || IS_CHERRYVIEW(driver->device_id) ||
+                    IS_BROXTON(driver->device_id) || IS_GEMINILAKE(driver->device_id));
 return 1;
 }
 
@@ -922,6 +925,14 @@ switch (tiling) {
 return 0;
 }
 
+static int intel_buffer_can_host_tile(cl_buffer bo)
+{
+uint32_t intel_tiling, intel_swizzle_mode;
+if (drm_intel_bo_get_tiling((drm_intel_bo*)bo, &intel_tiling, &intel_swizzle_mode))
+  return 0;
+return intel_swizzle_mode == I915_BIT_6_SWIZZLE_NONE;
+}
+
 static int intel_buffer_set_tiling(cl_buffer bo,
                                  cl_image_tiling_t tiling, size_t stride)
 {
@@ -1071,8 +1082,10 @@ cl_buffer_set_bo_use_full_range = (cl_buffer_set_bo_use_full_range_cb *) drm_int
   cl_buffer_subdata = (cl_buffer_subdata_cb *) drm_intel_bo_subdata;
   cl_buffer_get_subdata = (cl_buffer_get_subdata_cb *) drm_intel_bo_get_subdata;
   cl_buffer_wait_rendering = (cl_buffer_wait_rendering_cb *) drm_intel_bo_wait_rendering;
+  cl_buffer_is_busy = (cl_buffer_is_busy_cb *) drm_intel_bo_busy;
   cl_buffer_get_fd = (cl_buffer_get_fd_cb *) drm_intel_bo_gem_export_to_prime;
   cl_buffer_get_tiling_align = (cl_buffer_get_tiling_align_cb *)intel_buffer_get_tiling_align;
+  cl_buffer_can_host_tile = (cl_buffer_can_host_tile_cb *)intel_buffer_can_host_tile;
   cl_buffer_get_buffer_from_fd = (cl_buffer_get_buffer_from_fd_cb *) intel_share_buffer_from_fd;
   cl_buffer_get_image_from_fd = (cl_buffer_get_image_from_fd_cb *) intel_share_image_from_fd;
   intel_set_gpgpu_callbacks(intel_get_device_id());
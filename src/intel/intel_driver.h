@@ -61,6 +61,7 @@
 
 #define MI_NOOP                                 (CMD_MI | 0)
 #define MI_BATCH_BUFFER_END                     (CMD_MI | (0xA << 23))
+#define MI_BATCH_BUFFER_START_GEN8              (CMD_MI | (0x31 << 23) | (1 << 8) | (3 - 2))
 
 #define XY_COLOR_BLT_CMD                        (CMD_2D | (0x50 << 22) | 0x04)
 #define XY_COLOR_BLT_WRITE_ALPHA                (1 << 21)
@@ -91,6 +92,7 @@ typedef struct intel_driver
   struct dri_state *dri_ctx;
   struct intel_gpgpu_node *gpgpu_list;
   int atomic_test_result;
+  int has_llc;           /* CPU mappings stay coherent with the GPU */
 } intel_driver_t;
 
 #define SET_BLOCKED_SIGSET(DRIVER)   do {                     \
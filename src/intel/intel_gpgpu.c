@@ -133,6 +133,173 @@ static void intel_gpgpu_unref_batch_buf(void *buf)
     drm_intel_bo_unreference((drm_intel_bo *)buf);
 }
 
+/* On LLC platforms the aux buffer stays mapped for the whole life of the
+ * state, so a recycled state does no map/unmap per launch */
+static int
+intel_gpgpu_map_aux(intel_gpgpu_t *gpgpu)
+{
+  if (gpgpu->aux_buf.bo->virtual)
+    return 0;
+  if (dri_bo_map(gpgpu->aux_buf.bo, 1) != 0) {
+    fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+static void
+intel_gpgpu_unmap_aux(intel_gpgpu_t *gpgpu)
+{
+  if (!gpgpu->drv->has_llc)
+    dri_bo_unmap(gpgpu->aux_buf.bo);
+}
+
+static int
+intel_gpgpu_is_idle(intel_gpgpu_t *gpgpu)
+{
+  if (!gpgpu->batch || !gpgpu->batch->buffer)
+    return 1;
+  return !drm_intel_bo_busy(gpgpu->batch->buffer);
+}
+
+static struct intel_gpgpu_bo_cache *
+intel_gpgpu_bo_cache_new(intel_driver_t *drv)
+{
+  struct intel_gpgpu_bo_cache *cache = CALLOC(struct intel_gpgpu_bo_cache);
+  if (cache == NULL)
+    return NULL;
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->ref_n = 1;
+  return cache;
+}
+
+static void
+intel_gpgpu_bo_cache_close(struct intel_gpgpu_bo_cache *cache)
+{
+  uint32_t kind, i;
+  int last;
+
+  if (cache == NULL)
+    return;
+  pthread_mutex_lock(&cache->lock);
+  last = --cache->ref_n == 0;
+  pthread_mutex_unlock(&cache->lock);
+  if (!last)
+    return;
+
+  for (kind = 0; kind < INTEL_BO_CACHE_KIND_N; kind++)
+    for (i = 0; i < cache->bo_n[kind]; i++)
+      drm_intel_bo_unreference(cache->bo[kind][i]);
+  pthread_mutex_destroy(&cache->lock);
+  cl_free(cache);
+}
+
+static void
+intel_gpgpu_bo_cache_get_stats(struct intel_gpgpu_bo_cache *cache, cl_ulong stats[2])
+{
+  if (cache == NULL) {
+    stats[0] = stats[1] = 0;
+    return;
+  }
+  pthread_mutex_lock(&cache->lock);
+  stats[0] = cache->hit_n;
+  stats[1] = cache->miss_n;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+/* Take the smallest idle cached buffer of at least size bytes, or allocate
+ * one. Stack and printf sizes depend on the launch, so they are rounded up
+ * to a power of two. Scratch sizes already are a power of two per thread */
+static drm_intel_bo *
+intel_gpgpu_get_bo(intel_gpgpu_t *gpgpu, uint32_t kind, const char *name,
+                   uint32_t size, uint32_t align)
+{
+  struct intel_gpgpu_bo_cache *cache = gpgpu->bo_cache;
+  drm_intel_bo *bo = NULL;
+  uint32_t i, best = INTEL_BO_CACHE_SIZE, class_sz;
+
+  if (cache == NULL)
+    return drm_intel_bo_alloc(gpgpu->drv->bufmgr, name, size, align);
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->bo_n[kind]; i++) {
+    drm_intel_bo *it = cache->bo[kind][i];
+    if (it->size >= size &&
+        (best == INTEL_BO_CACHE_SIZE || it->size < cache->bo[kind][best]->size) &&
+        !drm_intel_bo_busy(it))
+      best = i;
+  }
+  if (best < INTEL_BO_CACHE_SIZE) {
+    bo = cache->bo[kind][best];
+    cache->bo_n[kind]--;
+    memmove(&cache->bo[kind][best], &cache->bo[kind][best + 1],
+            (cache->bo_n[kind] - best) * sizeof(drm_intel_bo *));
+    cache->hit_n++;
+  } else
+    cache->miss_n++;
+  pthread_mutex_unlock(&cache->lock);
+
+  if (bo == NULL) {
+    class_sz = size;
+    if (kind != INTEL_BO_CACHE_SCRATCH)
+      for (class_sz = 4096; class_sz < size; class_sz <<= 1)
+        ;
+    bo = drm_intel_bo_alloc(gpgpu->drv->bufmgr, name, class_sz, align);
+  }
+  return bo;
+}
+
+/* Give a buffer back to the cache, its oldest one goes when it is full */
+static void
+intel_gpgpu_put_bo(intel_gpgpu_t *gpgpu, uint32_t kind, drm_intel_bo *bo)
+{
+  struct intel_gpgpu_bo_cache *cache = gpgpu->bo_cache;
+  drm_intel_bo *drop = bo;
+
+  if (bo == NULL)
+    return;
+  if (cache) {
+    pthread_mutex_lock(&cache->lock);
+    drop = NULL;
+    if (cache->bo_n[kind] == INTEL_BO_CACHE_SIZE) {
+      drop = cache->bo[kind][0];
+      cache->bo_n[kind]--;
+      memmove(&cache->bo[kind][0], &cache->bo[kind][1], cache->bo_n[kind] * sizeof(drm_intel_bo *));
+    }
+    cache->bo[kind][cache->bo_n[kind]++] = bo;
+    pthread_mutex_unlock(&cache->lock);
+  }
+  if (drop)
+    drm_intel_bo_unreference(drop);
+}
+
+/* The buffers of the previous launch go back to the cache */
+static void
+intel_gpgpu_put_bos(intel_gpgpu_t *gpgpu)
+{
+  intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_SCRATCH, gpgpu->scratch_b.bo);
+  intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_STACK, gpgpu->stack_b.bo);
+  intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_PRINTF, gpgpu->printf_b.bo);
+  gpgpu->scratch_b.bo = NULL;
+  gpgpu->stack_b.bo = NULL;
+  gpgpu->printf_b.bo = NULL;
+}
+
+static void
+intel_gpgpu_set_bo_cache(intel_gpgpu_t *gpgpu, struct intel_gpgpu_bo_cache *cache)
+{
+  if (gpgpu->bo_cache == cache)
+    return;
+  intel_gpgpu_put_bos(gpgpu);
+  intel_gpgpu_bo_cache_close(gpgpu->bo_cache);
+  if (cache) {
+    pthread_mutex_lock(&cache->lock);
+    cache->ref_n++;
+    pthread_mutex_unlock(&cache->lock);
+  }
+  gpgpu->bo_cache = cache;
+}
+
 static void
 intel_gpgpu_delete_finished(intel_gpgpu_t *gpgpu)
 {
@@ -140,16 +307,15 @@ intel_gpgpu_delete_finished(intel_gpgpu_t *gpgpu)
     return;
   if(gpgpu->time_stamp_b.bo)
     drm_intel_bo_unreference(gpgpu->time_stamp_b.bo);
-  if(gpgpu->printf_b.bo)
-    drm_intel_bo_unreference(gpgpu->printf_b.bo);
-  if (gpgpu->aux_buf.bo)
+  intel_gpgpu_put_bos(gpgpu);
+  intel_gpgpu_bo_cache_close(gpgpu->bo_cache);
+  if (gpgpu->aux_buf.bo) {
+    if (gpgpu->aux_buf.bo->virtual)
+      drm_intel_bo_unmap(gpgpu->aux_buf.bo);
     drm_intel_bo_unreference(gpgpu->aux_buf.bo);
+  }
   if (gpgpu->perf_b.bo)
     drm_intel_bo_unreference(gpgpu->perf_b.bo);
-  if (gpgpu->stack_b.bo)
-    drm_intel_bo_unreference(gpgpu->stack_b.bo);
-  if (gpgpu->scratch_b.bo)
-    drm_intel_bo_unreference(gpgpu->scratch_b.bo);
   if (gpgpu->profiling_b.bo)
     drm_intel_bo_unreference(gpgpu->profiling_b.bo);
 
@@ -240,6 +406,7 @@ intel_gpgpu_new(intel_driver_t *drv)
 
   TRY_ALLOC_NO_ERR (state, CALLOC(intel_gpgpu_t));
   state->drv = drv;
+  state->dispatch_n = 1;
   state->batch = intel_batchbuffer_new(state->drv);
   assert(state->batch);
 
@@ -694,6 +861,20 @@ intel_gpgpu_get_max_curbe_size(uint32_t device_id)
     return 2016;
 }
 
+/* Each walker of the state has its own CURBE and interface descriptor */
+static uint32_t
+intel_gpgpu_curbe_offset(intel_gpgpu_t *gpgpu)
+{
+  return gpgpu->aux_offset.curbe_offset +
+         gpgpu->dispatch * gpgpu->curb.num_cs_entries * gpgpu->curb.size_cs_entry * 32;
+}
+
+static uint32_t
+intel_gpgpu_idrt_offset(intel_gpgpu_t *gpgpu)
+{
+  return gpgpu->aux_offset.idrt_offset + gpgpu->dispatch * 32;
+}
+
 static cl_int
 intel_gpgpu_get_curbe_size(intel_gpgpu_t *gpgpu)
 {
@@ -773,7 +954,7 @@ intel_gpgpu_load_curbe_buffer_gen7(intel_gpgpu_t *gpgpu)
   OUT_BATCH(gpgpu->batch, CMD(2,0,1) | (4 - 2));  /* length-2 */
   OUT_BATCH(gpgpu->batch, 0);                     /* mbz */
   OUT_BATCH(gpgpu->batch, intel_gpgpu_get_curbe_size(gpgpu) * 32);
-  OUT_RELOC(gpgpu->batch, gpgpu->aux_buf.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, gpgpu->aux_offset.curbe_offset);
+  OUT_RELOC(gpgpu->batch, gpgpu->aux_buf.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, intel_gpgpu_curbe_offset(gpgpu));
   ADVANCE_BATCH(gpgpu->batch);
 }
 
@@ -784,7 +965,7 @@ intel_gpgpu_load_curbe_buffer_gen8(intel_gpgpu_t *gpgpu)
   OUT_BATCH(gpgpu->batch, CMD(2,0,1) | (4 - 2));  /* length-2 */
   OUT_BATCH(gpgpu->batch, 0);                     /* mbz */
   OUT_BATCH(gpgpu->batch, intel_gpgpu_get_curbe_size(gpgpu) * 32);
-  OUT_BATCH(gpgpu->batch, gpgpu->aux_offset.curbe_offset);
+  OUT_BATCH(gpgpu->batch, intel_gpgpu_curbe_offset(gpgpu));
   ADVANCE_BATCH(gpgpu->batch);
 }
 
@@ -795,7 +976,7 @@ intel_gpgpu_load_idrt_gen7(intel_gpgpu_t *gpgpu)
   OUT_BATCH(gpgpu->batch, CMD(2,0,2) | (4 - 2)); /* length-2 */
   OUT_BATCH(gpgpu->batch, 0);                    /* mbz */
   OUT_BATCH(gpgpu->batch, 1 << 5);
-  OUT_RELOC(gpgpu->batch, gpgpu->aux_buf.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, gpgpu->aux_offset.idrt_offset);
+  OUT_RELOC(gpgpu->batch, gpgpu->aux_buf.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, intel_gpgpu_idrt_offset(gpgpu));
   ADVANCE_BATCH(gpgpu->batch);
 }
 
@@ -806,7 +987,7 @@ intel_gpgpu_load_idrt_gen8(intel_gpgpu_t *gpgpu)
   OUT_BATCH(gpgpu->batch, CMD(2,0,2) | (4 - 2)); /* length-2 */
   OUT_BATCH(gpgpu->batch, 0);                    /* mbz */
   OUT_BATCH(gpgpu->batch, 1 << 5);
-  OUT_BATCH(gpgpu->batch, gpgpu->aux_offset.idrt_offset);
+  OUT_BATCH(gpgpu->batch, intel_gpgpu_idrt_offset(gpgpu));
   ADVANCE_BATCH(gpgpu->batch);
 }
 
@@ -1033,6 +1214,7 @@ intel_gpgpu_batch_start(intel_gpgpu_t *gpgpu)
   intel_gpgpu_load_vfe_state(gpgpu);
   intel_gpgpu_load_curbe_buffer(gpgpu);
   intel_gpgpu_load_idrt(gpgpu);
+  gpgpu->loaded_dispatch = gpgpu->dispatch;
 
   if (gpgpu->perf_b.bo) {
     BEGIN_BATCH(gpgpu->batch, 3);
@@ -1121,6 +1303,14 @@ intel_gpgpu_flush(intel_gpgpu_t *gpgpu)
   */
 }
 
+static int
+intel_gpgpu_chain(intel_gpgpu_t *gpgpu, intel_gpgpu_t *next)
+{
+  if (!gpgpu->batch || !next->batch)
+    return -1;
+  return intel_batchbuffer_chain(gpgpu->batch, next->batch);
+}
+
 static int
 intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
                        uint32_t max_threads,
@@ -1140,9 +1330,8 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
   gpgpu->curb.size_cs_entry = size_cs_entry;
   gpgpu->max_threads = max_threads;
 
-  if (gpgpu->printf_b.bo)
-    dri_bo_unreference(gpgpu->printf_b.bo);
-  gpgpu->printf_b.bo = NULL;
+  /* Scratch, stack and printf buffers are taken again by this launch */
+  intel_gpgpu_put_bos(gpgpu);
 
   if (gpgpu->profiling_b.bo)
     dri_bo_unreference(gpgpu->profiling_b.bo);
@@ -1159,16 +1348,8 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
       fprintf(stderr, "Could not allocate buffer for profiling.\n");
   }
 
-  /* stack */
-  if (gpgpu->stack_b.bo)
-    dri_bo_unreference(gpgpu->stack_b.bo);
-  gpgpu->stack_b.bo = NULL;
-
   /* Set the auxiliary buffer*/
   uint32_t size_aux = 0;
-  if(gpgpu->aux_buf.bo)
-    dri_bo_unreference(gpgpu->aux_buf.bo);
-  gpgpu->aux_buf.bo = NULL;
 
   /* begin with surface heap to make sure it's page aligned,
      because state base address use 20bit for the address */
@@ -1178,7 +1359,7 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
   //curbe must be 32 bytes aligned
   size_aux = ALIGN(size_aux, 64);
   gpgpu->aux_offset.curbe_offset = size_aux;
-  size_aux += gpgpu->curb.num_cs_entries * gpgpu->curb.size_cs_entry * 32;
+  size_aux += gpgpu->dispatch_n * gpgpu->curb.num_cs_entries * gpgpu->curb.size_cs_entry * 32;
 
   //idrt must be 32 bytes aligned
   size_aux = ALIGN(size_aux, 32);
@@ -1200,6 +1381,23 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
   /* make sure aux buffer is page aligned */
   size_aux = ALIGN(size_aux, 4096);
 
+  /* A recycled state only gets handed out once its batch retired: keep the
+   * aux buffer if it is large enough and drop its old relocations */
+  bo = gpgpu->aux_buf.bo;
+  if (bo && bo->size >= size_aux && !drm_intel_bo_busy(bo)) {
+    drm_intel_gem_bo_clear_relocs(bo, 0);
+    if (intel_gpgpu_map_aux(gpgpu) != 0)
+      return -1;
+    memset(bo->virtual, 0, size_aux);
+    return 0;
+  }
+  if (bo) {
+    if (bo->virtual)
+      dri_bo_unmap(bo);
+    dri_bo_unreference(bo);
+  }
+  gpgpu->aux_buf.bo = NULL;
+
   bo = dri_bo_alloc(gpgpu->drv->bufmgr, "AUX_BUFFER", size_aux, 4096);
 
   if (!bo || dri_bo_map(bo, 1) != 0) {
@@ -1873,7 +2071,6 @@ intel_gpgpu_bind_buf(intel_gpgpu_t *gpgpu, drm_intel_bo *buf, uint32_t offset,
 static int
 intel_gpgpu_set_scratch(intel_gpgpu_t * gpgpu, uint32_t per_thread_size)
 {
-  drm_intel_bufmgr *bufmgr = gpgpu->drv->bufmgr;
   drm_intel_bo* old = gpgpu->scratch_b.bo;
   uint32_t total = per_thread_size * gpgpu->max_threads;
   /* Per Bspec, scratch should 2X the desired size when EU index is not continuous */
@@ -1884,12 +2081,12 @@ intel_gpgpu_set_scratch(intel_gpgpu_t * gpgpu, uint32_t per_thread_size)
   gpgpu->per_thread_scratch = per_thread_size;
 
   if(old && old->size < total) {
-    drm_intel_bo_unreference(old);
-    old = NULL;
+    intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_SCRATCH, old);
+    gpgpu->scratch_b.bo = old = NULL;
   }
 
   if(!old && total) {
-    gpgpu->scratch_b.bo = drm_intel_bo_alloc(bufmgr, "SCRATCH_BO", total, 4096);
+    gpgpu->scratch_b.bo = intel_gpgpu_get_bo(gpgpu, INTEL_BO_CACHE_SCRATCH, "SCRATCH_BO", total, 4096);
     if (gpgpu->scratch_b.bo == NULL)
       return -1;
   }
@@ -1898,8 +2095,8 @@ intel_gpgpu_set_scratch(intel_gpgpu_t * gpgpu, uint32_t per_thread_size)
 static void
 intel_gpgpu_set_stack(intel_gpgpu_t *gpgpu, uint32_t offset, uint32_t size, uint8_t bti)
 {
-  drm_intel_bufmgr *bufmgr = gpgpu->drv->bufmgr;
-  gpgpu->stack_b.bo = drm_intel_bo_alloc(bufmgr, "STACK", size, 64);
+  intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_STACK, gpgpu->stack_b.bo);
+  gpgpu->stack_b.bo = intel_gpgpu_get_bo(gpgpu, INTEL_BO_CACHE_STACK, "STACK", size, 64);
 
   cl_gpgpu_bind_buf((cl_gpgpu)gpgpu, (cl_buffer)gpgpu->stack_b.bo, offset, 0, size, bti);
 }
@@ -1910,7 +2107,7 @@ intel_gpgpu_build_idrt_gen7(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
   gen6_interface_descriptor_t *desc;
   drm_intel_bo *ker_bo = NULL;
 
-  desc = (gen6_interface_descriptor_t*) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.idrt_offset);
+  desc = (gen6_interface_descriptor_t*) (gpgpu->aux_buf.bo->virtual + intel_gpgpu_idrt_offset(gpgpu));
 
   memset(desc, 0, sizeof(*desc));
   ker_bo = (drm_intel_bo *) kernel->bo;
@@ -1950,13 +2147,13 @@ intel_gpgpu_build_idrt_gen7(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
   dri_bo_emit_reloc(gpgpu->aux_buf.bo,
                     I915_GEM_DOMAIN_INSTRUCTION, 0,
                     0,
-                    gpgpu->aux_offset.idrt_offset + offsetof(gen6_interface_descriptor_t, desc0),
+                    intel_gpgpu_idrt_offset(gpgpu) + offsetof(gen6_interface_descriptor_t, desc0),
                     ker_bo);
 
   dri_bo_emit_reloc(gpgpu->aux_buf.bo,
                     I915_GEM_DOMAIN_SAMPLER, 0,
                     gpgpu->aux_offset.sampler_state_offset,
-                    gpgpu->aux_offset.idrt_offset + offsetof(gen6_interface_descriptor_t, desc2),
+                    intel_gpgpu_idrt_offset(gpgpu) + offsetof(gen6_interface_descriptor_t, desc2),
                     gpgpu->aux_buf.bo);
 }
 
@@ -1965,7 +2162,7 @@ intel_gpgpu_build_idrt_gen8(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
 {
   gen8_interface_descriptor_t *desc;
 
-  desc = (gen8_interface_descriptor_t*) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.idrt_offset);
+  desc = (gen8_interface_descriptor_t*) (gpgpu->aux_buf.bo->virtual + intel_gpgpu_idrt_offset(gpgpu));
 
   memset(desc, 0, sizeof(*desc));
   desc->desc0.kernel_start_pointer = 0; /* reloc */
@@ -2006,7 +2203,7 @@ intel_gpgpu_build_idrt_gen9(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
 {
   gen8_interface_descriptor_t *desc;
 
-  desc = (gen8_interface_descriptor_t*) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.idrt_offset);
+  desc = (gen8_interface_descriptor_t*) (gpgpu->aux_buf.bo->virtual + intel_gpgpu_idrt_offset(gpgpu));
 
   memset(desc, 0, sizeof(*desc));
   desc->desc0.kernel_start_pointer = 0; /* reloc */
@@ -2053,12 +2250,10 @@ intel_gpgpu_upload_curbes_gen7(intel_gpgpu_t *gpgpu, const void* data, uint32_t
   uint32_t i, j;
 
   /* Upload the data first */
-  if (dri_bo_map(gpgpu->aux_buf.bo, 1) != 0) {
-    fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
+  if (intel_gpgpu_map_aux(gpgpu) != 0)
     return -1;
-  }
   assert(gpgpu->aux_buf.bo->virtual);
-  curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.curbe_offset);
+  curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + intel_gpgpu_curbe_offset(gpgpu));
   memcpy(curbe, data, size);
 
   /* Now put all the relocations for our flat address space */
@@ -2066,13 +2261,13 @@ intel_gpgpu_upload_curbes_gen7(intel_gpgpu_t *gpgpu, const void* data, uint32_t
     for (j = 0; j < gpgpu->binded_n; ++j) {
       *(uint32_t *)(curbe + gpgpu->binded_offset[j]+i*k->curbe_sz) = gpgpu->binded_buf[j]->offset64 + gpgpu->target_buf_offset[j];
       drm_intel_bo_emit_reloc(gpgpu->aux_buf.bo,
-                              gpgpu->aux_offset.curbe_offset + gpgpu->binded_offset[j]+i*k->curbe_sz,
+                              intel_gpgpu_curbe_offset(gpgpu) + gpgpu->binded_offset[j]+i*k->curbe_sz,
                               gpgpu->binded_buf[j],
                               gpgpu->target_buf_offset[j],
                               I915_GEM_DOMAIN_RENDER,
                               I915_GEM_DOMAIN_RENDER);
     }
-  dri_bo_unmap(gpgpu->aux_buf.bo);
+  intel_gpgpu_unmap_aux(gpgpu);
   return 0;
 }
 
@@ -2084,12 +2279,10 @@ intel_gpgpu_upload_curbes_gen8(intel_gpgpu_t *gpgpu, const void* data, uint32_t
   uint32_t i, j;
 
   /* Upload the data first */
-  if (dri_bo_map(gpgpu->aux_buf.bo, 1) != 0) {
-    fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
+  if (intel_gpgpu_map_aux(gpgpu) != 0)
     return -1;
-  }
   assert(gpgpu->aux_buf.bo->virtual);
-  curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.curbe_offset);
+  curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + intel_gpgpu_curbe_offset(gpgpu));
   memcpy(curbe, data, size);
 
   /* Now put all the relocations for our flat address space */
@@ -2097,13 +2290,13 @@ intel_gpgpu_upload_curbes_gen8(intel_gpgpu_t *gpgpu, const void* data, uint32_t
     for (j = 0; j < gpgpu->binded_n; ++j) {
       *(size_t *)(curbe + gpgpu->binded_offset[j]+i*k->curbe_sz) = gpgpu->binded_buf[j]->offset64 + gpgpu->target_buf_offset[j];
       drm_intel_bo_emit_reloc(gpgpu->aux_buf.bo,
-                              gpgpu->aux_offset.curbe_offset + gpgpu->binded_offset[j]+i*k->curbe_sz,
+                              intel_gpgpu_curbe_offset(gpgpu) + gpgpu->binded_offset[j]+i*k->curbe_sz,
                               gpgpu->binded_buf[j],
                               gpgpu->target_buf_offset[j],
                               I915_GEM_DOMAIN_RENDER,
                               I915_GEM_DOMAIN_RENDER);
     }
-  dri_bo_unmap(gpgpu->aux_buf.bo);
+  intel_gpgpu_unmap_aux(gpgpu);
   return 0;
 }
 
@@ -2414,14 +2607,50 @@ intel_gpgpu_bind_sampler_gen8(intel_gpgpu_t *gpgpu, uint32_t *samplers, size_t s
 }
 
 static void
+intel_gpgpu_set_dispatch_n(intel_gpgpu_t *gpgpu, uint32_t n)
+{
+  assert(n >= 1 && n <= CL_GPGPU_MAX_DISPATCH);
+  gpgpu->dispatch_n = n;
+  gpgpu->dispatch = gpgpu->loaded_dispatch = 0;
+  memset(gpgpu->dispatch_ker, 0, sizeof(gpgpu->dispatch_ker));
+}
+
+static void
+intel_gpgpu_select_dispatch(intel_gpgpu_t *gpgpu, uint32_t index)
+{
+  assert(index < gpgpu->dispatch_n);
+  gpgpu->dispatch = index;
+  if (gpgpu->dispatch_ker[index])
+    gpgpu->ker = gpgpu->dispatch_ker[index];
+}
+
+/* Before a walker using another CURBE than the previous one: wait for the
+ * previous walker, then load the CURBE and descriptor of this one */
+static void
+intel_gpgpu_load_dispatch(intel_gpgpu_t *gpgpu)
+{
+  if (gpgpu->dispatch == gpgpu->loaded_dispatch)
+    return;
+  intel_gpgpu_pipe_control(gpgpu);
+  intel_gpgpu_load_curbe_buffer(gpgpu);
+  intel_gpgpu_load_idrt(gpgpu);
+  gpgpu->loaded_dispatch = gpgpu->dispatch;
+}
+
+static int
 intel_gpgpu_states_setup(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
 {
   gpgpu->ker = kernel;
+  gpgpu->dispatch_ker[gpgpu->dispatch] = kernel;
+  /* The aux buffer was unmapped by the setup of the previous walker */
+  if (intel_gpgpu_map_aux(gpgpu) != 0)
+    return -1;
   if (gpgpu->drv->null_bo)
     intel_gpgpu_setup_bti(gpgpu, gpgpu->drv->null_bo, 0, 64*1024, 0xfe, I965_SURFACEFORMAT_RAW);
 
   intel_gpgpu_build_idrt(gpgpu, kernel);
-  dri_bo_unmap(gpgpu->aux_buf.bo);
+  intel_gpgpu_unmap_aux(gpgpu);
+  return 0;
 }
 
 static void
@@ -2451,6 +2680,7 @@ intel_gpgpu_walker_gen7(intel_gpgpu_t *gpgpu,
   size_t group_sz = local_wk_sz[0] * local_wk_sz[1] * local_wk_sz[2];
 
   assert(simd_sz == 8 || simd_sz == 16);
+  intel_gpgpu_load_dispatch(gpgpu);
 
   uint32_t shift = (group_sz & (simd_sz - 1));
   shift = (shift == 0) ? simd_sz : shift;
@@ -2501,6 +2731,7 @@ intel_gpgpu_walker_gen8(intel_gpgpu_t *gpgpu,
   size_t group_sz = local_wk_sz[0] * local_wk_sz[1] * local_wk_sz[2];
 
   assert(simd_sz == 8 || simd_sz == 16);
+  intel_gpgpu_load_dispatch(gpgpu);
 
   uint32_t shift = (group_sz & (simd_sz - 1));
   shift = (shift == 0) ? simd_sz : shift;
@@ -2708,16 +2939,15 @@ intel_gpgpu_get_profiling_info(intel_gpgpu_t *gpgpu)
 static int
 intel_gpgpu_set_printf_buf(intel_gpgpu_t *gpgpu, uint32_t size, uint8_t bti)
 {
-  if (gpgpu->printf_b.bo)
-    dri_bo_unreference(gpgpu->printf_b.bo);
-  gpgpu->printf_b.bo = dri_bo_alloc(gpgpu->drv->bufmgr, "Printf buffer", size, 4096);
+  intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_PRINTF, gpgpu->printf_b.bo);
+  gpgpu->printf_b.bo = intel_gpgpu_get_bo(gpgpu, INTEL_BO_CACHE_PRINTF, "Printf buffer", size, 4096);
 
   if (!gpgpu->printf_b.bo || (drm_intel_bo_map(gpgpu->printf_b.bo, 1) != 0)) {
     fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
     return -1;
   }
 
-  memset(gpgpu->printf_b.bo->virtual, 0, size);
+  /* The output is parsed up to the length, a reused buffer needs no clear */
   *(uint32_t *)(gpgpu->printf_b.bo->virtual) = 4; // first four is for the length.
   drm_intel_bo_unmap(gpgpu->printf_b.bo);
   /* No need to bind, we do not need to emit reloc. */
@@ -2763,7 +2993,7 @@ intel_gpgpu_unmap_printf_buf_addr(intel_gpgpu_t *gpgpu)
 static void
 intel_gpgpu_release_printf_buf(intel_gpgpu_t *gpgpu)
 {
-  drm_intel_bo_unreference(gpgpu->printf_b.bo);
+  intel_gpgpu_put_bo(gpgpu, INTEL_BO_CACHE_PRINTF, gpgpu->printf_b.bo);
   gpgpu->printf_b.bo = NULL;
 }
 
@@ -2797,6 +3027,14 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_new = (cl_gpgpu_new_cb *) intel_gpgpu_new;
   cl_gpgpu_delete = (cl_gpgpu_delete_cb *) intel_gpgpu_delete;
   cl_gpgpu_sync = (cl_gpgpu_sync_cb *) intel_gpgpu_sync;
+  cl_gpgpu_is_idle = (cl_gpgpu_is_idle_cb *) intel_gpgpu_is_idle;
+  cl_gpgpu_bo_cache_new = (cl_gpgpu_bo_cache_new_cb *) intel_gpgpu_bo_cache_new;
+  cl_gpgpu_bo_cache_close = (cl_gpgpu_bo_cache_close_cb *) intel_gpgpu_bo_cache_close;
+  cl_gpgpu_set_bo_cache = (cl_gpgpu_set_bo_cache_cb *) intel_gpgpu_set_bo_cache;
+  cl_gpgpu_bo_cache_get_stats = (cl_gpgpu_bo_cache_get_stats_cb *) intel_gpgpu_bo_cache_get_stats;
+  cl_gpgpu_chain = NULL;
+  cl_gpgpu_set_dispatch_n = (cl_gpgpu_set_dispatch_n_cb *) intel_gpgpu_set_dispatch_n;
+  cl_gpgpu_select_dispatch = (cl_gpgpu_select_dispatch_cb *) intel_gpgpu_select_dispatch;
   cl_gpgpu_bind_buf = (cl_gpgpu_bind_buf_cb *) intel_gpgpu_bind_buf;
   cl_gpgpu_set_stack = (cl_gpgpu_set_stack_cb *) intel_gpgpu_set_stack;
   cl_gpgpu_state_init = (cl_gpgpu_state_init_cb *) intel_gpgpu_state_init;
@@ -2853,6 +3091,7 @@ intel_set_gpgpu_callbacks(int device_id)
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen7;
     cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain;
     return;
   }
   if (IS_GEN9(device_id)) {
@@ -2876,6 +3115,7 @@ intel_set_gpgpu_callbacks(int device_id)
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen9;
     cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain;
     return;
   }
 
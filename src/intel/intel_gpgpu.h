@@ -40,6 +40,20 @@ enum {max_sampler_n = 16 };
 struct intel_driver;
 struct intel_batchbuffer;
 
+/* Idle internal buffers of the launches of one queue, in size classes */
+enum { INTEL_BO_CACHE_SCRATCH, INTEL_BO_CACHE_STACK, INTEL_BO_CACHE_PRINTF, INTEL_BO_CACHE_KIND_N };
+enum { INTEL_BO_CACHE_SIZE = 4 };
+
+struct intel_gpgpu_bo_cache
+{
+  pthread_mutex_t lock;
+  drm_intel_bo *bo[INTEL_BO_CACHE_KIND_N][INTEL_BO_CACHE_SIZE]; /* oldest first */
+  uint32_t bo_n[INTEL_BO_CACHE_KIND_N];
+  uint32_t ref_n;                       /* the queue plus one per gpgpu attached */
+  uint64_t hit_n;                       /* buffers reused */
+  uint64_t miss_n;                      /* buffers allocated */
+};
+
 /* Handle GPGPU state */
 struct intel_gpgpu
 {
@@ -68,6 +82,7 @@ struct intel_gpgpu
   struct { drm_intel_bo *bo; } printf_b;      /* the printf buf and index buf*/
   struct { drm_intel_bo *bo; } profiling_b;   /* the buf for profiling*/
   struct { drm_intel_bo *bo; } aux_buf;
+  struct intel_gpgpu_bo_cache *bo_cache;     /* where scratch, stack and printf come from */
   struct {
     uint32_t surface_heap_offset;
     uint32_t curbe_offset;
@@ -83,6 +98,11 @@ struct intel_gpgpu
   } curb;
 
   uint32_t max_threads;      /* max threads requested by the user */
+
+  uint32_t dispatch_n;       /* walkers with their own CURBE and descriptor */
+  uint32_t dispatch;         /* walker the state calls apply to */
+  uint32_t loaded_dispatch;  /* walker whose CURBE and descriptor the batch loaded last */
+  cl_gpgpu_kernel *dispatch_ker[CL_GPGPU_MAX_DISPATCH];
 };
 
 struct intel_gpgpu_node {
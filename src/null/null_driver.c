@@ -0,0 +1,1158 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "null/null_driver.h"
+#include "cl_device_data.h"
+#include "cl_context.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NULL_DEFAULT_DEVICE_ID  PCI_CHIP_SKYLAKE_DT_GT2
+#define NULL_DEFAULT_RECORD_N   4096
+
+typedef struct null_driver {
+  uint32_t device_id;
+  uint32_t gen_ver;
+  int atomic_test_result;
+  uint64_t delay_ns;          /* time a flushed batch takes to complete */
+  uint32_t record_max;        /* max number of batches kept in the log */
+  int dump;                   /* dump the log when the context is destroyed */
+  pthread_mutex_t lock;       /* protects the log below */
+  uint32_t batch_n;           /* number of flushed batches */
+  uint32_t record_n;
+  uint32_t record_cap;
+  null_batch_record_t *records;
+} null_driver_t;
+
+typedef struct null_buffer {
+  atomic_t ref_n;
+  null_driver_t *drv;
+  const char *name;
+  void *virtual;
+  size_t size;
+  uint32_t userptr:1;         /* memory owned by the application */
+  uint32_t tiling:2;
+  size_t stride;
+  volatile uint64_t ready_ns; /* the last batch using it is done at this time */
+} null_buffer_t;
+
+#define NULL_MAX_BOUND_BUF 256
+
+typedef struct null_gpgpu {
+  null_driver_t *drv;
+  null_buffer_t *batch;       /* fake batch buffer, tracks completion */
+  null_buffer_t *constant_b;
+  null_buffer_t *profiling_b;
+  null_buffer_t *printf_b;
+  null_buffer_t *bound[NULL_MAX_BOUND_BUF];
+  uint32_t bound_n;
+  void *kernel;
+  void *printf_info;
+  void *profiling_info;
+  null_batch_record_t rec;    /* batch being built */
+  uint64_t submit_ns;         /* flush time of the last batch */
+  uint64_t complete_ns;       /* completion time of the last batch */
+  struct null_gpgpu *chained; /* batch submitted along with this one */
+  uint32_t surface_cap;
+  uint32_t walker_cap;
+} null_gpgpu_t;
+
+typedef struct null_event {
+  null_buffer_t *batch;
+  int status;
+} null_event_t;
+
+static int null_driver_selected = -1;
+
+static uint64_t
+null_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+null_wait_until(uint64_t deadline)
+{
+  uint64_t now;
+  while ((now = null_now_ns()) < deadline) {
+    struct timespec ts;
+    ts.tv_sec = (deadline - now) / 1000000000ull;
+    ts.tv_nsec = (deadline - now) % 1000000000ull;
+    nanosleep(&ts, NULL);
+  }
+}
+
+static uint64_t
+null_getenv_u64(const char *name, uint64_t dflt)
+{
+  const char *env = getenv(name);
+  if (env == NULL || *env == '\0')
+    return dflt;
+  return strtoull(env, NULL, 0);
+}
+
+LOCAL int
+null_driver_enabled(void)
+{
+  if (null_driver_selected < 0)
+    null_driver_selected = null_getenv_u64("OCL_NULL_DRIVER", 0) != 0;
+  return null_driver_selected;
+}
+
+/**************************************************************************
+ * Driver
+ **************************************************************************/
+static int
+null_get_device_id(void)
+{
+  return (int)null_getenv_u64("OCL_NULL_DRIVER_DEVICE_ID", NULL_DEFAULT_DEVICE_ID);
+}
+
+static uint32_t
+null_gen_ver(uint32_t device_id)
+{
+  if (IS_GEN9(device_id))
+    return 9;
+  else if (IS_GEN8(device_id))
+    return 8;
+  else if (IS_GEN75(device_id))
+    return 75;
+  else if (IS_GEN7(device_id))
+    return 7;
+  return 6;
+}
+
+static void
+null_driver_delete(null_driver_t *drv)
+{
+  if (drv == NULL)
+    return;
+  if (drv->dump)
+    null_driver_dump_records((cl_driver)drv, stderr);
+  null_driver_reset_records((cl_driver)drv);
+  pthread_mutex_destroy(&drv->lock);
+  cl_free(drv);
+}
+
+static null_driver_t*
+null_driver_new(cl_context_prop props)
+{
+  null_driver_t *drv = NULL;
+
+  TRY_ALLOC_NO_ERR (drv, CALLOC(null_driver_t));
+  pthread_mutex_init(&drv->lock, NULL);
+  drv->device_id = null_get_device_id();
+  drv->gen_ver = null_gen_ver(drv->device_id);
+  drv->delay_ns = null_getenv_u64("OCL_NULL_DRIVER_DELAY_US", 0) * 1000;
+  drv->record_max = null_getenv_u64("OCL_NULL_DRIVER_RECORD", NULL_DEFAULT_RECORD_N);
+  drv->dump = null_getenv_u64("OCL_NULL_DRIVER_DUMP", 0) != 0;
+
+exit:
+  return drv;
+error:
+  drv = NULL;
+  goto exit;
+}
+
+static cl_buffer_mgr
+null_driver_get_bufmgr(null_driver_t *drv)
+{
+  /* The driver itself hands out buffers */
+  return (cl_buffer_mgr)drv;
+}
+
+static uint32_t
+null_driver_get_ver(null_driver_t *drv)
+{
+  return drv->gen_ver;
+}
+
+static void
+null_driver_enlarge_stack_size(null_driver_t *drv, int32_t *stack_size)
+{
+  if (drv->gen_ver == 75)
+    *stack_size = *stack_size * 4;
+  else if (drv->device_id == PCI_CHIP_BROXTON_1 || drv->device_id == PCI_CHIP_BROXTON_3 ||
+           IS_CHERRYVIEW(drv->device_id))
+    *stack_size = *stack_size * 2;
+}
+
+static void
+null_driver_set_atomic_flag(null_driver_t *drv, int atomic_flag)
+{
+  drv->atomic_test_result = atomic_flag;
+}
+
+static void
+null_update_device_info(cl_device_id device)
+{
+  /* Nothing to query: keep the static description of the device */
+  (void)device;
+}
+
+/**************************************************************************
+ * Buffers
+ **************************************************************************/
+static null_buffer_t*
+null_buffer_alloc(null_driver_t *drv, const char *name, size_t sz, size_t align)
+{
+  null_buffer_t *bo = NULL;
+
+  TRY_ALLOC_NO_ERR (bo, CALLOC(null_buffer_t));
+  if (align < 64)
+    align = 64;
+  /* Keep zero sized requests valid pointers like the kernel driver does */
+  TRY_ALLOC_NO_ERR (bo->virtual, cl_aligned_malloc(ALIGN(sz ? sz : 1, align), align));
+  bo->ref_n = 1;
+  bo->drv = drv;
+  bo->name = name;
+  bo->size = sz;
+
+exit:
+  return bo;
+error:
+  if (bo)
+    cl_free(bo);
+  bo = NULL;
+  goto exit;
+}
+
+static null_buffer_t*
+null_buffer_alloc_userptr(null_driver_t *drv, const char *name, void *data, size_t sz, unsigned long flags)
+{
+  null_buffer_t *bo = NULL;
+
+  TRY_ALLOC_NO_ERR (bo, CALLOC(null_buffer_t));
+  bo->ref_n = 1;
+  bo->drv = drv;
+  bo->name = name;
+  bo->virtual = data;
+  bo->size = sz;
+  bo->userptr = 1;
+
+exit:
+  return bo;
+error:
+  bo = NULL;
+  goto exit;
+}
+
+static void
+null_buffer_reference(null_buffer_t *bo)
+{
+  atomic_inc(&bo->ref_n);
+}
+
+static int
+null_buffer_unreference(null_buffer_t *bo)
+{
+  if (bo == NULL)
+    return 0;
+  if (atomic_dec(&bo->ref_n) > 1)
+    return 0;
+  if (!bo->userptr)
+    cl_free(bo->virtual);
+  cl_free(bo);
+  return 0;
+}
+
+static int
+null_buffer_wait_rendering(null_buffer_t *bo)
+{
+  null_wait_until(bo->ready_ns);
+  return 0;
+}
+
+static int
+null_buffer_is_busy(null_buffer_t *bo)
+{
+  return null_now_ns() < bo->ready_ns;
+}
+
+static int
+null_buffer_map(null_buffer_t *bo, uint32_t write_enable)
+{
+  return null_buffer_wait_rendering(bo);
+}
+
+static int
+null_buffer_map_unsync(null_buffer_t *bo)
+{
+  return 0;
+}
+
+static int
+null_buffer_unmap(null_buffer_t *bo)
+{
+  return 0;
+}
+
+static void*
+null_buffer_get_virtual(null_buffer_t *bo)
+{
+  return bo->virtual;
+}
+
+static size_t
+null_buffer_get_size(null_buffer_t *bo)
+{
+  return bo->size;
+}
+
+static int
+null_buffer_pin(null_buffer_t *bo, uint32_t alignment)
+{
+  return 0;
+}
+
+static int
+null_buffer_set_softpin_offset(null_buffer_t *bo, uint64_t offset)
+{
+  return 0;
+}
+
+static int
+null_buffer_set_bo_use_full_range(null_buffer_t *bo, uint32_t full_range)
+{
+  return 0;
+}
+
+static int
+null_buffer_subdata(null_buffer_t *bo, unsigned long offset, unsigned long size, const void *data)
+{
+  null_buffer_wait_rendering(bo);
+  memcpy((char*)bo->virtual + offset, data, size);
+  return 0;
+}
+
+static int
+null_buffer_get_subdata(null_buffer_t *bo, unsigned long offset, unsigned long size, void *data)
+{
+  null_buffer_wait_rendering(bo);
+  memcpy(data, (char*)bo->virtual + offset, size);
+  return 0;
+}
+
+static int
+null_buffer_set_tiling(null_buffer_t *bo, int tiling, size_t stride)
+{
+  bo->tiling = tiling;
+  bo->stride = stride;
+  return 0;
+}
+
+static int
+null_buffer_get_fd(null_buffer_t *bo, int *fd)
+{
+  /* Nothing to export without a kernel driver */
+  return -1;
+}
+
+static cl_buffer
+null_buffer_get_buffer_from_libva(cl_context ctx, unsigned int bo_name, size_t *sz)
+{
+  return NULL;
+}
+
+static cl_buffer
+null_buffer_get_image_from_libva(cl_context ctx, unsigned int bo_name, struct _cl_mem_image *image)
+{
+  return NULL;
+}
+
+static cl_buffer
+null_buffer_get_buffer_from_fd(cl_context ctx, int fd, int buffer_size)
+{
+  return NULL;
+}
+
+static cl_buffer
+null_buffer_get_image_from_fd(cl_context ctx, int fd, int image_size, struct _cl_mem_image *image)
+{
+  return NULL;
+}
+
+static int
+null_buffer_can_host_tile(null_buffer_t *bo)
+{
+  /* No fence either: the GTT map shows the same bytes as the CPU map, so
+   * the host must not reorder them behind it */
+  return 0;
+}
+
+static uint32_t
+null_buffer_get_tiling_align(cl_context ctx, uint32_t tiling_mode, uint32_t dim)
+{
+  uint32_t gen_ver = ((null_driver_t *)ctx->drv)->gen_ver;
+  uint32_t ret = 0;
+
+  /* Same surface layout constraints as the real hardware */
+  switch (tiling_mode) {
+  case CL_TILE_X:
+    if (dim == 0)
+      ret = 512;
+    else if (dim == 1)
+      ret = 8;
+    else if (dim == 2)
+      ret = gen_ver == 9 ? 8 : (gen_ver == 8 ? 4 : 2);
+    else
+      assert(0);
+    break;
+  case CL_TILE_Y:
+    if (dim == 0)
+      ret = 128;
+    else if (dim == 1)
+      ret = 32;
+    else if (dim == 2)
+      ret = gen_ver == 9 ? 32 : (gen_ver == 8 ? 4 : 2);
+    else
+      assert(0);
+    break;
+  case CL_NO_TILE:
+    if (dim == 1 || dim == 2)
+      ret = (gen_ver == 8 || gen_ver == 9) ? 4 : 2;
+    else
+      assert(0);
+    break;
+  }
+  return ret;
+}
+
+/**************************************************************************
+ * GPGPU
+ **************************************************************************/
+static void
+null_gpgpu_release_bound(null_gpgpu_t *gpgpu)
+{
+  uint32_t i;
+  for (i = 0; i < gpgpu->bound_n; ++i)
+    null_buffer_unreference(gpgpu->bound[i]);
+  gpgpu->bound_n = 0;
+}
+
+static void
+null_gpgpu_reset_record(null_gpgpu_t *gpgpu)
+{
+  cl_free(gpgpu->rec.surfaces);
+  cl_free(gpgpu->rec.walkers);
+  memset(&gpgpu->rec, 0, sizeof(gpgpu->rec));
+  gpgpu->surface_cap = gpgpu->walker_cap = 0;
+}
+
+static null_gpgpu_t*
+null_gpgpu_new(null_driver_t *drv)
+{
+  null_gpgpu_t *gpgpu = NULL;
+
+  TRY_ALLOC_NO_ERR (gpgpu, CALLOC(null_gpgpu_t));
+  gpgpu->drv = drv;
+
+exit:
+  return gpgpu;
+error:
+  gpgpu = NULL;
+  goto exit;
+}
+
+static void
+null_gpgpu_delete(null_gpgpu_t *gpgpu)
+{
+  if (gpgpu == NULL)
+    return;
+  null_gpgpu_release_bound(gpgpu);
+  null_gpgpu_reset_record(gpgpu);
+  null_buffer_unreference(gpgpu->batch);
+  null_buffer_unreference(gpgpu->constant_b);
+  null_buffer_unreference(gpgpu->profiling_b);
+  null_buffer_unreference(gpgpu->printf_b);
+  cl_free(gpgpu);
+}
+
+static void
+null_gpgpu_sync(void *buf)
+{
+  if (buf)
+    null_buffer_wait_rendering((null_buffer_t *)buf);
+}
+
+static int
+null_gpgpu_is_idle(null_gpgpu_t *gpgpu)
+{
+  return gpgpu->batch == NULL || null_now_ns() >= gpgpu->batch->ready_ns;
+}
+
+/* Scratch and stack are only recorded, there is nothing worth caching */
+static cl_gpgpu_bo_cache
+null_gpgpu_bo_cache_new(null_driver_t *drv)
+{
+  return NULL;
+}
+
+static void
+null_gpgpu_bo_cache_close(cl_gpgpu_bo_cache cache)
+{
+}
+
+static void
+null_gpgpu_set_bo_cache(null_gpgpu_t *gpgpu, cl_gpgpu_bo_cache cache)
+{
+}
+
+static void
+null_gpgpu_bo_cache_get_stats(cl_gpgpu_bo_cache cache, cl_ulong stats[2])
+{
+  stats[0] = stats[1] = 0;
+}
+
+static void*
+null_gpgpu_ref_batch_buf(null_gpgpu_t *gpgpu)
+{
+  if (gpgpu->batch)
+    null_buffer_reference(gpgpu->batch);
+  return gpgpu->batch;
+}
+
+static void
+null_gpgpu_unref_batch_buf(void *buf)
+{
+  null_buffer_unreference((null_buffer_t *)buf);
+}
+
+static null_surface_record_t*
+null_gpgpu_add_surface(null_gpgpu_t *gpgpu, null_buffer_t *bo, uint32_t bti)
+{
+  null_batch_record_t *rec = &gpgpu->rec;
+  null_surface_record_t *s;
+
+  if (bo && gpgpu->bound_n < NULL_MAX_BOUND_BUF) {
+    null_buffer_reference(bo);
+    gpgpu->bound[gpgpu->bound_n++] = bo;
+  }
+  if (rec->surface_n == gpgpu->surface_cap) {
+    uint32_t cap = gpgpu->surface_cap ? 2 * gpgpu->surface_cap : 16;
+    void *p = cl_realloc(rec->surfaces, cap * sizeof(null_surface_record_t));
+    if (p == NULL)
+      return NULL;
+    rec->surfaces = p;
+    gpgpu->surface_cap = cap;
+  }
+  s = &rec->surfaces[rec->surface_n++];
+  memset(s, 0, sizeof(*s));
+  s->bti = bti;
+  return s;
+}
+
+static void
+null_gpgpu_bind_buf(null_gpgpu_t *gpgpu, null_buffer_t *buf, uint32_t offset,
+                    uint32_t internal_offset, size_t size, uint8_t bti)
+{
+  null_surface_record_t *s = null_gpgpu_add_surface(gpgpu, buf, bti);
+  if (s == NULL)
+    return;
+  s->offset = internal_offset + offset;
+  s->size = size;
+}
+
+static void
+null_gpgpu_bind_image(null_gpgpu_t *gpgpu, uint32_t index, null_buffer_t *obj_bo,
+                      uint32_t obj_bo_offset, uint32_t format, uint32_t bpp, uint32_t type,
+                      int32_t w, int32_t h, int32_t depth, int32_t pitch,
+                      int32_t slice_pitch, cl_gpgpu_tiling tiling)
+{
+  null_surface_record_t *s = null_gpgpu_add_surface(gpgpu, obj_bo, index);
+  if (s == NULL)
+    return;
+  s->is_image = 1;
+  s->tiling = tiling;
+  s->offset = obj_bo_offset;
+  s->format = format;
+  s->type = type;
+  s->w = w;
+  s->h = h;
+  s->depth = depth;
+  s->pitch = pitch;
+}
+
+static void
+null_gpgpu_set_stack(null_gpgpu_t *gpgpu, uint32_t offset, uint32_t size, uint32_t cchint)
+{
+  gpgpu->rec.stack_sz = size;
+}
+
+static int
+null_gpgpu_set_scratch(null_gpgpu_t *gpgpu, uint32_t per_thread_size)
+{
+  gpgpu->rec.scratch_sz = per_thread_size;
+  return 0;
+}
+
+static uint32_t
+null_gpgpu_get_cache_ctrl(void)
+{
+  return cc_llc_l3;
+}
+
+static int
+null_gpgpu_state_init(null_gpgpu_t *gpgpu, uint32_t max_threads, uint32_t size_cs_entry, int profiling)
+{
+  /* A new kernel state starts a new batch record */
+  null_gpgpu_release_bound(gpgpu);
+  null_gpgpu_reset_record(gpgpu);
+  return 0;
+}
+
+static void
+null_gpgpu_set_perf_counters(null_gpgpu_t *gpgpu, null_buffer_t *perf)
+{
+}
+
+static cl_buffer
+null_gpgpu_alloc_constant_buffer(null_gpgpu_t *gpgpu, uint32_t size, uint8_t bti)
+{
+  null_buffer_unreference(gpgpu->constant_b);
+  gpgpu->constant_b = null_buffer_alloc(gpgpu->drv, "CONSTANT_BUFFER", size, 64);
+  if (gpgpu->constant_b == NULL)
+    return NULL;
+  null_gpgpu_bind_buf(gpgpu, gpgpu->constant_b, 0, 0, size, bti);
+  return (cl_buffer)gpgpu->constant_b;
+}
+
+static int
+null_gpgpu_upload_curbes(null_gpgpu_t *gpgpu, const void *data, uint32_t size)
+{
+  gpgpu->rec.curbe_sz += size;
+  return 0;
+}
+
+static int
+null_gpgpu_states_setup(null_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
+{
+  if (kernel->name) {
+    strncpy(gpgpu->rec.kernel_name, kernel->name, sizeof(gpgpu->rec.kernel_name) - 1);
+    gpgpu->rec.kernel_name[sizeof(gpgpu->rec.kernel_name) - 1] = '\0';
+  }
+  if (kernel->use_slm && kernel->slm_sz > gpgpu->rec.slm_sz)
+    gpgpu->rec.slm_sz = kernel->slm_sz;
+  return 0;
+}
+
+/* Walkers sharing a state are simply recorded in order */
+static void
+null_gpgpu_set_dispatch_n(null_gpgpu_t *gpgpu, uint32_t n)
+{
+  assert(n >= 1 && n <= CL_GPGPU_MAX_DISPATCH);
+}
+
+static void
+null_gpgpu_select_dispatch(null_gpgpu_t *gpgpu, uint32_t index)
+{
+}
+
+static void
+null_gpgpu_upload_samplers(cl_gpgpu *gpgpu, const void *data, uint32_t n)
+{
+}
+
+static void
+null_gpgpu_bind_sampler(null_gpgpu_t *gpgpu, uint32_t *samplers, size_t sampler_sz)
+{
+  gpgpu->rec.sampler_n = sampler_sz;
+}
+
+static void
+null_gpgpu_bind_vme_state(null_gpgpu_t *gpgpu, cl_accelerator_intel accel)
+{
+  gpgpu->rec.sampler_n = 1;
+}
+
+static int
+null_gpgpu_batch_reset(null_gpgpu_t *gpgpu, size_t sz)
+{
+  null_buffer_unreference(gpgpu->batch);
+  gpgpu->batch = NULL;
+  gpgpu->chained = NULL;
+  /* Only the completion time of the batch matters, its storage is never used */
+  gpgpu->batch = null_buffer_alloc_userptr(gpgpu->drv, "batch buffer", NULL, sz, 0);
+  return gpgpu->batch == NULL ? -1 : 0;
+}
+
+static void
+null_gpgpu_batch_start(null_gpgpu_t *gpgpu)
+{
+}
+
+static void
+null_gpgpu_batch_end(null_gpgpu_t *gpgpu, int32_t flush_mode)
+{
+}
+
+static void
+null_gpgpu_walker(null_gpgpu_t *gpgpu, uint32_t simd_sz, uint32_t thread_n,
+                  const size_t global_wk_off[3], const size_t global_dim_off[3],
+                  const size_t global_wk_sz[3], const size_t local_wk_sz[3])
+{
+  null_batch_record_t *rec = &gpgpu->rec;
+  null_walker_record_t *w;
+
+  if (rec->walker_n == gpgpu->walker_cap) {
+    uint32_t cap = gpgpu->walker_cap ? 2 * gpgpu->walker_cap : 4;
+    void *p = cl_realloc(rec->walkers, cap * sizeof(null_walker_record_t));
+    if (p == NULL)
+      return;
+    rec->walkers = p;
+    gpgpu->walker_cap = cap;
+  }
+  w = &rec->walkers[rec->walker_n++];
+  w->simd_sz = simd_sz;
+  w->thread_n = thread_n;
+  memcpy(w->global_wk_off, global_wk_off, sizeof(w->global_wk_off));
+  memcpy(w->global_dim_off, global_dim_off, sizeof(w->global_dim_off));
+  memcpy(w->global_wk_sz, global_wk_sz, sizeof(w->global_wk_sz));
+  memcpy(w->local_wk_sz, local_wk_sz, sizeof(w->local_wk_sz));
+}
+
+static int
+null_gpgpu_flush_one(null_gpgpu_t *gpgpu)
+{
+  null_driver_t *drv = gpgpu->drv;
+  null_batch_record_t *rec = &gpgpu->rec;
+  const uint64_t now = null_now_ns();
+  const uint64_t done = now + drv->delay_ns;
+  uint32_t i;
+
+  if (gpgpu->batch)
+    gpgpu->batch->ready_ns = done;
+  for (i = 0; i < gpgpu->bound_n; ++i)
+    gpgpu->bound[i]->ready_ns = done;
+  rec->submit_ns = gpgpu->submit_ns = now;
+  rec->complete_ns = gpgpu->complete_ns = done;
+
+  pthread_mutex_lock(&drv->lock);
+  rec->seqno = drv->batch_n++;
+  if (drv->record_n < drv->record_max) {
+    if (drv->record_n == drv->record_cap) {
+      uint32_t cap = drv->record_cap ? 2 * drv->record_cap : 64;
+      void *p = cl_realloc(drv->records, cap * sizeof(null_batch_record_t));
+      if (p != NULL) {
+        drv->records = p;
+        drv->record_cap = cap;
+      }
+    }
+    if (drv->record_n < drv->record_cap) {
+      /* The log takes ownership of the surface and walker arrays */
+      drv->records[drv->record_n++] = *rec;
+      memset(rec, 0, sizeof(*rec));
+      gpgpu->surface_cap = gpgpu->walker_cap = 0;
+    }
+  }
+  pthread_mutex_unlock(&drv->lock);
+
+  /* A flushed batch may be flushed again: start over with an empty record */
+  null_gpgpu_reset_record(gpgpu);
+  return 0;
+}
+
+/* Chained batches are recorded one by one, as if they were flushed together */
+static int
+null_gpgpu_flush(null_gpgpu_t *gpgpu)
+{
+  while (gpgpu) {
+    null_gpgpu_t *next = gpgpu->chained;
+    gpgpu->chained = NULL;
+    null_gpgpu_flush_one(gpgpu);
+    gpgpu = next;
+  }
+  return 0;
+}
+
+static int
+null_gpgpu_chain(null_gpgpu_t *gpgpu, null_gpgpu_t *next)
+{
+  assert(gpgpu->chained == NULL);
+  gpgpu->chained = next;
+  return 0;
+}
+
+static null_event_t*
+null_gpgpu_event_new(null_gpgpu_t *gpgpu)
+{
+  null_event_t *event = NULL;
+
+  TRY_ALLOC_NO_ERR (event, CALLOC(null_event_t));
+  event->status = command_queued;
+  event->batch = gpgpu->batch;
+  if (event->batch)
+    null_buffer_reference(event->batch);
+
+exit:
+  return event;
+error:
+  event = NULL;
+  goto exit;
+}
+
+static int
+null_gpgpu_event_update_status(null_event_t *event, int wait)
+{
+  if (event->status == command_complete)
+    return event->status;
+
+  if (event->batch && event->status == command_running &&
+      null_now_ns() >= event->batch->ready_ns) {
+    event->status = command_complete;
+    null_buffer_unreference(event->batch);
+    event->batch = NULL;
+    return event->status;
+  }
+
+  if (wait == 0)
+    return event->status;
+
+  if (event->batch) {
+    null_buffer_wait_rendering(event->batch);
+    null_buffer_unreference(event->batch);
+    event->batch = NULL;
+  }
+  event->status = command_complete;
+  return event->status;
+}
+
+static void
+null_gpgpu_event_flush(null_event_t *event)
+{
+  if (event->status == command_queued)
+    event->status = command_running;
+}
+
+static void
+null_gpgpu_event_delete(null_event_t *event)
+{
+  if (event == NULL)
+    return;
+  null_buffer_unreference(event->batch);
+  cl_free(event);
+}
+
+static void
+null_gpgpu_event_get_exec_timestamp(null_gpgpu_t *gpgpu, int index, uint64_t *ret_ts)
+{
+  assert(index == 0 || index == 1);
+  /* Mirror the flush time and the reported completion time */
+  *ret_ts = index == 0 ? gpgpu->submit_ns : gpgpu->complete_ns;
+}
+
+static void
+null_gpgpu_event_get_gpu_cur_timestamp(null_driver_t *drv, uint64_t *ret_ts)
+{
+  *ret_ts = null_now_ns();
+}
+
+static int
+null_gpgpu_set_profiling_buf(null_gpgpu_t *gpgpu, uint32_t size, uint32_t offset, uint8_t bti)
+{
+  null_buffer_unreference(gpgpu->profiling_b);
+  gpgpu->profiling_b = null_buffer_alloc(gpgpu->drv, "Profiling buffer", size, 64);
+  if (gpgpu->profiling_b == NULL)
+    return -1;
+  memset(gpgpu->profiling_b->virtual, 0, size);
+  null_gpgpu_bind_buf(gpgpu, gpgpu->profiling_b, offset, 0, size, bti);
+  return 0;
+}
+
+static void
+null_gpgpu_set_profiling_info(null_gpgpu_t *gpgpu, void *profiling_info)
+{
+  gpgpu->profiling_info = profiling_info;
+}
+
+static void*
+null_gpgpu_get_profiling_info(null_gpgpu_t *gpgpu)
+{
+  return gpgpu->profiling_info;
+}
+
+static void*
+null_gpgpu_map_profiling_buf(null_gpgpu_t *gpgpu)
+{
+  if (gpgpu->profiling_b == NULL)
+    return NULL;
+  null_buffer_wait_rendering(gpgpu->profiling_b);
+  return gpgpu->profiling_b->virtual;
+}
+
+static void
+null_gpgpu_unmap_profiling_buf(null_gpgpu_t *gpgpu)
+{
+}
+
+static int
+null_gpgpu_set_printf_buf(null_gpgpu_t *gpgpu, uint32_t size, uint8_t bti)
+{
+  null_buffer_unreference(gpgpu->printf_b);
+  gpgpu->printf_b = null_buffer_alloc(gpgpu->drv, "Printf buffer", size, 4096);
+  if (gpgpu->printf_b == NULL)
+    return -1;
+  memset(gpgpu->printf_b->virtual, 0, size);
+  *(uint32_t *)(gpgpu->printf_b->virtual) = 4; // first four is for the length.
+  null_gpgpu_bind_buf(gpgpu, gpgpu->printf_b, 0, 0, size, bti);
+  return 0;
+}
+
+static unsigned long
+null_gpgpu_reloc_printf_buf(null_gpgpu_t *gpgpu, uint32_t index, uint32_t offset)
+{
+  if (gpgpu->printf_b == NULL)
+    return 0;
+  return (unsigned long)gpgpu->printf_b->virtual + offset;
+}
+
+static void*
+null_gpgpu_map_printf_buf(null_gpgpu_t *gpgpu)
+{
+  if (gpgpu->printf_b == NULL)
+    return NULL;
+  null_buffer_wait_rendering(gpgpu->printf_b);
+  return gpgpu->printf_b->virtual;
+}
+
+static void
+null_gpgpu_unmap_printf_buf(null_gpgpu_t *gpgpu)
+{
+}
+
+static void
+null_gpgpu_release_printf_buf(null_gpgpu_t *gpgpu)
+{
+  null_buffer_unreference(gpgpu->printf_b);
+  gpgpu->printf_b = NULL;
+}
+
+static void
+null_gpgpu_set_printf_info(null_gpgpu_t *gpgpu, void *printf_info)
+{
+  gpgpu->printf_info = printf_info;
+}
+
+static void*
+null_gpgpu_get_printf_info(null_gpgpu_t *gpgpu)
+{
+  return gpgpu->printf_info;
+}
+
+static void
+null_gpgpu_set_kernel(null_gpgpu_t *gpgpu, void *kernel)
+{
+  gpgpu->kernel = kernel;
+}
+
+static void*
+null_gpgpu_get_kernel(null_gpgpu_t *gpgpu)
+{
+  return gpgpu->kernel;
+}
+
+/**************************************************************************
+ * Batch log
+ **************************************************************************/
+LOCAL uint32_t
+null_driver_get_batch_n(cl_driver driver)
+{
+  null_driver_t *drv = (null_driver_t *)driver;
+  uint32_t n;
+  pthread_mutex_lock(&drv->lock);
+  n = drv->batch_n;
+  pthread_mutex_unlock(&drv->lock);
+  return n;
+}
+
+LOCAL uint32_t
+null_driver_get_record_n(cl_driver driver)
+{
+  null_driver_t *drv = (null_driver_t *)driver;
+  uint32_t n;
+  pthread_mutex_lock(&drv->lock);
+  n = drv->record_n;
+  pthread_mutex_unlock(&drv->lock);
+  return n;
+}
+
+LOCAL const null_batch_record_t*
+null_driver_get_record(cl_driver driver, uint32_t index)
+{
+  null_driver_t *drv = (null_driver_t *)driver;
+  const null_batch_record_t *rec = NULL;
+  pthread_mutex_lock(&drv->lock);
+  if (index < drv->record_n)
+    rec = &drv->records[index];
+  pthread_mutex_unlock(&drv->lock);
+  return rec;
+}
+
+LOCAL void
+null_driver_reset_records(cl_driver driver)
+{
+  null_driver_t *drv = (null_driver_t *)driver;
+  uint32_t i;
+  pthread_mutex_lock(&drv->lock);
+  for (i = 0; i < drv->record_n; ++i) {
+    cl_free(drv->records[i].surfaces);
+    cl_free(drv->records[i].walkers);
+  }
+  cl_free(drv->records);
+  drv->records = NULL;
+  drv->record_n = drv->record_cap = 0;
+  pthread_mutex_unlock(&drv->lock);
+}
+
+LOCAL void
+null_driver_dump_records(cl_driver driver, FILE *out)
+{
+  null_driver_t *drv = (null_driver_t *)driver;
+  uint32_t i, j;
+
+  pthread_mutex_lock(&drv->lock);
+  fprintf(out, "null driver: device 0x%04x, %u batches flushed, %u recorded\n",
+          drv->device_id, drv->batch_n, drv->record_n);
+  for (i = 0; i < drv->record_n; ++i) {
+    const null_batch_record_t *rec = &drv->records[i];
+    fprintf(out, "batch %u: kernel \"%s\" curbe %u scratch %u stack %u slm %u samplers %u"
+            " latency %lluns\n", rec->seqno, rec->kernel_name, rec->curbe_sz,
+            rec->scratch_sz, rec->stack_sz, rec->slm_sz, rec->sampler_n,
+            (unsigned long long)(rec->complete_ns - rec->submit_ns));
+    for (j = 0; j < rec->walker_n; ++j) {
+      const null_walker_record_t *w = &rec->walkers[j];
+      fprintf(out, "  walker simd%u threads %u off (%zu,%zu,%zu) global (%zu,%zu,%zu)"
+              " local (%zu,%zu,%zu)\n", w->simd_sz, w->thread_n,
+              w->global_wk_off[0], w->global_wk_off[1], w->global_wk_off[2],
+              w->global_wk_sz[0], w->global_wk_sz[1], w->global_wk_sz[2],
+              w->local_wk_sz[0], w->local_wk_sz[1], w->local_wk_sz[2]);
+    }
+    for (j = 0; j < rec->surface_n; ++j) {
+      const null_surface_record_t *s = &rec->surfaces[j];
+      if (s->is_image)
+        fprintf(out, "  bti %u image fmt 0x%x type %u %dx%dx%d pitch %d tiling %u\n",
+                s->bti, s->format, s->type, s->w, s->h, s->depth, s->pitch, s->tiling);
+      else
+        fprintf(out, "  bti %u buffer offset %u size %zu\n", s->bti, s->offset, s->size);
+    }
+  }
+  pthread_mutex_unlock(&drv->lock);
+}
+
+LOCAL void
+null_setup_callbacks(void)
+{
+  cl_driver_new = (cl_driver_new_cb *) null_driver_new;
+  cl_driver_delete = (cl_driver_delete_cb *) null_driver_delete;
+  cl_driver_get_ver = (cl_driver_get_ver_cb *) null_driver_get_ver;
+  cl_driver_enlarge_stack_size = (cl_driver_enlarge_stack_size_cb *) null_driver_enlarge_stack_size;
+  cl_driver_set_atomic_flag = (cl_driver_set_atomic_flag_cb *) null_driver_set_atomic_flag;
+  cl_driver_get_bufmgr = (cl_driver_get_bufmgr_cb *) null_driver_get_bufmgr;
+  cl_driver_get_device_id = (cl_driver_get_device_id_cb *) null_get_device_id;
+  cl_driver_update_device_info = (cl_driver_update_device_info_cb *) null_update_device_info;
+
+  cl_buffer_alloc = (cl_buffer_alloc_cb *) null_buffer_alloc;
+  cl_buffer_alloc_userptr = (cl_buffer_alloc_userptr_cb *) null_buffer_alloc_userptr;
+  cl_buffer_set_softpin_offset = (cl_buffer_set_softpin_offset_cb *) null_buffer_set_softpin_offset;
+  cl_buffer_set_bo_use_full_range = (cl_buffer_set_bo_use_full_range_cb *) null_buffer_set_bo_use_full_range;
+  cl_buffer_disable_reuse = (cl_buffer_disable_reuse_cb *) null_buffer_unmap;
+  cl_buffer_set_tiling = (cl_buffer_set_tiling_cb *) null_buffer_set_tiling;
+  cl_buffer_get_buffer_from_libva = (cl_buffer_get_buffer_from_libva_cb *) null_buffer_get_buffer_from_libva;
+  cl_buffer_get_image_from_libva = (cl_buffer_get_image_from_libva_cb *) null_buffer_get_image_from_libva;
+  cl_buffer_reference = (cl_buffer_reference_cb *) null_buffer_reference;
+  cl_buffer_unreference = (cl_buffer_unreference_cb *) null_buffer_unreference;
+  cl_buffer_map = (cl_buffer_map_cb *) null_buffer_map;
+  cl_buffer_unmap = (cl_buffer_unmap_cb *) null_buffer_unmap;
+  cl_buffer_map_gtt = (cl_buffer_map_gtt_cb *) null_buffer_wait_rendering;
+  cl_buffer_unmap_gtt = (cl_buffer_unmap_gtt_cb *) null_buffer_unmap;
+  cl_buffer_map_gtt_unsync = (cl_buffer_map_gtt_unsync_cb *) null_buffer_map_unsync;
+  cl_buffer_get_virtual = (cl_buffer_get_virtual_cb *) null_buffer_get_virtual;
+  cl_buffer_get_size = (cl_buffer_get_size_cb *) null_buffer_get_size;
+  cl_buffer_pin = (cl_buffer_pin_cb *) null_buffer_pin;
+  cl_buffer_unpin = (cl_buffer_unpin_cb *) null_buffer_unmap;
+  cl_buffer_subdata = (cl_buffer_subdata_cb *) null_buffer_subdata;
+  cl_buffer_get_subdata = (cl_buffer_get_subdata_cb *) null_buffer_get_subdata;
+  cl_buffer_wait_rendering = (cl_buffer_wait_rendering_cb *) null_buffer_wait_rendering;
+  cl_buffer_is_busy = (cl_buffer_is_busy_cb *) null_buffer_is_busy;
+  cl_buffer_get_fd = (cl_buffer_get_fd_cb *) null_buffer_get_fd;
+  cl_buffer_get_tiling_align = (cl_buffer_get_tiling_align_cb *) null_buffer_get_tiling_align;
+  cl_buffer_can_host_tile = (cl_buffer_can_host_tile_cb *) null_buffer_can_host_tile;
+  cl_buffer_get_buffer_from_fd = (cl_buffer_get_buffer_from_fd_cb *) null_buffer_get_buffer_from_fd;
+  cl_buffer_get_image_from_fd = (cl_buffer_get_image_from_fd_cb *) null_buffer_get_image_from_fd;
+
+  cl_gpgpu_new = (cl_gpgpu_new_cb *) null_gpgpu_new;
+  cl_gpgpu_delete = (cl_gpgpu_delete_cb *) null_gpgpu_delete;
+  cl_gpgpu_sync = (cl_gpgpu_sync_cb *) null_gpgpu_sync;
+  cl_gpgpu_is_idle = (cl_gpgpu_is_idle_cb *) null_gpgpu_is_idle;
+  cl_gpgpu_bo_cache_new = (cl_gpgpu_bo_cache_new_cb *) null_gpgpu_bo_cache_new;
+  cl_gpgpu_bo_cache_close = (cl_gpgpu_bo_cache_close_cb *) null_gpgpu_bo_cache_close;
+  cl_gpgpu_set_bo_cache = (cl_gpgpu_set_bo_cache_cb *) null_gpgpu_set_bo_cache;
+  cl_gpgpu_bo_cache_get_stats = (cl_gpgpu_bo_cache_get_stats_cb *) null_gpgpu_bo_cache_get_stats;
+  cl_gpgpu_bind_buf = (cl_gpgpu_bind_buf_cb *) null_gpgpu_bind_buf;
+  cl_gpgpu_set_stack = (cl_gpgpu_set_stack_cb *) null_gpgpu_set_stack;
+  cl_gpgpu_set_scratch = (cl_gpgpu_set_scratch_cb *) null_gpgpu_set_scratch;
+  cl_gpgpu_bind_image = (cl_gpgpu_bind_image_cb *) null_gpgpu_bind_image;
+  cl_gpgpu_bind_image_for_vme = (cl_gpgpu_bind_image_for_vme_cb *) null_gpgpu_bind_image;
+  cl_gpgpu_get_cache_ctrl = (cl_gpgpu_get_cache_ctrl_cb *) null_gpgpu_get_cache_ctrl;
+  cl_gpgpu_state_init = (cl_gpgpu_state_init_cb *) null_gpgpu_state_init;
+  cl_gpgpu_alloc_constant_buffer = (cl_gpgpu_alloc_constant_buffer_cb *) null_gpgpu_alloc_constant_buffer;
+  cl_gpgpu_set_perf_counters = (cl_gpgpu_set_perf_counters_cb *) null_gpgpu_set_perf_counters;
+  cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) null_gpgpu_upload_curbes;
+  cl_gpgpu_states_setup = (cl_gpgpu_states_setup_cb *) null_gpgpu_states_setup;
+  cl_gpgpu_upload_samplers = (cl_gpgpu_upload_samplers_cb *) null_gpgpu_upload_samplers;
+  cl_gpgpu_batch_reset = (cl_gpgpu_batch_reset_cb *) null_gpgpu_batch_reset;
+  cl_gpgpu_batch_start = (cl_gpgpu_batch_start_cb *) null_gpgpu_batch_start;
+  cl_gpgpu_batch_end = (cl_gpgpu_batch_end_cb *) null_gpgpu_batch_end;
+  cl_gpgpu_flush = (cl_gpgpu_flush_cb *) null_gpgpu_flush;
+  cl_gpgpu_chain = (cl_gpgpu_chain_cb *) null_gpgpu_chain;
+  cl_gpgpu_set_dispatch_n = (cl_gpgpu_set_dispatch_n_cb *) null_gpgpu_set_dispatch_n;
+  cl_gpgpu_select_dispatch = (cl_gpgpu_select_dispatch_cb *) null_gpgpu_select_dispatch;
+  cl_gpgpu_walker = (cl_gpgpu_walker_cb *) null_gpgpu_walker;
+  cl_gpgpu_bind_sampler = (cl_gpgpu_bind_sampler_cb *) null_gpgpu_bind_sampler;
+  cl_gpgpu_bind_vme_state = (cl_gpgpu_bind_vme_state_cb *) null_gpgpu_bind_vme_state;
+  cl_gpgpu_event_new = (cl_gpgpu_event_new_cb *) null_gpgpu_event_new;
+  cl_gpgpu_event_update_status = (cl_gpgpu_event_update_status_cb *) null_gpgpu_event_update_status;
+  cl_gpgpu_event_flush = (cl_gpgpu_event_flush_cb *) null_gpgpu_event_flush;
+  cl_gpgpu_event_delete = (cl_gpgpu_event_delete_cb *) null_gpgpu_event_delete;
+  cl_gpgpu_event_get_exec_timestamp = (cl_gpgpu_event_get_exec_timestamp_cb *) null_gpgpu_event_get_exec_timestamp;
+  cl_gpgpu_event_get_gpu_cur_timestamp = (cl_gpgpu_event_get_gpu_cur_timestamp_cb *) null_gpgpu_event_get_gpu_cur_timestamp;
+  cl_gpgpu_ref_batch_buf = (cl_gpgpu_ref_batch_buf_cb *) null_gpgpu_ref_batch_buf;
+  cl_gpgpu_unref_batch_buf = (cl_gpgpu_unref_batch_buf_cb *) null_gpgpu_unref_batch_buf;
+  cl_gpgpu_set_profiling_buffer = (cl_gpgpu_set_profiling_buffer_cb *) null_gpgpu_set_profiling_buf;
+  cl_gpgpu_set_profiling_info = (cl_gpgpu_set_profiling_info_cb *) null_gpgpu_set_profiling_info;
+  cl_gpgpu_get_profiling_info = (cl_gpgpu_get_profiling_info_cb *) null_gpgpu_get_profiling_info;
+  cl_gpgpu_map_profiling_buffer = (cl_gpgpu_map_profiling_buffer_cb *) null_gpgpu_map_profiling_buf;
+  cl_gpgpu_unmap_profiling_buffer = (cl_gpgpu_unmap_profiling_buffer_cb *) null_gpgpu_unmap_profiling_buf;
+  cl_gpgpu_set_printf_buffer = (cl_gpgpu_set_printf_buffer_cb *) null_gpgpu_set_printf_buf;
+  cl_gpgpu_reloc_printf_buffer = (cl_gpgpu_reloc_printf_buffer_cb *) null_gpgpu_reloc_printf_buf;
+  cl_gpgpu_map_printf_buffer = (cl_gpgpu_map_printf_buffer_cb *) null_gpgpu_map_printf_buf;
+  cl_gpgpu_unmap_printf_buffer = (cl_gpgpu_unmap_printf_buffer_cb *) null_gpgpu_unmap_printf_buf;
+  cl_gpgpu_release_printf_buffer = (cl_gpgpu_release_printf_buffer_cb *) null_gpgpu_release_printf_buf;
+  cl_gpgpu_set_printf_info = (cl_gpgpu_set_printf_info_cb *) null_gpgpu_set_printf_info;
+  cl_gpgpu_get_printf_info = (cl_gpgpu_get_printf_info_cb *) null_gpgpu_get_printf_info;
+  cl_gpgpu_set_kernel = (cl_gpgpu_set_kernel_cb *) null_gpgpu_set_kernel;
+  cl_gpgpu_get_kernel = (cl_gpgpu_get_kernel_cb *) null_gpgpu_get_kernel;
+}
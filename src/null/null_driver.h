@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2025 Frosted Beignet Contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The null driver implements the whole cl_driver.h interface in host
+ * memory: buffers are plain malloc'ed blocks, batches are never executed
+ * and events complete either at once or after a configurable delay. Every
+ * submitted batch is recorded (kernel, walkers, bound surfaces) so the
+ * runtime can be profiled and inspected on machines without a GPU.
+ *
+ * It is selected at load time with OCL_NULL_DRIVER=1 and configured with:
+ *  - OCL_NULL_DRIVER_DEVICE_ID: PCI ID to report (default 0x1912, SKL GT2)
+ *  - OCL_NULL_DRIVER_DELAY_US: delay before a batch completes (default 0)
+ *  - OCL_NULL_DRIVER_RECORD: max number of batches recorded (default 4096)
+ *  - OCL_NULL_DRIVER_DUMP: dump the recorded batches to stderr when the
+ *    context is destroyed
+ */
+#ifndef __NULL_DRIVER_H__
+#define __NULL_DRIVER_H__
+
+#include "cl_driver.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* One buffer or image surface bound to a batch */
+typedef struct null_surface_record {
+  uint32_t bti;          /* binding table index */
+  uint32_t is_image:1;   /* image or raw buffer */
+  uint32_t tiling:2;     /* cl_gpgpu_tiling for images */
+  uint32_t offset;       /* offset of the surface in the buffer */
+  size_t size;           /* size in bytes (buffers only) */
+  uint32_t format;       /* surface format (images only) */
+  uint32_t type;         /* surface type (images only) */
+  int32_t w, h, depth;   /* image extent */
+  int32_t pitch;         /* image row pitch */
+} null_surface_record_t;
+
+/* One GPGPU_WALKER emitted in a batch */
+typedef struct null_walker_record {
+  uint32_t simd_sz;
+  uint32_t thread_n;
+  size_t global_wk_off[3];
+  size_t global_dim_off[3];
+  size_t global_wk_sz[3];
+  size_t local_wk_sz[3];
+} null_walker_record_t;
+
+/* One flushed batch */
+typedef struct null_batch_record {
+  uint32_t seqno;                   /* submission order in the driver */
+  char kernel_name[64];             /* empty for non-kernel batches */
+  uint32_t curbe_sz;                /* total uploaded CURBE bytes */
+  uint32_t scratch_sz;              /* per thread scratch size */
+  uint32_t stack_sz;                /* stack buffer size */
+  uint32_t slm_sz;                  /* shared local memory size */
+  uint32_t sampler_n;               /* number of bound samplers */
+  uint32_t surface_n;
+  null_surface_record_t *surfaces;
+  uint32_t walker_n;
+  null_walker_record_t *walkers;
+  uint64_t submit_ns;               /* CLOCK_MONOTONIC time of the flush */
+  uint64_t complete_ns;             /* time the batch is reported done */
+} null_batch_record_t;
+
+/* Tell if the null driver has been selected for this process */
+extern int null_driver_enabled(void);
+
+/* Number of batches flushed so far (recorded or not) */
+extern uint32_t null_driver_get_batch_n(cl_driver);
+
+/* Number of batches kept in the log */
+extern uint32_t null_driver_get_record_n(cl_driver);
+
+/* Get a recorded batch, NULL if out of range */
+extern const null_batch_record_t *null_driver_get_record(cl_driver, uint32_t index);
+
+/* Drop all recorded batches */
+extern void null_driver_reset_records(cl_driver);
+
+/* Print the recorded batches */
+extern void null_driver_dump_records(cl_driver, FILE *out);
+
+/* init the call backs used by the ocl driver */
+extern void null_setup_callbacks(void);
+
+#endif /* __NULL_DRIVER_H__ */
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "utest_helper.hpp"
+
+/* Small buffers share slab BOs at different offsets. Fill many of them,
+ * copy between them, read them back, map them and cut sub-buffers out of
+ * them, then check the slab statistics of the context. */
+
+static void get_slab_stats(cl_ulong stats[6])
+{
+  OCL_CALL(clGetContextInfo, ctx, CL_CONTEXT_BUFFER_SLAB_STATS_INTEL,
+           6 * sizeof(cl_ulong), stats, NULL);
+}
+
+static void buffer_slab(void)
+{
+  const size_t buf_n = 256;
+  std::vector<cl_mem> bufs(buf_n);
+  std::vector<size_t> sizes(buf_n);
+  std::vector<uint8_t> data, out;
+  cl_ulong before[6], stats[6];
+  cl_int status;
+
+  get_slab_stats(before);
+  for (size_t i = 0; i < buf_n; i++) {
+    sizes[i] = 64 + (i * 769) % 16384;
+    data.assign(sizes[i], (uint8_t)i);
+    bufs[i] = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                             sizes[i], &data[0], &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+  }
+
+  get_slab_stats(stats);
+  OCL_ASSERT(stats[0] > 0);
+  OCL_ASSERT(stats[5] >= before[5] + buf_n);
+  OCL_ASSERT(stats[2] >= stats[3] && stats[1] >= stats[2]);
+
+  /* Copy the front of each buffer into the next one */
+  for (size_t i = 0; i + 1 < buf_n; i += 2) {
+    const size_t sz = std::min(sizes[i], sizes[i + 1]) / 2;
+    OCL_CALL(clEnqueueCopyBuffer, queue, bufs[i], bufs[i + 1], 0, 0, sz, 0, NULL, NULL);
+  }
+  OCL_FINISH();
+
+  for (size_t i = 0; i < buf_n; i++) {
+    const size_t copied = (i & 1) ? std::min(sizes[i - 1], sizes[i]) / 2 : 0;
+    out.assign(sizes[i], 0);
+    OCL_CALL(clEnqueueReadBuffer, queue, bufs[i], CL_TRUE, 0, sizes[i], &out[0], 0, NULL, NULL);
+    for (size_t j = 0; j < sizes[i]; j++)
+      OCL_ASSERT(out[j] == (uint8_t)(j < copied ? i - 1 : i));
+  }
+
+  /* Maps and sub-buffers see the data of their own chunk only */
+  uint8_t *ptr = (uint8_t *)clEnqueueMapBuffer(queue, bufs[2], CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                               0, sizes[2], 0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  for (size_t j = 0; j < sizes[2]; j++)
+    OCL_ASSERT(ptr[j] == 2);
+  memset(ptr, 0xab, sizes[2]);
+  OCL_CALL(clEnqueueUnmapMemObject, queue, bufs[2], ptr, 0, NULL, NULL);
+
+  cl_buffer_region region = { 0, 128 };
+  cl_mem sub = clCreateSubBuffer(bufs[2], 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  out.assign(128, 0);
+  OCL_CALL(clEnqueueReadBuffer, queue, sub, CL_TRUE, 0, 128, &out[0], 0, NULL, NULL);
+  for (size_t j = 0; j < 128; j++)
+    OCL_ASSERT(out[j] == 0xab);
+  OCL_CALL(clReleaseMemObject, sub);
+
+  for (size_t i = 0; i < buf_n; i++)
+    OCL_CALL(clReleaseMemObject, bufs[i]);
+  OCL_FINISH();
+
+  get_slab_stats(stats);
+  OCL_ASSERT(stats[2] == before[2] && stats[3] == before[3]);
+}
+
+MAKE_UTEST_FROM_FUNCTION(buffer_slab);
+
+/* A kernel waiting for a user event is not submitted, so its slab BO is not
+ * busy. Releasing its source buffer meanwhile must not let new buffers take
+ * the chunk before the kernel ran. */
+static void buffer_slab_release_pending(void)
+{
+  const size_t n = 64, new_n = 256;
+  std::vector<cl_mem> news(new_n);
+  std::vector<float> data(n), out(n);
+  cl_event user_event;
+  cl_int status;
+
+  for (size_t i = 0; i < n; i++)
+    data[i] = (float)i;
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_COPY_HOST_PTR, n * sizeof(float), &data[0]);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(float), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+
+  OCL_CREATE_USER_EVENT(user_event);
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_CALL(clEnqueueNDRangeKernel, queue, kernel, 1, NULL, globals, locals, 1, &user_event, NULL);
+  OCL_CALL(clReleaseMemObject, buf[0]);
+  buf[0] = NULL;
+
+  /* Buffers of the same size class, written at once */
+  std::vector<float> garbage(n, -1.0f);
+  for (size_t i = 0; i < new_n; i++) {
+    news[i] = clCreateBuffer(ctx, CL_MEM_COPY_HOST_PTR, n * sizeof(float), &garbage[0], &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+  }
+
+  OCL_SET_USER_EVENT_STATUS(user_event, CL_COMPLETE);
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[1], CL_TRUE, 0, n * sizeof(float), &out[0], 0, NULL, NULL);
+  for (size_t i = 0; i < n; i++)
+    OCL_ASSERT(out[i] == data[i]);
+
+  for (size_t i = 0; i < new_n; i++)
+    OCL_CALL(clReleaseMemObject, news[i]);
+  OCL_CALL(clReleaseEvent, user_event);
+}
+
+MAKE_UTEST_FROM_FUNCTION(buffer_slab_release_pending);
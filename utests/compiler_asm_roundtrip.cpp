@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include "utest_helper.hpp"
+
+/* Kernels built with -dump-opt-asm are disassembled, assembled back and
+ * compared with their binary. Every instruction must come back unchanged:
+ * the dump is what a hand written override starts from. */
+static void compiler_asm_roundtrip(void)
+{
+  const char *kernels[] = {
+    "compiler_if_else", "compiler_switch", "compiler_local_memory_barrier",
+    "compiler_global_memory_barrier", "compiler_insn_recompact", "compiler_math",
+  };
+  const char *asm_file = "test_roundtrip_asm_dump.txt";
+
+  if (!cl_check_gen8())
+    return;
+  for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+    char file_name[256];
+    cl_uint insns = 0, same = 0;
+    snprintf(file_name, sizeof(file_name), "%s.cl", kernels[i]);
+    cl_kernel_destroy(true);
+    OCL_CALL(cl_kernel_init, file_name, kernels[i], SOURCE, "-dump-opt-asm=test_roundtrip_asm_dump.txt");
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_INSTRUCTION_COUNT_INTEL,
+             sizeof(insns), &insns, NULL);
+    OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_ASM_ROUNDTRIP_COUNT_INTEL,
+             sizeof(same), &same, NULL);
+    OCL_ASSERT(insns > 0);
+    if (same != insns)
+      printf("\n%s: only %u of %u instructions reassemble unchanged", kernels[i], same, insns);
+    OCL_ASSERT(same == insns);
+  }
+  cl_kernel_destroy(true);
+  std::remove(asm_file);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_asm_roundtrip);
@@ -36,3 +36,59 @@ void compiler_device_enqueue(void)
 }
 
 MAKE_UTEST_FROM_FUNCTION(compiler_device_enqueue);
+
+static volatile bool device_enqueue_running;
+
+static void *device_enqueue_flush_thread(void *arg)
+{
+  cl_command_queue q = (cl_command_queue)arg;
+  while (device_enqueue_running)
+    clFlush(q);
+  return NULL;
+}
+
+/* The children of a kernel are held to go to the GPU in one submission.
+ * Flushing the queue meanwhile must submit what is held, every launch
+ * still runs exactly once. */
+static void compiler_device_enqueue_flush(void)
+{
+  if(!cl_check_ocl20(false))
+    return;
+  const size_t n = 32;
+  const uint32_t global_sz = 3;
+  uint32_t result = 0;
+  cl_ulong before[2], after[2];
+  pthread_t tid;
+
+  OCL_CALL(cl_kernel_init, "compiler_device_enqueue.cl", "compiler_device_enqueue", SOURCE, "-cl-std=CL2.0");
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(uint32_t), NULL);
+  OCL_SET_ARG(0, sizeof(uint32_t), &global_sz);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[0]);
+  OCL_MAP_BUFFER(0);
+  for(uint32_t i = 0; i < n; ++i)
+    ((uint32_t *)buf_data[0])[i] = 0;
+  OCL_UNMAP_BUFFER(0);
+
+  OCL_CALL(clGetCommandQueueInfo, queue, CL_QUEUE_SUBMIT_STATS_INTEL, sizeof(before), before, NULL);
+  device_enqueue_running = true;
+  OCL_ASSERT(pthread_create(&tid, NULL, device_enqueue_flush_thread, queue) == 0);
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_NDRANGE(1);
+  OCL_FINISH();
+  device_enqueue_running = false;
+  pthread_join(tid, NULL);
+  OCL_CALL(clGetCommandQueueInfo, queue, CL_QUEUE_SUBMIT_STATS_INTEL, sizeof(after), after, NULL);
+  // The parent and one child per enqueue_kernel of each work item
+  OCL_ASSERT(after[1] - before[1] == 1 + n * global_sz);
+
+  for(uint32_t i = 0; i < global_sz; ++i)
+    result += i;
+  result *= global_sz;
+  OCL_MAP_BUFFER(0);
+  for (uint32_t i = 0; i < n; ++i)
+    OCL_ASSERT(((uint32_t *)buf_data[0])[i] == result);
+  OCL_UNMAP_BUFFER(0);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_device_enqueue_flush);
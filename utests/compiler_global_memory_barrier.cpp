@@ -1,3 +1,7 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
 #include "utest_helper.hpp"
 
 static void compiler_global_memory_barrier(void)
@@ -26,3 +30,46 @@ static void compiler_global_memory_barrier(void)
 }
 
 MAKE_UTEST_FROM_FUNCTION(compiler_global_memory_barrier);
+
+/* GRFs of an instruction line of the asm dump, in order */
+static std::vector<int> asm_line_grfs(const char *text)
+{
+  std::vector<int> grfs;
+  for (const char *p = text; *p; p++)
+    if (*p == 'g' && (p == text || *(p - 1) == ' ') && isdigit(p[1]))
+      grfs.push_back(atoi(p + 1));
+  return grfs;
+}
+
+/* The barrier fence is followed by a self MOV of its reply register, which
+ * makes the thread wait for the fence. The final cleanup of the code must
+ * keep it. */
+static void compiler_global_memory_barrier_fence_wait(void)
+{
+  const char *asm_file = "test_fence_asm_dump.txt";
+  char line[1024];
+  bool found = false;
+  int fence_grf = -1;
+
+  std::remove(asm_file);
+  OCL_CALL(cl_kernel_init, "compiler_global_memory_barrier.cl", "compiler_global_memory_barrier",
+           SOURCE, "-dump-opt-asm=test_fence_asm_dump.txt");
+  FILE *fp = fopen(asm_file, "r");
+  OCL_ASSERT(fp != NULL);
+  while (fgets(line, sizeof(line), fp)) {
+    const char *insn = strstr(line, ")  ");
+    if (strncmp(line, "    (", 5) != 0 || insn == NULL)
+      continue;
+    insn += 3;
+    std::vector<int> grfs = asm_line_grfs(insn);
+    if (fence_grf >= 0 && strstr(insn, "mov(") && grfs.size() >= 2 &&
+        grfs[0] == fence_grf && grfs[1] == fence_grf)
+      found = true;
+    fence_grf = strstr(insn, "send(") && grfs.size() > 0 ? grfs[0] : -1;
+  }
+  fclose(fp);
+  std::remove(asm_file);
+  OCL_ASSERT(found);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_global_memory_barrier_fence_wait);
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <vector>
+#include "utest_helper.hpp"
+
+struct asm_jump {
+  int from;     /* instruction the offsets are relative to */
+  int target[2];
+  int targetNum;
+};
+
+/* Branches are printed as "<op>(<width>) jip [uip]" in instruction units,
+ * JMPI is relative to the next native instruction */
+static bool asm_line_jump(int id, const char *insn, asm_jump &jump)
+{
+  static const struct { const char *name; int offsets; } ops[] = {
+    {"if", 2}, {"else", 2}, {"brc", 1}, {"endif", 1}, {"while", 1}, {"brd", 1}, {"jmpi", 1},
+  };
+  if (*insn == '(')
+    insn = strchr(insn, ' ') + 1;
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    const size_t len = strlen(ops[i].name);
+    if (strncmp(insn, ops[i].name, len) != 0 || insn[len] != '(')
+      continue;
+    char *end = (char *)strchr(insn + len, ')') + 1;
+    jump.from = strcmp(ops[i].name, "jmpi") == 0 ? id + 2 : id;
+    jump.targetNum = ops[i].offsets;
+    for (int j = 0; j < jump.targetNum; j++)
+      jump.target[j] = jump.from + (int)strtol(end, &end, 10);
+    return true;
+  }
+  return false;
+}
+
+/* Recompaction moves every instruction after a shrunk one, every jump of the
+ * final stream must still land on the start of an instruction and the code
+ * must still run correctly */
+static void compiler_insn_recompact(void)
+{
+  const char *asm_file = "test_recompact_asm_dump.txt";
+  const int n = 16, iters = 5;
+  char line[1024];
+  std::vector<int> ids;
+  std::vector<asm_jump> jumps;
+
+  std::remove(asm_file);
+  OCL_CALL(cl_kernel_init, "compiler_insn_recompact.cl", "compiler_insn_recompact",
+           SOURCE, "-dump-opt-asm=test_recompact_asm_dump.txt");
+  FILE *fp = fopen(asm_file, "r");
+  OCL_ASSERT(fp != NULL);
+  while (fgets(line, sizeof(line), fp)) {
+    const char *insn = strstr(line, ")  ");
+    if (strncmp(line, "    (", 5) != 0 || insn == NULL)
+      continue;
+    asm_jump jump;
+    ids.push_back(atoi(line + 5));
+    if (asm_line_jump(ids.back(), insn + 3, jump))
+      jumps.push_back(jump);
+  }
+  fclose(fp);
+  std::remove(asm_file);
+  OCL_ASSERT(ids.size() > 0 && jumps.size() > 0);
+
+  // Gen7 never recompacts and encodes its jumps differently
+  if (cl_check_gen8()) {
+    const std::set<int> starts(ids.begin(), ids.end());
+    std::set<int> compacted;
+    for (size_t i = 0; i + 1 < ids.size(); i++)
+      if (ids[i + 1] - ids[i] == 1)
+        compacted.insert(ids[i]);
+    bool overCompacted = false;
+    for (size_t i = 0; i < jumps.size(); i++) {
+      for (int j = 0; j < jumps[i].targetNum; j++) {
+        const int target = jumps[i].target[j];
+        OCL_ASSERT(starts.count(target) == 1);
+        const int lo = std::min(jumps[i].from, target), hi = std::max(jumps[i].from, target);
+        if (compacted.lower_bound(lo) != compacted.lower_bound(hi))
+          overCompacted = true;
+      }
+    }
+    const char *recompact = getenv("OCL_RECOMPACT_INSN");
+    if (recompact == NULL || atoi(recompact) != 0)
+      OCL_ASSERT(overCompacted);
+  }
+
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(int), NULL);
+  OCL_MAP_BUFFER(0);
+  for (int i = 0; i < n; i++)
+    ((int *)buf_data[0])[i] = (i * 7) % 13 - 3;
+  OCL_UNMAP_BUFFER(0);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(int), &iters);
+  globals[0] = n;
+  locals[0] = n;
+  OCL_NDRANGE(1);
+
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(1);
+  for (int id = 0; id < n; id++) {
+    int sum = 0;
+    for (int i = 0; i < iters; i++) {
+      const int v = ((int *)buf_data[0])[(id + i) % 16];
+      if (v > id)
+        sum += v * 3;
+      else if (v & 1)
+        sum -= v;
+      else
+        sum ^= i;
+    }
+    OCL_ASSERT(((int *)buf_data[1])[id] == sum);
+  }
+  OCL_UNMAP_BUFFER(1);
+  OCL_UNMAP_BUFFER(0);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_insn_recompact);
@@ -0,0 +1,111 @@
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "utest_helper.hpp"
+
+/* Read/write buffer and their rect variants go through the host copy engine,
+ * which splits transfers of several MB across the host worker pool. Check
+ * unaligned pointers, odd row sizes and pitches, and overlapping ranges. */
+
+static size_t rect_offset(const size_t origin[3], size_t row_pitch, size_t slice_pitch,
+                          size_t y, size_t z)
+{
+  return origin[0] + (origin[1] + y) * row_pitch + (origin[2] + z) * slice_pitch;
+}
+
+/* What a rect copy between two distinct layouts does */
+static void rect_ref(uint8_t *dst, const size_t dst_origin[3], size_t dst_row_pitch, size_t dst_slice_pitch,
+                     const uint8_t *src, const size_t src_origin[3], size_t src_row_pitch, size_t src_slice_pitch,
+                     const size_t region[3])
+{
+  for (size_t z = 0; z < region[2]; z++)
+    for (size_t y = 0; y < region[1]; y++)
+      memcpy(dst + rect_offset(dst_origin, dst_row_pitch, dst_slice_pitch, y, z),
+             src + rect_offset(src_origin, src_row_pitch, src_slice_pitch, y, z), region[0]);
+}
+
+static void enqueue_host_copy_unaligned_rect(void)
+{
+  const size_t row_pitch = 3019, slice_pitch = row_pitch * 709, n = slice_pitch * 4;
+  const size_t host_row_pitch = 3011, host_slice_pitch = host_row_pitch * 705, host_n = host_slice_pitch * 3;
+  const size_t buffer_origin[3] = { 5, 3, 1 }, host_origin[3] = { 1, 2, 0 };
+  const size_t region[3] = { 3001, 700, 3 };
+  const size_t write_origin[3] = { 11, 0, 0 }, write_region[3] = { 2999, 699, 3 };
+  std::vector<uint8_t> data(n + 1), out(n + 3), host(host_n + 1), ref(host_n);
+  uint8_t *src = &data[1], *dst = &host[1];
+
+  for (size_t i = 0; i < n; i++)
+    src[i] = (uint8_t)(i * 7 + 3);
+  OCL_CREATE_BUFFER(buf[0], 0, n, NULL);
+
+  /* Linear transfers from and to pointers of no alignment */
+  OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, n, src, 0, NULL, NULL);
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, n, &out[3], 0, NULL, NULL);
+  OCL_ASSERT(memcmp(&out[3], src, n) == 0);
+
+  /* Rect read, the bytes around the region must stay */
+  memset(dst, 0xa5, host_n);
+  memset(&ref[0], 0xa5, host_n);
+  OCL_CALL(clEnqueueReadBufferRect, queue, buf[0], CL_TRUE, buffer_origin, host_origin, region,
+           row_pitch, slice_pitch, host_row_pitch, host_slice_pitch, dst, 0, NULL, NULL);
+  rect_ref(&ref[0], host_origin, host_row_pitch, host_slice_pitch,
+           src, buffer_origin, row_pitch, slice_pitch, region);
+  OCL_ASSERT(memcmp(dst, &ref[0], host_n) == 0);
+
+  /* Rect write of another region back, then the whole buffer */
+  for (size_t i = 0; i < host_n; i++)
+    dst[i] = (uint8_t)(i * 13 + 1);
+  OCL_CALL(clEnqueueWriteBufferRect, queue, buf[0], CL_TRUE, write_origin, host_origin, write_region,
+           row_pitch, slice_pitch, host_row_pitch, host_slice_pitch, dst, 0, NULL, NULL);
+  rect_ref(src, write_origin, row_pitch, slice_pitch,
+           dst, host_origin, host_row_pitch, host_slice_pitch, write_region);
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, n, &out[3], 0, NULL, NULL);
+  OCL_ASSERT(memcmp(&out[3], src, n) == 0);
+}
+
+MAKE_UTEST_FROM_FUNCTION(enqueue_host_copy_unaligned_rect);
+
+static void enqueue_host_copy_overlap(void)
+{
+  const size_t n = 8 << 20, shift = 4099;
+  const size_t row_pitch = 8192, slice_pitch = n;
+  const size_t buffer_origin[3] = { 7, 3, 0 }, host_origin[3] = { 12, 5, 0 };
+  const size_t region[3] = { 5000, 1000, 1 };
+  std::vector<uint8_t> orig(n), out(n), ref(n);
+  void *host = NULL;
+  uint8_t *h;
+
+  OCL_ASSERT(posix_memalign(&host, 4096, n) == 0);
+  h = (uint8_t *)host;
+  for (size_t i = 0; i < n; i++)
+    orig[i] = (uint8_t)(i * 11 + 5);
+  memcpy(h, &orig[0], n);
+  /* Where supported, the buffer uses the host memory itself */
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_USE_HOST_PTR, n, host);
+
+  /* Read of the whole buffer into its host memory */
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, n, h, 0, NULL, NULL);
+  OCL_ASSERT(memcmp(h, &orig[0], n) == 0);
+
+  /* Write from a source overlapping the destination */
+  OCL_CALL(clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, n - shift, h + shift, 0, NULL, NULL);
+  ref = orig;
+  memmove(&ref[0], &orig[shift], n - shift);
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, n, &out[0], 0, NULL, NULL);
+  OCL_ASSERT(memcmp(&out[0], &ref[0], n) == 0);
+
+  /* Rect read into the host memory, the destination lines after the source.
+   * Every line gets the buffer data before the copy, out holds it */
+  OCL_CALL(clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, n, h, 0, NULL, NULL);
+  OCL_CALL(clEnqueueReadBufferRect, queue, buf[0], CL_TRUE, buffer_origin, host_origin, region,
+           row_pitch, slice_pitch, row_pitch, slice_pitch, h, 0, NULL, NULL);
+  rect_ref(&ref[0], host_origin, row_pitch, slice_pitch,
+           &out[0], buffer_origin, row_pitch, slice_pitch, region);
+  OCL_ASSERT(memcmp(h, &ref[0], n) == 0);
+
+  clReleaseMemObject(buf[0]);
+  buf[0] = NULL;
+  free(host);
+}
+
+MAKE_UTEST_FROM_FUNCTION(enqueue_host_copy_overlap);
@@ -0,0 +1,66 @@
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "utest_helper.hpp"
+
+/* Small copies and fills are done by the CPU on devices sharing memory with
+ * the host. Chain them behind a user event and between large copies done by
+ * a kernel, then check the data and which path each one took. A contiguous
+ * rectangle copy becomes an internal buffer copy, which is not counted. */
+
+static void enqueue_host_path(void)
+{
+  const size_t n = 64 * 1024, small = 256;
+  std::vector<uint8_t> data(n), out(n), ref(n);
+  cl_command_queue host_queue;
+  cl_event user_event;
+  cl_bool unified;
+  cl_ulong stats[4];
+  cl_int status;
+
+  setenv("OCL_HOST_PATH_THRESHOLD", "1024", 1);
+  host_queue = clCreateCommandQueue(ctx, device, 0, &status);
+  unsetenv("OCL_HOST_PATH_THRESHOLD");
+  OCL_ASSERT(status == CL_SUCCESS);
+  OCL_CALL(clGetDeviceInfo, device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+
+  for (size_t i = 0; i < n; i++)
+    data[i] = (uint8_t)(i * 13);
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_COPY_HOST_PTR, n, &data[0]);
+  OCL_CREATE_BUFFER(buf[1], 0, n, NULL);
+  OCL_CREATE_USER_EVENT(user_event);
+
+  /* kernel copy, host fill over it, host copy, kernel copy of the result */
+  const uint32_t pattern = 0xdeadbeef;
+  OCL_CALL(clEnqueueCopyBuffer, host_queue, buf[0], buf[1], 0, 0, n / 2, 1, &user_event, NULL);
+  OCL_CALL(clEnqueueFillBuffer, host_queue, buf[1], &pattern, sizeof(pattern), 128, small, 0, NULL, NULL);
+  OCL_CALL(clEnqueueCopyBuffer, host_queue, buf[0], buf[1], n - small - 3, 1000, small + 3, 0, NULL, NULL);
+  OCL_CALL(clEnqueueCopyBuffer, host_queue, buf[1], buf[1], 0, n / 2, n / 2, 0, NULL, NULL);
+  const size_t rect_origin[3] = { 0, 0, 0 }, rect_dst_origin[3] = { n - small, 0, 0 };
+  const size_t rect_region[3] = { small, 1, 1 };
+  OCL_CALL(clEnqueueCopyBufferRect, host_queue, buf[0], buf[1], rect_origin, rect_dst_origin,
+           rect_region, small, small, small, small, 0, NULL, NULL);
+  OCL_SET_USER_EVENT_STATUS(user_event, CL_COMPLETE);
+
+  memset(&ref[0], 0, n);
+  memcpy(&ref[0], &data[0], n / 2);
+  for (size_t i = 0; i < small; i += sizeof(pattern))
+    memcpy(&ref[128 + i], &pattern, sizeof(pattern));
+  memcpy(&ref[1000], &data[n - small - 3], small + 3);
+  memcpy(&ref[n / 2], &ref[0], n / 2);
+  memcpy(&ref[n - small], &data[0], small);
+
+  OCL_CALL(clEnqueueReadBuffer, host_queue, buf[1], CL_TRUE, 0, n, &out[0], 0, NULL, NULL);
+  for (size_t i = 0; i < n; i++)
+    OCL_ASSERT(out[i] == ref[i]);
+
+  OCL_CALL(clGetCommandQueueInfo, host_queue, CL_QUEUE_HOST_PATH_STATS_INTEL,
+           sizeof(stats), stats, NULL);
+  OCL_ASSERT(stats[0] == (unified ? 1 : 0) && stats[0] + stats[1] == 3);
+  OCL_ASSERT(stats[2] == (unified ? 1 : 0) && stats[2] + stats[3] == 1);
+
+  OCL_CALL(clReleaseEvent, user_event);
+  OCL_CALL(clReleaseCommandQueue, host_queue);
+}
+
+MAKE_UTEST_FROM_FUNCTION(enqueue_host_path);
@@ -0,0 +1,49 @@
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "utest_helper.hpp"
+
+/* With a staging ring, a non-blocking write takes a copy of the host data at
+ * enqueue time. Hold the writes behind a user event, scribble over the host
+ * buffer and check the buffer still gets the data of the enqueue. */
+
+static void enqueue_write_staging(void)
+{
+  const size_t n = 4096, write_n = 8;
+  std::vector<uint32_t> host(n), out(n * write_n);
+  cl_command_queue staged_queue;
+  cl_event user_event;
+  cl_ulong stats[3];
+  cl_int status;
+
+  setenv("OCL_WRITE_STAGING_RING", "1048576", 1);
+  staged_queue = clCreateCommandQueue(ctx, device, 0, &status);
+  unsetenv("OCL_WRITE_STAGING_RING");
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CREATE_BUFFER(buf[0], 0, n * write_n * sizeof(uint32_t), NULL);
+  OCL_CREATE_USER_EVENT(user_event);
+  for (size_t w = 0; w < write_n; w++) {
+    for (size_t i = 0; i < n; i++)
+      host[i] = w * n + i;
+    OCL_CALL(clEnqueueWriteBuffer, staged_queue, buf[0], CL_FALSE, w * n * sizeof(uint32_t),
+             n * sizeof(uint32_t), &host[0], 1, &user_event, NULL);
+    memset(&host[0], 0xff, n * sizeof(uint32_t));
+  }
+  OCL_SET_USER_EVENT_STATUS(user_event, CL_COMPLETE);
+
+  OCL_CALL(clEnqueueReadBuffer, staged_queue, buf[0], CL_TRUE, 0, n * write_n * sizeof(uint32_t),
+           &out[0], 0, NULL, NULL);
+  for (size_t i = 0; i < n * write_n; i++)
+    OCL_ASSERT(out[i] == i);
+
+  OCL_CALL(clGetCommandQueueInfo, staged_queue, CL_QUEUE_WRITE_STAGING_STATS_INTEL,
+           sizeof(stats), stats, NULL);
+  OCL_ASSERT(stats[0] == write_n);
+  OCL_ASSERT(stats[1] == write_n * n * sizeof(uint32_t));
+
+  OCL_CALL(clReleaseEvent, user_event);
+  OCL_CALL(clReleaseCommandQueue, staged_queue);
+}
+
+MAKE_UTEST_FROM_FUNCTION(enqueue_write_staging);
@@ -0,0 +1,174 @@
+#include <string.h>
+#include <vector>
+#include "utest_helper.hpp"
+extern "C" {
+#include "cl_image_tiling.h"
+}
+
+/* Read and write image convert tiled images on the host when they can. Check
+ * them, on every pixel size and on sub-rectangles, against a map of the
+ * image, which is detiled by the GTT fence. */
+
+static void check_against_map(cl_mem image, const std::vector<uint8_t> &ref,
+                              size_t w, size_t h, size_t d, size_t bpp)
+{
+  size_t origin[3] = { 0, 0, 0 };
+  size_t region[3] = { w, h, d };
+  size_t row_pitch = 0, slice_pitch = 0;
+  cl_int status;
+
+  uint8_t *ptr = (uint8_t *)clEnqueueMapImage(queue, image, CL_TRUE, CL_MAP_READ, origin, region,
+                                              &row_pitch, &slice_pitch, 0, NULL, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  for (size_t z = 0; z < d; z++)
+    for (size_t y = 0; y < h; y++)
+      OCL_ASSERT(memcmp(ptr + z * slice_pitch + y * row_pitch, &ref[(z * h + y) * w * bpp], w * bpp) == 0);
+  OCL_CALL(clEnqueueUnmapMemObject, queue, image, ptr, 0, NULL, NULL);
+  OCL_FINISH();
+}
+
+static void image_host_tiling_run(cl_mem_object_type type, size_t w, size_t h, size_t d)
+{
+  /* Slice pitches must be 0 for 2D images */
+  const size_t slices = d > 1 ? 1 : 0;
+  const struct { cl_channel_order order; cl_channel_type type; size_t bpp; } formats[] = {
+    { CL_R, CL_UNSIGNED_INT8, 1 },
+    { CL_RG, CL_UNSIGNED_INT8, 2 },
+    { CL_RGBA, CL_UNSIGNED_INT8, 4 },
+    { CL_RGBA, CL_UNSIGNED_INT16, 8 },
+    { CL_RGBA, CL_UNSIGNED_INT32, 16 },
+  };
+  /* origin, region */
+  const size_t rects[][6] = {
+    { 0, 0, 0, w, h, d },
+    { 1, 1, 0, 1, 1, 1 },
+    { 3, 5, 0, w - 3, h - 5, 1 },
+    { w / 2 - 7, 9, d - 1, 17, h - 18, 1 },
+    { w - 1, h - 1, d - 1, 1, 1, 1 },
+    { 5, 0, 0, w - 10, 31, d },
+  };
+
+  for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+    const size_t bpp = formats[f].bpp;
+    cl_image_format format;
+    cl_image_desc desc;
+    std::vector<uint8_t> ref(w * h * d * bpp);
+
+    memset(&desc, 0x0, sizeof(cl_image_desc));
+    format.image_channel_order = formats[f].order;
+    format.image_channel_data_type = formats[f].type;
+    desc.image_type = type;
+    desc.image_width = w;
+    desc.image_height = h;
+    desc.image_depth = type == CL_MEM_OBJECT_IMAGE3D ? d : 0;
+    desc.image_array_size = type == CL_MEM_OBJECT_IMAGE2D_ARRAY ? d : 0;
+    OCL_CREATE_IMAGE(buf[0], 0, &format, &desc, NULL);
+
+    for (size_t i = 0; i < ref.size(); i++)
+      ref[i] = rand();
+    size_t origin[3] = { 0, 0, 0 };
+    size_t region[3] = { w, h, d };
+    OCL_CALL(clEnqueueWriteImage, queue, buf[0], CL_TRUE, origin, region,
+             w * bpp, slices * w * h * bpp, &ref[0], 0, NULL, NULL);
+    check_against_map(buf[0], ref, w, h, d, bpp);
+
+    for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); r++) {
+      const size_t *o = rects[r], *s = rects[r] + 3;
+      const size_t row = s[0] * bpp;
+      std::vector<uint8_t> data(row * s[1] * s[2]);
+
+      /* Read the rectangle, then write it back with new contents */
+      OCL_CALL(clEnqueueReadImage, queue, buf[0], CL_TRUE, o, s, row, slices * row * s[1],
+               &data[0], 0, NULL, NULL);
+      for (size_t z = 0; z < s[2]; z++)
+        for (size_t y = 0; y < s[1]; y++) {
+          uint8_t *ref_row = &ref[(((o[2] + z) * h + o[1] + y) * w + o[0]) * bpp];
+          uint8_t *data_row = &data[(z * s[1] + y) * row];
+          OCL_ASSERT(memcmp(data_row, ref_row, row) == 0);
+          for (size_t x = 0; x < row; x++)
+            ref_row[x] = data_row[x] = rand();
+        }
+      OCL_CALL(clEnqueueWriteImage, queue, buf[0], CL_TRUE, o, s, row, slices * row * s[1],
+               &data[0], 0, NULL, NULL);
+      check_against_map(buf[0], ref, w, h, d, bpp);
+    }
+    OCL_CALL(clReleaseMemObject, buf[0]);
+    buf[0] = NULL;
+  }
+}
+
+static void image_host_tiling(void)
+{
+  image_host_tiling_run(CL_MEM_OBJECT_IMAGE2D, 157, 67, 1);
+  image_host_tiling_run(CL_MEM_OBJECT_IMAGE2D_ARRAY, 61, 45, 3);
+  image_host_tiling_run(CL_MEM_OBJECT_IMAGE3D, 61, 45, 3);
+}
+
+MAKE_UTEST_FROM_FUNCTION(image_host_tiling);
+
+/* Host only: check the row copies of the tiling library against the scalar
+ * swizzle, on every pixel size, many pitches and odd rectangles. */
+static void image_host_tiling_swizzle_run(cl_image_tiling_t tiling, size_t pitch)
+{
+  const size_t tile_h = tiling == CL_TILE_X ? 8 : 32;
+  const size_t slice_rows = 3 * tile_h, slices = 3;
+  const size_t slice_pitch = slice_rows * pitch;
+  const size_t bpps[] = { 1, 2, 4, 8, 16 };
+  std::vector<uint8_t> tiled(slice_pitch * slices), expect(tiled.size());
+
+  for (size_t i = 0; i < tiled.size(); i++)
+    tiled[i] = rand();
+
+  for (size_t b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++) {
+    const size_t bpp = bpps[b], w = pitch / bpp;
+    for (int iter = 0; iter < 64; iter++) {
+      size_t origin[3], region[3];
+      origin[0] = rand() % w;
+      origin[1] = rand() % slice_rows;
+      origin[2] = rand() % slices;
+      region[0] = 1 + rand() % (w - origin[0]);
+      region[1] = 1 + rand() % (slice_rows - origin[1]);
+      region[2] = 1 + rand() % (slices - origin[2]);
+
+      /* Odd linear pitches, so rows and slices are not aligned */
+      const size_t row = region[0] * bpp;
+      const size_t lin_row_pitch = row + rand() % 19;
+      const size_t lin_slice_pitch = lin_row_pitch * region[1] + rand() % 23;
+      std::vector<uint8_t> lin(lin_slice_pitch * region[2]);
+
+      cl_image_detile(&lin[0], lin_row_pitch, lin_slice_pitch, &tiled[0], tiling,
+                      pitch, slice_pitch, bpp, origin, region);
+      for (size_t z = 0; z < region[2]; z++)
+        for (size_t y = 0; y < region[1]; y++) {
+          const size_t surf_y = (origin[2] + z) * slice_rows + origin[1] + y;
+          const uint8_t *l = &lin[z * lin_slice_pitch + y * lin_row_pitch];
+          for (size_t x = 0; x < row; x++)
+            OCL_ASSERT(l[x] == tiled[cl_image_tiling_offset(tiling, pitch, origin[0] * bpp + x, surf_y)]);
+        }
+
+      for (size_t i = 0; i < lin.size(); i++)
+        lin[i] = rand();
+      expect = tiled;
+      for (size_t z = 0; z < region[2]; z++)
+        for (size_t y = 0; y < region[1]; y++) {
+          const size_t surf_y = (origin[2] + z) * slice_rows + origin[1] + y;
+          const uint8_t *l = &lin[z * lin_slice_pitch + y * lin_row_pitch];
+          for (size_t x = 0; x < row; x++)
+            expect[cl_image_tiling_offset(tiling, pitch, origin[0] * bpp + x, surf_y)] = l[x];
+        }
+      cl_image_tile(&tiled[0], tiling, pitch, slice_pitch, bpp, origin, region,
+                    &lin[0], lin_row_pitch, lin_slice_pitch);
+      OCL_ASSERT(tiled == expect);
+    }
+  }
+}
+
+static void image_host_tiling_swizzle(void)
+{
+  for (size_t tiles = 1; tiles <= 5; tiles++) {
+    image_host_tiling_swizzle_run(CL_TILE_X, tiles * 512);
+    image_host_tiling_swizzle_run(CL_TILE_Y, tiles * 128);
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(image_host_tiling_swizzle);
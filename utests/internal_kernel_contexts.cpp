@@ -0,0 +1,58 @@
+#include <string.h>
+#include <vector>
+#include "utest_helper.hpp"
+
+/* Internal copy and fill kernels are loaded once per device and their
+ * instances recycled per context. Run many copies and fills in a row of
+ * short-lived contexts, with unaligned offsets and patterns of every size,
+ * and check each result. */
+
+static void internal_kernel_contexts(void)
+{
+  const size_t n = 4096, ctx_n = 4, round_n = 16;
+  std::vector<uint8_t> data(n), out(n), ref(n);
+  cl_int status;
+
+  for (size_t c = 0; c < ctx_n; c++) {
+    cl_context short_ctx = clCreateContext(NULL, 1, &device, NULL, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    cl_command_queue short_queue = clCreateCommandQueue(short_ctx, device, 0, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+
+    for (size_t i = 0; i < n; i++)
+      data[i] = (uint8_t)(i * 7 + c);
+    cl_mem src = clCreateBuffer(short_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, n, &data[0], &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    cl_mem dst = clCreateBuffer(short_ctx, CL_MEM_READ_WRITE, n, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+
+    memset(&ref[0], 0, n);
+    OCL_CALL(clEnqueueFillBuffer, short_queue, dst, "\0", 1, 0, n, 0, NULL, NULL);
+    for (size_t r = 0; r < round_n; r++) {
+      const size_t pattern_sz = (size_t)1 << (r % 8);
+      const size_t off = (r * 3 % 5) * pattern_sz, sz = (r + 1) * 64 * pattern_sz % (n / 2) + pattern_sz;
+      uint8_t pattern[128];
+      for (size_t i = 0; i < pattern_sz; i++)
+        pattern[i] = (uint8_t)(r * 31 + i);
+
+      OCL_CALL(clEnqueueFillBuffer, short_queue, dst, pattern, pattern_sz, off, sz, 0, NULL, NULL);
+      for (size_t i = 0; i < sz; i++)
+        ref[off + i] = pattern[i % pattern_sz];
+
+      const size_t src_off = r * 13 % 7, dst_off = n / 2 + r * 5 % 3, cb = 1000 + r * 17;
+      OCL_CALL(clEnqueueCopyBuffer, short_queue, src, dst, src_off, dst_off, cb, 0, NULL, NULL);
+      memcpy(&ref[dst_off], &data[src_off], cb);
+    }
+
+    OCL_CALL(clEnqueueReadBuffer, short_queue, dst, CL_TRUE, 0, n, &out[0], 0, NULL, NULL);
+    for (size_t i = 0; i < n; i++)
+      OCL_ASSERT(out[i] == ref[i]);
+
+    OCL_CALL(clReleaseMemObject, src);
+    OCL_CALL(clReleaseMemObject, dst);
+    OCL_CALL(clReleaseCommandQueue, short_queue);
+    OCL_CALL(clReleaseContext, short_ctx);
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(internal_kernel_contexts);
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <vector>
+#include "utest_helper.hpp"
+extern "C" {
+#include "cl_mem.h"
+#include "cl_mem_registry.h"
+}
+
+/* The registry of the memory objects of a context, driven on the host with
+ * random adds, removes and host pointer changes. Every lookup is checked
+ * against a linear search: the oldest object whose range holds the address
+ * is the one found. */
+
+#define MEM_REGISTRY_BASE 0x10000
+
+static void *mem_registry_random_ptr(size_t slots)
+{
+  return (void *)(uintptr_t)(MEM_REGISTRY_BASE + (rand() % slots) * 64);
+}
+
+static cl_mem mem_registry_ref_find(std::vector<struct _cl_mem_buffer> &objs,
+                                    const std::vector<uint64_t> &seq,
+                                    const void *p, bool svm_only)
+{
+  cl_mem best = NULL;
+  uint64_t best_seq = 0;
+
+  for (size_t i = 0; i < objs.size(); i++) {
+    cl_mem mem = &objs[i].base;
+    if (seq[i] == 0 || mem->host_ptr == NULL)
+      continue;
+    if (svm_only && !(mem->is_svm && mem->type == CL_MEM_SVM_TYPE))
+      continue;
+    if ((uintptr_t)mem->host_ptr <= (uintptr_t)p &&
+        (uintptr_t)p < (uintptr_t)mem->host_ptr + mem->size &&
+        (best == NULL || seq[i] < best_seq)) {
+      best = mem;
+      best_seq = seq[i];
+    }
+  }
+  return best;
+}
+
+/* Buffers and SVM allocations, some without host pointer */
+static void mem_registry_random(void)
+{
+  const size_t n = 1000, slots = 2000;
+  std::vector<struct _cl_mem_buffer> objs(n);
+  std::vector<uint64_t> seq(n, 0);   /* 0 when not registered */
+  uint64_t next_seq = 0;
+  cl_mem_registry reg;
+
+  srand(1);
+  cl_mem_registry_init(&reg);
+  for (int iter = 0; iter < 50000; iter++) {
+    const size_t i = rand() % n;
+    cl_mem mem = &objs[i].base;
+    if (seq[i] == 0) {
+      mem->host_ptr = rand() % 3 ? mem_registry_random_ptr(slots) : NULL;
+      mem->size = rand() % 1000 + 1;
+      mem->is_svm = rand() % 2;
+      mem->type = mem->is_svm ? CL_MEM_SVM_TYPE : CL_MEM_BUFFER_TYPE;
+      OCL_ASSERT(cl_mem_registry_add(&reg, mem) == CL_SUCCESS);
+      seq[i] = ++next_seq;
+    } else if (rand() % 4 == 0 && mem->type != CL_MEM_SVM_TYPE) {
+      OCL_ASSERT(cl_mem_registry_set_host_ptr(&reg, mem,
+                 rand() % 2 ? mem_registry_random_ptr(slots) : NULL) == CL_SUCCESS);
+    } else {
+      cl_mem_registry_remove(&reg, mem);
+      seq[i] = 0;
+    }
+
+    const size_t j = rand() % n;
+    OCL_ASSERT(cl_mem_registry_contains(&reg, &objs[j].base) == (seq[j] != 0));
+    const void *p = (const void *)(uintptr_t)(MEM_REGISTRY_BASE + rand() % (slots * 64 + 1000));
+    OCL_ASSERT(cl_mem_registry_find_host_ptr(&reg, p) == mem_registry_ref_find(objs, seq, p, false));
+    OCL_ASSERT(cl_mem_registry_find_svm(&reg, p) == mem_registry_ref_find(objs, seq, p, true));
+  }
+  for (size_t i = 0; i < n; i++)
+    if (seq[i])
+      cl_mem_registry_remove(&reg, &objs[i].base);
+  cl_mem_registry_destroy(&reg);
+}
+
+MAKE_UTEST_FROM_FUNCTION(mem_registry_random);
+
+/* Sub-buffers inside the range of their parent are not indexed, the parent
+ * is found first anyway. Moving either host pointer must keep the lookups
+ * right. */
+static void mem_registry_random_sub_buffer(void)
+{
+  const size_t n = 1000, parent_n = 100, slots = 500;
+  std::vector<struct _cl_mem_buffer> objs(n);
+  std::vector<uint64_t> seq(n, 0);
+  std::vector<int> sub_n(parent_n, 0);
+  uint64_t next_seq = 0;
+  cl_mem_registry reg;
+
+  srand(2);
+  cl_mem_registry_init(&reg);
+  for (size_t i = 0; i < n; i++)
+    pthread_mutex_init(&objs[i].sub_lock, NULL);
+  for (int iter = 0; iter < 50000; iter++) {
+    const size_t i = rand() % n;
+    struct _cl_mem_buffer *buf = &objs[i];
+    cl_mem mem = &buf->base;
+    if (seq[i] == 0) {
+      if (i < parent_n) {
+        mem->type = CL_MEM_BUFFER_TYPE;
+        mem->host_ptr = rand() % 4 ? mem_registry_random_ptr(slots) : NULL;
+        mem->size = rand() % 4000 + 1;
+      } else {
+        struct _cl_mem_buffer *parent = &objs[rand() % parent_n];
+        if (seq[parent - &objs[0]] == 0)
+          continue;
+        mem->type = CL_MEM_SUBBUFFER_TYPE;
+        mem->host_ptr = parent->base.host_ptr;
+        mem->size = rand() % parent->base.size + 1;
+        buf->parent = parent;
+        buf->sub_prev = NULL;
+        buf->sub_next = parent->subs;
+        if (parent->subs)
+          parent->subs->sub_prev = buf;
+        parent->subs = buf;
+        sub_n[parent - &objs[0]]++;
+      }
+      OCL_ASSERT(cl_mem_registry_add(&reg, mem) == CL_SUCCESS);
+      seq[i] = ++next_seq;
+    } else if (rand() % 4 == 0) {
+      OCL_ASSERT(cl_mem_registry_set_host_ptr(&reg, mem,
+                 rand() % 3 ? mem_registry_random_ptr(slots) : NULL) == CL_SUCCESS);
+    } else if (i >= parent_n) {
+      if (buf->sub_prev)
+        buf->sub_prev->sub_next = buf->sub_next;
+      if (buf->sub_next)
+        buf->sub_next->sub_prev = buf->sub_prev;
+      if (buf->parent->subs == buf)
+        buf->parent->subs = buf->sub_next;
+      sub_n[buf->parent - &objs[0]]--;
+      cl_mem_registry_remove(&reg, mem);
+      seq[i] = 0;
+    } else if (sub_n[i] == 0) {
+      cl_mem_registry_remove(&reg, mem);
+      seq[i] = 0;
+    }
+
+    const void *p = (const void *)(uintptr_t)(MEM_REGISTRY_BASE + rand() % (slots * 64 + 4000));
+    OCL_ASSERT(cl_mem_registry_find_host_ptr(&reg, p) == mem_registry_ref_find(objs, seq, p, false));
+  }
+  for (size_t i = n; i-- > 0; )
+    if (seq[i])
+      cl_mem_registry_remove(&reg, &objs[i].base);
+  for (size_t i = 0; i < n; i++)
+    pthread_mutex_destroy(&objs[i].sub_lock);
+  cl_mem_registry_destroy(&reg);
+}
+
+MAKE_UTEST_FROM_FUNCTION(mem_registry_random_sub_buffer);
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utest_helper.hpp"
+extern "C" {
+#include "null/null_driver.h"
+}
+
+/* The null driver, driven on the host through the driver interface: buffers
+ * keep their data, flushed batches land in the log with what was bound to
+ * them and complete after the configured delay. */
+
+static void null_driver_fill_batch(cl_gpgpu gpgpu, const char *name, cl_buffer bo,
+                                   uint32_t offset, uint8_t bti, uint32_t curbe_sz)
+{
+  const size_t off[3] = { 0, 0, 0 }, global[3] = { 256, 4, 1 }, local[3] = { 16, 2, 1 };
+  static const char curbe[256] = { 0 };
+  cl_gpgpu_kernel kernel;
+
+  memset(&kernel, 0, sizeof(kernel));
+  kernel.name = name;
+  OCL_ASSERT(cl_gpgpu_batch_reset(gpgpu, 4096) == 0);
+  OCL_ASSERT(cl_gpgpu_state_init(gpgpu, 64, 1, 0) == 0);
+  cl_gpgpu_bind_buf(gpgpu, bo, offset, 0, 1024, bti);
+  OCL_ASSERT(cl_gpgpu_upload_curbes(gpgpu, curbe, curbe_sz) == 0);
+  OCL_ASSERT(cl_gpgpu_states_setup(gpgpu, &kernel) == 0);
+  cl_gpgpu_walker(gpgpu, 16, 32, off, off, global, local);
+}
+
+static void null_driver_buffers(void)
+{
+  cl_driver drv;
+  cl_buffer bo, user_bo;
+  char data[4096], out[4096];
+  void *user = NULL;
+
+  null_setup_callbacks();
+  drv = cl_driver_new(NULL);
+  OCL_ASSERT(drv != NULL);
+
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = (char)(i * 7);
+  bo = cl_buffer_alloc(cl_driver_get_bufmgr(drv), "null buffer", sizeof(data), 4096);
+  OCL_ASSERT(bo != NULL);
+  OCL_ASSERT(cl_buffer_get_size(bo) == sizeof(data));
+  OCL_ASSERT(((uintptr_t)cl_buffer_get_virtual(bo) & 4095) == 0);
+  OCL_ASSERT(cl_buffer_subdata(bo, 0, sizeof(data), data) == 0);
+  OCL_ASSERT(cl_buffer_map(bo, 0) == 0);
+  OCL_ASSERT(memcmp(cl_buffer_get_virtual(bo), data, sizeof(data)) == 0);
+  OCL_ASSERT(cl_buffer_unmap(bo) == 0);
+  OCL_ASSERT(cl_buffer_get_subdata(bo, 100, 1000, out) == 0);
+  OCL_ASSERT(memcmp(out, data + 100, 1000) == 0);
+  OCL_ASSERT(!cl_buffer_is_busy(bo));
+
+  /* A userptr buffer is the memory of the application, which it keeps */
+  OCL_ASSERT(posix_memalign(&user, 4096, sizeof(data)) == 0);
+  user_bo = cl_buffer_alloc_userptr(cl_driver_get_bufmgr(drv), "null userptr", user, sizeof(data), 0);
+  OCL_ASSERT(user_bo != NULL);
+  OCL_ASSERT(cl_buffer_get_virtual(user_bo) == user);
+  OCL_ASSERT(cl_buffer_subdata(user_bo, 0, sizeof(data), data) == 0);
+  OCL_ASSERT(memcmp(user, data, sizeof(data)) == 0);
+  cl_buffer_unreference(user_bo);
+  memset(user, 0, sizeof(data));
+  free(user);
+
+  /* Zero sized buffers still have valid storage */
+  cl_buffer empty = cl_buffer_alloc(cl_driver_get_bufmgr(drv), "null empty", 0, 64);
+  OCL_ASSERT(empty != NULL && cl_buffer_get_virtual(empty) != NULL);
+  cl_buffer_unreference(empty);
+
+  cl_buffer_unreference(bo);
+  cl_driver_delete(drv);
+}
+
+MAKE_UTEST_FROM_FUNCTION(null_driver_buffers);
+
+static void null_driver_record(void)
+{
+  cl_driver drv;
+  cl_buffer bo;
+  cl_gpgpu gpgpu[2];
+  const char *names[2] = { "null_first", "null_second" };
+  const null_batch_record_t *rec;
+
+  null_setup_callbacks();
+  drv = cl_driver_new(NULL);
+  OCL_ASSERT(drv != NULL);
+  bo = cl_buffer_alloc(cl_driver_get_bufmgr(drv), "null buffer", 4096, 64);
+  OCL_ASSERT(bo != NULL);
+
+  /* Chained batches are logged one by one, in order */
+  for (int i = 0; i < 2; i++) {
+    gpgpu[i] = cl_gpgpu_new(drv);
+    OCL_ASSERT(gpgpu[i] != NULL);
+    null_driver_fill_batch(gpgpu[i], names[i], bo, 128 * i, 2 + i, 64 * (i + 1));
+  }
+  OCL_ASSERT(cl_gpgpu_chain(gpgpu[0], gpgpu[1]) == 0);
+  OCL_ASSERT(cl_gpgpu_flush(gpgpu[0]) == 0);
+
+  OCL_ASSERT(null_driver_get_batch_n(drv) == 2);
+  OCL_ASSERT(null_driver_get_record_n(drv) == 2);
+  for (uint32_t i = 0; i < 2; i++) {
+    rec = null_driver_get_record(drv, i);
+    OCL_ASSERT(rec != NULL);
+    OCL_ASSERT(rec->seqno == i);
+    OCL_ASSERT(strcmp(rec->kernel_name, names[i]) == 0);
+    OCL_ASSERT(rec->curbe_sz == 64 * (i + 1));
+    OCL_ASSERT(rec->walker_n == 1);
+    OCL_ASSERT(rec->walkers[0].simd_sz == 16 && rec->walkers[0].thread_n == 32);
+    OCL_ASSERT(rec->walkers[0].global_wk_sz[0] == 256 && rec->walkers[0].global_wk_sz[1] == 4);
+    OCL_ASSERT(rec->walkers[0].local_wk_sz[0] == 16 && rec->walkers[0].local_wk_sz[1] == 2);
+    OCL_ASSERT(rec->surface_n == 1);
+    OCL_ASSERT(!rec->surfaces[0].is_image);
+    OCL_ASSERT(rec->surfaces[0].bti == 2 + i);
+    OCL_ASSERT(rec->surfaces[0].offset == 128 * i);
+    OCL_ASSERT(rec->surfaces[0].size == 1024);
+    OCL_ASSERT(rec->complete_ns == rec->submit_ns);
+  }
+  OCL_ASSERT(null_driver_get_record(drv, 2) == NULL);
+
+  /* Dropping the log keeps counting the batches */
+  null_driver_reset_records(drv);
+  OCL_ASSERT(null_driver_get_record_n(drv) == 0);
+  null_driver_fill_batch(gpgpu[0], names[0], bo, 0, 2, 64);
+  OCL_ASSERT(cl_gpgpu_flush(gpgpu[0]) == 0);
+  OCL_ASSERT(null_driver_get_batch_n(drv) == 3);
+  rec = null_driver_get_record(drv, 0);
+  OCL_ASSERT(rec != NULL && rec->seqno == 2);
+
+  for (int i = 0; i < 2; i++)
+    cl_gpgpu_delete(gpgpu[i]);
+  cl_buffer_unreference(bo);
+  cl_driver_delete(drv);
+}
+
+MAKE_UTEST_FROM_FUNCTION(null_driver_record);
+
+static void null_driver_delay(void)
+{
+  const uint64_t delay_ns = 50 * 1000 * 1000;
+  cl_driver drv;
+  cl_buffer bo;
+  cl_gpgpu gpgpu;
+  cl_gpgpu_event event;
+  const null_batch_record_t *rec;
+
+  /* Batches take 50ms, only the first one is logged */
+  setenv("OCL_NULL_DRIVER_DELAY_US", "50000", 1);
+  setenv("OCL_NULL_DRIVER_RECORD", "1", 1);
+  null_setup_callbacks();
+  drv = cl_driver_new(NULL);
+  unsetenv("OCL_NULL_DRIVER_DELAY_US");
+  unsetenv("OCL_NULL_DRIVER_RECORD");
+  OCL_ASSERT(drv != NULL);
+  bo = cl_buffer_alloc(cl_driver_get_bufmgr(drv), "null buffer", 4096, 64);
+  gpgpu = cl_gpgpu_new(drv);
+  OCL_ASSERT(bo != NULL && gpgpu != NULL);
+
+  null_driver_fill_batch(gpgpu, "null_delay", bo, 0, 2, 64);
+  event = cl_gpgpu_event_new(gpgpu);
+  OCL_ASSERT(event != NULL);
+  OCL_ASSERT(cl_gpgpu_event_update_status(event, 0) == command_queued);
+  OCL_ASSERT(cl_gpgpu_flush(gpgpu) == 0);
+  cl_gpgpu_event_flush(event);
+
+  /* The bound buffer is busy until the batch is done */
+  OCL_ASSERT(cl_buffer_is_busy(bo));
+  OCL_ASSERT(cl_gpgpu_event_update_status(event, 0) == command_running);
+  OCL_ASSERT(cl_gpgpu_event_update_status(event, 1) == command_complete);
+  OCL_ASSERT(!cl_buffer_is_busy(bo));
+  cl_gpgpu_event_delete(event);
+
+  rec = null_driver_get_record(drv, 0);
+  OCL_ASSERT(rec != NULL);
+  OCL_ASSERT(rec->complete_ns - rec->submit_ns == delay_ns);
+
+  null_driver_fill_batch(gpgpu, "null_delay", bo, 0, 2, 64);
+  OCL_ASSERT(cl_gpgpu_flush(gpgpu) == 0);
+  OCL_ASSERT(null_driver_get_batch_n(drv) == 2);
+  OCL_ASSERT(null_driver_get_record_n(drv) == 1);
+
+  cl_gpgpu_delete(gpgpu);
+  cl_buffer_unreference(bo);
+  cl_driver_delete(drv);
+}
+
+MAKE_UTEST_FROM_FUNCTION(null_driver_delay);
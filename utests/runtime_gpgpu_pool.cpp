@@ -0,0 +1,79 @@
+#include "utest_helper.hpp"
+
+/* Each queue keeps the gpgpu states of retired launches and hands them out
+ * again. A reused state must bind the buffers of its new launch, a state
+ * whose event is still held stays out of the pool, and the events keep the
+ * pool alive after their queue is gone. */
+
+#define POOL_N 1024
+#define POOL_LAUNCH_N 8
+
+static void pool_launch(cl_command_queue q, cl_mem src, cl_event *ev)
+{
+  size_t global = POOL_N, local = 16;
+
+  OCL_CALL(clSetKernelArg, kernel, 0, sizeof(cl_mem), &src);
+  OCL_CALL(clSetKernelArg, kernel, 1, sizeof(cl_mem), &buf[2]);
+  OCL_CALL(clEnqueueNDRangeKernel, q, kernel, 1, NULL, &global, &local, 0, NULL, ev);
+  /* The queue worker deletes the event, giving the state back, only after
+   * it completed: the second clFinish waits for the worker to be done */
+  OCL_CALL(clFinish, q);
+  OCL_CALL(clFinish, q);
+}
+
+static void pool_check(cl_command_queue q, float base)
+{
+  float out[POOL_N];
+
+  OCL_CALL(clEnqueueReadBuffer, q, buf[2], CL_TRUE, 0, sizeof(out), out, 0, NULL, NULL);
+  for (int i = 0; i < POOL_N; i++)
+    OCL_ASSERT(out[i] == base + i);
+}
+
+static void runtime_gpgpu_pool(void)
+{
+  cl_command_queue pool_queue;
+  cl_ulong before[2], after[2];
+  cl_event held;
+  float data[2][POOL_N];
+  cl_int status;
+
+  pool_queue = clCreateCommandQueue(ctx, device, 0, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  OCL_CREATE_KERNEL("test_copy_buffer");
+  for (int i = 0; i < POOL_N; i++) {
+    data[0][i] = i;
+    data[1][i] = 10000.0f + i;
+  }
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_COPY_HOST_PTR, sizeof(data[0]), data[0]);
+  OCL_CREATE_BUFFER(buf[1], CL_MEM_COPY_HOST_PTR, sizeof(data[1]), data[1]);
+  OCL_CREATE_BUFFER(buf[2], 0, sizeof(data[0]), NULL);
+
+  /* Once the first launch retired, every launch reuses a state, with the
+   * source of this launch bound */
+  pool_launch(pool_queue, buf[0], NULL);
+  OCL_CALL(clGetCommandQueueInfo, pool_queue, CL_QUEUE_GPGPU_POOL_STATS_INTEL, sizeof(before), before, NULL);
+  for (int i = 0; i < POOL_LAUNCH_N; i++) {
+    pool_launch(pool_queue, buf[i & 1], NULL);
+    pool_check(pool_queue, (i & 1) ? 10000.0f : 0.0f);
+  }
+  OCL_CALL(clGetCommandQueueInfo, pool_queue, CL_QUEUE_GPGPU_POOL_STATS_INTEL, sizeof(after), after, NULL);
+  OCL_ASSERT(after[0] >= before[0] + POOL_LAUNCH_N);
+  OCL_ASSERT(after[1] == before[1]);
+
+  /* The state of a held event does not go back to the pool */
+  pool_launch(pool_queue, buf[1], &held);
+  OCL_CALL(clGetCommandQueueInfo, pool_queue, CL_QUEUE_GPGPU_POOL_STATS_INTEL, sizeof(before), before, NULL);
+  pool_launch(pool_queue, buf[0], NULL);
+  OCL_CALL(clGetCommandQueueInfo, pool_queue, CL_QUEUE_GPGPU_POOL_STATS_INTEL, sizeof(after), after, NULL);
+  OCL_ASSERT(after[1] == before[1] + 1);
+  pool_check(pool_queue, 0.0f);
+
+  /* The held event outlives its queue, then gives its state back */
+  clReleaseCommandQueue(pool_queue);
+  OCL_CALL(clGetEventInfo, held, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+  OCL_ASSERT(status == CL_COMPLETE);
+  clReleaseEvent(held);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_gpgpu_pool);
@@ -0,0 +1,72 @@
+#include "utest_helper.hpp"
+
+/* Host commands of out-of-order queues run on the host worker pool. A native
+ * kernel there which waits for a command queued behind it must not hold
+ * the pool: with more of them than pool threads, this would hang. */
+
+#define OUTER_N 16
+
+struct nested_args {
+  cl_command_queue q;
+  int *inner_done;
+  int *outer_done;
+};
+
+static void inner_func(void *args)
+{
+  struct nested_args *a = (struct nested_args *)args;
+  __sync_fetch_and_add(a->inner_done, 1);
+}
+
+static void outer_func(void *args)
+{
+  struct nested_args *a = (struct nested_args *)args;
+  cl_event gate, inner_ev;
+  cl_int status;
+
+  /* Gated, so the inner command goes through the queue and the pool */
+  gate = clCreateUserEvent(ctx, &status);
+  if (status != CL_SUCCESS)
+    return;
+  status = clEnqueueNativeKernel(a->q, inner_func, a, sizeof(*a), 0, NULL, NULL,
+                                 1, &gate, &inner_ev);
+  if (status == CL_SUCCESS) {
+    clSetUserEventStatus(gate, CL_COMPLETE);
+    if (clWaitForEvents(1, &inner_ev) == CL_SUCCESS)
+      __sync_fetch_and_add(a->outer_done, 1);
+    clReleaseEvent(inner_ev);
+  }
+  clReleaseEvent(gate);
+}
+
+static void runtime_host_worker_wait(void)
+{
+  cl_command_queue ooo_queue;
+  cl_event gate;
+  cl_int status;
+  int inner_done = 0, outer_done = 0;
+  struct nested_args args;
+
+  ooo_queue = clCreateCommandQueue(ctx, device, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  args.q = ooo_queue;
+  args.inner_done = &inner_done;
+  args.outer_done = &outer_done;
+
+  /* Let all the outer commands become ready at once */
+  OCL_CREATE_USER_EVENT(gate);
+  for (int i = 0; i < OUTER_N; i++)
+    OCL_CALL(clEnqueueNativeKernel, ooo_queue, outer_func, &args, sizeof(args), 0, NULL, NULL,
+             1, &gate, NULL);
+  OCL_SET_USER_EVENT_STATUS(gate, CL_COMPLETE);
+
+  OCL_CALL(clFinish, ooo_queue);
+  OCL_ASSERT(outer_done == OUTER_N);
+  OCL_ASSERT(inner_done == OUTER_N);
+
+  clReleaseEvent(gate);
+  clReleaseCommandQueue(ooo_queue);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_host_worker_wait);
@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include "utest_helper.hpp"
+
+/* With OCL_NDRANGE_COALESCE, consecutive launches of an in-order queue go
+ * to the GPU in one submission. They must still run in order, and a finish
+ * must submit what is held without waiting for the chain to fill. */
+
+#define CHAIN_N 1024
+#define CHAIN_MAX 8
+
+static void chain_launch(cl_command_queue q, cl_uint k, cl_uint *ref)
+{
+  size_t global = CHAIN_N, local = 16;
+
+  OCL_SET_ARG(1, sizeof(cl_uint), &k);
+  OCL_CALL(clEnqueueNDRangeKernel, q, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+  for (cl_uint i = 0; i < CHAIN_N; i++)
+    ref[i] = ref[i] * 3 + k + i;
+}
+
+static void chain_check(cl_command_queue q, const cl_uint *ref)
+{
+  cl_uint out[CHAIN_N];
+
+  OCL_CALL(clEnqueueReadBuffer, q, buf[0], CL_TRUE, 0, sizeof(out), out, 0, NULL, NULL);
+  for (int i = 0; i < CHAIN_N; i++)
+    OCL_ASSERT(out[i] == ref[i]);
+}
+
+static void runtime_ndrange_chain(void)
+{
+  cl_command_queue chain_queue;
+  cl_ulong before[2], after[2];
+  cl_uint ref[CHAIN_N];
+  cl_int status;
+
+  /* Held batches wait up to a second for the chain to fill */
+  setenv("OCL_NDRANGE_COALESCE", "8", 1);
+  setenv("OCL_NDRANGE_COALESCE_US", "1000000", 1);
+  chain_queue = clCreateCommandQueue(ctx, device, 0, &status);
+  unsetenv("OCL_NDRANGE_COALESCE");
+  unsetenv("OCL_NDRANGE_COALESCE_US");
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  OCL_CREATE_KERNEL("runtime_ndrange_chain");
+  for (int i = 0; i < CHAIN_N; i++)
+    ref[i] = i;
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_COPY_HOST_PTR, sizeof(ref), ref);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_CALL(clFinish, chain_queue);
+
+  /* A full chain, each launch reads what the previous one wrote */
+  OCL_CALL(clGetCommandQueueInfo, chain_queue, CL_QUEUE_SUBMIT_STATS_INTEL, sizeof(before), before, NULL);
+  for (cl_uint k = 0; k < CHAIN_MAX; k++)
+    chain_launch(chain_queue, k * 7 + 1, ref);
+  OCL_CALL(clFinish, chain_queue);
+  OCL_CALL(clGetCommandQueueInfo, chain_queue, CL_QUEUE_SUBMIT_STATS_INTEL, sizeof(after), after, NULL);
+  OCL_ASSERT(after[1] - before[1] == CHAIN_MAX);
+  OCL_ASSERT(after[0] - before[0] < CHAIN_MAX);
+  chain_check(chain_queue, ref);
+
+  /* A partial chain goes out on finish */
+  OCL_CALL(clGetCommandQueueInfo, chain_queue, CL_QUEUE_SUBMIT_STATS_INTEL, sizeof(before), before, NULL);
+  for (cl_uint k = 0; k < 3; k++)
+    chain_launch(chain_queue, k + 100, ref);
+  OCL_CALL(clFinish, chain_queue);
+  OCL_CALL(clGetCommandQueueInfo, chain_queue, CL_QUEUE_SUBMIT_STATS_INTEL, sizeof(after), after, NULL);
+  OCL_ASSERT(after[1] - before[1] == 3);
+  chain_check(chain_queue, ref);
+
+  clReleaseCommandQueue(chain_queue);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_ndrange_chain);
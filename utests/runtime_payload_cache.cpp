@@ -0,0 +1,62 @@
+#include "utest_helper.hpp"
+
+/* Each kernel keeps the per-thread CURBEs built for its last local sizes and
+ * only patches the uniform part when one is used again. Every launch must
+ * see its own arguments and the local IDs of its own local size, through
+ * hits, patches and the replacement of cached sizes. */
+
+#define PAYLOAD_W 64
+#define PAYLOAD_H 8
+
+static const size_t payload_locals[][2] = {
+  { 16, 1 }, { 8, 2 }, { 4, 4 }, { 32, 2 }, { 2, 8 },
+  { 64, 1 }, { 1, 8 }, { 16, 4 }, { 8, 8 }, { 4, 2 },
+};
+
+static void payload_launch(size_t l, int a, int b)
+{
+  const size_t lx = payload_locals[l][0], ly = payload_locals[l][1];
+
+  OCL_SET_ARG(1, sizeof(int), &a);
+  OCL_SET_ARG(2, sizeof(int), &b);
+  globals[0] = PAYLOAD_W;
+  globals[1] = PAYLOAD_H;
+  locals[0] = lx;
+  locals[1] = ly;
+  OCL_NDRANGE(2);
+
+  OCL_MAP_BUFFER(0);
+  for (size_t y = 0; y < PAYLOAD_H; y++)
+    for (size_t x = 0; x < PAYLOAD_W; x++) {
+      const int lid = (int)((y % ly) * lx + x % lx);
+      OCL_ASSERT(((int *)buf_data[0])[y * PAYLOAD_W + x] == a + b * lid + 100000 * (int)lx);
+    }
+  OCL_UNMAP_BUFFER(0);
+}
+
+static void runtime_payload_cache(void)
+{
+  const size_t local_n = sizeof(payload_locals) / sizeof(payload_locals[0]);
+
+  OCL_CREATE_KERNEL("runtime_payload_cache");
+  OCL_CREATE_BUFFER(buf[0], 0, PAYLOAD_W * PAYLOAD_H * sizeof(int), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+
+  /* Same local size, the arguments change every launch */
+  for (int i = 0; i < 4; i++)
+    payload_launch(0, i * 3 + 1, i + 2);
+
+  /* Two cached local sizes in turn */
+  for (int i = 0; i < 6; i++)
+    payload_launch(i & 1, i * 5 - 7, 3 - i);
+
+  /* More local sizes than the cache keeps, twice, so sizes get replaced
+   * and built again */
+  for (size_t i = 0; i < 2 * local_n; i++)
+    payload_launch(i % local_n, (int)i * 11, (int)i + 1);
+
+  /* Back to the first size, with the arguments it had */
+  payload_launch(0, 1, 2);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_payload_cache);
@@ -1,4 +1,6 @@
+#include <string>
 #include "utest_helper.hpp"
+#include "utest_file_map.hpp"
 
 void test_printf(void)
 {
@@ -70,3 +72,131 @@ void test_printf_4(void)
 }
 
 MAKE_UTEST_FROM_FUNCTION(test_printf_4);
+
+void test_printf_reuse(void)
+{
+  cl_ulong before[2], after[2];
+  const int launch_n = 4;
+
+  // Setup kernel and buffers
+  OCL_CREATE_KERNEL_FROM_FILE("test_printf", "test_printf_2");
+  globals[0] = 4;
+  locals[0] = 2;
+
+  // Every launch once the first has retired gets its printf buffer back.
+  // The queue worker retires a launch just after it completed, the second
+  // finish waits for it
+  OCL_NDRANGE(1);
+  OCL_FINISH();
+  OCL_FINISH();
+  OCL_CALL(clGetCommandQueueInfo, queue, CL_QUEUE_BO_CACHE_STATS_INTEL, sizeof(before), before, NULL);
+  for (int i = 0; i < launch_n; i++) {
+    OCL_NDRANGE(1);
+    OCL_FINISH();
+    OCL_FINISH();
+  }
+  OCL_CALL(clGetCommandQueueInfo, queue, CL_QUEUE_BO_CACHE_STATS_INTEL, sizeof(after), after, NULL);
+  OCL_ASSERT(after[0] >= before[0] + launch_n);
+  OCL_ASSERT(after[1] == before[1]);
+}
+
+MAKE_UTEST_FROM_FUNCTION(test_printf_reuse);
+
+/* With cl_arm_printf the output of a launch reaches the context callback in
+ * one piece instead of stdout. */
+static void CL_CALLBACK printf_callback(const char *buf, unsigned int len, size_t complete, void *user_data)
+{
+  std::string *out = (std::string *)user_data;
+  OCL_ASSERT(complete);
+  out->append(buf, len);
+}
+
+void test_printf_callback(void)
+{
+  std::string out;
+  cl_int status;
+  cl_context_properties props[] = {
+    CL_PRINTF_CALLBACK_ARM, (cl_context_properties)printf_callback, 0
+  };
+  cl_context cb_ctx = clCreateContext(props, 1, &device, NULL, &out, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  cl_command_queue cb_queue = clCreateCommandQueue(cb_ctx, device, 0, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  char *ker_path = cl_do_kiss_path("test_printf.cl", device);
+  cl_file_map_t *fm = cl_file_map_new();
+  OCL_ASSERT(cl_file_map_open(fm, ker_path) == CL_FILE_MAP_SUCCESS);
+  const char *src = cl_file_map_begin(fm);
+  cl_program cb_program = clCreateProgramWithSource(cb_ctx, 1, &src, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+  free(ker_path);
+  cl_file_map_delete(fm);
+  OCL_CALL(clBuildProgram, cb_program, 1, &device, NULL, NULL, NULL);
+  cl_kernel cb_kernel = clCreateKernel(cb_program, "test_printf_2", &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  globals[0] = 4;
+  locals[0] = 2;
+  OCL_CALL(clEnqueueNDRangeKernel, cb_queue, cb_kernel, 1, NULL, globals, locals, 0, NULL, NULL);
+  OCL_CALL(clFinish, cb_queue);
+
+  /* Work items may print in any order, count the lines of each kind */
+  int float_n = 0, long_n = 0;
+  size_t begin = 0, end;
+  OCL_ASSERT(!out.empty() && out[out.size() - 1] == '\n');
+  while ((end = out.find('\n', begin)) != std::string::npos) {
+    const std::string line = out.substr(begin, end - begin);
+    if (line == "float 2.000000")
+      float_n++;
+    else if (line == "long abcd1234ccccdddd")
+      long_n++;
+    else
+      OCL_ASSERT(0);
+    begin = end + 1;
+  }
+  OCL_ASSERT(float_n == 4 && long_n == 4);
+
+  OCL_CALL(clReleaseKernel, cb_kernel);
+  OCL_CALL(clReleaseProgram, cb_program);
+  OCL_CALL(clReleaseCommandQueue, cb_queue);
+  OCL_CALL(clReleaseContext, cb_ctx);
+}
+
+MAKE_UTEST_FROM_FUNCTION(test_printf_callback);
+
+// Launch n work items, tell whether a new printf buffer was allocated
+static bool printf_launch_allocates(size_t n)
+{
+  cl_ulong before[2], after[2];
+
+  globals[0] = n;
+  OCL_CALL(clGetCommandQueueInfo, queue, CL_QUEUE_BO_CACHE_STATS_INTEL, sizeof(before), before, NULL);
+  OCL_NDRANGE(1);
+  // The state, with its printf buffer, is back once the worker is done
+  OCL_FINISH();
+  OCL_FINISH();
+  OCL_CALL(clGetCommandQueueInfo, queue, CL_QUEUE_BO_CACHE_STATS_INTEL, sizeof(after), after, NULL);
+  OCL_ASSERT(after[0] + after[1] > before[0] + before[1]);
+  return after[1] != before[1];
+}
+
+void test_printf_bucket(void)
+{
+  const int id = -1;
+
+  // The printf buffer takes 64 bytes per work item and printf, at least 1MB.
+  // Nothing is printed, as no work item matches
+  OCL_CREATE_KERNEL_FROM_FILE("test_printf", "test_printf_cond");
+  OCL_SET_ARG(0, sizeof(int), &id);
+  locals[0] = 16;
+
+  // 1.28MB gets a 2MB buffer, which 1.92MB reuses
+  printf_launch_allocates(20000);
+  OCL_ASSERT(!printf_launch_allocates(30000));
+  // 2.56MB needs a 4MB one, then both classes are served from the cache
+  OCL_ASSERT(printf_launch_allocates(40000));
+  OCL_ASSERT(!printf_launch_allocates(20000));
+  OCL_ASSERT(!printf_launch_allocates(60000));
+}
+
+MAKE_UTEST_FROM_FUNCTION(test_printf_bucket);
@@ -1040,6 +1040,19 @@ int cl_check_half(void)
   return 1;
 }
 
+int cl_check_gen8(void)
+{
+  char name[256] = {0};
+  OCL_CALL(clGetDeviceInfo, device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+  if (std::strstr(name, "SandyBridge") || std::strstr(name, "IvyBridge") ||
+      std::strstr(name, "Haswell") || std::strstr(name, "Bay Trail")) {
+    printf("Not a Gen8+ device, Skip!");
+    return 0;
+  }
+
+  return 1;
+}
+
 uint32_t __half_to_float(uint16_t h, bool *isInf, bool *infSign)
 {
   uint32_t out_val = 0;
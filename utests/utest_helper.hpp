@@ -324,6 +324,9 @@ extern int cl_check_ocl20(bool or_beignet = true);
 /* Check is FP16 enabled. */
 extern int cl_check_half(void);
 
+/* Check is the device Gen8 or later, the ones with recompaction and the Gen assembler. */
+extern int cl_check_gen8(void);
+
 /* Helper function for half type numbers */
 extern uint32_t __half_to_float(uint16_t h, bool* isInf = NULL, bool* infSign = NULL);
 extern uint16_t __float_to_half(uint32_t x);